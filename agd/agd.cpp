@@ -1,4 +1,7 @@
+#include <QElapsedTimer>
+
 #include "agd.h"
+#include "GeodesicService.h"
 
 void agd::initParameters(RichParameterSet *pars)
 {
@@ -13,40 +16,21 @@ void agd::applyFilter(RichParameterSet *pars)
 	// Clear any past visualizations
 	drawArea()->deleteAllRenderObjects();
 
-	FilterPlugin * gd_plugin = pluginManager()->getFilter("Geodesic distance: heat kernel");
+	QElapsedTimer timer; timer.start();
+
+	// Heat method systems are factorized once for all sources
+	GeodesicService geodesic( mesh() );
 
 	BoolVertexProperty src_points = mesh()->vertex_property<bool>("v:geo_src_points", false);
-	ScalarVertexProperty geo_dist = mesh()->vertex_property<Scalar>("v:uniformDistance", 0);
+
+	std::vector<int> sources;
 
 	// Consider a subset of vertices
 	if(pars && pars->getBool("IsSubset"))
 	{
-		// Starting point
-		src_points[Vertex(0)] = true;
-
-		int numIter = pars->getInt("NumSubset");
-
-		for(int itr = 0; itr < numIter; itr++)
-		{
-			gd_plugin->applyFilter( NULL );
-
-			// Find furthest point, add it to source set
-			double maxDist = -DBL_MAX;
-			int maxIDX = -1;
-			foreach(Vertex v, mesh()->vertices())
-			{
-				if(geo_dist[v] > maxDist){
-					maxDist = geo_dist[v];
-					maxIDX = v.idx();
-				}
-			}
-
-			src_points[Vertex(maxIDX)] = true;
-
-			mainWindow()->setStatusBarMessage( QString("iter (%1) out of (%2)").arg(itr).arg(numIter)  );
-
-			qApp->processEvents();
-		}
+		// Starting point, then repeatedly the furthest point from the source set
+		sources = geodesic.farthestPoints( 0, pars->getInt("NumSubset") + 1 );
+		for(int s : sources) src_points[Vertex(s)] = true;
 
 		// Visualize selected subset
 		if(pars->getBool("VisualizeSubset"))
@@ -60,31 +44,16 @@ void agd::applyFilter(RichParameterSet *pars)
 	else
 	{
 		foreach(Vertex v, mesh()->vertices()) src_points[v] = true;
+		foreach(Vertex v, mesh()->vertices()) sources.push_back( v.idx() );
 	}
 
-	drawArea()->updateGL();
-	qApp->processEvents();
-
 	// Compute vertex-to-all distances
 	ScalarVertexProperty all_dist = mesh()->vertex_property<Scalar>("v:agd", 0);
 
-	RichParameterSet * gd_params = new RichParameterSet;
-	gd_plugin->initParameters( gd_params );
-	gd_params->setValue("visualizeDistance", false);
-
-	foreach(Vertex v, mesh()->vertices())
-	{
-		if(!src_points[v]) continue;
-
-		gd_params->setValue("sourceVertex", int( v.idx() ));
-		gd_plugin->applyFilter( gd_params );
-		ScalarVertexProperty geo_dist = mesh()->vertex_property<Scalar>("v:uniformDistance", 0);
+	Eigen::VectorXd sum = geodesic.sumDistances( sources );
+	foreach(Vertex v, mesh()->vertices()) all_dist[v] = sum[v.idx()];
 
-		foreach(Vertex v, mesh()->vertices())
-		{
-			all_dist[v] += geo_dist[v];
-		}
-	}
+	mainWindow()->setStatusBarMessage( QString("AGD from (%1) sources (%2 ms)").arg(sources.size()).arg(timer.elapsed()) );
 
 	double minVal = DBL_MAX;
 	double maxVal = -DBL_MAX;
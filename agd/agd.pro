@@ -4,3 +4,10 @@ StarlabTemplate(plugin)
 
 HEADERS += agd.h
 SOURCES += agd.cpp
+
+# Build options
+CONFIG(debug, debug|release) {CFG = debug} else {CFG = release}
+
+# Geodesic library
+LIBS += -L$$PWD/../geodesic/$$CFG/lib -lgeodesic
+INCLUDEPATH += ../geodesic
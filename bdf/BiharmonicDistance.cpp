@@ -0,0 +1,136 @@
+#include "BiharmonicDistance.h"
+
+#include <Eigen/Dense>
+
+BiharmonicDistance::BiharmonicDistance( const Eigen::SparseMatrix<double> & L, const Eigen::VectorXd & mass )
+	: n( int(L.rows()) ), L(L), mass(mass), isFactorized(false)
+{
+}
+
+bool BiharmonicDistance::factorize()
+{
+	if( isFactorized ) return true;
+
+	Eigen::SparseMatrix<double> K = L;
+	K.coeffRef(0, 0) += mass[0];
+
+	solver.compute( K );
+	isFactorized = (solver.info() == Eigen::Success);
+
+	return isFactorized;
+}
+
+Eigen::MatrixXd BiharmonicDistance::solve( const Eigen::MatrixXd & r )
+{
+	Eigen::MatrixXd x = solver.solve( r );
+
+	double totalMass = mass.sum();
+	for(int c = 0; c < x.cols(); c++)
+		x.col(c).array() -= mass.dot( x.col(c) ) / totalMass;
+
+	return x;
+}
+
+bool BiharmonicDistance::computeExactDiagonal( int blockSize )
+{
+	if( !factorize() ) return false;
+	if( diagonal.size() == n ) return true;
+
+	diagonal.resize( n );
+	Eigen::VectorXd massShift = mass / mass.sum();
+
+	for(int start = 0; start < n; start += blockSize)
+	{
+		int cols = std::min(blockSize, n - start);
+
+		// Unit sources, shifted to sum to zero without changing the result
+		Eigen::MatrixXd E = -massShift.replicate(1, cols);
+		for(int c = 0; c < cols; c++) E(start + c, c) += 1.0;
+
+		Eigen::MatrixXd G = solve( E );
+
+		for(int c = 0; c < cols; c++)
+			diagonal[start + c] = G.col(c).cwiseAbs2().dot( mass );
+	}
+
+	return true;
+}
+
+bool BiharmonicDistance::distances( int source, Eigen::VectorXd & result )
+{
+	if( !factorize() ) return false;
+
+	// Exact diagonal if it was asked for, otherwise the truncated one of the embedding
+	Eigen::VectorXd d;
+	if( diagonal.size() == n ) d = diagonal;
+	else if( embedding.rows() == n ) d = embedding.rowwise().squaredNorm();
+	else return false;
+
+	Eigen::VectorXd e = -mass / mass.sum();
+	e[source] += 1.0;
+
+	// Green's function of the source, then the bi-Laplacian response to it
+	Eigen::VectorXd g = solve( e );
+	Eigen::VectorXd h = solve( mass.cwiseProduct(g) );
+
+	result = (d.array() + d[source] - 2.0 * h.array()).max(0).sqrt();
+
+	return true;
+}
+
+bool BiharmonicDistance::computeEmbedding( int k, int iterations )
+{
+	k = std::min(k, n - 1);
+	int p = std::min(k + 1 + 10, n);
+
+	// Shift-invert subspace iteration on L phi = lambda M phi
+	double sigma = 1e-8 * L.diagonal().cwiseQuotient(mass).maxCoeff();
+
+	Eigen::SparseMatrix<double> S = L;
+	for(int i = 0; i < n; i++) S.coeffRef(i, i) += sigma * mass[i];
+
+	Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > shifted( S );
+	if( shifted.info() != Eigen::Success ) return false;
+
+	Eigen::MatrixXd Q = Eigen::MatrixXd::Random(n, p);
+	Eigen::VectorXd values;
+
+	for(int it = 0; it < iterations; it++)
+	{
+		Eigen::MatrixXd Y = shifted.solve( mass.asDiagonal() * Q );
+
+		// Rayleigh-Ritz in the spanned subspace
+		Eigen::MatrixXd A = Y.transpose() * (L * Y);
+		Eigen::MatrixXd B = Y.transpose() * mass.asDiagonal() * Y;
+		A = 0.5 * (A + A.transpose());
+		B = 0.5 * (B + B.transpose());
+
+		Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> ges( A, B );
+		Q = Y * ges.eigenvectors();
+		values = ges.eigenvalues();
+	}
+
+	// Drop the constant modes
+	double tolerance = 1e-10 * std::max(1.0, values.cwiseAbs().maxCoeff());
+	int first = 0;
+	while( first < p && values[first] < tolerance ) first++;
+	k = std::min(k, p - first);
+
+	eigenvalues = values.segment(first, k);
+	embedding = Q.middleCols(first, k) * eigenvalues.cwiseInverse().asDiagonal();
+
+	return true;
+}
+
+void BiharmonicDistance::spectralDistances( int source, Eigen::VectorXd & result ) const
+{
+	result = (embedding.rowwise() - embedding.row(source)).rowwise().norm();
+}
+
+size_t BiharmonicDistance::memoryBytes() const
+{
+	size_t bytes = sizeof(double) * (embedding.size() + eigenvalues.size() + diagonal.size() + mass.size());
+	bytes += (sizeof(double) + sizeof(int)) * L.nonZeros();
+	if( isFactorized ) bytes += (sizeof(double) + sizeof(int)) * solver.matrixL().nestedExpression().nonZeros();
+	return bytes;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+
+// Biharmonic distances d(i,j)^2 = sum_k (phi_k(i) - phi_k(j))^2 / lambda_k^2 of the
+// generalized problem L phi = lambda M phi, computed per source instead of as an
+// n x n matrix. The exact engine works from one sparse factorization of L, while the
+// spectral engine keeps a truncated k-dimensional embedding.
+//
+// The per-source distance also needs the diagonal terms sum_k phi_k(i)^2 / lambda_k^2 of
+// every vertex. By default they are taken from the embedding, so 'computeEmbedding' has
+// to run first. 'computeExactDiagonal' replaces them with exact values at the cost of n
+// solves, which only pays off when distances from many sources are needed.
+class BiharmonicDistance
+{
+public:
+	// 'L' is the (positive) cotangent Laplacian, 'mass' the lumped vertex areas
+	BiharmonicDistance( const Eigen::SparseMatrix<double> & L, const Eigen::VectorXd & mass );
+
+	// Distances from one source with two solves, false if the Laplacian could not be
+	// factorized or no diagonal is available (neither embedding nor exact diagonal)
+	bool distances( int source, Eigen::VectorXd & result );
+
+	// Exact diagonal terms: n solves in blocks of 'blockSize' right-hand sides
+	bool computeExactDiagonal( int blockSize = 64 );
+
+	// Truncated spectral embedding with k nonzero eigenpairs
+	bool computeEmbedding( int k, int iterations = 30 );
+	void spectralDistances( int source, Eigen::VectorXd & result ) const;
+	double spectralDistance( int i, int j ) const { return (embedding.row(i) - embedding.row(j)).norm(); }
+
+	Eigen::VectorXd eigenvalues;
+	Eigen::MatrixXd embedding;	// n x k, eigenvectors scaled by 1 / lambda
+
+	size_t memoryBytes() const;
+
+protected:
+	int n;
+	Eigen::SparseMatrix<double> L;
+	Eigen::VectorXd mass;
+
+	// Laplacian pinned at one vertex, giving solutions up to a constant
+	Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > solver;
+	bool isFactorized;
+	bool factorize();
+
+	// Solution of L x = r with r summing to zero, shifted to zero mass-weighted mean
+	Eigen::MatrixXd solve( const Eigen::MatrixXd & r );
+
+	// Squared M-norm of each vertex's Green's function, empty until 'computeExactDiagonal'
+	Eigen::VectorXd diagonal;
+};
@@ -5,11 +5,16 @@
 #include "RenderObjectExt.h"
 
 #include "redsvd.h"
+#include "BiharmonicDistance.h"
 
 void bdf::initParameters(RichParameterSet *pars)
 {
 	pars->addParam(new RichInt("StartVertex", 0, "Start vertex"));
+	pars->addParam(new RichBool("UseDense", false, "Dense all-pairs matrix"));
 	pars->addParam(new RichBool("UsePsudeoInverse", true, "UsePsudeoInverse"));
+	pars->addParam(new RichBool("Spectral", false, "Spectral embedding"));
+	pars->addParam(new RichBool("ExactDiagonal", false, "Exact diagonal (n solves)"));
+	pars->addParam(new RichInt("NumEigen", 50, "Num. eigenpairs"));
 	pars->addParam(new RichBool("Visualize", true, "Visualize"));
 }
 
@@ -104,6 +109,45 @@ void bdf::applyFilter(RichParameterSet *pars)
 	// Diagonal entries
 	for(unsigned int i = 0; i < AV.rows(); i++) AV[i] = 6.0 / AV[i];
 
+	int startVertex = pars->getInt("StartVertex");
+
+	// Distances from the start vertex only, without forming the n x n matrices
+	if( !pars->getBool("UseDense") )
+	{
+		QElapsedTimer timer; timer.start();
+
+		BiharmonicDistance engine( L, AV.cwiseInverse() );
+		Eigen::VectorXd dist;
+
+		if( pars->getBool("Spectral") )
+		{
+			if( !engine.computeEmbedding( pars->getInt("NumEigen") ) ) return;
+			engine.spectralDistances( startVertex, dist );
+		}
+		else
+		{
+			// Diagonal terms from the embedding unless the exact ones are asked for
+			if( pars->getBool("ExactDiagonal") ){
+				if( !engine.computeExactDiagonal() ) return;
+			}
+			else if( !engine.computeEmbedding( pars->getInt("NumEigen") ) ) return;
+
+			if( !engine.distances( startVertex, dist ) ) return;
+		}
+
+		mainWindow()->setStatusBarMessage(QString("Distances time (%1 ms) memory (%2 KB)").arg( timer.elapsed() ).arg( engine.memoryBytes() / 1024 ));
+
+		dist /= dist.maxCoeff();
+
+		if(pars->getBool("Visualize"))
+		{
+			for(Vertex v : mesh()->vertices())
+				drawArea()->drawPoint( points[v], 8, starlab::qtJetColor(dist[v.idx()]) );
+		}
+
+		return;
+	}
+
 	// System
 	Eigen::SparseMatrix<double> X = L * AV.asDiagonal() * L;
 
@@ -145,8 +189,6 @@ void bdf::applyFilter(RichParameterSet *pars)
 	// Visualize
 	if(pars->getBool("Visualize"))
 	{
-		int startVertex = pars->getInt("StartVertex");
-
 		for(Vertex v : mesh()->vertices())
 		{
             QColor c = starlab::qtJetColor(dB(startVertex, v.idx()));
@@ -2,5 +2,5 @@ include($$[STARLAB])
 include($$[SURFACEMESH])
 StarlabTemplate(plugin)
 
-HEADERS += bdf.h
-SOURCES += bdf.cpp
+HEADERS += bdf.h BiharmonicDistance.h
+SOURCES += bdf.cpp BiharmonicDistance.cpp
@@ -0,0 +1,108 @@
+#include "HarmonicFieldSolver.h"
+
+using namespace SurfaceMesh;
+
+typedef Eigen::SimplicialLLT< Eigen::SparseMatrix<double> > SparseSolver;
+
+const double HarmonicFieldSolver::ConstantWeight = 1000;
+
+void HarmonicFieldSolver::laplacianTriplets( SurfaceMeshModel * m_mesh, const ScalarVertexProperty & concaveVertices,
+	double avgEdgeLength, double ConcaveWeight, std::vector< Eigen::Triplet<double> > & A )
+{
+	typedef Eigen::Triplet<double> T;
+	Vector3VertexProperty points = m_mesh->vertex_coordinates();
+
+	for(Vertex v : m_mesh->vertices())
+	{
+		double tot = 0;
+
+		Vector3 v1 = points[v];
+
+		std::vector<double> wei(m_mesh->valence(v), 0);
+		int count = 0;
+
+		for(Halfedge h : m_mesh->onering_hedges(v))
+		{
+			Vertex vj = m_mesh->to_vertex(h);
+			Vector3 v2 = points[vj];
+
+			double w = 1.0;
+
+			if (concaveVertices[vj] || concaveVertices[v])
+			{
+				w = ((v1-v2).norm() / avgEdgeLength) * ConcaveWeight;
+			}
+
+			wei[count++] = w;
+			tot += w;
+		}
+
+		count = 0;
+		for(Halfedge h : m_mesh->onering_hedges(v))
+			A.push_back(T(v.idx(), m_mesh->to_vertex(h).idx(), wei[count++] / tot));
+		A.push_back(T(v.idx(), v.idx(), -1.0));
+	}
+}
+
+HarmonicFieldSolver::HarmonicFieldSolver( SurfaceMeshModel * mesh, const ScalarVertexProperty & concaveVertices, 
+	double avgEdgeLength, double ConcaveWeight ) : n( mesh->n_vertices() )
+{
+	std::vector< Eigen::Triplet<double> > A;
+	laplacianTriplets( mesh, concaveVertices, avgEdgeLength, ConcaveWeight, A );
+
+	Eigen::SparseMatrix<double> L(n, n);
+	L.setFromTriplets(A.begin(), A.end());
+	LTL = L.transpose() * L;
+}
+
+bool HarmonicFieldSolver::prepare( const std::vector<int> & samples )
+{
+	this->samples = samples;
+	if( samples.empty() ) return false;
+
+	// Pinning one vertex only fixes the constant offset, which is projected out below
+	Eigen::SparseMatrix<double> K = LTL;
+	K.coeffRef(samples.front(), samples.front()) += 1.0;
+
+	SparseSolver sparseSolver;
+	sparseSolver.compute( K );
+	if( sparseSolver.info() != Eigen::Success ) return false;
+
+	// Zero-mean right-hand sides lie in the range of the system
+	Eigen::MatrixXd E = Eigen::MatrixXd::Constant(n, samples.size(), -1.0 / n);
+	for(size_t k = 0; k < samples.size(); k++) E(samples[k], k) += 1.0;
+
+	Z = sparseSolver.solve( E );
+	if( sparseSolver.info() != Eigen::Success ) return false;
+
+	for(int k = 0; k < Z.cols(); k++)
+		Z.col(k).array() -= Z.col(k).mean();
+
+	return true;
+}
+
+Eigen::VectorXd HarmonicFieldSolver::field( int i, int j ) const
+{
+	double c2 = ConstantWeight * ConstantWeight;
+
+	// With x = Z_i s_i + Z_j s_j + g, the constrained normal equations reduce to
+	// [ G + I/c2  1 ] [s]   [e_1]
+	// [ 1'        0 ] [g] = [ 0 ]
+	// where G holds the pseudo-inverse entries between the two constrained vertices.
+	int cols[2] = { i, j };
+
+	Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
+	for(int a = 0; a < 2; a++){
+		for(int b = 0; b < 2; b++)
+			A(a,b) = Z(samples[cols[a]], cols[b]);
+		A(a,a) += 1.0 / c2;
+		A(a,2) = A(2,a) = 1.0;
+	}
+
+	Eigen::Vector3d y = A.fullPivLu().solve( Eigen::Vector3d(1, 0, 0) );
+
+	Eigen::VectorXd x = y[0] * Z.col(i) + y[1] * Z.col(j);
+	x.array() += y[2];
+
+	return x;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "SurfaceMeshModel.h"
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+
+// Harmonic fields between pairs of sample vertices, sharing one factorization.
+// The constraint-free system is only singular along constant fields, so its
+// pseudo-inverse is applied to every sample at once; each pair's two constraint
+// rows then reduce to a small Schur complement system.
+class HarmonicFieldSolver
+{
+public:
+	HarmonicFieldSolver( SurfaceMesh::SurfaceMeshModel * mesh, const SurfaceMesh::ScalarVertexProperty & concaveVertices,
+		double avgEdgeLength, double ConcaveWeight );
+
+	// Factorizes once and solves for every sample as one multi-RHS solve, false if the system is singular
+	bool prepare( const std::vector<int> & samples );
+
+	// Field that is one at samples[i] and zero at samples[j]
+	Eigen::VectorXd field( int i, int j ) const;
+
+	// Rows of the (unconstrained) system as used by the per-pair solve
+	static void laplacianTriplets( SurfaceMesh::SurfaceMeshModel * mesh, const SurfaceMesh::ScalarVertexProperty & concaveVertices,
+		double avgEdgeLength, double ConcaveWeight, std::vector< Eigen::Triplet<double> > & A );
+
+	static const double ConstantWeight;
+
+protected:
+	int n;
+	Eigen::SparseMatrix<double> LTL;
+	std::vector<int> samples;
+	Eigen::MatrixXd Z;	// pseudo-inverse applied to each sample's unit vector
+};
@@ -1,3 +1,5 @@
+#include <QElapsedTimer>
+
 #include "concavity.h"
 #include "RenderObjectExt.h"
 
@@ -5,6 +7,8 @@
 #include "CurvatureEstimationHelper.h"
 #include "StatisticsHelper.h"
 #include "ColorizeHelper.h"
+#include "HarmonicFieldSolver.h"
+#include "GeodesicService.h"
 
 #include <Eigen/Core>
 #include <Eigen/Sparse>
@@ -17,6 +21,8 @@ void concavity::initParameters(RichParameterSet *pars)
 {
 	pars->addParam(new RichFloat("ConcaveWeight", 0.01f, "Concave weight"));
 	pars->addParam(new RichInt("Iterations", 10, "Iterations"));
+	pars->addParam(new RichBool("FactorizeOnce", true, "Factorize once for all pairs"));
+	pars->addParam(new RichBool("CompareFields", false, "Compare with per-pair solve"));
 	pars->addParam(new RichBool("Visualize", true, "Visualize"));
 }
 
@@ -24,49 +30,13 @@ ScalarVertexProperty computeHarmonicField( std::pair<int,int> vertex_pair, Surfa
 						  const ScalarVertexProperty & concaveVertices, 
 						  double avgEdgeLength, double ConcaveWeight)
 {
-	// Vertex properties
-	Vector3VertexProperty points = m_mesh->vertex_coordinates();
-	Vector3VertexProperty normals = m_mesh->vertex_normals();
-
 	// Field
 	ScalarVertexProperty harmonicField = m_mesh->vertex_property<Scalar>("v:harmonicField", 0.0);
 
 	// Efficient sparse matrix construction
 	typedef Eigen::Triplet<double> T;
 	std::vector< T > A;
-
-	for(Vertex v : m_mesh->vertices())
-	{
-		double tot = 0;
-
-		Vector3 v1 = points[v];
-		Vector3 n1 = normals[v];
-
-		std::vector<double> wei(m_mesh->valence(v), 0);
-		int count = 0;
-
-		/// Part 1: change weight here and remember to change Part 2 of weight
-		for(Halfedge h : m_mesh->onering_hedges(v))
-		{
-			Vertex vj = m_mesh->to_vertex(h);
-			Vector3 v2 = points[vj];
-
-			double w = 1.0;
-
-			if (concaveVertices[vj] || concaveVertices[v])
-			{
-				w = ((v1-v2).norm() / avgEdgeLength) * ConcaveWeight;
-			}
-
-			wei[count++] = w;
-			tot += w;
-		}
-
-		count = 0;
-		for(Halfedge h : m_mesh->onering_hedges(v))
-			A.push_back(T(v.idx(), m_mesh->to_vertex(h).idx(), wei[count++] / tot));
-		A.push_back(T(v.idx(), v.idx(), -1.0));
-	}
+	HarmonicFieldSolver::laplacianTriplets( m_mesh, concaveVertices, avgEdgeLength, ConcaveWeight, A );
 
 	int n = m_mesh->n_vertices();
 	int m = n + 2;
@@ -75,7 +45,7 @@ ScalarVertexProperty computeHarmonicField( std::pair<int,int> vertex_pair, Surfa
 	int I = vertex_pair.first;
 	int J = vertex_pair.second;
 
-	double ConstantWeight = 1000;
+	double ConstantWeight = HarmonicFieldSolver::ConstantWeight;
 	A.push_back(T(n, I, 1.0 * ConstantWeight));
 	A.push_back(T(n + 1, J, 1.0 * ConstantWeight));
 
@@ -137,28 +107,12 @@ void concavity::applyFilter(RichParameterSet *pars)
 
 	// Get 'X' most distant points
 	{
-		FilterPlugin * gd_plugin = pluginManager()->getFilter("Geodesic distance: heat kernel");
+		GeodesicService geodesic( mesh() );
 		BoolVertexProperty src_points = mesh()->vertex_property<bool>("v:geo_src_points", false);
-		ScalarVertexProperty geo_dist = mesh()->vertex_property<Scalar>("v:uniformDistance", 0);
 
 		// Consider a subset of vertices
-		src_points[Vertex(0)] = true;
 		int numIter = pars->getInt("Iterations");
-
-		for(int itr = 0; itr < numIter; itr++){
-			gd_plugin->applyFilter( NULL );
-
-			// Find furthest point, add it to source set
-			double maxDist = -DBL_MAX;
-			int maxIDX = -1;
-			foreach(Vertex v, mesh()->vertices()){
-				if(geo_dist[v] > maxDist){
-					maxDist = geo_dist[v];
-					maxIDX = v.idx();
-				}
-			}
-			src_points[Vertex(maxIDX)] = true;
-		}
+		for(int s : geodesic.farthestPoints( 0, numIter + 1 )) src_points[Vertex(s)] = true;
 		
 		// Collect the used ones
 		std::vector<Vertex> used;
@@ -175,15 +129,50 @@ void concavity::applyFilter(RichParameterSet *pars)
 		ScalarVertexProperty sum = mesh()->vertex_property<Scalar>("v:sumHarmonicField", 0.0);
 		for(Vertex v : mesh()->vertices()) sum[v] = 0.0; // clear sum
 
+		QElapsedTimer timer; timer.start();
+
+		bool isFactorizeOnce = pars->getBool("FactorizeOnce");
+		bool isCompare = pars->getBool("CompareFields");
+
+		HarmonicFieldSolver solver( mesh(), concaveVertices, avgEdgeLength, ConcaveWeight );
+		if( isFactorizeOnce || isCompare )
+		{
+			std::vector<int> samples;
+			for(Vertex v : used) samples.push_back( v.idx() );
+
+			// Fallback to per-pair solves when the base system is singular (e.g. many components)
+			if( !solver.prepare( samples ) ) isFactorizeOnce = isCompare = false;
+		}
+
+		double maxDiff = 0;
+
 		for(size_t i = 0; i < used.size(); i++){
 			for(size_t j = i + 1; j < used.size(); j++)
 			{
-				std::pair<int,int> vertex_pair(used[i].idx(), used[j].idx());
-				ScalarVertexProperty harmonicField = computeHarmonicField(vertex_pair, mesh(), concaveVertices, avgEdgeLength, ConcaveWeight);
+				Eigen::VectorXd x;
+				if( isFactorizeOnce || isCompare )
+					x = solver.field( int(i), int(j) );
+
+				if( isFactorizeOnce )
+					for(Vertex v : mesh()->vertices()) sum[v] += x[v.idx()];
 
-				for(Vertex v : mesh()->vertices()) sum[v] += harmonicField[v];
+				if( !isFactorizeOnce || isCompare )
+				{
+					std::pair<int,int> vertex_pair(used[i].idx(), used[j].idx());
+					ScalarVertexProperty harmonicField = computeHarmonicField(vertex_pair, mesh(), concaveVertices, avgEdgeLength, ConcaveWeight);
+
+					if( isCompare )
+						for(Vertex v : mesh()->vertices()) maxDiff = qMax(maxDiff, std::abs(x[v.idx()] - harmonicField[v]));
+
+					if( !isFactorizeOnce )
+						for(Vertex v : mesh()->vertices()) sum[v] += harmonicField[v];
+				}
 			}
 		}
+
+		QString message = QString("Harmonic fields (%1 ms)").arg(timer.elapsed());
+		if( isCompare ) message += QString(" max difference to per-pair solve (%1)").arg(maxDiff);
+		mainWindow()->setStatusBarMessage( message );
 	}
 
 	// Visualize
@@ -3,5 +3,12 @@ include($$[SURFACEMESH])
 include($$[CHOLMOD])
 StarlabTemplate(plugin)
 
-HEADERS += concavity.h
-SOURCES += concavity.cpp
+HEADERS += concavity.h HarmonicFieldSolver.h
+SOURCES += concavity.cpp HarmonicFieldSolver.cpp
+
+# Build options
+CONFIG(debug, debug|release) {CFG = debug} else {CFG = release}
+
+# Geodesic library
+LIBS += -L$$PWD/../geodesic/$$CFG/lib -lgeodesic
+INCLUDEPATH += ../geodesic
@@ -3,11 +3,12 @@ CONFIG += ordered
 
 # Libraries
 #SUBDIRS += NURBS
+SUBDIRS  = geodesic     # Heat method geodesic service
 
 # Plugins
 #SUBDIRS += voxel_resampler
 
-SUBDIRS  = agd          # Average geodesic distance
+SUBDIRS += agd          # Average geodesic distance
 SUBDIRS += bdf   	# Biharmonic distance function
 SUBDIRS += sdf   	# Shape Diameter Function
 SUBDIRS += curvature    # Curvature
@@ -388,6 +388,64 @@ void BSplineBasis<Real>::Compute (Real t, unsigned int order, int& minIndex, int
     maxIndex = i;
 }
 //----------------------------------------------------------------------------
+template <typename Real>
+int BSplineBasis<Real>::Evaluate (Real t, unsigned int order, Real* values) const
+{
+    assertion(order <= 3, "Only derivatives to third order supported\n");
+
+    // Local copy of the rows of Compute, column c holds basis index i-d+c
+    int w = mDegree + 1;
+    std::vector<Real> bd((order + 1) * w * w, (Real)0);
+    #define BD(o,j,k) bd[((o)*w + (j))*w + (k) - (i - mDegree)]
+
+    int i = GetKey(t);
+    BD(0,0,i) = (Real)1;
+
+    Real n0 = t - mKnot[i], n1 = mKnot[i+1] - t;
+    Real invD0, invD1;
+    int j;
+    for (j = 1; j <= mDegree; j++)
+    {
+        invD0 = ((Real)1)/(mKnot[i+j] - mKnot[i]);
+        invD1 = ((Real)1)/(mKnot[i+1] - mKnot[i-j+1]);
+
+        BD(0,j,i) = n0*BD(0,j-1,i)*invD0;
+        BD(0,j,i-j) = n1*BD(0,j-1,i-j+1)*invD1;
+
+        for (unsigned int o = 1; o <= order; o++)
+        {
+            BD(o,j,i) = (n0*BD(o,j-1,i) + ((Real)o)*BD(o-1,j-1,i))*invD0;
+            BD(o,j,i-j) = (n1*BD(o,j-1,i-j+1) - ((Real)o)*BD(o-1,j-1,i-j+1))*invD1;
+        }
+    }
+
+    for (j = 2; j <= mDegree; ++j)
+    {
+        for (int k = i-j+1; k < i; ++k)
+        {
+            n0 = t - mKnot[k];
+            n1 = mKnot[k+j+1] - t;
+            invD0 = ((Real)1)/(mKnot[k+j] - mKnot[k]);
+            invD1 = ((Real)1)/(mKnot[k+j+1] - mKnot[k+1]);
+
+            BD(0,j,k) = n0*BD(0,j-1,k)*invD0 + n1*BD(0,j-1,k+1)*invD1;
+
+            for (unsigned int o = 1; o <= order; o++)
+            {
+                BD(o,j,k) = (n0*BD(o,j-1,k) + ((Real)o)*BD(o-1,j-1,k))*invD0 +
+                    (n1*BD(o,j-1,k+1) - ((Real)o)*BD(o-1,j-1,k+1))*invD1;
+            }
+        }
+    }
+
+    for (unsigned int o = 0; o <= order; o++)
+        for (int c = 0; c < w; c++)
+            values[o*w + c] = bd[(o*w + mDegree)*w + c];
+
+    #undef BD
+    return i - mDegree;
+}
+//----------------------------------------------------------------------------
 
 //----------------------------------------------------------------------------
 // Explicit instantiation.
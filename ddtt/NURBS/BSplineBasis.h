@@ -63,6 +63,11 @@ public:
     // Evaluate basis functions and their derivatives.
     void Compute (Real t, unsigned int order, int& minIndex, int& maxIndex);
 
+    // Same as Compute without touching the stored arrays, safe to call from
+    // several threads.  Writes the d+1 nonzero values of each derivative up to
+    // 'order' to values[o*(d+1) + k - minIndex] and returns minIndex.
+    int Evaluate (Real t, unsigned int order, Real* values) const;
+
 public:
     int Initialize (int numCtrlPoints, int degree, bool open);
 
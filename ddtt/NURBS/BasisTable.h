@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <algorithm>
+
+#include "BSplineBasis.h"
+
+namespace NURBS
+{
+
+// Basis values of one spline direction at a sorted list of distinct parameters. Tables only
+// depend on the knots, so the same parameter grid evaluated again (next frame, another node
+// with the same knots) reuses them from a small shared cache.
+template <typename Real>
+class BasisTable
+{
+public:
+	std::vector<Real> params;
+	std::vector<int> minIndex;
+	std::vector<Real> values;	// [param][order][degree + 1]
+	int width;
+	unsigned int order;
+
+	const Real * D( size_t p, unsigned int o ) const { return &values[(p * (order + 1) + o) * width]; }
+
+	// Position of 't' in the table, 't' must be one of the parameters it was built for
+	size_t indexOf( Real t ) const { return std::lower_bound(params.begin(), params.end(), t) - params.begin(); }
+
+	static QSharedPointer< const BasisTable<Real> > get( const BSplineBasis<Real> & basis, std::vector<Real> params, unsigned int order )
+	{
+		std::sort( params.begin(), params.end() );
+		params.erase( std::unique(params.begin(), params.end()), params.end() );
+
+		const int cacheSize = 32;
+		std::vector< QSharedPointer< const BasisTable<Real> > > & cache = entries();
+
+		{
+			QMutexLocker locker( &mutex() );
+			for(auto & t : cache)
+				if( t->order >= order && t->degree == basis.mDegree && t->open == basis.mOpen && t->uniform == basis.mUniform
+					&& t->params == params && t->knots == basis.mKnot ) return t;
+		}
+
+		BasisTable<Real> * table = new BasisTable<Real>;
+		table->params = params;
+		table->knots = basis.mKnot;
+		table->degree = basis.mDegree;
+		table->open = basis.mOpen;
+		table->uniform = basis.mUniform;
+		table->width = basis.mDegree + 1;
+		table->order = order;
+		table->minIndex.resize( params.size() );
+		table->values.resize( params.size() * (order + 1) * table->width );
+
+		for(size_t p = 0; p < params.size(); p++)
+			table->minIndex[p] = basis.Evaluate( params[p], order, &table->values[p * (order + 1) * table->width] );
+
+		QSharedPointer< const BasisTable<Real> > result( table );
+
+		QMutexLocker locker( &mutex() );
+		cache.insert( cache.begin(), result );
+		if( (int)cache.size() > cacheSize ) cache.pop_back();
+
+		return result;
+	}
+
+	static void clearCache()
+	{
+		QMutexLocker locker( &mutex() );
+		entries().clear();
+	}
+
+private:
+	static QMutex & mutex() { static QMutex m; return m; }
+	static std::vector< QSharedPointer< const BasisTable<Real> > > & entries() { static std::vector< QSharedPointer< const BasisTable<Real> > > e; return e; }
+
+	std::vector<Real> knots;
+	int degree;
+	bool open, uniform;
+};
+
+}
@@ -10,19 +10,41 @@
 
 #ifndef QT_DEBUG
 	// Standard resolution
-	int TIME_ITERATIONS			= 16;
-	double CURVE_TOLERANCE		= 1e-06;
-	int RombergIntegralOrder	= 7;
+	static constexpr NURBS::EvaluationContext preciseContext( 16, 1e-06, 7 );
 #else
 	// Lower resolution
-	int TIME_ITERATIONS			= 8;
-	double CURVE_TOLERANCE		= 1e-05;
-	int RombergIntegralOrder	= 3;
+	static constexpr NURBS::EvaluationContext preciseContext( 8, 1e-05, 3 );
 #endif
 
+thread_local int TIME_ITERATIONS		= preciseContext.timeIterations;
+thread_local double CURVE_TOLERANCE		= preciseContext.curveTolerance;
+thread_local int RombergIntegralOrder	= preciseContext.rombergOrder;
+
 namespace NURBS
 {
 //----------------------------------------------------------------------------
+EvaluationContext EvaluationContext::current()
+{
+    return EvaluationContext(TIME_ITERATIONS, CURVE_TOLERANCE, RombergIntegralOrder);
+}
+//----------------------------------------------------------------------------
+EvaluationContext EvaluationContext::precise()
+{
+    return preciseContext;
+}
+//----------------------------------------------------------------------------
+EvaluationContext EvaluationContext::fast()
+{
+    return EvaluationContext(6, 1e-05, 5);
+}
+//----------------------------------------------------------------------------
+void EvaluationContext::apply() const
+{
+    TIME_ITERATIONS = timeIterations;
+    CURVE_TOLERANCE = curveTolerance;
+    RombergIntegralOrder = rombergOrder;
+}
+//----------------------------------------------------------------------------
 template <typename Real>
 Curve<Real>::Curve (Real tmin, Real tmax)
 {
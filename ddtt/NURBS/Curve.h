@@ -6,9 +6,11 @@
 
 #include "NURBSGlobal.h"
 
-extern int TIME_ITERATIONS;
-extern double CURVE_TOLERANCE;
-extern int RombergIntegralOrder;
+// Evaluation quality, per thread so a worker can lower it without affecting others.
+// Prefer NURBS::ScopedEvaluationContext over setting these directly.
+extern thread_local int TIME_ITERATIONS;
+extern thread_local double CURVE_TOLERANCE;
+extern thread_local int RombergIntegralOrder;
 
 static inline bool IsFiniteNumber(double x){return (x <= DBL_MAX && x >= -DBL_MAX); }   
 static inline bool IsNumber(double x) {return (x == x); }
@@ -16,6 +18,43 @@ static inline bool IsNumber(double x) {return (x == x); }
 namespace NURBS
 {
 
+// Accuracy of arc length integration and inversion. The current context is per thread,
+// so a worker (or a whole blend) can run in fast mode while others stay precise.
+// Threads started for a job do not inherit it, capture 'current()' and apply it there.
+struct EvaluationContext
+{
+	int timeIterations;
+	double curveTolerance;
+	int rombergOrder;
+
+	constexpr EvaluationContext( int timeIterations, double curveTolerance, int rombergOrder )
+		: timeIterations(timeIterations), curveTolerance(curveTolerance), rombergOrder(rombergOrder) {}
+
+	static EvaluationContext current();
+	static EvaluationContext precise();
+	static EvaluationContext fast();
+
+	void apply() const;
+
+	bool operator==( const EvaluationContext & other ) const {
+		return timeIterations == other.timeIterations && curveTolerance == other.curveTolerance && rombergOrder == other.rombergOrder;
+	}
+};
+
+// Sets the context of the calling thread and restores the previous one when leaving the scope
+class ScopedEvaluationContext
+{
+public:
+	explicit ScopedEvaluationContext( const EvaluationContext & context ) : previous( EvaluationContext::current() ) { context.apply(); }
+	~ScopedEvaluationContext() { previous.apply(); }
+
+private:
+	ScopedEvaluationContext( const ScopedEvaluationContext & );
+	ScopedEvaluationContext & operator=( const ScopedEvaluationContext & );
+
+	EvaluationContext previous;
+};
+
 template <typename Real>
 class Curve
 {
@@ -41,6 +41,8 @@ HEADERS += \
     NURBSGlobal.h \
     Curve.h \
     BSplineBasis.h \
+    BasisTable.h \
+    ProjectionBVH.h \
     Integrate1.h \
     LineSegment.h \
     NurbsDraw.h
@@ -10,6 +10,8 @@
 #include "NURBSCurve.h"
 #include "LineSegment.h"
 
+#include <thread>
+
 namespace NURBS
 {
 //----------------------------------------------------------------------------
@@ -334,33 +336,91 @@ std::vector<Vector3> NURBSCurve<Real>::getControlPoints()
 template <typename Real>
 Real NURBSCurve<Real>::timeAt( const Vector3 & pos )
 {
-	int segmentCount = 100;
+	QSharedPointer< const ProjectionBVH<Real> > bvh = projection(100);
+	const std::vector<Real> & times = bvh->valU;
+	int n = bvh->nu();
+
+	// Closest segment between samples
+	int minIdx = 0, j = 0;
+	bvh->closest(pos, [&](int i, int){
+		if(i == n - 1) return (bvh->point(i,0) - pos).norm();
+		Line segment(bvh->point(i,0), bvh->point(i+1,0));
+		double t = 0.0; Vector3 d(0,0,0);
+		segment.ClosestPoint(pos, t, d);
+		return (pos - d).norm();
+	}, minIdx, j);
 
-	std::vector<Real> times;
-	this->SubdivideByLengthTime(segmentCount, times);
+	if(minIdx == n - 1) minIdx = qMax(0, n - 2);
 
-    int minIdx = 0;
-    double t = 0.0;
-    Vector3 d(0,0,0);
-    Scalar minDist = std::numeric_limits<Scalar>::max();
+	double t = 0.0;
+	Vector3 d(0,0,0);
+	Line closestSegment(bvh->point(minIdx,0), bvh->point(minIdx+1,0));
+	closestSegment.ClosestPoint(pos, t, d);
+	Real time = ((1-t) * times[minIdx]) + (t * times[minIdx+1]);
 
-    for(int i = 0; i < ((int)times.size()) - 1; i++)
-    {
-        Line segment(this->GetPosition(times[i]), this->GetPosition(times[i+1]));
-        segment.ClosestPoint(pos, t, d);
+	// Newton iterations on the squared distance, within the neighbouring segments
+	Real minTime = times[qMax(0, minIdx - 1)], maxTime = times[qMin(n - 1, minIdx + 2)];
 
-        Scalar dist = (pos - d).norm();
+	Vector3 p, der1, der2;
+	Get(time, &p, &der1, &der2, 0);
+	Real dist = (p - pos).norm();
 
-        if(dist < minDist){
-            minDist = dist;
-            minIdx = i;
-        }
-    }
+	for(int it = 0; it < 10; it++)
+	{
+		Vector3 r = p - pos;
+		Real h = der1.dot(der1) + r.dot(der2);
+		if(h <= 0) h = der1.dot(der1);
+		if(h < 1e-20) break;
 
-	Line closestSegment(this->GetPosition(times[minIdx]), this->GetPosition(times[minIdx+1]));
+		Real step = -r.dot(der1) / h;
+		if(std::abs(step) < 1e-12) break;
+
+		// Halve the step until the distance decreases
+		bool isImproved = false;
+		for(int k = 0; k < 6 && !isImproved; k++, step *= 0.5)
+		{
+			Real next = qRanged(minTime, time + step, maxTime);
 
-    closestSegment.ClosestPoint(pos, t, d);
-    return qRanged(0.0, ((1-t) * times[minIdx]) + (t * times[minIdx+1]), 1.0);
+			Vector3 q;
+			Get(next, &q, 0, 0, 0);
+			Real nextDist = (q - pos).norm();
+
+			if(nextDist < dist){
+				time = next;
+				dist = nextDist;
+				isImproved = true;
+			}
+		}
+
+		if(!isImproved) break;
+
+		Get(time, &p, &der1, &der2, 0);
+	}
+
+	return qRanged(0.0, time, 1.0);
+}
+
+template <typename Real>
+QSharedPointer< const ProjectionBVH<Real> > NURBSCurve<Real>::projection( int segmentCount )
+{
+	// Everything the samples depend on, arc length parameters follow the integration settings
+	std::vector<Real> key;
+	key.push_back(segmentCount);
+	key.push_back(TIME_ITERATIONS);
+	key.push_back(CURVE_TOLERANCE);
+	key.push_back(RombergIntegralOrder);
+	key.push_back(mBasis.mDegree);
+	key.insert(key.end(), mBasis.mKnot.begin(), mBasis.mKnot.end());
+	for(int i = 0; i < (int)mCtrlPoint.size(); i++){
+		key.insert(key.end(), mCtrlPoint[i].data(), mCtrlPoint[i].data() + 3);
+		key.push_back(mCtrlWeight[i]);
+	}
+
+	return ProjectionBVH<Real>::get(key, [&](ProjectionBVH<Real> & bvh){
+		this->SubdivideByLengthTime(segmentCount, bvh.valU);
+		bvh.valV.push_back(0);
+		GetBatch(bvh.valU, &bvh.points);
+	});
 }
 
 template <typename Real>
@@ -817,6 +877,167 @@ Array1D_Vector3 NURBSCurve<Real>::removeKnots(int iterations)
 	return curCurve.mCtrlPoint;
 }
 
+//----------------------------------------------------------------------------
+template <typename Real>
+void NURBSCurve<Real>::GetBatch (const Array1D_Real& t, Array1D_Vector3* pos,
+    Array1D_Vector3* der1, Array1D_Vector3* der2) const
+{
+    size_t n = t.size();
+    unsigned int order = der2 ? 2 : (der1 ? 1 : 0);
+
+    QSharedPointer< const BasisTable<Real> > table = BasisTable<Real>::get(mBasis, t, order);
+
+    if (pos) pos->resize(n);
+    if (der1) der1->resize(n);
+    if (der2) der2->resize(n);
+
+    int width = table->width;
+    Real tmp;
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        size_t p = table->indexOf(t[k]);
+        int imin = table->minIndex[p];
+
+        // Same sums as 'Get'
+        const Real* b0 = table->D(p, 0);
+        Vector3 X = Vector3_ZERO;
+        Real w = (Real)0;
+        for (int i = 0; i < width; ++i)
+        {
+            tmp = b0[i]*mCtrlWeight[imin+i];
+            X += tmp*mCtrlPoint[imin+i];
+            w += tmp;
+        }
+        Real invW = ((Real)1)/w;
+        Vector3 P = invW*X;
+        if (pos) (*pos)[k] = P;
+
+        if (!der1 && !der2) continue;
+
+        const Real* b1 = table->D(p, 1);
+        Vector3 XDer1 = Vector3_ZERO;
+        Real wDer1 = (Real)0;
+        for (int i = 0; i < width; ++i)
+        {
+            tmp = b1[i]*mCtrlWeight[imin+i];
+            XDer1 += tmp*mCtrlPoint[imin+i];
+            wDer1 += tmp;
+        }
+        Vector3 PDer1 = invW*(XDer1 - wDer1*P);
+        if (der1) (*der1)[k] = PDer1;
+
+        if (!der2) continue;
+
+        const Real* b2 = table->D(p, 2);
+        Vector3 XDer2 = Vector3_ZERO;
+        Real wDer2 = (Real)0;
+        for (int i = 0; i < width; ++i)
+        {
+            tmp = b2[i]*mCtrlWeight[imin+i];
+            XDer2 += tmp*mCtrlPoint[imin+i];
+            wDer2 += tmp;
+        }
+        (*der2)[k] = invW*(XDer2 - ((Real)2)*wDer1*PDer1 - wDer2*P);
+    }
+}
+//----------------------------------------------------------------------------
+template <typename Real>
+typename NURBSCurve<Real>::BatchBenchmark NURBSCurve<Real>::benchmarkBatch (NURBSCurve<Real> curve, int count)
+{
+    BatchBenchmark b;
+    b.points = count;
+
+    Array1D_Real t;
+    for (int i = 0; i < count; ++i) t.push_back(Real(i) / (count - 1));
+
+    Array1D_Vector3 pos(count), der1(count), der2(count);
+    Array1D_Vector3 batchPos, batchDer1, batchDer2;
+
+    QElapsedTimer timer; timer.start();
+    for (int k = 0; k < count; ++k)
+        curve.Get(t[k], &pos[k], &der1[k], &der2[k], 0);
+    b.perPoint = timer.nsecsElapsed() * 1e-9;
+
+    BasisTable<Real>::clearCache();
+
+    timer.restart();
+    curve.GetBatch(t, &batchPos, &batchDer1, &batchDer2);
+    b.batch = timer.nsecsElapsed() * 1e-9;
+
+    timer.restart();
+    curve.GetBatch(t, &batchPos, &batchDer1, &batchDer2);
+    b.cached = timer.nsecsElapsed() * 1e-9;
+
+    b.maxDifference = 0;
+    for (int k = 0; k < count; ++k)
+    {
+        b.maxDifference = std::max(b.maxDifference, (pos[k] - batchPos[k]).norm());
+        b.maxDifference = std::max(b.maxDifference, (der1[k] - batchDer1[k]).norm());
+        b.maxDifference = std::max(b.maxDifference, (der2[k] - batchDer2[k]).norm());
+    }
+
+    return b;
+}
+
+//----------------------------------------------------------------------------
+template <typename Real>
+typename NURBSCurve<Real>::ContextCheck NURBSCurve<Real>::checkContexts (NURBSCurve<Real> curve, int count, int rounds)
+{
+    ContextCheck c;
+    c.projections = 0;
+    c.mismatches = 0;
+    c.gap = 0;
+
+    EvaluationContext before = EvaluationContext::current();
+
+    // Query points around the curve
+    Array1D_Vector3 points;
+    Scalar offset = 0.05 * (curve.mCtrlPoint.front() - curve.mCtrlPoint.back()).norm();
+    for (int i = 0; i < count; ++i)
+    {
+        Vector3 p = curve.GetPosition(Real(i) / (count - 1));
+        points.push_back(p + offset * Vector3(sin(i * 1.3), cos(i * 0.7), sin(i * 2.1)));
+    }
+
+    // Arc length to the projection of each point, each thread works on its own copy
+    auto project = [&](const EvaluationContext & context, Array1D_Real & lengths){
+        ScopedEvaluationContext scoped(context);
+        NURBSCurve<Real> copy = curve;
+        lengths.clear();
+        for (int i = 0; i < count; ++i)
+            lengths.push_back(copy.GetLength(0, copy.timeAt(points[i])));
+    };
+
+    Array1D_Real fastAlone, preciseAlone;
+    project(EvaluationContext::fast(), fastAlone);
+    project(EvaluationContext::precise(), preciseAlone);
+
+    for (int i = 0; i < count; ++i)
+        c.gap = std::max(c.gap, std::abs(fastAlone[i] - preciseAlone[i]));
+
+    for (int r = 0; r < rounds; ++r)
+    {
+        Array1D_Real fastLengths, preciseLengths;
+
+        std::thread fastThread(project, EvaluationContext::fast(), std::ref(fastLengths));
+        project(EvaluationContext::precise(), preciseLengths);
+        fastThread.join();
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (fastLengths[i] != fastAlone[i]) c.mismatches++;
+            if (preciseLengths[i] != preciseAlone[i]) c.mismatches++;
+        }
+
+        c.projections += 2 * count;
+    }
+
+    c.isRestored = (EvaluationContext::current() == before);
+
+    return c;
+}
+
 //----------------------------------------------------------------------------
 // Explicit instantiation.
 //----------------------------------------------------------------------------
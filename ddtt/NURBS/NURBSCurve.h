@@ -7,6 +7,8 @@
 #include "NURBSGlobal.h"
 #include "SingleCurve.h"
 #include "BSplineBasis.h"
+#include "BasisTable.h"
+#include "ProjectionBVH.h"
 
 namespace NURBS
 {
@@ -113,6 +115,23 @@ public:
     void Get (Real t, Vector3* pos, Vector3* der1,
         Vector3* der2, Vector3* der3);
 
+    // Evaluate at every t[i].  Basis values are computed once per distinct
+    // parameter and kept in a shared cache, and the state used by 'Get' is not
+    // touched, so this may be called from several threads.
+    void GetBatch (const Array1D_Real& t, Array1D_Vector3* pos,
+        Array1D_Vector3* der1 = 0, Array1D_Vector3* der2 = 0) const;
+
+    // Seconds for evaluating 'count' parameters with 'Get' and with 'GetBatch'
+    // (first and repeated call), and the largest difference found
+    struct BatchBenchmark{ int points; double perPoint, batch, cached, maxDifference; };
+    static BatchBenchmark benchmarkBatch (NURBSCurve<Real> curve, int count = 10000);
+
+    // Projects points around the curve in fast and in precise mode on two threads at
+    // once, 'rounds' times, and counts results differing from the same projections run
+    // alone. 'gap' is the largest difference in arc length between the two modes.
+    struct ContextCheck{ int projections, mismatches; double gap; bool isRestored; };
+    static ContextCheck checkContexts (NURBSCurve<Real> curve, int count = 200, int rounds = 8);
+
     // Access the basis function to compute it without control points.  This
     // is useful for least squares fitting of curves.
     BSplineBasis<Real>& GetBasis ();
@@ -122,6 +141,10 @@ public:
     Real timeAt(const Vector3 &pos);
 	Real fastTimeAt(const Vector3 &pos);
 
+    // Arc length samples in a bounding volume hierarchy, shared by all curves with the
+    // same control points and knots. Rebuilt only when those change.
+    QSharedPointer< const ProjectionBVH<Real> > projection(int segmentCount);
+
     std::vector<std::vector<Vector3> > toSegments(Scalar resolution);
 
     // Modify
@@ -750,39 +750,29 @@ Array1D_Vector3 NURBSRectangle<Real>::intersect( NURBSRectangle<Real> & other, d
 {
     Array1D_Vector3 samples;
 
-    std::vector< std::vector<Vector3> > pnts1, pnts2;
-    std::vector< std::vector< std::vector<Real> > > val( 2, std::vector< std::vector<Real> >(2) );
-    std::vector<Real> valU1,valV1,valU2,valV2;
-    std::vector<Real> iU1,iV1,iU2,iV2;
-
-    generateSurfacePoints(resolution, pnts1, valU1, valV1);
-    other.generateSurfacePoints(resolution, pnts2, valU2, valV2);
-
-    val[0][0] = valU1; val[0][1] = valV1;
-    val[1][0] = valU2; val[1][1] = valV2;
-
-    std::vector< std::pair< std::pair<Scalar,Scalar>, Vector3d> > mysamples, othersamples;
-
-    for(int y1 = 0; y1 < (int)valV1.size(); y1++){
-        for(int x1 = 0; x1 < (int)valU1.size(); x1++){
-            mysamples.push_back(std::make_pair( std::make_pair(valU1[x1], valV1[y1]), pnts1[x1][y1] ));
-        }
-    }
-
-    for(int y2 = 0; y2 < (int)valV2.size(); y2++){
-        for(int x2 = 0; x2 < (int)valU2.size(); x2++){
-            othersamples.push_back(std::make_pair( std::make_pair(valU2[x2], valV2[y2]), pnts2[x2][y2] ));
-        }
-    }
+    QSharedPointer< const ProjectionBVH<Real> > mine = projection(resolution);
+    QSharedPointer< const ProjectionBVH<Real> > others = other.projection(resolution);
+
+    typedef typename ProjectionBVH<Real>::Node PatchNode;
+
+    // Samples of mine touching samples of the other, only within patches that are close enough
+    mine->overlapping(*others, resolution, [&](const PatchNode & a, const PatchNode & b){
+        for(int x1 = a.u0; x1 < a.u1; x1++){
+            for(int y1 = a.v0; y1 < a.v1; y1++){
+                Vector3d p1 = mine->point(x1, y1);
+                bool isTouching = false;
+
+                for(int x2 = b.u0; x2 < b.u1 && !isTouching; x2++){
+                    for(int y2 = b.v0; y2 < b.v1 && !isTouching; y2++){
+                        Vector3d p2 = others->point(x2, y2);
+                        isTouching = sphereTest(p1, p2, resolution * 0.5, resolution * 0.5);
+                    }
+                }
 
-    for(int i = 0; i < (int)mysamples.size(); i++)
-    {
-        for(int j = 0; j < (int)othersamples.size(); j++)
-        {
-            if(sphereTest(mysamples[i].second, othersamples[j].second, resolution * 0.5, resolution * 0.5))
-                samples.push_back(mysamples[i].second);
+                if(isTouching) samples.push_back(p1);
+            }
         }
-    }
+    });
 
     std::vector<size_t> corner_xrefs;
     weld(samples, corner_xrefs, std::hash_Vector3d(), std::equal_to<Vector3d>());
@@ -866,35 +856,7 @@ void NURBSRectangle<Real>::generateSurfacePoints( Scalar stepSize, std::vector<
 template <typename Real>
 Vector4d NURBSRectangle<Real>::timeAt( const Vector3 & pos )
 {
-    std::vector< std::vector<Vector3> > pts;
-
-    std::vector<Real> valU, valV;
-    Scalar stepSize = 0.01 * (mCtrlPoint.front().front() - mCtrlPoint.back().back()).norm();
-    generateSurfacePoints(stepSize, pts, valU, valV);
-
-    int minIdxU = 0, minIdxV = 0;
-    Scalar minDist = std::numeric_limits<Scalar>::max();
-
-    // Approximate area search
-    for(int x = 0; x < (int)valU.size(); x++){
-        for(int y = 0; y < (int)valV.size(); y++){
-            Scalar dist = (pts[x][y] - pos).norm();
-
-            if(dist < minDist){
-                minDist = dist;
-                minIdxU = x;
-                minIdxV = y;
-            }
-        }
-    }
-
-    // More precise search
-    Vector4d minRange( valU[qMax(0, minIdxU - 1)], valV[qMax(0, minIdxV - 1)], 0, 0);
-    Vector4d maxRange( valU[qMin((int)valU.size() - 1, minIdxU + 1)], valV[qMin((int)valV.size() - 1, minIdxV + 1)], 0, 0);
-
-    Vector4d bestUV( valU[minIdxU], valV[minIdxV], 0, 0 );
-
-    return timeAt(pos, bestUV, minRange, maxRange, minDist);
+    return timeAt(std::vector<Vector3>(1, pos), 1e-4).front();
 }
 
 template <typename Real>
@@ -950,41 +912,115 @@ Array1D_Vector4d NURBSRectangle<Real>::timeAt( const std::vector<Vector3> & posi
 {
     Array1D_Vector4d times;
 
-    std::vector< std::vector<Vector3> > pts;
-    std::vector<Real> valU, valV;
     Scalar stepSize = 0.01 * (mCtrlPoint.front().front() - mCtrlPoint.back().back()).norm();
-    generateSurfacePoints(stepSize, pts, valU, valV);
+    QSharedPointer< const ProjectionBVH<Real> > bvh = projection(stepSize);
 
     for(int i = 0; i < (int)positions.size(); i++)
     {
         Vector3 pos = positions[i];
 
+        if(bvh->points.empty()){
+            times.push_back(Vector4d(0,0,0,0));
+            continue;
+        }
+
+        // Closest sample
         int minIdxU = 0, minIdxV = 0;
-        Scalar minDist = std::numeric_limits<Scalar>::max();
+        bvh->closest(pos, [&](int x, int y){ return (bvh->point(x,y) - pos).norm(); }, minIdxU, minIdxV);
 
-        // Approximate area search
-        for(int x = 0; x < (int)valU.size(); x++){
-            for(int y = 0; y < (int)valV.size(); y++){
-                Scalar dist = (pts[x][y] - pos).norm();
+        // Newton iterations around it
+        Vector4d minRange( bvh->valU[qMax(0, minIdxU - 1)], bvh->valV[qMax(0, minIdxV - 1)], 0, 0);
+        Vector4d maxRange( bvh->valU[qMin(bvh->nu() - 1, minIdxU + 1)], bvh->valV[qMin(bvh->nv() - 1, minIdxV + 1)], 0, 0);
 
-                if(dist < minDist){
-                    minDist = dist;
-                    minIdxU = x;
-                    minIdxV = y;
-                }
+        Vector4d bestUV( bvh->valU[minIdxU], bvh->valV[minIdxV], 0, 0 );
+
+        times.push_back( refineTimeAt(pos, bestUV, minRange, maxRange, threshold) );
+    }
+
+    return times;
+}
+
+template <typename Real>
+Vector4d NURBSRectangle<Real>::refineTimeAt( const Vector3 & pos, Vector4d uv, const Vector4d & minRange, const Vector4d & maxRange, Real threshold )
+{
+    Vector3 p, du, dv, duu, duv, dvv;
+    Get(uv[0], uv[1], &p, &du, &dv, &duu, &duv, &dvv);
+    Real dist = (p - pos).norm();
+
+    for(int it = 0; it < 10 && dist >= threshold; it++)
+    {
+        Vector3 r = p - pos;
+        Eigen::Vector2d g( r.dot(du), r.dot(dv) );
+
+        Eigen::Matrix2d H;
+        H << du.dot(du) + r.dot(duu), du.dot(dv) + r.dot(duv),
+             du.dot(dv) + r.dot(duv), dv.dot(dv) + r.dot(dvv);
+
+        // Gauss-Newton where the distance is not locally convex
+        if(H.determinant() <= 0 || H(0,0) <= 0)
+            H << du.dot(du), du.dot(dv), du.dot(dv), dv.dot(dv);
+
+        if(std::abs(H.determinant()) < 1e-20) break;
+
+        Eigen::Vector2d step = -(H.inverse() * g);
+
+        // Halve the step until the distance decreases
+        bool isImproved = false;
+        for(int k = 0; k < 6 && !isImproved; k++, step *= 0.5)
+        {
+            Vector4d next( qRanged(minRange[0], uv[0] + step[0], maxRange[0]), qRanged(minRange[1], uv[1] + step[1], maxRange[1]), 0, 0 );
+
+            Vector3 q;
+            Get(next[0], next[1], &q);
+            Real d = (q - pos).norm();
+
+            if(d < dist){
+                uv = next;
+                dist = d;
+                isImproved = true;
             }
         }
 
-        // More precise search
-        Vector4d minRange( valU[qMax(0, minIdxU - 1)], valV[qMax(0, minIdxV - 1)], 0, 0);
-        Vector4d maxRange( valU[qMin((int)valU.size() - 1, minIdxU + 1)], valV[qMin((int)valV.size() - 1, minIdxV + 1)], 0, 0);
+        if(!isImproved) break;
 
-        Vector4d bestUV( valU[minIdxU], valV[minIdxV], 0, 0 );
+        Get(uv[0], uv[1], &p, &du, &dv, &duu, &duv, &dvv);
+    }
+
+    return uv;
+}
 
-        times.push_back( timeAt(pos, bestUV, minRange, maxRange, minDist, threshold) );
+template <typename Real>
+QSharedPointer< const ProjectionBVH<Real> > NURBSRectangle<Real>::projection( Scalar stepSize )
+{
+    // Everything the samples depend on
+    std::vector<Real> key;
+    key.push_back(stepSize);
+    key.push_back(mCtrlPoint.size());
+    key.push_back(mCtrlPoint.empty() ? 0 : mCtrlPoint.front().size());
+    for(int i = 0; i < 2; i++){
+        key.push_back(mBasis[i].mDegree);
+        key.insert(key.end(), mBasis[i].mKnot.begin(), mBasis[i].mKnot.end());
+    }
+    for(int y = 0; y < (int)mCtrlPoint.size(); y++){
+        for(int x = 0; x < (int)mCtrlPoint[y].size(); x++){
+            key.insert(key.end(), mCtrlPoint[y][x].data(), mCtrlPoint[y][x].data() + 3);
+            key.push_back(mCtrlWeight[y][x]);
+        }
     }
 
-    return times;
+    return ProjectionBVH<Real>::get(key, [&](ProjectionBVH<Real> & bvh){
+        uniformCoordinates(bvh.valU, bvh.valV, stepSize);
+
+        Array1D_Real u, v;
+        for(int x = 0; x < bvh.nu(); x++){
+            for(int y = 0; y < bvh.nv(); y++){
+                u.push_back(bvh.valU[x]);
+                v.push_back(bvh.valV[y]);
+            }
+        }
+
+        GetBatch(u, v, &bvh.points);
+    });
 }
 
 template <typename Real>
@@ -1256,6 +1292,128 @@ Array2D_Vector3 NURBS::NURBSRectangle<Real>::simpleRemove( int idx, int dir )
 	return Qw;
 }
 
+//----------------------------------------------------------------------------
+template <typename Real>
+void NURBSRectangle<Real>::GetBatch (const Array1D_Real& u, const Array1D_Real& v,
+    Array1D_Vector3* pos, Array1D_Vector3* derU, Array1D_Vector3* derV) const
+{
+    size_t n = std::min(u.size(), v.size());
+    unsigned int order = (derU || derV) ? 1 : 0;
+
+    QSharedPointer< const BasisTable<Real> > tu = BasisTable<Real>::get(mBasis[0], u, order);
+    QSharedPointer< const BasisTable<Real> > tv = BasisTable<Real>::get(mBasis[1], v, order);
+
+    if (pos) pos->resize(n);
+    if (derU) derU->resize(n);
+    if (derV) derV->resize(n);
+
+    int wu = tu->width, wv = tv->width;
+    Real tmp;
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        size_t pu = tu->indexOf(u[k]), pv = tv->indexOf(v[k]);
+        int iumin = tu->minIndex[pu], ivmin = tv->minIndex[pv];
+        const Real* bu0 = tu->D(pu, 0);
+        const Real* bv0 = tv->D(pv, 0);
+
+        // Same sums as 'Get'
+        Vector3 X = Vector3_ZERO;
+        Real w = (Real)0;
+        for (int a = 0; a < wu; ++a)
+        {
+            for (int b = 0; b < wv; ++b)
+            {
+                tmp = bu0[a]*bv0[b]*mCtrlWeight[iumin+a][ivmin+b];
+                X += tmp*mCtrlPoint[iumin+a][ivmin+b];
+                w += tmp;
+            }
+        }
+        Real invW = ((Real)1)/w;
+        Vector3 P = invW*X;
+        if (pos) (*pos)[k] = P;
+
+        if (derU)
+        {
+            const Real* bu1 = tu->D(pu, 1);
+            Vector3 XDerU = Vector3_ZERO;
+            Real wDerU = (Real)0;
+            for (int a = 0; a < wu; ++a)
+            {
+                for (int b = 0; b < wv; ++b)
+                {
+                    tmp = bu1[a]*bv0[b]*mCtrlWeight[iumin+a][ivmin+b];
+                    XDerU += tmp*mCtrlPoint[iumin+a][ivmin+b];
+                    wDerU += tmp;
+                }
+            }
+            (*derU)[k] = invW*(XDerU - wDerU*P);
+        }
+
+        if (derV)
+        {
+            const Real* bv1 = tv->D(pv, 1);
+            Vector3 XDerV = Vector3_ZERO;
+            Real wDerV = (Real)0;
+            for (int a = 0; a < wu; ++a)
+            {
+                for (int b = 0; b < wv; ++b)
+                {
+                    tmp = bu0[a]*bv1[b]*mCtrlWeight[iumin+a][ivmin+b];
+                    XDerV += tmp*mCtrlPoint[iumin+a][ivmin+b];
+                    wDerV += tmp;
+                }
+            }
+            (*derV)[k] = invW*(XDerV - wDerV*P);
+        }
+    }
+}
+//----------------------------------------------------------------------------
+template <typename Real>
+typename NURBSRectangle<Real>::BatchBenchmark NURBSRectangle<Real>::benchmarkBatch (NURBSRectangle<Real> surface, int resolution)
+{
+    BatchBenchmark b;
+
+    Array1D_Real u, v;
+    for (int i = 0; i < resolution; ++i)
+    {
+        for (int j = 0; j < resolution; ++j)
+        {
+            u.push_back(Real(i) / (resolution - 1));
+            v.push_back(Real(j) / (resolution - 1));
+        }
+    }
+    b.points = (int)u.size();
+
+    Array1D_Vector3 pos(u.size()), derU(u.size()), derV(u.size());
+    Array1D_Vector3 batchPos, batchDerU, batchDerV;
+
+    QElapsedTimer timer; timer.start();
+    for (size_t k = 0; k < u.size(); ++k)
+        surface.Get(u[k], v[k], &pos[k], &derU[k], &derV[k]);
+    b.perPoint = timer.nsecsElapsed() * 1e-9;
+
+    BasisTable<Real>::clearCache();
+
+    timer.restart();
+    surface.GetBatch(u, v, &batchPos, &batchDerU, &batchDerV);
+    b.batch = timer.nsecsElapsed() * 1e-9;
+
+    timer.restart();
+    surface.GetBatch(u, v, &batchPos, &batchDerU, &batchDerV);
+    b.cached = timer.nsecsElapsed() * 1e-9;
+
+    b.maxDifference = 0;
+    for (size_t k = 0; k < u.size(); ++k)
+    {
+        b.maxDifference = std::max(b.maxDifference, (pos[k] - batchPos[k]).norm());
+        b.maxDifference = std::max(b.maxDifference, (derU[k] - batchDerU[k]).norm());
+        b.maxDifference = std::max(b.maxDifference, (derV[k] - batchDerV[k]).norm());
+    }
+
+    return b;
+}
+
 
 //----------------------------------------------------------------------------
 // Explicit instantiation.
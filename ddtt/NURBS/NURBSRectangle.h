@@ -7,6 +7,8 @@
 #include "NURBSGlobal.h"
 #include "ParametricSurface.h"
 #include "BSplineBasis.h"
+#include "BasisTable.h"
+#include "ProjectionBVH.h"
 
 namespace NURBS
 {
@@ -111,6 +113,18 @@ public:
         Vector3* derV = 0, Vector3* derUU = 0, Vector3* derUV = 0,
         Vector3* derVV = 0);
 
+    // Evaluate at (u[i],v[i]) for every i.  Basis values are computed once per
+    // distinct parameter and kept in a shared cache, and the state used by
+    // 'Get' is not touched, so this may be called from several threads.
+    void GetBatch (const Array1D_Real& u, const Array1D_Real& v,
+        Array1D_Vector3* pos, Array1D_Vector3* derU = 0,
+        Array1D_Vector3* derV = 0) const;
+
+    // Seconds for evaluating a resolution x resolution grid with 'Get' and with
+    // 'GetBatch' (first and repeated call), and the largest difference found
+    struct BatchBenchmark{ int points; double perPoint, batch, cached, maxDifference; };
+    static BatchBenchmark benchmarkBatch (NURBSRectangle<Real> surface, int resolution = 100);
+
     // Cached visualization
     std::vector<SurfaceQuad> quads;
     void generateSurfaceQuads( double resolution );
@@ -134,8 +148,13 @@ public:
     Vector4d timeAt(const Vector3 &pos);
     Vector4d timeAt(const Vector3 &pos, Vector4d &bestUV, Vector4d &minRange, Vector4d &maxRange, Real currentDist, Real threshold = 1e-4 );
     Array1D_Vector4d timeAt(const std::vector<Vector3> &positions, Real threshold);
+    Vector4d refineTimeAt(const Vector3 &pos, Vector4d uv, const Vector4d &minRange, const Vector4d &maxRange, Real threshold);
 	Vector4d fastTimeAt(const Vector3 &pos);
 
+    // Samples at 'stepSize' in a bounding volume hierarchy, shared by all surfaces with the
+    // same control net and knots. Rebuilt only when those change.
+    QSharedPointer< const ProjectionBVH<Real> > projection(Scalar stepSize);
+
     Vector3 projectOnControl(Real u, Real v);
 
     void translate(const Vector3d &delta);
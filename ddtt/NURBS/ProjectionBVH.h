@@ -0,0 +1,223 @@
+#pragma once
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <Eigen/Geometry>
+
+#include "NURBSGlobal.h"
+
+namespace NURBS
+{
+
+// Samples of a curve (one column) or a surface on a grid of parameters, with a bounding volume
+// hierarchy over patches of grid cells. Cell (i,j) spans samples i..i+1 and j..j+1, clamped at
+// the last row and column. Trees are built once per sampling of a given control net and kept in
+// a small shared least recently used cache, so repeated projections onto an unchanged curve or
+// surface (and copies of it) only descend the tree. Entries are found by a hash of their key,
+// the full key is only compared when hashes match.
+template <typename Real>
+class ProjectionBVH
+{
+public:
+	std::vector<Real> valU, valV;
+	Array1D_Vector3 points;	// [i * valV.size() + j]
+
+	struct Node{ Eigen::AlignedBox3d box; int u0, u1, v0, v1; int child; };	// child + 1 is the second child, -1 for leaves
+	std::vector<Node> nodes;
+
+	int nu() const { return (int)valU.size(); }
+	int nv() const { return (int)valV.size(); }
+	const Vector3d & point( int i, int j ) const { return points[i * nv() + j]; }
+
+	void build( int leafSize = 16 )
+	{
+		nodes.clear();
+		if( points.empty() ) return;
+
+		nodes.push_back( makeNode(0, nu(), 0, nv()) );
+
+		for(size_t n = 0; n < nodes.size(); n++)
+		{
+			Node node = nodes[n];
+			int du = node.u1 - node.u0, dv = node.v1 - node.v0;
+			if( du * dv <= leafSize ) continue;
+
+			nodes[n].child = (int)nodes.size();
+
+			if( du >= dv ){
+				int m = node.u0 + du / 2;
+				nodes.push_back( makeNode(node.u0, m, node.v0, node.v1) );
+				nodes.push_back( makeNode(m, node.u1, node.v0, node.v1) );
+			}
+			else{
+				int m = node.v0 + dv / 2;
+				nodes.push_back( makeNode(node.u0, node.u1, node.v0, m) );
+				nodes.push_back( makeNode(node.u0, node.u1, m, node.v1) );
+			}
+		}
+	}
+
+	// Cell closest to 'p' by best-first descent. 'cellDistance(i,j)' must not be smaller than the
+	// distance from 'p' to the samples spanned by the cell. Returns the distance, MAX_REAL when empty.
+	template<typename Distance>
+	Real closest( const Vector3d & p, Distance cellDistance, int & bestI, int & bestJ ) const
+	{
+		Real best = std::numeric_limits<Real>::max();
+		bestI = bestJ = 0;
+		if( nodes.empty() ) return best;
+
+		typedef std::pair<Real,int> Entry;
+		std::vector<Entry> heap( 1, Entry(nodes[0].box.exteriorDistance(p), 0) );
+
+		while( !heap.empty() )
+		{
+			std::pop_heap( heap.begin(), heap.end(), std::greater<Entry>() );
+			Entry top = heap.back(); heap.pop_back();
+			if( top.first >= best ) break;
+
+			const Node & node = nodes[top.second];
+
+			if( node.child < 0 ){
+				for(int i = node.u0; i < node.u1; i++){
+					for(int j = node.v0; j < node.v1; j++){
+						Real d = cellDistance(i, j);
+						if( d < best ){ best = d; bestI = i; bestJ = j; }
+					}
+				}
+				continue;
+			}
+
+			for(int c = node.child; c < node.child + 2; c++){
+				heap.push_back( Entry(nodes[c].box.exteriorDistance(p), c) );
+				std::push_heap( heap.begin(), heap.end(), std::greater<Entry>() );
+			}
+		}
+
+		return best;
+	}
+
+	// Calls f(a, b) for every leaf 'a' of this tree and leaf 'b' of 'other' whose boxes are at most 'margin' apart
+	template<typename Function>
+	void overlapping( const ProjectionBVH<Real> & other, Real margin, Function f ) const
+	{
+		if( nodes.empty() || other.nodes.empty() ) return;
+
+		std::vector< std::pair<int,int> > stack( 1, std::make_pair(0, 0) );
+
+		while( !stack.empty() )
+		{
+			std::pair<int,int> top = stack.back(); stack.pop_back();
+			const Node & a = nodes[top.first];
+			const Node & b = other.nodes[top.second];
+
+			if( boxDistance(a.box, b.box) > margin ) continue;
+
+			if( a.child < 0 && b.child < 0 ){ f(a, b); continue; }
+
+			// Descend the larger of the two
+			bool splitA = b.child < 0 || (a.child >= 0 && a.box.diagonal().squaredNorm() >= b.box.diagonal().squaredNorm());
+
+			if( splitA ){
+				stack.push_back( std::make_pair(a.child, top.second) );
+				stack.push_back( std::make_pair(a.child + 1, top.second) );
+			}
+			else{
+				stack.push_back( std::make_pair(top.first, b.child) );
+				stack.push_back( std::make_pair(top.first, b.child + 1) );
+			}
+		}
+	}
+
+	// 'key' identifies the curve or surface and its sampling, 'create' fills valU, valV and points
+	static QSharedPointer< const ProjectionBVH<Real> > get( const std::vector<Real> & key, std::function<void(ProjectionBVH<Real>&)> create )
+	{
+		const int cacheSize = 32;
+		std::vector< QSharedPointer< const ProjectionBVH<Real> > > & cache = entries();
+
+		quint64 hash = keyHash( key );
+
+		{
+			QMutexLocker locker( &mutex() );
+			QSharedPointer< const ProjectionBVH<Real> > hit = find( cache, hash, key );
+			if( !hit.isNull() ) return hit;
+		}
+
+		ProjectionBVH<Real> * bvh = new ProjectionBVH<Real>;
+		bvh->key = key;
+		bvh->hash = hash;
+		create( *bvh );
+		bvh->build();
+
+		QSharedPointer< const ProjectionBVH<Real> > result( bvh );
+
+		QMutexLocker locker( &mutex() );
+
+		// Another thread may have built the same one meanwhile
+		QSharedPointer< const ProjectionBVH<Real> > hit = find( cache, hash, key );
+		if( !hit.isNull() ) return hit;
+
+		cache.insert( cache.begin(), result );
+		if( (int)cache.size() > cacheSize ) cache.pop_back();
+
+		return result;
+	}
+
+	static void clearCache()
+	{
+		QMutexLocker locker( &mutex() );
+		entries().clear();
+	}
+
+private:
+	static QMutex & mutex() { static QMutex m; return m; }
+	static std::vector< QSharedPointer< const ProjectionBVH<Real> > > & entries() { static std::vector< QSharedPointer< const ProjectionBVH<Real> > > e; return e; }
+
+	std::vector<Real> key;
+	quint64 hash;
+
+	// FNV-1a over the key values
+	static quint64 keyHash( const std::vector<Real> & key )
+	{
+		quint64 h = 14695981039346656037ULL;
+		const unsigned char * bytes = (const unsigned char *) key.data();
+		for(size_t i = 0; i < key.size() * sizeof(Real); i++){ h ^= bytes[i]; h *= 1099511628211ULL; }
+		return h;
+	}
+
+	// Cached tree for 'key', moved to the front when found. Caller holds the mutex
+	static QSharedPointer< const ProjectionBVH<Real> > find( std::vector< QSharedPointer< const ProjectionBVH<Real> > > & cache,
+		quint64 hash, const std::vector<Real> & key )
+	{
+		for(size_t i = 0; i < cache.size(); i++)
+		{
+			if( cache[i]->hash != hash || cache[i]->key != key ) continue;
+			std::rotate( cache.begin(), cache.begin() + i, cache.begin() + i + 1 );
+			return cache.front();
+		}
+		return QSharedPointer< const ProjectionBVH<Real> >();
+	}
+
+	Node makeNode( int u0, int u1, int v0, int v1 ) const
+	{
+		Node node;
+		node.u0 = u0; node.u1 = u1; node.v0 = v0; node.v1 = v1;
+		node.child = -1;
+
+		for(int i = u0; i <= std::min(u1, nu() - 1); i++)
+			for(int j = v0; j <= std::min(v1, nv() - 1); j++)
+				node.box.extend( point(i, j) );
+
+		return node;
+	}
+
+	static Real boxDistance( const Eigen::AlignedBox3d & a, const Eigen::AlignedBox3d & b )
+	{
+		Vector3d gap = (a.min() - b.max()).cwiseMax( b.min() - a.max() ).cwiseMax( Vector3d::Zero() );
+		return gap.norm();
+	}
+};
+
+}
@@ -3,12 +3,15 @@
 // Code adapted from https://github.com/propanoid/DBSCAN
 
 #include <vector>
+#include <map>
 #include <algorithm>
 #include <omp.h>
 
 // Any basic vector/matrix library should also work
 #include <Eigen/Core>
 
+#include "RangeIndex.hpp"
+
 namespace clustering
 {
 	template<typename Vector, typename Matrix>
@@ -98,13 +101,60 @@ namespace clustering
 			dbscan( D );
 		}
 
+		// Neighbors come from range queries on a kd-tree, no rows x rows matrix is stored. Same labels as 'wfit_dense'
 		void wfit( const ClusterData & C, const FeaturesWeights & W )
+		{
+			prepare_labels( C.rows() );
+
+			const ClusterData cl_d = normalized( C );
+			auto dist = [&]( int i, int j ){ return l1_dist( cl_d, W, i, j ); };
+
+			m_dmin = 0.0;
+			m_dmax = reference_dmax( cl_d, W );
+			m_eps = (m_dmax - m_dmin) * m_eps + m_dmin;
+
+			const RangeIndex< L1BoxDistance<FeaturesWeights> > index( cl_d, L1BoxDistance<FeaturesWeights>(W) );
+
+			expand( cl_d.rows(), [&]( unsigned int pid ){
+				return index.range( cl_d.row(pid), m_eps, [&](int j){ return dist(pid, j); } );
+			});
+		}
+
+		// Original path, builds the full distance matrix
+		void wfit_dense( const ClusterData & C, const FeaturesWeights & W )
 		{
 			prepare_labels( C.rows() );
 			const DistanceMatrix D = calc_dist_matrix( C, W );
 			dbscan( D );
 		}
 
+		void fit_dense( const ClusterData & C )
+		{
+			wfit_dense( C, std_weights( C.cols() ) );
+		}
+
+		// Runs both paths on 'C', timings in seconds
+		struct Comparison{ int elements, mismatches; double dense, indexed; };
+		static Comparison compare( const ClusterData & C, double eps, size_t min_elems )
+		{
+			Comparison c = { (int)C.rows(), 0, 0, 0 };
+
+			DBSCAN dense( eps, min_elems ), indexed( eps, min_elems );
+
+			double start = omp_get_wtime();
+			dense.fit_dense( C );
+			c.dense = omp_get_wtime() - start;
+
+			start = omp_get_wtime();
+			indexed.fit( C );
+			c.indexed = omp_get_wtime() - start;
+
+			for (size_t i = 0; i < dense.get_labels().size(); ++i)
+				if (dense.get_labels()[i] != indexed.get_labels()[i]) c.mismatches++;
+
+			return c;
+		}
+
 	private:
 		void prepare_labels( size_t s )
 		{
@@ -125,7 +175,8 @@ namespace clustering
 			return ne;
 		}
 
-		const DistanceMatrix calc_dist_matrix( const ClusterData & C, const FeaturesWeights & W )
+		// Each column scaled to [0,1]
+		static ClusterData normalized( const ClusterData & C )
 		{
 			ClusterData cl_d = C;
 
@@ -150,6 +201,41 @@ namespace clustering
 				cl_d.col(i) = col;
 			}
 
+			return cl_d;
+		}
+
+		// Weighted manhattan distance between rows, same sums as the distance matrix
+		static double l1_dist( const ClusterData & cl_d, const FeaturesWeights & W, int i, int j )
+		{
+			if (i == j) return 0.0;
+
+			double d = 0.0;
+			for(int k = 0; k < (int)cl_d.cols(); k++)
+			{
+				auto e = cl_d(i, k) - cl_d(j, k);
+				d += fabs(e)*W[k];
+			}
+			return d;
+		}
+
+		// Largest distance 'eps' is relative to, as the distance matrix path computes it: its row
+		// min/max walk 'row(i).data()' of a column major matrix, which is column 0 and then column 1
+		// up to row i - 1, so only the distances from rows 0 and 1 are seen (and 0 as the minimum)
+		static double reference_dmax( const ClusterData & cl_d, const FeaturesWeights & W )
+		{
+			const int n = (int)cl_d.rows();
+
+			double d_max = 0.0;
+			for (int j = 0; j < n; ++j) d_max = std::max(d_max, l1_dist(cl_d, W, 0, j));
+			for (int j = 0; j + 1 < n; ++j) d_max = std::max(d_max, l1_dist(cl_d, W, std::min(j, 1), std::max(j, 1)));
+
+			return d_max;
+		}
+
+		const DistanceMatrix calc_dist_matrix( const ClusterData & C, const FeaturesWeights & W )
+		{
+			const ClusterData cl_d = normalized( C );
+
 			// rows x rows
 			DistanceMatrix d_m( cl_d.rows(), cl_d.rows() );
 			Vector d_max( cl_d.rows() );
@@ -196,38 +282,54 @@ namespace clustering
 
 		void dbscan( const DistanceMatrix & dm )
 		{
-			std::vector<unsigned int> visited( dm.rows() );
+			expand( dm.rows(), [&]( unsigned int pid ){ return find_neighbors(dm, pid); } );
+		}
+
+		// Grows clusters from core points. A point is queued at most once per cluster, further
+		// copies of it in the neighbor lists would find it visited and labeled and do nothing
+		template<typename NeighborsFunction>
+		void expand( unsigned int count, NeighborsFunction neighbors )
+		{
+			std::vector<unsigned int> visited( count );
+			std::vector<int> queued( count, -1 );
 
 			unsigned int cluster_id = 0;
 
-			for (unsigned int pid = 0; pid < dm.rows(); ++pid)
+			for (unsigned int pid = 0; pid < count; ++pid)
 			{
 				if ( !visited[pid] )
 				{
 					visited[pid] = 1;
 
-					Neighbors ne = find_neighbors(dm, pid );
+					Neighbors ne = neighbors( pid );
 
 					if (ne.size() >= m_min_elems)
 					{
 						m_labels[pid] = cluster_id;
 
-						for (unsigned int i = 0; i < ne.size(); ++i)
+						Neighbors queue;
+						auto enqueue = [&]( const Neighbors & points ){
+							for (auto p : points){
+								if (queued[p] == (int)cluster_id) continue;
+								queued[p] = cluster_id;
+								queue.push_back(p);
+							}
+						};
+						enqueue( ne );
+
+						for (size_t i = 0; i < queue.size(); ++i)
 						{
-							unsigned int nPid = ne[i];
+							unsigned int nPid = queue[i];
 
 							if ( !visited[nPid] )
 							{
 								visited[nPid] = 1;
 
-								Neighbors ne1 = find_neighbors(dm, nPid);
+								Neighbors ne1 = neighbors( nPid );
 
 								if ( ne1.size() >= m_min_elems )
 								{
-									for (const auto & n1 : ne1)
-									{
-										ne.push_back(n1);
-									}
+									enqueue( ne1 );
 								}
 							}
 
@@ -21,7 +21,10 @@ SOURCES += main.cpp\
 
 HEADERS  += mainwindow.h \
             globals.h \
-            Evaluator.h
+            Evaluator.h \
+            DBSCAN.hpp \
+            optics.h \
+            RangeIndex.hpp
 
 FORMS    += mainwindow.ui \
             Evaluator.ui
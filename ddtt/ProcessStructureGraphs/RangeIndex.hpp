@@ -0,0 +1,147 @@
+#pragma once
+
+// kd-tree over the rows of a matrix answering range queries. The tree only prunes by a lower bound
+// on the distance from the query to a node's box, the metric itself stays with the caller: every
+// row that may lie within the radius is handed back and the caller tests it with its own distance.
+// So the neighbours are exactly those of a linear scan with the same distance function.
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Core>
+
+namespace clustering
+{
+	// Weighted L1 (manhattan) distance from a point to a box
+	template<typename Vector>
+	struct L1BoxDistance
+	{
+		Vector W;
+		L1BoxDistance( const Vector & W ) : W(W) {}
+
+		template<typename Row>
+		double operator()( const Row & q, const Eigen::VectorXd & lo, const Eigen::VectorXd & hi ) const
+		{
+			double d = 0;
+			for(int k = 0; k < (int)lo.size(); k++)
+				d += std::max(0.0, std::max(lo[k] - q[k], q[k] - hi[k])) * W[k];
+			return d;
+		}
+	};
+
+	// Euclidean distance from a point to a box
+	struct L2BoxDistance
+	{
+		template<typename Row>
+		double operator()( const Row & q, const Eigen::VectorXd & lo, const Eigen::VectorXd & hi ) const
+		{
+			double d = 0;
+			for(int k = 0; k < (int)lo.size(); k++){
+				double gap = std::max(0.0, std::max(lo[k] - q[k], q[k] - hi[k]));
+				d += gap * gap;
+			}
+			return std::sqrt(d);
+		}
+	};
+
+	template<typename BoxDistance>
+	class RangeIndex
+	{
+	public:
+		RangeIndex( const Eigen::MatrixXd & points, BoxDistance boxDistance, int leafSize = 16 )
+			: P(points), boxDistance(boxDistance)
+		{
+			order.resize( P.rows() );
+			for(int i = 0; i < (int)order.size(); i++) order[i] = i;
+			if( order.empty() ) return;
+
+			nodes.push_back( makeNode(0, (int)order.size()) );
+
+			for(size_t n = 0; n < nodes.size(); n++)
+			{
+				Node node = nodes[n];
+				if( node.end - node.begin <= leafSize ) continue;
+
+				// Split the widest side at the median
+				int axis;
+				(node.hi - node.lo).maxCoeff( &axis );
+				if( node.hi[axis] == node.lo[axis] ) continue;
+
+				int mid = (node.begin + node.end) / 2;
+				std::nth_element( order.begin() + node.begin, order.begin() + mid, order.begin() + node.end,
+					[&](int a, int b){ return P(a, axis) < P(b, axis); } );
+
+				nodes[n].child = (int)nodes.size();
+				nodes.push_back( makeNode(node.begin, mid) );
+				nodes.push_back( makeNode(mid, node.end) );
+			}
+		}
+
+		// Calls f(j) for every row j in a box within 'radius' of 'q', a superset of the rows within 'radius'
+		template<typename Row, typename Function>
+		void candidates( const Row & q, double radius, Function f ) const
+		{
+			if( nodes.empty() ) return;
+
+			// Slack so that rounding in the bound never drops a row, the caller's test decides
+			double limit = radius + 1e-9 * (1.0 + std::abs(radius));
+
+			std::vector<int> stack( 1, 0 );
+
+			while( !stack.empty() )
+			{
+				const Node & node = nodes[ stack.back() ]; stack.pop_back();
+
+				if( boxDistance(q, node.lo, node.hi) > limit ) continue;
+
+				if( node.child < 0 ){
+					for(int i = node.begin; i < node.end; i++) f( order[i] );
+					continue;
+				}
+
+				stack.push_back( node.child );
+				stack.push_back( node.child + 1 );
+			}
+		}
+
+		// Rows with dist(j) <= radius (or < radius when 'isStrict'), in increasing order
+		template<typename Row, typename Distance>
+		std::vector<unsigned int> range( const Row & q, double radius, Distance dist, bool isStrict = false ) const
+		{
+			std::vector<unsigned int> result;
+
+			candidates(q, radius, [&](int j){
+				double d = dist(j);
+				if( isStrict ? (d < radius) : (d <= radius) ) result.push_back( j );
+			});
+
+			std::sort( result.begin(), result.end() );
+			return result;
+		}
+
+		const Eigen::MatrixXd & points() const { return P; }
+
+	private:
+		struct Node{ Eigen::VectorXd lo, hi; int begin, end, child; };	// child + 1 is the second child, -1 for leaves
+
+		const Eigen::MatrixXd P;
+		BoxDistance boxDistance;
+		std::vector<int> order;
+		std::vector<Node> nodes;
+
+		Node makeNode( int begin, int end ) const
+		{
+			Node node;
+			node.begin = begin; node.end = end; node.child = -1;
+			node.lo = P.row( order[begin] ).transpose();
+			node.hi = node.lo;
+
+			for(int i = begin + 1; i < end; i++){
+				node.lo = node.lo.cwiseMin( P.row(order[i]).transpose() );
+				node.hi = node.hi.cwiseMax( P.row(order[i]).transpose() );
+			}
+
+			return node;
+		}
+	};
+}
@@ -34,6 +34,7 @@ static inline void debugBoxVec2( Container2D data, int limit = -1 ){
 
 // Loading XML files
 #include <QDir>
+#include <QFileInfo>
 typedef QMap<QString, QVariantMap> DatasetMap;
 static inline DatasetMap shapesInDataset(QString datasetPath)
 {
@@ -56,6 +57,12 @@ static inline DatasetMap shapesInDataset(QString datasetPath)
 
         dataset[subdir]["Name"] = subdir;
         dataset[subdir]["graphFile"] = d.absolutePath() + "/" + (xml_files.empty() ? "" : xml_files.front());
+        dataset[subdir]["xmlFile"] = dataset[subdir]["graphFile"];
+
+        // Prefer the binary container when one was converted, unless the XML was edited since
+        QString binFile = d.absolutePath() + "/" + QFileInfo(xml_files.front()).completeBaseName() + ".sgb";
+        QFileInfo binInfo(binFile), xmlInfo(dataset[subdir]["graphFile"].toString());
+        if (binInfo.exists() && binInfo.lastModified() >= xmlInfo.lastModified()) dataset[subdir]["graphFile"] = binFile;
         dataset[subdir]["thumbFile"] = d.absolutePath() + "/" + d.entryList(QStringList() << "*.png", QDir::Files).join("");
         dataset[subdir]["objFile"] = d.absolutePath() + "/" + d.entryList(QStringList() << "*.obj", QDir::Files).join("");
     }
@@ -14,6 +14,7 @@
 #include "Evaluator.h"
 
 #include "StructureGraph.h"
+#include "GraphContainer.h"
 
 #include "DBSCAN.hpp"
 #include "optics.h"
@@ -453,7 +454,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
 			dbscan.fit(M);
 
-			auto labels = dbscan.get_labels();
+			labels = dbscan.get_labels();
 			//num_classes = dbscan.num_classes();
 		}
 
@@ -965,6 +966,38 @@ MainWindow::MainWindow(QWidget *parent) :
 
         std::cout << qPrintable(QString("Time = %1").arg(timer.elapsed()));
     });
+
+	connect(ui->convertBinaryButton, &QPushButton::clicked, [&](){
+		auto folders = shapesInDataset(default_folder);
+
+		int converted = 0;
+		for (auto folder : folders)
+			if (GraphContainer::convert(folder["xmlFile"].toString())) converted++;
+
+		debugBox(QString("Converted %1 of %2 graphs").arg(converted).arg(folders.size()));
+	});
+
+	connect(ui->loaderBenchButton, &QPushButton::clicked, [&](){
+		auto folders = shapesInDataset(default_folder);
+
+		QStringList xmlFiles;
+		for (auto folder : folders) xmlFiles << folder["xmlFile"].toString();
+
+		auto b = GraphContainer::benchmark(xmlFiles);
+
+		debugBox(QString("Graphs (%1): XML (%2 s) / binary (%3 s) / mismatches (%4)")
+			.arg(b.files).arg(b.xml, 0, 'f', 2).arg(b.binary, 0, 'f', 2).arg(b.mismatches));
+	});
+
+	connect(ui->clusterBenchButton, &QPushButton::clicked, [&](){
+		typedef clustering::DBSCAN<Eigen::VectorXd, Eigen::MatrixXd> DBSCAN;
+
+		auto M = DBSCAN::gen_cluster_data(6, 4000);
+		auto c = DBSCAN::compare(M, ui->greedyParam->value(), ui->greedyParam2->value());
+
+		debugBox(QString("DBSCAN (%1 elements): distance matrix (%2 s) / range queries (%3 s) / mismatches (%4)")
+			.arg(c.elements).arg(c.dense, 0, 'f', 2).arg(c.indexed, 0, 'f', 2).arg(c.mismatches));
+	});
 }
 
 MainWindow::~MainWindow()
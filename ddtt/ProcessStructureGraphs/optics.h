@@ -32,6 +32,9 @@
 #include <fstream>
 #include <map>
 #include <iostream>
+#include <memory>
+
+#include "RangeIndex.hpp"
 
 #pragma warning(disable: 4267)
 
@@ -54,7 +57,6 @@
  *  - Extract the hierarchy properly (what would be a good way to store / return this?)
  *  - Fix known issues (as far as possible)
  *  - Fix other TODO's scattered in the code
- *  - Use an indexer to speed up neighborhood queries...
  *  - Use a seperate class / ABC for the cluster extracting algorithms
  *  - Keep AIM stuff apart from OPTICS stuff: move OPTICS to seperate class
  *
@@ -212,6 +214,7 @@ private:
     bool permissive;
 
     std::vector<int> seeds;
+	std::shared_ptr< clustering::RangeIndex<clustering::L2BoxDistance> > index; // kd-tree over data_set, null when it holds nan or inf
 	std::vector<DataPoint> data_set;    //every sample thats coming in is stored here
 	std::vector<DataPoint> ordered_set;  //the result of the basic OPTICS algorithm
 	std::vector<Cluster> clusters;      //using some heuristics, clusters are made out of that
@@ -468,6 +471,8 @@ private:
 	 * Function to start OPTICS and keep expanding seeds
 	 ****************************************************/
 	void startOptics() {
+		buildIndex();
+
         for (int i = 0; i < data_set.size(); i++) {
             if (!data_set[i].processed) {
             	seeds.push_back(i); //finds the first sample that wasnt processed yet
@@ -476,6 +481,20 @@ private:
 	    }
 	}
 
+	void buildIndex() {
+		index.reset();
+		if (data_set.empty()) return;
+
+		Eigen::MatrixXd points(data_set.size(), data_set.front().data.size());
+		for (int i = 0; i < data_set.size(); i++) points.row(i) = data_set[i].data;
+
+		// Box bounds are meaningless for non finite values, those go through the linear scan
+		for (int i = 0; i < points.size(); i++)
+			if (!std::isfinite(points.data()[i])) return;
+
+		index = std::make_shared< clustering::RangeIndex<clustering::L2BoxDistance> >(points, clustering::L2BoxDistance());
+	}
+
 	/******************************************************************************************************************
 	 * Helper function to find the seed that should be processed next: the one with the smallest reachability distance
 	 *****************************************************************************************************************/
@@ -503,53 +522,63 @@ private:
      ***********************************************************/
     void expandSeeds() {
 
-        //first find seed thats up next; thats the one with the smallest reachability distance
-        int nextSeed = seedWithSmallestRDistance();
-        int i = seeds[nextSeed];  //store the index of the sample we are interested in
-        seeds.erase(seeds.begin() + nextSeed); //and take it off the seeds list
-
-        //then find the seeds neighbors
-        std::vector<Neighbor> neighbors;
-        std::vector<double> distances;
-        for (int j = 0; j < data_set.size(); j++) {  /// TODO: this is the main/only candidate for speedup by indexing
-            if (j == i) continue;                    //  dont put yourself on your neighbors list..
-            double distance = (data_set[i].data - data_set[j].data).norm();
-            if (distance >= epsilon) continue;       //  point is too far away to be a neighbor
-            neighbors.push_back( {j, distance} );
-            distances.push_back(distance);           // this one only for sorting in the next step
-        }
+        //keep going until there are no seeds left
+        while (!seeds.empty()) {
+
+            //first find seed thats up next; thats the one with the smallest reachability distance
+            int nextSeed = seedWithSmallestRDistance();
+            int i = seeds[nextSeed];  //store the index of the sample we are interested in
+            seeds.erase(seeds.begin() + nextSeed); //and take it off the seeds list
+
+            //then find the seeds neighbors, in increasing order of index
+            std::vector<Neighbor> neighbors;
+            std::vector<double> distances;
+            auto visit = [&](int j) {
+                if (j == i) return;                      //  dont put yourself on your neighbors list..
+                double distance = (data_set[i].data - data_set[j].data).norm();
+                if (distance >= epsilon) return;         //  point is too far away to be a neighbor
+                neighbors.push_back( {j, distance} );
+                distances.push_back(distance);           // this one only for sorting in the next step
+            };
+
+            if (index) {
+                std::vector<int> candidates;             // rows whose kd-tree box is within epsilon
+                index->candidates(data_set[i].data, epsilon, [&](int j){ candidates.push_back(j); });
+                std::sort(candidates.begin(), candidates.end());
+                for (int j : candidates) visit(j);
+            } else {
+                for (int j = 0; j < data_set.size(); j++) visit(j);
+            }
 
-        //calculate core distance of current seed (it stays -1 if its not a core object)
-        if (neighbors.size() >= minPts) {
-            std::partial_sort(distances.begin(), distances.begin() + minPts ,distances.end());
-            data_set[i].coreDistance = distances[minPts - 1];
-        }
+            //calculate core distance of current seed (it stays -1 if its not a core object)
+            if (neighbors.size() >= minPts) {
+                std::partial_sort(distances.begin(), distances.begin() + minPts ,distances.end());
+                data_set[i].coreDistance = distances[minPts - 1];
+            }
 
-        //do some bookkeeping...
-        data_set[i].processed = true;             //dont return to this sample anymore
-        ///TODO: better to only store order with ints instead of whole structs
-        ordered_set.push_back(data_set[i]);       //insert data point in ordered list
-        if (data_set[i].coreDistance >= 0) { //finally, if we have a core object, add its neighbours to the seed list
-			for (int j = 0; j < neighbors.size(); j++) {
-				if (data_set[neighbors[j].index].processed) continue; //dont add neighbors that have been processed already
-
-				//check if we should update reachability distance from current sample
-				double newReachibilityDistance = std::max(data_set[i].coreDistance, neighbors[j].distance);
-
-				//insert neighbour as seed if it isnt in the list yet
-				if (data_set[neighbors[j].index].reachabilityDistance < 0) {
-
-					seeds.push_back(neighbors[j].index);
-					data_set[neighbors[j].index].reachabilityDistance = newReachibilityDistance;
-				} else { //should be in the list already, just check if we have to update r-distance
-					data_set[neighbors[j].index].reachabilityDistance =
-							std::min(newReachibilityDistance, data_set[neighbors[j].index].reachabilityDistance);
-				}
-			}
+            //do some bookkeeping...
+            data_set[i].processed = true;             //dont return to this sample anymore
+            ///TODO: better to only store order with ints instead of whole structs
+            ordered_set.push_back(data_set[i]);       //insert data point in ordered list
+            if (data_set[i].coreDistance >= 0) { //finally, if we have a core object, add its neighbours to the seed list
+                for (int j = 0; j < neighbors.size(); j++) {
+                    if (data_set[neighbors[j].index].processed) continue; //dont add neighbors that have been processed already
+
+                    //check if we should update reachability distance from current sample
+                    double newReachibilityDistance = std::max(data_set[i].coreDistance, neighbors[j].distance);
+
+                    //insert neighbour as seed if it isnt in the list yet
+                    if (data_set[neighbors[j].index].reachabilityDistance < 0) {
+
+                        seeds.push_back(neighbors[j].index);
+                        data_set[neighbors[j].index].reachabilityDistance = newReachibilityDistance;
+                    } else { //should be in the list already, just check if we have to update r-distance
+                        data_set[neighbors[j].index].reachabilityDistance =
+                                std::min(newReachibilityDistance, data_set[neighbors[j].index].reachabilityDistance);
+                    }
+                }
+            }
         }
-
-        //keep going until there are no seeds left
-        if (!seeds.empty()) expandSeeds();
     }
 
 };
@@ -69,6 +69,38 @@ public:
     }
 };
 
+// Reads positions and normals in place from caller owned arrays, strides are in floats
+template< class Real >
+class StridedPointStream : public PointStream< Real >
+{
+    const float *pos, *normal;
+    size_t posStride, normalStride, count, curPos;
+public:
+    StridedPointStream( const float * positions, size_t positionStride, const float * normals, size_t normalsStride, size_t pointCount ){
+        pos = positions;
+        normal = normals;
+        posStride = positionStride;
+        normalStride = normalsStride;
+        count = pointCount;
+
+        reset();
+    }
+    ~StridedPointStream( void ){}
+    void reset( void ){
+        curPos = 0;
+    }
+    bool nextPoint( Point3D< Real >& p , Point3D< Real >& n ){
+        if(curPos == count)
+            return false;
+        const float * pp = pos + curPos * posStride;
+        const float * nn = normal + curPos * normalStride;
+        p[0] = pp[0]; p[1] = pp[1]; p[2] = pp[2];
+        n[0] = nn[0]; n[1] = nn[1]; n[2] = nn[2];
+        curPos++;
+        return true;
+    }
+};
+
 template< class Real >
 class ASCIIPointStream : public PointStream< Real >
 {
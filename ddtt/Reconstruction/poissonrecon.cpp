@@ -3,9 +3,14 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QTextStream>
+#include <QMutex>
+#include <omp.h>
 
 #include "Src/PoissonRecon.cpp"
 
+// The solver keeps its parameters and node allocator in globals, one reconstruction at a time
+static QMutex executeMutex;
+
 char **PoissonRecon::convertArguments(QStringList args)
 {
     char ** argsv = new char*[args.size()];
@@ -23,53 +28,132 @@ char **PoissonRecon::convertArguments(QStringList args)
     return argsv;
 }
 
-void PoissonRecon::makeFromCloud( std::vector< std::vector<float> > p, std::vector< std::vector<float> > n, SimpleMesh & mesh, int depth /*= 7*/ )
+// In memory variant of 'writeTriMesh', flattened straight into the caller's buffers
+static void writeTriMesh( CoredMeshData< PlyVertex< Real > >* mesh, std::vector< float > & vertices, std::vector< int > & triangles )
 {
-	QStringList args;
+	int inCore = int( mesh->inCorePoints.size() );
+	int vertexStart = int( vertices.size() / 3 );
 
-	args << "program_name";
-	args << "--in" << "dummy" << "--out" << "output";
-	args << "--depth" << QString::number(depth);
+	mesh->resetIterator();
 
-	std::vector< std::vector<float> > mesh_verts;
-	std::vector< std::vector<int> > mesh_faces;
+	vertices.reserve( vertices.size() + 3 * (inCore + mesh->outOfCorePointCount()) );
+	triangles.reserve( triangles.size() + 3 * mesh->polygonCount() );
 
-    ExecuteMemory< 2 >(args.size(), convertArguments(args), p, n, mesh.vertices, mesh.faces);
+	PlyVertex< float > p;
+	for( int i = 0; i < inCore; i++ )
+	{
+		p = mesh->inCorePoints[i];
+		vertices.push_back( p.point[0] ); vertices.push_back( p.point[1] ); vertices.push_back( p.point[2] );
+	}
+	for( int i = 0, n = mesh->outOfCorePointCount(); i < n; i++ )
+	{
+		mesh->nextOutOfCorePoint( p );
+		vertices.push_back( p.point[0] ); vertices.push_back( p.point[1] ); vertices.push_back( p.point[2] );
+	}
 
-	// DEBUG: output point cloud
-	if( mesh.faces.size() == 0 )
+	std::vector< CoredVertexIndex > polygon;
+	for( int i = 0, n = mesh->polygonCount(); i < n; i++ )
 	{
-		QFile file( "cloud.xyz" );
-		QFileInfo fileInfo(file.fileName());
-		QDir d(""); d.mkpath(fileInfo.absolutePath());
-		if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return;
-		QTextStream out(&file);
-
-		for(int i = 0; i < (int)p.size(); i++){
-			for(int v = 0; v < 3; v++)	out << p[i][v] << " ";
-			for(int v = 0; v < 3; v++)	out << n[i][v] << " ";
-			out << "\n";
-		}
-
-		file.close();
+		mesh->nextPolygon( polygon );
+		for( auto & v : polygon ) triangles.push_back( vertexStart + (v.inCore ? v.idx : v.idx + inCore) );
+	}
+}
+
+template< int Degree >
+static bool ExecuteOptions( PointStream< Real > * ps, const PoissonOptions & options, std::vector< float > & vertices, std::vector< int > & triangles )
+{
+	typedef OctNode< TreeNodeData< false > , Real > TreeOctNode;
+
+	int depth = options.depth;
+	int minDepth = std::min( options.minDepth, depth );
+	int kernelDepth = options.kernelDepth < 0 ? depth - 2 : std::min( options.kernelDepth, depth );
+	int solverDivide = std::max( options.solverDivide, minDepth );
+	int isoDivide = std::max( options.isoDivide, minDepth );
+
+	// Node blocks stay allocated between calls, rolling back hands them to the new tree
+	if( !TreeOctNode::UseAllocator() ) TreeOctNode::SetAllocator( MEMORY_ALLOCATOR_BLOCK_SIZE );
+	else TreeOctNode::Allocator.rollBack();
+
+	Octree< Degree , false > tree;
+	tree.threads = options.threads > 0 ? options.threads : omp_get_num_procs();
+	tree.setBSplineData( depth , options.boundary );
+
+	int pointCount = tree.setTreeMemory( ps , depth , minDepth , kernelDepth , Real(options.samplesPerNode) , options.scale ,
+		options.confidence , options.pointWeight , options.adaptiveExponent , XForm4x4< Real >::Identity() );
+	if( !pointCount ) return false;
+
+	tree.ClipTree();
+	tree.finalize( isoDivide );
+	tree.SetLaplacianConstraints();
+	tree.LaplacianMatrixIteration( solverDivide , false , options.minIters , options.accuracy , depth , options.fixedIters );
+
+	CoredVectorMeshData< PlyVertex< Real > > mesh;
+	tree.GetMCIsoTriangles( tree.GetIsoValue() , isoDivide , &mesh , 0 , 1 , options.manifold , false );
+
+	size_t before = triangles.size();
+	writeTriMesh( &mesh, vertices, triangles );
+
+	return triangles.size() > before;
+}
+
+bool PoissonRecon::reconstruct( const float * positions, size_t positionStride, const float * normals, size_t normalStride, size_t count,
+	const PoissonOptions & options, std::vector<float> & vertices, std::vector<int> & triangles )
+{
+	if( !count ) return false;
+
+	QMutexLocker locker(&executeMutex);
+
+	// Stream is released by the tree
+	PointStream< Real > * ps = new StridedPointStream< Real >( positions, positionStride, normals, normalStride, count );
+	return ExecuteOptions< 2 >( ps, options, vertices, triangles );
+}
+
+void PoissonRecon::releaseScratch()
+{
+	QMutexLocker locker(&executeMutex);
+	OctNode< TreeNodeData< false > , Real >::SetAllocator( 0 );
+	OctNode< TreeNodeData< false > , Real >::Allocator.reset();
+}
+
+static bool reconstructNested( const std::vector< std::vector<float> > & p, const std::vector< std::vector<float> > & n, int depth,
+	std::vector<float> & vertices, std::vector<int> & triangles )
+{
+	std::vector<float> flatP, flatN;
+	flatP.reserve( p.size() * 3 );
+	flatN.reserve( n.size() * 3 );
+	for(size_t i = 0; i < p.size(); i++){
+		flatP.insert( flatP.end(), p[i].begin(), p[i].begin() + 3 );
+		flatN.insert( flatN.end(), n[i].begin(), n[i].begin() + 3 );
 	}
+
+	PoissonOptions options;
+	options.depth = depth;
+
+	return PoissonRecon::reconstruct( flatP.data(), 3, flatN.data(), 3, p.size(), options, vertices, triangles );
 }
 
-void PoissonRecon::makeFileFromCloud( std::vector< std::vector<float> > p, std::vector< std::vector<float> > n, QString out_filename, int depth /*= 7*/ )
+void PoissonRecon::makeFromCloud( const std::vector< std::vector<float> > & p, const std::vector< std::vector<float> > & n, SimpleMesh & mesh, int depth /*= 7*/ )
 {
-	QStringList args;
+	std::vector<float> vertices;
+	std::vector<int> triangles;
+	reconstructNested( p, n, depth, vertices, triangles );
 
-	args << "program_name";
-	args << "--in" << "dummy" << "--out" << "output";
-	args << "--depth" << QString::number(depth);
+	mesh.vertices.resize( vertices.size() / 3 );
+	for(size_t i = 0; i < mesh.vertices.size(); i++)
+		mesh.vertices[i].assign( vertices.begin() + 3 * i, vertices.begin() + 3 * i + 3 );
 
-	std::vector< std::vector<float> > mesh_verts;
-	std::vector< std::vector<int> > mesh_faces;
+	mesh.faces.resize( triangles.size() / 3 );
+	for(size_t i = 0; i < mesh.faces.size(); i++)
+		mesh.faces[i].assign( triangles.begin() + 3 * i, triangles.begin() + 3 * i + 3 );
+}
 
-    ExecuteMemory< 2 >(args.size(), convertArguments(args), p, n, mesh_verts, mesh_faces);
+void PoissonRecon::makeFileFromCloud( const std::vector< std::vector<float> > & p, const std::vector< std::vector<float> > & n, QString out_filename, int depth /*= 7*/ )
+{
+	SimpleMesh mesh;
+	makeFromCloud( p, n, mesh, depth );
 
 	// Write OBJ
-	writeOBJ(out_filename, mesh_verts, mesh_faces);
+	writeOBJ(out_filename, mesh.vertices, mesh.faces);
 }
 
 void PoissonRecon::writeOBJ(QString out_filename, std::vector< std::vector<float> > & mesh_verts, std::vector< std::vector<int> > & mesh_faces)
@@ -9,14 +9,42 @@ struct SimpleMesh{
 	std::vector< std::vector<int> > faces;
 };
 
+// Solver settings, defaults match the command line tool
+struct PoissonOptions{
+	int depth = 8;
+	int minDepth = 5;
+	int kernelDepth = -1;		// depth - 2 when negative
+	int solverDivide = 8;
+	int isoDivide = 8;
+	int minIters = 24;
+	int fixedIters = -1;
+	int boundary = 1;
+	int adaptiveExponent = 1;
+	float samplesPerNode = 1.0f;
+	float scale = 1.1f;
+	float accuracy = 1e-3f;
+	float pointWeight = 4.0f;
+	bool confidence = false;
+	bool manifold = true;
+	int threads = 0;			// all cores when not positive
+};
+
 class PoissonRecon
 {
 public:
     static char** convertArguments(QStringList args);
 
+	// Reads 'count' samples in place, strides are in floats (3 for packed xyz).
+	// Output is appended to 'vertices' as xyz triples and to 'triangles' as index triples.
+	static bool reconstruct( const float * positions, size_t positionStride, const float * normals, size_t normalStride, size_t count,
+		const PoissonOptions & options, std::vector<float> & vertices, std::vector<int> & triangles );
+
+	// Frees the octree blocks kept between calls
+	static void releaseScratch();
+
     //static void makeFromCloudFile(QString filename, QString out_filename, int depth = 7);
-	static void makeFileFromCloud( std::vector< std::vector<float> > p, std::vector< std::vector<float> > n, QString out_filename, int depth = 7);
-	static void makeFromCloud(std::vector< std::vector<float> > p, std::vector< std::vector<float> > n, SimpleMesh & mesh, int depth = 7);
+	static void makeFileFromCloud( const std::vector< std::vector<float> > & p, const std::vector< std::vector<float> > & n, QString out_filename, int depth = 7);
+	static void makeFromCloud( const std::vector< std::vector<float> > & p, const std::vector< std::vector<float> > & n, SimpleMesh & mesh, int depth = 7);
 
 	static void writeOBJ(QString out_filename, std::vector< std::vector<float> > & mesh_verts, std::vector< std::vector<int> > & mesh_faces);
 };
@@ -0,0 +1,250 @@
+#include "GraphAnimation.h"
+using namespace Structure;
+
+GraphAnimation::GraphAnimation( int keyframeInterval, int cacheSize )
+	: keyframeInterval(qMax(1, keyframeInterval)), cacheSize(qMax(1, cacheSize))
+{
+}
+
+GraphAnimation::~GraphAnimation()
+{
+	clear();
+}
+
+void GraphAnimation::clear()
+{
+	QMutexLocker locker(&mutex);
+
+	qDeleteAll(keyframes);
+	keyframes.clear();
+	keyframeStart.clear();
+	frames.clear();
+
+	cache.clear();
+	recent.clear();
+}
+
+int GraphAnimation::size() const
+{
+	QMutexLocker locker(&mutex);
+	return frames.size();
+}
+
+bool GraphAnimation::isCompatible( Graph * key, Graph * g ) const
+{
+	if(key->nodes.size() != g->nodes.size() || key->edges.size() != g->edges.size()) return false;
+
+	for(int i = 0; i < (int)g->nodes.size(); i++)
+	{
+		Node * a = key->nodes[i], * b = g->nodes[i];
+		if(a->id != b->id || a->type() != b->type() || a->controlCount() != b->controlCount()) return false;
+		if(a->controlWeights() != b->controlWeights()) return false;
+
+		// Knots come from the keyframe
+		if(a->type() == CURVE && ((Curve*)a)->curve.GetKnotVector() != ((Curve*)b)->curve.GetKnotVector()) return false;
+		if(a->type() == SHEET){
+			NURBS::NURBSRectangled & sa = ((Sheet*)a)->surface, & sb = ((Sheet*)b)->surface;
+			if(sa.GetKnotVectorU() != sb.GetKnotVectorU() || sa.GetKnotVectorV() != sb.GetKnotVectorV()) return false;
+		}
+	}
+
+	for(int i = 0; i < (int)g->edges.size(); i++)
+	{
+		Link * a = key->edges[i], * b = g->edges[i];
+		if(a->id != b->id || a->n1->id != b->n1->id || a->n2->id != b->n2->id) return false;
+		if(a->coord[0].size() != b->coord[0].size() || a->coord[1].size() != b->coord[1].size()) return false;
+	}
+
+	return true;
+}
+
+void GraphAnimation::append( Graph * g )
+{
+	QMutexLocker locker(&mutex);
+
+	Frame f;
+	f.property = g->property;
+	f.groups = g->groups;
+	f.debugPoints = g->debugPoints;
+	f.debugPoints2 = g->debugPoints2;
+	f.debugPoints3 = g->debugPoints3;
+	f.misc = g->misc;
+
+	bool isKeyframe = keyframes.isEmpty()
+		|| (frames.size() - keyframeStart.back()) >= keyframeInterval
+		|| !isCompatible(keyframes.back(), g);
+
+	if( isKeyframe )
+	{
+		f.key = keyframes.size();
+		keyframes.push_back( new Graph(*g) );
+		keyframeStart.push_back( frames.size() );
+		frames.push_back( f );
+		return;
+	}
+
+	f.key = keyframes.size() - 1;
+	Graph * key = keyframes.back();
+
+	for(int i = 0; i < (int)g->nodes.size(); i++)
+	{
+		Node * n = g->nodes[i];
+
+		NodeState s;
+		s.property = n->property;
+		s.meta = n->meta;
+		s.vis_property = n->vis_property;
+
+		std::vector<Vector3> points = n->controlPoints();
+		if(points != key->nodes[i]->controlPoints()) s.points = points;
+
+		f.nodes.push_back( s );
+	}
+
+	for(int i = 0; i < (int)g->edges.size(); i++)
+	{
+		Link * l = g->edges[i];
+
+		LinkState s;
+		s.coord = l->coord;
+		s.property = l->property;
+		s.state = l->state;
+
+		f.links.push_back( s );
+	}
+
+	frames.push_back( f );
+}
+
+Graph * GraphAnimation::materialize( int i ) const
+{
+	const Frame & f = frames[i];
+
+	Graph * g = new Graph( *keyframes[f.key] );
+
+	g->debugPoints = f.debugPoints;
+	g->debugPoints2 = f.debugPoints2;
+	g->debugPoints3 = f.debugPoints3;
+	g->misc = f.misc;
+
+	if( f.nodes.isEmpty() ) return g;
+
+	g->property = f.property;
+	g->groups = f.groups;
+
+	for(int j = 0; j < (int)f.nodes.size(); j++)
+	{
+		Node * n = g->nodes[j];
+		const NodeState & s = f.nodes[j];
+
+		n->property = s.property;
+		n->meta = s.meta;
+		n->vis_property = s.vis_property;
+
+		if( !s.points.empty() ) n->setControlPoints( s.points );
+	}
+
+	for(int j = 0; j < (int)f.links.size(); j++)
+	{
+		Link * l = g->edges[j];
+		const LinkState & s = f.links[j];
+
+		l->coord = s.coord;
+		l->property = s.property;
+		l->state = s.state;
+	}
+
+	return g;
+}
+
+QSharedPointer<Graph> GraphAnimation::operator[]( int i )
+{
+	QMutexLocker locker(&mutex);
+
+	if( cache.contains(i) )
+	{
+		recent.removeOne(i);
+		recent.push_front(i);
+		return cache[i];
+	}
+
+	QSharedPointer<Graph> g( materialize(i) );
+	cache[i] = g;
+	recent.push_front(i);
+
+	// Least recently used frames are dropped, callers still holding one keep it alive
+	while( recent.size() > cacheSize )
+		cache.remove( recent.takeLast() );
+
+	return g;
+}
+
+Graph * GraphAnimation::build( int i ) const
+{
+	QMutexLocker locker(&mutex);
+	return materialize(i);
+}
+
+void GraphAnimation::apply( std::function<void(Graph*)> modify )
+{
+	GraphAnimation modified( keyframeInterval, cacheSize );
+
+	int count = size();
+	for(int i = 0; i < count; i++)
+	{
+		Graph * g = build(i);
+		modify( g );
+		modified.append( g );
+		delete g;
+	}
+
+	clear();
+
+	QMutexLocker locker(&mutex);
+	qSwap(keyframes, modified.keyframes);
+	qSwap(keyframeStart, modified.keyframeStart);
+	qSwap(frames, modified.frames);
+}
+
+size_t GraphAnimation::graphBytes( Graph * g )
+{
+	size_t bytes = sizeof(Graph);
+
+	foreach(Node * n, g->nodes)
+	{
+		bytes += (n->type() == CURVE) ? sizeof(Curve) : sizeof(Sheet);
+		bytes += n->numCtrlPnts() * (sizeof(Vector3) + sizeof(Scalar));
+	}
+
+	foreach(Link * l, g->edges)
+	{
+		bytes += sizeof(Link);
+		for(auto & c : l->coord) bytes += c.size() * sizeof(Vector4d);
+	}
+
+	bytes += (g->debugPoints.size() + g->debugPoints2.size() + g->debugPoints3.size()) * sizeof(Vector3);
+
+	return bytes;
+}
+
+size_t GraphAnimation::memoryBytes() const
+{
+	QMutexLocker locker(&mutex);
+
+	size_t bytes = 0;
+
+	foreach(Graph * g, keyframes) bytes += graphBytes(g);
+	foreach(QSharedPointer<Graph> g, cache) bytes += graphBytes(g.data());
+
+	for(auto & f : frames)
+	{
+		bytes += sizeof(Frame);
+		bytes += f.nodes.size() * sizeof(NodeState) + f.links.size() * sizeof(LinkState);
+
+		bytes += (f.debugPoints.size() + f.debugPoints2.size() + f.debugPoints3.size()) * sizeof(Vector3);
+		for(auto & s : f.nodes) bytes += s.points.size() * sizeof(Vector3);
+		for(auto & s : f.links) for(auto & c : s.coord) bytes += c.size() * sizeof(Vector4d);
+	}
+
+	return bytes;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+#include <QMutex>
+#include <QSharedPointer>
+
+#include "StructureGraph.h"
+
+// Sequence of graphs produced by a blend. Every few steps (and whenever the topology
+// changes) a full keyframe is kept, other frames only store node and link properties
+// and the control points of nodes that moved away from their keyframe.
+// Frames are rebuilt on demand and the most recently used ones are cached. A frame from
+// operator[] is shared with the cache and stays alive as long as the caller holds it.
+// Debug points and 'misc' are kept per frame. Knot vectors are not stored per frame, a
+// frame whose knots differ from the current keyframe starts a new keyframe instead.
+class GraphAnimation
+{
+public:
+	GraphAnimation( int keyframeInterval = 16, int cacheSize = 16 );
+	~GraphAnimation();
+
+	// Records the current state of 'g', the graph itself is not kept
+	void append( Structure::Graph * g );
+	void clear();
+
+	int size() const;
+	bool isEmpty() const { return size() == 0; }
+
+	// Frame access, shared with the cache
+	QSharedPointer<Structure::Graph> operator[]( int i );
+	QSharedPointer<Structure::Graph> front() { return (*this)[0]; }
+	QSharedPointer<Structure::Graph> back() { return (*this)[size() - 1]; }
+
+	// Fresh copy owned by the caller, does not touch the cache
+	Structure::Graph * build( int i ) const;
+
+	// Modify every frame, the sequence is re-encoded afterwards
+	void apply( std::function<void(Structure::Graph*)> modify );
+
+	// Footprint of stored keyframes, deltas and cached frames
+	size_t memoryBytes() const;
+	static size_t graphBytes( Structure::Graph * g );
+
+private:
+	struct NodeState{
+		PropertyMap property, meta;
+		QMap< QString, QVariant > vis_property;
+		std::vector<Vector3> points; // empty when same as keyframe
+	};
+
+	struct LinkState{
+		std::vector<LinkCoords> coord;
+		PropertyMap property;
+		QMap< QString, QVariant > state;
+	};
+
+	struct Frame{
+		int key;
+		PropertyMap property;
+		Structure::NodeGroups groups;
+		std::vector<Vector3> debugPoints, debugPoints2, debugPoints3;
+		QMap< QString, void* > misc;
+		QVector<NodeState> nodes; // empty for keyframes
+		QVector<LinkState> links;
+	};
+
+	int keyframeInterval, cacheSize;
+
+	QVector<Structure::Graph*> keyframes;
+	QVector<int> keyframeStart;
+	QVector<Frame> frames;
+
+	QMap< int, QSharedPointer<Structure::Graph> > cache;
+	QList<int> recent;
+
+	mutable QMutex mutex;
+
+	bool isCompatible( Structure::Graph * key, Structure::Graph * g ) const;
+	Structure::Graph * materialize( int i ) const;
+
+	GraphAnimation( const GraphAnimation & );
+	GraphAnimation & operator=( const GraphAnimation & );
+};
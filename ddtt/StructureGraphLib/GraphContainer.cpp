@@ -0,0 +1,421 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QElapsedTimer>
+
+#include "GraphContainer.h"
+using namespace Structure;
+
+static const char MAGIC[4] = { 'S', 'G', 'B', '\0' };
+const quint32 GraphContainer::VERSION;
+
+namespace{
+
+struct Writer
+{
+	QByteArray data;
+
+	template<typename T> void put( const T & value ) { data.append( (const char*) &value, sizeof(T) ); }
+	void putArray( const void * values, size_t bytes ) { data.append( (const char*) values, int(bytes) ); }
+	void putString( const QString & s ) { QByteArray utf = s.toUtf8(); put<quint32>( utf.size() ); data.append( utf ); }
+};
+
+// Reads straight from the mapped file, every read is bounds checked
+struct Reader
+{
+	const uchar * cur, * end;
+	bool ok;
+
+	Reader( const uchar * data, qint64 size ) : cur(data), end(data + size), ok(true) {}
+
+	bool has( size_t bytes ) { if( size_t(end - cur) < bytes ) ok = false; return ok; }
+
+	template<typename T> T get()
+	{
+		T value = T();
+		if( !has(sizeof(T)) ) return value;
+		memcpy( &value, cur, sizeof(T) );
+		cur += sizeof(T);
+		return value;
+	}
+
+	void getArray( void * values, size_t bytes )
+	{
+		if( !has(bytes) ) return;
+		memcpy( values, cur, bytes );
+		cur += bytes;
+	}
+
+	// Element count, rejected when the remaining data cannot hold that many elements
+	quint32 getCount( size_t elementBytes )
+	{
+		quint32 count = get<quint32>();
+		if( !has(count * elementBytes) ) return 0;
+		return count;
+	}
+
+	QString getString()
+	{
+		quint32 size = get<quint32>();
+		if( !has(size) ) return QString();
+		QString s = QString::fromUtf8( (const char*) cur, int(size) );
+		cur += size;
+		return s;
+	}
+};
+
+}
+
+bool GraphContainer::isContainer( QString filename )
+{
+	QFile file( filename );
+	if( !file.open(QIODevice::ReadOnly) ) return false;
+
+	char magic[4];
+	return file.read( magic, 4 ) == 4 && memcmp( magic, MAGIC, 4 ) == 0;
+}
+
+bool GraphContainer::save( Graph * g, QString filename )
+{
+	Writer w;
+	w.putArray( MAGIC, 4 );
+	w.put<quint32>( VERSION );
+
+	// Nodes
+	w.put<quint32>( g->nodes.size() );
+	foreach(Node * n, g->nodes)
+	{
+		w.putString( n->id );
+		w.putString( n->type() );
+		w.putString( n->property.value("mesh_filename").toString() );
+
+		std::vector<int> controlCount = n->controlCount();
+		w.put<quint32>( quint32(controlCount.size()) );
+		for(int c : controlCount) w.put<qint32>( c );
+
+		std::vector<Vector3> points = n->controlPoints();
+		w.put<quint32>( quint32(points.size()) );
+		for(auto & p : points) w.putArray( p.data(), 3 * sizeof(double) );
+
+		std::vector<Scalar> weights = n->controlWeights();
+		w.put<quint32>( quint32(weights.size()) );
+		for(Scalar s : weights) w.put<double>( s );
+
+		w.put<quint32>( n->meta.size() );
+		foreach(QString key, n->meta.keys()){
+			w.putString( key );
+			w.putString( n->meta[key].toString() );
+		}
+
+		// Part mesh, vertices are renumbered in iteration order
+		QSharedPointer<SurfaceMeshModel> mesh = n->property.value("mesh").value< QSharedPointer<SurfaceMeshModel> >();
+		w.put<quint8>( mesh.isNull() ? 0 : 1 );
+		if( mesh.isNull() ) continue;
+
+		SurfaceMesh::Vector3VertexProperty meshPoints = mesh->vertex_property<Vector3d>("v:point");
+		std::vector<quint32> remap( mesh->vertices_size(), 0 );
+
+		w.put<quint32>( mesh->n_vertices() );
+		quint32 vi = 0;
+		foreach(SurfaceMesh::Vertex v, mesh->vertices()){
+			remap[v.idx()] = vi++;
+			w.putArray( meshPoints[v].data(), 3 * sizeof(double) );
+		}
+
+		std::vector<quint32> valence, indices;
+		foreach(SurfaceMesh::Face f, mesh->faces()){
+			quint32 count = 0;
+			for(auto v : mesh->vertices(f)){ indices.push_back( remap[v.idx()] ); count++; }
+			valence.push_back( count );
+		}
+
+		w.put<quint32>( quint32(valence.size()) );
+		w.putArray( valence.data(), valence.size() * sizeof(quint32) );
+		w.put<quint32>( quint32(indices.size()) );
+		w.putArray( indices.data(), indices.size() * sizeof(quint32) );
+	}
+
+	// Edges
+	w.put<quint32>( g->edges.size() );
+	foreach(Link * e, g->edges)
+	{
+		w.putString( e->id );
+		w.putString( e->type );
+		w.putString( e->n1->id );
+		w.putString( e->n2->id );
+
+		for(int k = 0; k < 2; k++){
+			w.put<quint32>( quint32(e->coord[k].size()) );
+			for(auto & c : e->coord[k]) w.putArray( c.data(), 4 * sizeof(double) );
+		}
+	}
+
+	// Groups
+	w.put<quint32>( g->groups.size() );
+	foreach(QVector<QString> group, g->groups){
+		w.put<quint32>( group.size() );
+		foreach(QString nid, group) w.putString( nid );
+	}
+
+	QFile file( filename );
+	if( !file.open(QIODevice::WriteOnly) ) return false;
+	return file.write( w.data ) == w.data.size();
+}
+
+bool GraphContainer::load( Graph * g, QString filename )
+{
+	QFile file( filename );
+	if( !file.open(QIODevice::ReadOnly) ) return false;
+
+	qint64 size = file.size();
+	const uchar * mapped = file.map( 0, size );
+
+	// Fall back to one read when mapping is not available
+	QByteArray buffer;
+	if( !mapped ){
+		buffer = file.readAll();
+		mapped = (const uchar *) buffer.constData();
+		size = buffer.size();
+	}
+
+	Reader r( mapped, size );
+
+	char magic[4];
+	r.getArray( magic, 4 );
+	if( !r.ok || memcmp( magic, MAGIC, 4 ) != 0 ) return false;
+	if( r.get<quint32>() != VERSION ) return false;
+
+	int degree = 3;
+	bool hasMeshes = false;
+
+	// Nodes
+	quint32 numNodes = r.getCount(3 * sizeof(quint32));
+	for(quint32 i = 0; i < numNodes && r.ok; i++)
+	{
+		QString id = r.getString();
+		QString node_type = r.getString();
+		QString mesh_filename = r.getString();
+
+		std::vector<int> control_count( r.getCount(sizeof(qint32)) );
+		for(auto & c : control_count) c = r.get<qint32>();
+
+		std::vector<Vector3d> ctrlPoints( r.getCount(3 * sizeof(double)) );
+		for(auto & p : ctrlPoints) r.getArray( p.data(), 3 * sizeof(double) );
+
+		std::vector<Scalar> ctrlWeights( r.getCount(sizeof(double)) );
+		r.getArray( ctrlWeights.data(), ctrlWeights.size() * sizeof(double) );
+
+		PropertyMap meta_values;
+		quint32 numMeta = r.getCount(2 * sizeof(quint32));
+		for(quint32 m = 0; m < numMeta && r.ok; m++){
+			QString key = r.getString();
+			meta_values[key] = r.getString();
+		}
+
+		QSharedPointer<SurfaceMeshModel> nodeMesh;
+		if( r.get<quint8>() )
+		{
+			nodeMesh = QSharedPointer<SurfaceMeshModel>( new SurfaceMeshModel(mesh_filename, id) );
+
+			quint32 nv = r.getCount(3 * sizeof(double));
+			for(quint32 v = 0; v < nv; v++){
+				Vector3d p;
+				r.getArray( p.data(), 3 * sizeof(double) );
+				nodeMesh->add_vertex( p );
+			}
+
+			std::vector<quint32> valence( r.getCount(sizeof(quint32)) );
+			r.getArray( valence.data(), valence.size() * sizeof(quint32) );
+			std::vector<quint32> indices( r.getCount(sizeof(quint32)) );
+			r.getArray( indices.data(), indices.size() * sizeof(quint32) );
+			if( !r.ok ) break;
+
+			size_t k = 0;
+			std::vector<SurfaceMesh::Vertex> face;
+			for(quint32 count : valence){
+				face.clear();
+				for(quint32 j = 0; j < count && k < indices.size(); j++, k++)
+					if( indices[k] < nv ) face.push_back( SurfaceMesh::Vertex(int(indices[k])) );
+				nodeMesh->add_face( face );
+			}
+
+			nodeMesh->update_face_normals();
+			nodeMesh->update_vertex_normals();
+			nodeMesh->updateBoundingBox();
+		}
+
+		// Add node, as in Graph::loadFromFile
+		Node * new_node = NULL;
+
+		if(node_type == CURVE)
+		{
+			new_node = g->addNode( new Curve( NURBS::NURBSCurved(ctrlPoints, ctrlWeights, degree, false, true), id) );
+		}
+		else if(node_type == SHEET)
+		{
+			if(control_count.size() < 2) continue;
+
+			int nu = control_count.front(), nv = control_count.back();
+			if( (int)ctrlPoints.size() < nu * nv || (int)ctrlWeights.size() < nu * nv ) continue;
+
+			std::vector< std::vector<Vector3d> > cp( nu, std::vector<Vector3d>(nv, Vector3(0,0,0)) );
+			std::vector< std::vector<Scalar> > cw( nu, std::vector<Scalar>(nv, 1.0) );
+
+			for(int u = 0; u < nu; u++){
+				for(int v = 0; v < nv; v++){
+					cp[u][v] = ctrlPoints[u * nv + v];
+					cw[u][v] = ctrlWeights[u * nv + v];
+				}
+			}
+
+			new_node = g->addNode( new Sheet( NURBS::NURBSRectangled(cp, cw, degree, degree, false, false, true, true), id ) );
+		}
+
+		if( !new_node ) continue;
+
+		new_node->meta = meta_values;
+		new_node->property["mesh_filename"].setValue( mesh_filename );
+
+		if( !nodeMesh.isNull() ){
+			new_node->property["mesh"].setValue( nodeMesh );
+			hasMeshes = true;
+		}
+	}
+
+	// Original shape bounding box
+	if( hasMeshes ){
+		Eigen::AlignedBox3d shapeBox;
+		foreach(Node * n, g->nodes){
+			QSharedPointer<SurfaceMeshModel> nodeMesh = n->property["mesh"].value< QSharedPointer<SurfaceMeshModel> >();
+			if( nodeMesh ) shapeBox = shapeBox.merged( nodeMesh->bbox() );
+		}
+		g->property["shapeBox"].setValue( shapeBox );
+		g->property["hasMeshes"].setValue( hasMeshes );
+	}
+
+	// Edges
+	quint32 numEdges = r.getCount(4 * sizeof(quint32));
+	for(quint32 i = 0; i < numEdges && r.ok; i++)
+	{
+		QString id = r.getString();
+		QString edge_type = r.getString();
+		QString n1_id = r.getString();
+		QString n2_id = r.getString();
+
+		Array2D_Vector4d coords(2);
+		for(int k = 0; k < 2; k++){
+			coords[k].resize( r.getCount(4 * sizeof(double)) );
+			for(auto & c : coords[k]) r.getArray( c.data(), 4 * sizeof(double) );
+		}
+
+		Node * n1 = g->getNode(n1_id), * n2 = g->getNode(n2_id);
+		if( !r.ok || !n1 || !n2 ) continue;
+
+		g->addEdge( n1, n2, coords.front(), coords.back(), id );
+	}
+
+	// Groups
+	quint32 numGroups = r.getCount(sizeof(quint32));
+	for(quint32 i = 0; i < numGroups && r.ok; i++)
+	{
+		QVector<QString> elements_ids( r.getCount(sizeof(quint32)) );
+		for(auto & nid : elements_ids) nid = r.getString();
+
+		QColor groupColor = starlab::qRandomColor2();
+
+		QVector<QString> element_nodes;
+		foreach(QString nid, elements_ids){
+			Node * n = g->getNode(nid);
+			if(n){
+				element_nodes.push_back( nid );
+				n->vis_property["color"].setValue( groupColor );
+			}
+		}
+		g->addGroup( element_nodes );
+	}
+
+	return r.ok;
+}
+
+bool GraphContainer::convert( QString xmlFilename, QString outFilename )
+{
+	if( outFilename.isEmpty() ){
+		QFileInfo info( xmlFilename );
+		outFilename = info.absolutePath() + "/" + info.completeBaseName() + "." + extension();
+	}
+
+	Graph g( xmlFilename );
+	if( g.nodes.isEmpty() ) return false;
+
+	return save( &g, outFilename );
+}
+
+bool GraphContainer::isSame( Graph * a, Graph * b )
+{
+	if( a->nodes.size() != b->nodes.size() || a->edges.size() != b->edges.size() ) return false;
+	if( a->groups != b->groups ) return false;
+
+	for(int i = 0; i < a->nodes.size(); i++)
+	{
+		Node * x = a->nodes[i], * y = b->nodes[i];
+
+		if( x->id != y->id || x->type() != y->type() ) return false;
+		if( x->controlCount() != y->controlCount() ) return false;
+		if( x->controlPoints() != y->controlPoints() || x->controlWeights() != y->controlWeights() ) return false;
+		if( x->meta.keys() != y->meta.keys() ) return false;
+		foreach(QString key, x->meta.keys())
+			if( x->meta[key].toString() != y->meta[key].toString() ) return false;
+
+		QSharedPointer<SurfaceMeshModel> mx = x->property.value("mesh").value< QSharedPointer<SurfaceMeshModel> >();
+		QSharedPointer<SurfaceMeshModel> my = y->property.value("mesh").value< QSharedPointer<SurfaceMeshModel> >();
+		if( mx.isNull() != my.isNull() ) return false;
+		if( mx.isNull() ) continue;
+
+		if( mx->n_vertices() != my->n_vertices() || mx->n_faces() != my->n_faces() ) return false;
+
+		SurfaceMesh::Vector3VertexProperty px = mx->vertex_property<Vector3d>("v:point");
+		SurfaceMesh::Vector3VertexProperty py = my->vertex_property<Vector3d>("v:point");
+		auto vx = mx->vertices_begin(), vy = my->vertices_begin();
+		for(; vx != mx->vertices_end(); ++vx, ++vy)
+			if( px[*vx] != py[*vy] ) return false;
+	}
+
+	for(int i = 0; i < a->edges.size(); i++)
+	{
+		Link * x = a->edges[i], * y = b->edges[i];
+
+		if( x->id != y->id || x->type != y->type ) return false;
+		if( x->n1->id != y->n1->id || x->n2->id != y->n2->id ) return false;
+		if( x->coord[0] != y->coord[0] || x->coord[1] != y->coord[1] ) return false;
+	}
+
+	return true;
+}
+
+GraphContainer::Benchmark GraphContainer::benchmark( QStringList xmlFilenames )
+{
+	Benchmark b = { 0, 0, 0, 0 };
+
+	foreach(QString xmlFilename, xmlFilenames)
+	{
+		QFileInfo info( xmlFilename );
+		QString binFilename = info.absolutePath() + "/" + info.completeBaseName() + "." + extension();
+		if( !QFileInfo(binFilename).exists() && !convert( xmlFilename, binFilename ) ) continue;
+
+		QElapsedTimer timer; timer.start();
+		Graph * fromXML = new Graph( xmlFilename );
+		b.xml += timer.nsecsElapsed() * 1e-9;
+
+		timer.restart();
+		Graph * fromBinary = new Graph( binFilename );
+		b.binary += timer.nsecsElapsed() * 1e-9;
+
+		if( !isSame( fromXML, fromBinary ) ) b.mismatches++;
+		b.files++;
+
+		delete fromXML;
+		delete fromBinary;
+	}
+
+	return b;
+}
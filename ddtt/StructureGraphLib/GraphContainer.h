@@ -0,0 +1,30 @@
+#pragma once
+
+#include "StructureGraph.h"
+
+// Binary alternative to the XML graph files. One file holds the nodes, their control
+// points and weights, meta data, edges with coordinates, groups and the part meshes,
+// so a graph is loaded from a single mapping of the file instead of a DOM plus one OBJ per part.
+// Numbers are stored in native byte order, meta values as strings (as in the XML).
+class GraphContainer
+{
+public:
+	static const quint32 VERSION = 1;
+	static QString extension() { return "sgb"; }
+
+	static bool isContainer( QString filename );
+
+	static bool save( Structure::Graph * g, QString filename );
+	static bool load( Structure::Graph * g, QString filename );
+
+	// Writes 'outFilename' (defaults to the XML name with the container extension)
+	static bool convert( QString xmlFilename, QString outFilename = "" );
+
+	// Same nodes, control points, meta data, edges, groups and meshes
+	static bool isSame( Structure::Graph * a, Structure::Graph * b );
+
+	// Seconds spent loading the given XML graphs and their containers (converted when missing),
+	// and the number of graphs that did not load identically
+	struct Benchmark{ int files; double xml, binary; int mismatches; };
+	static Benchmark benchmark( QStringList xmlFilenames );
+};
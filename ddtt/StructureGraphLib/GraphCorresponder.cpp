@@ -5,6 +5,7 @@
 #include <fstream>
 
 #include "GraphDistance.h"
+#include "HausdorffEngine.h"
 
 #define INVALID_VALUE -1
 
@@ -520,25 +521,29 @@ void GraphCorresponder::computeHausdorffDistanceMatrix( MATRIX & M )
 {
 	initializeMatrix<float>(M, INVALID_VALUE);
 
-	// The control points of each node in the target graph
-	Array2D_Vector3 targetControlPointsArray;
+	// The control points of each node, source nodes first
+	std::vector<HausdorffEngine::Points> controlPointsArray;
+	foreach (Structure::Node *sNode, this->sg->nodes)
+		controlPointsArray.push_back(sNode->controlPoints());
 	foreach (Structure::Node *tNode, this->tg->nodes)
-		targetControlPointsArray.push_back(tNode->controlPoints());
+		controlPointsArray.push_back(tNode->controlPoints());
+
+	HausdorffEngine engine(controlPointsArray);
 
 	// The Hausdorff distance
 	int sN = sg->nodes.size();
 	int tN = tg->nodes.size();
+
+	std::vector< std::pair<int,int> > validPairs;
 	for(int i = 0; i < sN; i++)
-	{
-		std::vector<Vector3> sPoints = sg->nodes[i]->controlPoints();
 		for (int j = 0; j < tN; j++)
-		{
-			if (validM[i][j])
-			{
-				std::vector<Vector3> &tPoints = targetControlPointsArray[j];
-				M[i][j] = HausdorffDistance(sPoints, tPoints);
-			}
-		}
+			if (validM[i][j]) validPairs.push_back( std::make_pair(i, j) );
+
+	#pragma omp parallel for
+	for(int k = 0; k < (int)validPairs.size(); k++)
+	{
+		int i = validPairs[k].first, j = validPairs[k].second;
+		M[i][j] = engine.distance(i, sN + j);
 	}
 
 	normalizeMatrix(M);
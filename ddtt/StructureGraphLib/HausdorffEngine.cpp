@@ -0,0 +1,76 @@
+#include "HausdorffEngine.h"
+#include <algorithm>
+#include <cfloat>
+
+HausdorffEngine::HausdorffEngine( const std::vector<Points> & pointSets )
+{
+	sets.resize( pointSets.size() );
+
+	#pragma omp parallel for
+	for(int i = 0; i < (int)pointSets.size(); i++)
+	{
+		PointSet & s = sets[i];
+		s.points = pointSets[i];
+		if( s.points.empty() ) continue;
+
+		s.tree = QSharedPointer<NanoKdTree>( new NanoKdTree );
+		for(auto & p : s.points){
+			s.box.extend( p );
+			s.tree->addPoint( p );
+		}
+		s.tree->build();
+	}
+}
+
+double HausdorffEngine::minMaxDistance( const Eigen::Vector3d & p, const Eigen::AlignedBox3d & box )
+{
+	// Every face of a tight box touches a point, so the farthest corner of the nearest
+	// face bounds the distance to the set (the MINMAXDIST of R-tree search)
+	Eigen::Vector3d mid = box.center(), nearFace, farFace;
+	for(int k = 0; k < 3; k++){
+		nearFace[k] = (p[k] <= mid[k]) ? box.min()[k] : box.max()[k];
+		farFace[k] = (p[k] >= mid[k]) ? box.min()[k] : box.max()[k];
+	}
+
+	Eigen::Vector3d toFar = (p - farFace).cwiseAbs2();
+	double sumFar = toFar.sum(), best = DBL_MAX;
+
+	for(int k = 0; k < 3; k++)
+		best = std::min( best, sumFar - toFar[k] + std::pow(p[k] - nearFace[k], 2) );
+
+	return std::sqrt( best );
+}
+
+double HausdorffEngine::directed( int a, int b ) const
+{
+	const PointSet & A = sets[a], & B = sets[b];
+	if( A.points.empty() ) return -1;
+	if( B.points.empty() ) return DBL_MAX;
+
+	// Points of A by decreasing upper bound on their distance to B
+	std::vector< std::pair<double,int> > order( A.points.size() );
+	for(int i = 0; i < (int)A.points.size(); i++)
+		order[i] = std::make_pair( minMaxDistance(A.points[i], B.box), i );
+	std::sort( order.rbegin(), order.rend() );
+
+	double supinfDis = -1;
+
+	for(auto & o : order)
+	{
+		// No remaining point can be farther than the current maximum
+		if( o.first <= supinfDis ) break;
+
+		size_t idx;
+		double d2;
+		B.tree->tree->knnSearch( A.points[o.second].data(), 1, &idx, &d2 );
+
+		supinfDis = std::max( supinfDis, std::sqrt(d2) );
+	}
+
+	return supinfDis;
+}
+
+double HausdorffEngine::distance( int a, int b ) const
+{
+	return std::max( directed(a, b), directed(b, a) );
+}
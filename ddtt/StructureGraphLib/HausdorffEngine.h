@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <QSharedPointer>
+#include <Eigen/Geometry>
+
+#include "NanoKdTree.h"
+
+// Hausdorff distances between a fixed collection of point sets. Every set gets its kd-tree
+// and bounding box once, directed distances then query the tree and stop as soon as the
+// remaining points are known to lie closer than the running maximum.
+class HausdorffEngine
+{
+public:
+	typedef std::vector<Eigen::Vector3d> Points;
+
+	HausdorffEngine( const std::vector<Points> & pointSets );
+
+	int size() const { return (int)sets.size(); }
+
+	// Largest distance from a point of set 'a' to set 'b', same values as 'supInfDistance'
+	double directed( int a, int b ) const;
+
+	// Symmetric distance, same values as 'HausdorffDistance'
+	double distance( int a, int b ) const;
+
+	// Upper bound on the distance from 'p' to a point set with tight bounding box 'box'
+	static double minMaxDistance( const Eigen::Vector3d & p, const Eigen::AlignedBox3d & box );
+
+private:
+	struct PointSet{
+		Points points;
+		Eigen::AlignedBox3d box;
+		QSharedPointer<NanoKdTree> tree;
+	};
+	std::vector<PointSet> sets;
+};
@@ -35,7 +35,6 @@ Q_DECLARE_METATYPE( QSet<int> ) // for tags
 
 Scheduler::~Scheduler()
 {
-	qDeleteAll(allGraphs);
 	allGraphs.clear();
 
 	qDeleteAll(tasks);
@@ -470,7 +469,6 @@ void Scheduler::reset()
 	QMap< QString,QPair<int,int> > curSchedule = getSchedule();
 
 	// Clean previous outputs
-	qDeleteAll(allGraphs);
 	allGraphs.clear();
 
 	// Clean old tasks
@@ -567,7 +565,7 @@ void Scheduler::executeAll()
 					// Keep track of original edge info
 					QString oldNode = edge->otherNode(sid)->id;
 					edge->pushState();
-					edge->replace(oldNode, linkKeep->otherNode(sid), linkKeep->getCoordOther(sid));
+					activeGraph->relinkEdge(edge, oldNode, linkKeep->otherNode(sid), linkKeep->getCoordOther(sid));
 				}
 
 				snode->property["edgesModified"] = true;
@@ -633,7 +631,7 @@ void Scheduler::executeAll()
 
 		// Output current active graph:
 		activeGraph->property["graphIndex"] = allGraphs.size();
-		allGraphs.push_back(  new Structure::Graph( *activeGraph )  );
+		allGraphs.append( activeGraph );
 
 		// DEBUG:
 		activeGraph->clearDebug();
@@ -652,6 +650,7 @@ void Scheduler::executeAll()
 	finalize();
 
 	property["progressDone"] = true;
+	property["allGraphsBytes"] = (qulonglong)allGraphs.memoryBytes();
 
 	if( isApplyChangesUI ) 
 	{
@@ -684,8 +683,9 @@ void Scheduler::finalize()
 
 		// Reassign 't' values for generated graphs
 		double stretch = (totalExecutionTime() - overTime) / totalExecutionTime();
-		for(int i = 0; i < (int)allGraphs.size(); i++)
-			allGraphs[i]->property["t"] = qMin(1.0, stretch * (allGraphs[i]->property["t"].toDouble()));
+		allGraphs.apply([&](Structure::Graph * g){
+			g->property["t"] = qMin(1.0, stretch * (g->property["t"].toDouble()));
+		});
 
 		QMap<Node*, Array1D_Vector3> curGeometry;
 		foreach(Node * n, activeGraph->nodes)
@@ -710,7 +710,7 @@ void Scheduler::finalize()
 				n->setControlPoints( newGeometry );
 			}
 
-			allGraphs.push_back(  new Structure::Graph( *activeGraph )  );
+			allGraphs.append( activeGraph );
 		}
 
 		overTime = Task::DEFAULT_LENGTH;
@@ -767,9 +767,11 @@ void Scheduler::timeChanged( int newTime )
 	int idx = allGraphs.size() * (double(newTime) / totalExecutionTime());
 
 	idx = qRanged(0, idx, allGraphs.size() - 1);
-	allGraphs[idx]->property["graphIndex"] = idx;
+	// Pinned while shown, the animation may drop it from its cache
+	shownGraph = allGraphs[idx];
+	shownGraph->property["graphIndex"] = idx;
 
-	emit( activeGraphChanged(allGraphs[idx]) );
+	emit( activeGraphChanged(shownGraph.data()) );
 }
 
 void Scheduler::doBlend()
@@ -1271,9 +1273,9 @@ QVector<ScheduleType> Scheduler::allSchedules()
 	return schedules;
 }
 
-QVector<Structure::Graph*> Scheduler::interestingInBetweens(int N)
+QVector< QSharedPointer<Structure::Graph> > Scheduler::interestingInBetweens(int N)
 {
-	QVector<Structure::Graph*> result;
+	QVector< QSharedPointer<Structure::Graph> > result;
 	if(!allGraphs.size()) return result;
 
 	QSet<int> tags = property["timeTags"].value< QSet<int> >();
@@ -1327,13 +1329,13 @@ QVector<Structure::Graph*> Scheduler::interestingInBetweens(int N)
 	return result;
 }
 
-QVector<Structure::Graph*> Scheduler::topoVaryingInBetweens(int N, bool isVisualize)
+QVector< QSharedPointer<Structure::Graph> > Scheduler::topoVaryingInBetweens(int N, bool isVisualize)
 {
-	QVector<Structure::Graph*> samples;
+	QVector< QSharedPointer<Structure::Graph> > samples;
 	if(allGraphs.size() < 2) return samples;
 
-	QSharedPointer<Structure::Graph> firstInstance = QSharedPointer<Structure::Graph>( Structure::Graph::actualGraph( allGraphs.front() ) );
-	QSharedPointer<Structure::Graph> lastInstance = QSharedPointer<Structure::Graph>( Structure::Graph::actualGraph( allGraphs.back() ) );
+	QSharedPointer<Structure::Graph> firstInstance = QSharedPointer<Structure::Graph>( Structure::Graph::actualGraph( allGraphs.front().data() ) );
+	QSharedPointer<Structure::Graph> lastInstance = QSharedPointer<Structure::Graph>( Structure::Graph::actualGraph( allGraphs.back().data() ) );
 
 	if(!firstInstance->nodes.size() || !lastInstance->nodes.size()) return interestingInBetweens(N);
 
@@ -1353,7 +1355,7 @@ QVector<Structure::Graph*> Scheduler::topoVaryingInBetweens(int N, bool isVisual
 
 	for(int i = 0; i < allGraphs.size(); i++)
 	{
-		Structure::Graph * g = Structure::Graph::actualGraph(allGraphs[i]);
+		Structure::Graph * g = Structure::Graph::actualGraph(allGraphs[i].data());
 
 		// Topological dissimilarity
 		gd.addGraph( g );
@@ -1481,7 +1483,7 @@ QVector<Structure::Graph*> Scheduler::topoVaryingInBetweens(int N, bool isVisual
 	{
 		QVector<int> chosenOnes;
 
-		foreach(Structure::Graph * g, samples){
+		foreach(QSharedPointer<Structure::Graph> g, samples){
 			chosenOnes.push_back( g->property["graphIndex"].toInt() );
 		}
 
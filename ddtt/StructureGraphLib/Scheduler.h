@@ -1,6 +1,7 @@
 #pragma once
 
 #include "StructureGraph.h"
+#include "GraphAnimation.h"
 #include <QGraphicsScene>
 #include <QDockWidget>
 #include "TimelineSlider.h"
@@ -38,7 +39,8 @@ public:
 	double overTime;
 
 	// Output
-	QVector<Structure::Graph*> allGraphs;
+	GraphAnimation allGraphs;
+	QSharedPointer<Structure::Graph> shownGraph; // last frame sent by 'activeGraphChanged'
 
 	// Input
 	void setInputGraphs(Structure::Graph * source, Structure::Graph * target);
@@ -123,8 +125,8 @@ public slots:
 	void shuffleSchedule();
 	QVector<ScheduleType> manyRandomSchedules(int N);
 	QVector<ScheduleType> allSchedules();
-	QVector<Structure::Graph*> interestingInBetweens(int N);
-	QVector<Structure::Graph*> topoVaryingInBetweens(int N, bool isVisualize = false);
+	QVector< QSharedPointer<Structure::Graph> > interestingInBetweens(int N);
+	QVector< QSharedPointer<Structure::Graph> > topoVaryingInBetweens(int N, bool isVisualize = false);
 
 	void emitUpdateExternalViewer();
 	void emitProgressStarted();
@@ -85,6 +85,16 @@ SurfaceMesh::Vector3 Curve::position( const Vector4d& coordinates )
     return curve.GetPosition(coordinates[0]);
 }
 
+Array1D_Vector3 Curve::positions( const Array1D_Vector4d& coordinates )
+{
+	Array1D_Real t;
+	for(auto & c : coordinates) t.push_back( c[0] );
+
+	Array1D_Vector3 pnts;
+	curve.GetBatch( t, &pnts );
+	return pnts;
+}
+
 Vector4d Curve::approxCoordinates( const Vector3 & pos )
 {
 	Scalar t = curve.timeAt( pos );
@@ -49,6 +49,7 @@ struct Curve : public Node
 	// Coordinates
     void get( const Vector4d& coordinates, Vector3 & pos, std::vector<Vector3> & frame );
 	Vector3 position( const Vector4d& coordinates );
+	Array1D_Vector3 positions( const Array1D_Vector4d& coordinates );
 	Vector4d approxCoordinates( const Vector3 & pos );
 	Vector3 approxProjection( const Vector3 & point );
 	Vector3 center();
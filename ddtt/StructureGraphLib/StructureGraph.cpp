@@ -9,6 +9,7 @@
 #include <QMatrix4x4>
 
 #include "StructureGraph.h"
+#include "GraphContainer.h"
 using namespace Structure;
 
 #include "GraphDistance.h"
@@ -81,6 +82,9 @@ Graph::Graph( const Graph & other )
 		newEdge->property = e->property;
 	}
 
+	// Copied links keep the original uids
+	rebuildIndex();
+
 	groups = other.groups;
 	property = other.property;
 	misc = other.misc;
@@ -167,6 +171,7 @@ Node *Graph::addNode(Node * n)
     assert(getNode( n->id ) == NULL);
 
     nodes.push_back(n);
+	if( !nodeIndex.contains(n->id) ) nodeIndex.insert(n->id, n);
 
 	// Add property : id
 	n->property["index"] = nodes.size() - 1;
@@ -243,25 +248,20 @@ Link * Graph::addEdge(Node *n1, Node *n2, Array1D_Vector4d coord1, Array1D_Vecto
 	edges.push_back( e );
 
 	e->property["uid"] = ueid++;
+	indexEdge( e );
 
 	return e;
 }
 
 void Graph::removeEdge( int uid )
 {
-	int edge_idx = -1;
-
-	for(int i = 0; i < (int)edges.size(); i++){
-		Link * e = edges[i];
-		if(e->property["uid"].toInt() == uid){
-			edge_idx = i;
-			break;
-		}
-	}
+	Link * e = getEdge( uid );
+	if( !e ) return;
 
-	if(edge_idx < 0) return;
+	int edge_idx = edges.indexOf(e);
+	unindexEdge( e );
 
-	Node *n1 = edges[edge_idx]->n1, *n2 = edges[edge_idx]->n2;
+	Node *n1 = e->n1, *n2 = e->n2;
 
 	delete edges[edge_idx];
 	edges[edge_idx] = NULL;
@@ -272,21 +272,10 @@ void Graph::removeEdge( int uid )
 
 void Graph::removeEdge( Node * n1, Node * n2 )
 {
-	int edge_idx = -1;
+	Link * e = getEdge( n1->id, n2->id );
+	if( !e ) return;
 
-	for(int i = 0; i < (int)edges.size(); i++)
-	{
-		Link * e = edges[i];
-
-		if((e->n1->id == n1->id && e->n2->id == n2->id) || (e->n2->id == n1->id && e->n1->id == n2->id)){
-			edge_idx = i;
-			break;
-		}
-	}
-	
-	if(edge_idx < 0) return;
-
-	removeEdge( edges[edge_idx]->property["uid"].toInt() );
+	removeEdge( e->property.value("uid").toInt() );
 }
 
 void Graph::removeEdge( QString n1_id, QString n2_id )
@@ -318,28 +307,62 @@ QString Graph::linkName( QString n1_id, QString n2_id )
 	return linkName(getNode(n1_id),getNode(n2_id));
 }
 
-Node *Graph::getNode(QString nodeID)
+void Graph::rebuildIndex()
+{
+	nodeIndex.clear();
+	edgeAdjacency.clear();
+	edgeUidIndex.clear();
+
+	// First match wins, as with the plain scans
+	foreach(Node * n, nodes)
+		if( !nodeIndex.contains(n->id) ) nodeIndex.insert(n->id, n);
+
+	foreach(Link * e, edges) indexEdge( e );
+}
+
+void Graph::indexEdge( Link * e )
+{
+	edgeAdjacency[e->n1->id].push_back( e );
+	if( e->n2->id != e->n1->id ) edgeAdjacency[e->n2->id].push_back( e );
+
+	int uid = e->property.value("uid").toInt();
+	if( !edgeUidIndex.contains(uid) ) edgeUidIndex.insert(uid, e);
+}
+
+void Graph::unindexEdge( Link * e )
 {
-    foreach(Node* n, nodes)
+	QString ids[] = { e->n1->id, e->n2->id };
+	for(int i = 0; i < 2; i++)
 	{
-        if(n->id == nodeID) 
-			return n;
+		auto it = edgeAdjacency.find( ids[i] );
+		if( it == edgeAdjacency.end() ) continue;
+		int k = it->indexOf( e );
+		if( k >= 0 ) it->remove( k );
+		if( it->isEmpty() ) edgeAdjacency.erase( it );
 	}
 
-    return NULL;
+	int uid = e->property.value("uid").toInt();
+	if( edgeUidIndex.value(uid) == e ) edgeUidIndex.remove(uid);
 }
 
-Link *Graph::getEdge(QString id1, QString id2)
+// Lookups only read the index, so they are safe from several threads at once
+Node *Graph::getNode(QString nodeID)
 {
-	for(int i = 0; i < (int)edges.size(); i++)
-	{
-		Link * e = edges[i];
+	Node * n = nodeIndex.value(nodeID, NULL);
+	if( n && n->id == nodeID ) return n;
 
-		QString nid1 = e->n1->id;
-		QString nid2 = e->n2->id;
+	// Misses fall back to a scan in case ids were changed behind our back
+	foreach(Node * m, nodes)
+		if(m->id == nodeID) return m;
 
-		if( (nid1 == id1 && nid2 == id2) || (nid1 == id2 && nid2 == id1))
-			return e;
+	return NULL;
+}
+
+Link *Graph::getEdge(QString id1, QString id2)
+{
+	foreach(Link * e, getEdges(id1))
+	{
+		if( e->otherNode(id1)->id == id2 ) return e;
 	}
 	
 	return NULL;
@@ -347,12 +370,11 @@ Link *Graph::getEdge(QString id1, QString id2)
 
 Link* Graph::getEdge( int edgeUID )
 {
-	for(int i = 0; i < (int)edges.size(); i++)
-	{
-		Link * e = edges[i];
+	Link * e = edgeUidIndex.value(edgeUID, NULL);
+	if( e && e->property.value("uid").toInt() == edgeUID ) return e;
 
-		if( e->property["uid"].toInt() == edgeUID) return e;
-	}
+	for(int i = 0; i < (int)edges.size(); i++)
+		if( edges[i]->property.value("uid").toInt() == edgeUID ) return edges[i];
 
 	return NULL;
 }
@@ -374,6 +396,56 @@ QVector<int> Structure::Graph::getEdgeIDs( QVector<Link*> forEdges )
 	return result;
 }
 
+Graph::LookupBenchmark Graph::benchmarkLookups( Graph * g, int rounds )
+{
+	LookupBenchmark b = { 0, 0, 0 };
+
+	QVector<QString> ids;
+	foreach(Node * n, g->nodes) ids.push_back(n->id);
+	QVector<int> uids = g->getEdgeIDs(g->edges);
+
+	// Plain scans, as the lookups were done without the index
+	auto scanNode = [&]( const QString & id ) -> Node * {
+		foreach(Node * n, g->nodes) if(n->id == id) return n;
+		return NULL;
+	};
+	auto scanEdges = [&]( const QString & id ){
+		QVector<Link*> result;
+		foreach(Link * l, g->edges) if(l->hasNode(id)) result.push_back(l);
+		return result;
+	};
+	auto scanUid = [&]( int uid ) -> Link * {
+		foreach(Link * l, g->edges) if(l->property.value("uid").toInt() == uid) return l;
+		return NULL;
+	};
+
+	for(int i = 0; i < ids.size(); i++)
+		if( g->getNode(ids[i]) != scanNode(ids[i]) || g->getEdges(ids[i]) != scanEdges(ids[i]) ) b.mismatches++;
+	foreach(int uid, uids)
+		if( g->getEdge(uid) != scanUid(uid) ) b.mismatches++;
+
+	size_t found = 0;
+	QElapsedTimer timer; timer.start();
+	for(int r = 0; r < rounds; r++)
+	{
+		foreach(QString id, ids) found += (g->getNode(id) != NULL) + g->getEdges(id).size();
+		foreach(int uid, uids) found += (g->getEdge(uid) != NULL);
+	}
+	b.indexed = timer.nsecsElapsed() * 1e-6;
+
+	timer.restart();
+	for(int r = 0; r < rounds; r++)
+	{
+		foreach(QString id, ids) found -= (scanNode(id) != NULL) + scanEdges(id).size();
+		foreach(int uid, uids) found -= (scanUid(uid) != NULL);
+	}
+	b.linear = timer.nsecsElapsed() * 1e-6;
+
+	if( found ) b.mismatches++;
+
+	return b;
+}
+
 Eigen::AlignedBox3d Graph::cached_bbox()
 {
 	if(!property.contains("bbox"))
@@ -1006,6 +1078,12 @@ void Graph::loadFromFile( QString fileName )
 	// Clear data
 	nodes.clear();
 	edges.clear();
+	rebuildIndex();
+
+	if( GraphContainer::isContainer(fileName) ){
+		GraphContainer::load(this, fileName);
+		return;
+	}
 
 	QFile file(fileName);
 	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return;
@@ -1430,10 +1508,14 @@ QVector<Link*> Graph::getEdges( QString nodeID )
 {
 	QVector<Link*> mylinks;
 
-	for(int i = 0; i < edges.size(); i++)
-	{
-		Link * l = edges[i];
+	foreach(Link * l, edgeAdjacency.value(nodeID))
 		if( l->hasNode(nodeID) ) mylinks.push_back(l);
+
+	// Misses fall back to a scan in case end points were changed behind our back
+	if( mylinks.isEmpty() )
+	{
+		foreach(Link * l, edges)
+			if( l->hasNode(nodeID) ) mylinks.push_back(l);
 	}
 
 	return mylinks;
@@ -1464,12 +1546,7 @@ QMap<Link*, Array1D_Vector4d > Graph::linksCoords( QString nodeID )
 
 QVector<Link*> Graph::nodeEdges( QString nodeID )
 {
-	QVector<Link*> nodeLinks;
-	
-	foreach(Link * e, edges) if(e->hasNode(nodeID)) 
-		nodeLinks.push_back(e);
-
-	return nodeLinks;
+	return getEdges( nodeID );
 }
 
 void Graph::removeNode( QString nodeID )
@@ -1478,6 +1555,7 @@ void Graph::removeNode( QString nodeID )
 
 	foreach(Link * e, getEdges(nodeID)){
 		int edge_idx = edges.indexOf(e);
+		unindexEdge( e );
 
 		delete edges[edge_idx];
 		edges[edge_idx] = NULL;
@@ -1488,6 +1566,8 @@ void Graph::removeNode( QString nodeID )
 
 	if( node_idx < 0) return;
 
+	if( nodeIndex.value(nodeID) == n ) nodeIndex.remove(nodeID);
+
 	delete nodes[node_idx];
 	nodes[node_idx] = NULL;
 	nodes.remove(node_idx);
@@ -1963,7 +2043,7 @@ void Graph::clearSelections()
 
 QString Graph::name()
 {
-    return property["name"].toString().section('\\', -1).section('/', -1).section('.', 0, 0);
+    return property.value("name").toString().section('\\', -1).section('/', -1).section('.', 0, 0);
 }
 
 void Graph::setColorAll( QColor newNodesColor )
@@ -1988,13 +2068,24 @@ void Graph::renameNode( QString oldNodeID, QString newNodeID )
 	Structure::Node * n = getNode(oldNodeID);
 	if(!n) return;
 
+	QVector<Link*> links = getEdges(oldNodeID);
+
 	n->id = n->id.replace(oldNodeID, newNodeID);
 
-	foreach(Link * l, getEdges(oldNodeID))
+	foreach(Link * l, links)
 	{
 		if(l->id.contains(oldNodeID))
 			l->id = l->id.replace(oldNodeID, newNodeID);
 	}
+
+	rebuildIndex();
+}
+
+void Graph::relinkEdge( Link * l, QString oldNodeID, Node * newNode, Array1D_Vector4d newCoord )
+{
+	unindexEdge( l );
+	l->replace( oldNodeID, newNode, newCoord );
+	indexEdge( l );
 }
 
 void Graph::clearAll()
@@ -2373,7 +2464,7 @@ Structure::Graph * Graph::actualGraph(Structure::Graph * fromGraph)
 
 						Array1D_Vector4d coord(1, c);
 
-						e->replace(n->id, replacment, coord);
+						actual->relinkEdge(e, n->id, replacment, coord);
 					}
 				}
 
@@ -74,6 +74,7 @@ namespace Structure{
 		bool shareEdge( Node * n1, Node * n2 );
 		bool shareEdge( QString nid1, QString nid2 );
 		void renameNode( QString oldNodeID, QString newNodeID );
+		void relinkEdge( Link * l, QString oldNodeID, Node * newNode, Array1D_Vector4d newCoord );
 
 		// Accessors
         Node* getNode(QString nodeID);
@@ -95,6 +96,15 @@ namespace Structure{
         Eigen::AlignedBox3d robustBBox();
         Eigen::AlignedBox3d robustBBox(QString nodeID, double eps = 1e-6);
 
+		// Lookup index (node by id, links per node id, link by uid), kept in sync by the
+		// modifiers above. Code that edits 'nodes', 'edges', node ids or link end points
+		// directly has to call rebuildIndex() afterwards. Lookups never write to it.
+		void rebuildIndex();
+
+		// Milliseconds for 'rounds' passes of node, adjacency and uid lookups over every node and link
+		struct LookupBenchmark{ double indexed, linear; int mismatches; };
+		static LookupBenchmark benchmarkLookups( Graph * g, int rounds = 100 );
+
 		// Input / Output
 		void saveToFile(QString fileName, bool isOutParts = true) const;
 		void loadFromFile(QString fileName);
@@ -163,6 +173,14 @@ namespace Structure{
 		void clearDebug();
 		void clearAll();
         void clearSelections();
+
+	private:
+		QHash<QString, Node*> nodeIndex;
+		QHash<QString, QVector<Link*> > edgeAdjacency;
+		QHash<int, Link*> edgeUidIndex;
+
+		void indexEdge( Link * e );
+		void unindexEdge( Link * e );
     };
 }
 
@@ -64,7 +64,10 @@ HEADERS += StructureNode.h \
     Relink.h \
     GraphModifyWidget.h \
     GraphDissimilarity.h \
-    GraphExplorer.h
+    GraphExplorer.h \
+    GraphAnimation.h \
+    GraphContainer.h \
+    HausdorffEngine.h
 
 SOURCES += StructureGraph.cpp \
     StructureCurve.cpp \
@@ -88,7 +91,10 @@ SOURCES += StructureGraph.cpp \
     Relink.cpp \
     GraphModifyWidget.cpp \
     GraphDissimilarity.cpp \
-    GraphExplorer.cpp
+    GraphExplorer.cpp \
+    GraphAnimation.cpp \
+    GraphContainer.cpp \
+    HausdorffEngine.cpp
 
 # Graph visualization
 SOURCES += QGraphViz/svgview.cpp
@@ -41,6 +41,11 @@ struct Node
 	// Coordinates
     virtual void get( const Vector4d& coordinates, Vector3 & pos, std::vector<Vector3> & frame ) = 0;
 	virtual Vector3 position( const Vector4d& coordinates ) = 0;
+	virtual Array1D_Vector3 positions( const Array1D_Vector4d& coordinates ){
+		Array1D_Vector3 pnts;
+		for(auto & c : coordinates) pnts.push_back( position(c) );
+		return pnts;
+	}
 	virtual Vector4d approxCoordinates( const Vector3 & pos ) = 0;
 	virtual Vector3 approxProjection( const Vector3 & point ) = 0;
 	virtual Vector3 center() = 0;
@@ -55,9 +60,14 @@ struct Node
 	virtual Array2D_Vector4d discretizedPoints(Scalar resolution) = 0;
 	Array2D_Vector3 getPoints( const Array2D_Vector4d & coords ){
 		Array2D_Vector3 pnts(coords.size(), std::vector<Vector3>(coords.front().size(), Vector3(0,0,0)));
+		Array1D_Vector4d flat;
 		for(int i = 0; i < (int)coords.size(); i++)
 			for(int j = 0; j < (int)coords.front().size(); j++)
-				pnts[i][j] = position( coords[i][j] );
+				flat.push_back( coords[i][j] );
+		Array1D_Vector3 flatPnts = positions( flat );
+		for(int i = 0, k = 0; i < (int)coords.size(); i++)
+			for(int j = 0; j < (int)coords.front().size(); j++)
+				pnts[i][j] = flatPnts[k++];
 		return pnts;
 	}
 
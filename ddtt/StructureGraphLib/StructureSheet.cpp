@@ -121,6 +121,16 @@ SurfaceMesh::Vector3 Sheet::position( const Vector4d& coordinates )
     return surface.P(coordinates[0],coordinates[1]);
 }
 
+Array1D_Vector3 Sheet::positions( const Array1D_Vector4d& coordinates )
+{
+	Array1D_Real u, v;
+	for(auto & c : coordinates){ u.push_back( c[0] ); v.push_back( c[1] ); }
+
+	Array1D_Vector3 pnts;
+	surface.GetBatch( u, v, &pnts );
+	return pnts;
+}
+
 Vector4d Sheet::approxCoordinates( const Vector3 & pos )
 {
 	return surface.timeAt( pos );
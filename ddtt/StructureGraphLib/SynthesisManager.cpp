@@ -1,6 +1,8 @@
 #include <QApplication>
 #include <QFileDialog>
+#include <QThread>
 #include <QtConcurrent/QtConcurrent>
+#include <omp.h>
 
 #include "GlSplatRenderer.h"
 GlSplatRenderer * splat_renderer = NULL;
@@ -30,13 +32,11 @@ QGLFunctions * newGLFunction() { return new QGLFunctions(QGLContext::currentCont
 // The following depends on the power of the GPU
 #define POINTS_LIMIT 600000
 
-QStack<double> nurbsQuality;
-
 Q_DECLARE_METATYPE( QVector<bool> )
 	
 SynthesisManager::SynthesisManager( GraphCorresponder * gcorr, Scheduler * scheduler, TopoBlender * blender, int samplesCount ) :
 	gcorr(gcorr), scheduler(scheduler), blender(blender), samplesCount(samplesCount), isSplatRenderer(false), 
-		splatSize(0.02), pointSize(3), color(QColor::fromRgbF(0.9, 0.9, 0.9))
+		splatSize(0.02), pointSize(3), color(QColor::fromRgbF(0.9, 0.9, 0.9)), reconCacheSize(256)
 {
 }
 
@@ -52,6 +52,10 @@ void SynthesisManager::clear()
 	currentData.clear();
 	currentGraph.clear();
 
+	QMutexLocker locker(&reconCacheMutex);
+	reconCache.clear();
+	reconCacheOrder.clear();
+
 	property["isEnabled"] = false;
 }
 
@@ -220,16 +224,10 @@ void SynthesisManager::doRenderAll()
 	int renderCount = scheduler->property["renderCount"].toInt();
 	int stepSize = qMax(1, N / renderCount);
 
-    for(int i = startID; i < scheduler->allGraphs.size(); i += stepSize)
-    {
-        Structure::Graph currentGraph = *(scheduler->allGraphs[i]);
+	QVector<int> frameIDs;
+	for(int i = startID; i < N; i += stepSize) frameIDs << i;
 
-        int progress = (double(i) / (N-1)) * 100;
-        qDebug() << QString("Rendering sequence [%1 %]").arg(progress);
-
-		QString numString = QString("%1").arg(i, 3, 10, QChar('0'));
-        renderGraph( currentGraph, QString("output_%1").arg(numString), false, reconLevel );
-    }
+	renderFrames( frameIDs, "output", reconLevel );
 
     qDebug() << QString("Sequence rendered [%1 ms]").arg(timer.elapsed());
 }
@@ -344,73 +342,9 @@ void SynthesisManager::renderGraph( Structure::Graph graph, QString filename, bo
 			continue;
 		}
 
-        std::vector<Eigen::Vector3f> clean_points;
-        foreach(Eigen::Vector3f p, points) clean_points.push_back(p);
-
-        std::vector< Eigen::Matrix<float,3,1,Eigen::DontAlign> > finalP, finalN;
+		QSharedPointer<SimpleMesh> reconstructed = reconstructNode( points, normals, reconLevel );
+		const SimpleMesh & mesh = *reconstructed;
 
-        /// Clean up duplicated points
-        if( false )
-        {
-            std::vector<size_t> xrefs;
-            weld(clean_points, xrefs, std::hash_Vector3f(), std::equal_to<Eigen::Vector3f>());
-
-            std::set<int> uniqueIds;
-            for(int i = 0; i < (int)points.size(); i++)	uniqueIds.insert(xrefs[i]);
-
-            foreach(int id, uniqueIds)
-            {
-                finalP.push_back( points[id] );
-                finalN.push_back( normals[id] );
-            }
-        }
-        else
-        {
-            foreach(Vector3f p, points) finalP.push_back(p);
-            foreach(Vector3f n, normals) finalN.push_back(n);
-        }
-
-        /// Better Estimate Normals
-        {
-            //int num_nighbours = 10;
-            //NormalExtrapolation::ExtrapolateNormals(clean_points, normals, num_nighbours);
-        }
-
-        /// Smooth normals
-        if( true )
-        {
-            NanoKdTree tree;
-            foreach(Vector3f p, finalP) tree.addPoint(p.cast<double>());
-            tree.build();
-
-            for(int i = 0; i < (int)finalP.size(); i++)
-            {
-                Vector3d newNormal(0,0,0);
-
-                int k = 12;
-
-                KDResults matches;
-                tree.k_closest(finalP[i].cast<double>(), k, matches);
-                foreach(KDResultPair match, matches) newNormal += finalN[match.first].cast<double>();
-                newNormal /= 12.0;
-
-                finalN[i] = newNormal.cast<float>();
-            }
-        }
-
-        /// Send for reconstruction:
-        if(isOutPointCloud)
-        {
-            //QString xyz_filename = node->id + "_" + filename + ".xyz";
-            //tempFiles << xyz_filename;
-            //Synthesizer::writeXYZ( xyz_filename, finalP, finalN );
-        }
-
-		SimpleMesh mesh;
-        auto cloudPoints = pointCloudf(finalP);
-        auto cloudNormals = pointCloudf(finalN);
-        PoissonRecon::makeFromCloud( cloudPoints, cloudNormals, mesh, reconLevel );
-		
 		reconMeshes[node->id] = new SurfaceMesh::Model;
 		SurfaceMesh::Model* nodeMesh = reconMeshes[node->id];
 
@@ -504,6 +438,7 @@ void SynthesisManager::renderGraph( Structure::Graph graph, QString filename, bo
 		// Clean-up names
 		foreach(Node * n, graph.nodes) n->id = n->id.replace("_","");
 		foreach(Link * e, graph.edges) e->id = e->id.replace("_","");
+		graph.rebuildIndex();
 		
         graph.saveToFile( filename + ".xml", isOutParts );
     }
@@ -520,6 +455,251 @@ void SynthesisManager::renderGraph( Structure::Graph graph, QString filename, bo
 	scheduler->emitProgressedDone();
 }
 
+QSharedPointer<SimpleMesh> SynthesisManager::reconstructNode( const QVector<Eigen::Vector3f> & points, const QVector<Eigen::Vector3f> & normals, int reconLevel, int threads )
+{
+	// FNV-1a over the synthesized samples
+	quint64 key = 14695981039346656037ULL;
+	auto hashBytes = [&]( const void * data, size_t count ){
+		const unsigned char * bytes = (const unsigned char *) data;
+		for(size_t i = 0; i < count; i++){ key ^= bytes[i]; key *= 1099511628211ULL; }
+	};
+	hashBytes( &reconLevel, sizeof(reconLevel) );
+	hashBytes( points.constData(), points.size() * sizeof(Eigen::Vector3f) );
+	hashBytes( normals.constData(), normals.size() * sizeof(Eigen::Vector3f) );
+
+	auto isSameInput = [&]( const ReconEntry & entry ){
+		return entry.reconLevel == reconLevel && entry.points == points && entry.normals == normals;
+	};
+
+	{
+		QMutexLocker locker(&reconCacheMutex);
+		auto it = reconCache.constFind(key);
+		if( it != reconCache.constEnd() && isSameInput(*it) ) return it->mesh;
+	}
+
+	std::vector< Eigen::Matrix<float,3,1,Eigen::DontAlign> > finalP, finalN;
+	foreach(Vector3f p, points) finalP.push_back(p);
+	foreach(Vector3f n, normals) finalN.push_back(n);
+
+	/// Smooth normals
+	{
+		NanoKdTree tree;
+		foreach(Vector3f p, finalP) tree.addPoint(p.cast<double>());
+		tree.build();
+
+		for(int i = 0; i < (int)finalP.size(); i++)
+		{
+			Vector3d newNormal(0,0,0);
+
+			int k = 12;
+
+			KDResults matches;
+			tree.k_closest(finalP[i].cast<double>(), k, matches);
+			foreach(KDResultPair match, matches) newNormal += finalN[match.first].cast<double>();
+			newNormal /= 12.0;
+
+			finalN[i] = newNormal.cast<float>();
+		}
+	}
+
+	/// Send for reconstruction, samples are read in place
+	PoissonOptions options;
+	options.depth = reconLevel;
+	options.threads = threads;
+
+	std::vector<float> vertices;
+	std::vector<int> triangles;
+	if( !finalP.empty() )
+		PoissonRecon::reconstruct( finalP[0].data(), 3, finalN[0].data(), 3, finalP.size(), options, vertices, triangles );
+
+	QSharedPointer<SimpleMesh> mesh( new SimpleMesh );
+	mesh->vertices.resize( vertices.size() / 3 );
+	for(size_t i = 0; i < mesh->vertices.size(); i++) mesh->vertices[i].assign( &vertices[3*i], &vertices[3*i] + 3 );
+	mesh->faces.resize( triangles.size() / 3 );
+	for(size_t i = 0; i < mesh->faces.size(); i++) mesh->faces[i].assign( &triangles[3*i], &triangles[3*i] + 3 );
+
+	QMutexLocker locker(&reconCacheMutex);
+	auto it = reconCache.find(key);
+	if( it == reconCache.end() )
+	{
+		ReconEntry entry = { reconLevel, points, normals, mesh };
+		reconCache.insert(key, entry);
+		reconCacheOrder.push_back(key);
+		while( reconCacheOrder.size() > reconCacheSize ) reconCache.remove( reconCacheOrder.takeFirst() );
+	}
+	else if( !isSameInput(*it) )
+	{
+		// Colliding input replaces the older one in its slot
+		it->reconLevel = reconLevel; it->points = points; it->normals = normals; it->mesh = mesh;
+	}
+
+	return mesh;
+}
+
+// Original part mesh moved to where the node currently is, used for parts without synthesized points
+static QSharedPointer<SimpleMesh> placedNodeMesh( Structure::Node * node, const SynthesisManager::NodeLookup & lookup )
+{
+	QSharedPointer<SimpleMesh> result( new SimpleMesh );
+
+	Structure::Node * n = node;
+
+	Vector3 c0 = n->controlPoints().front();
+	if( n->property.value("taskIsDone").toBool() ){
+		n = lookup.target.value( n->property.value("correspond").toString() );
+		if( !n ) return result;
+	}
+
+	QSharedPointer<SurfaceMeshModel> nodeMesh = n->property.value("mesh").value< QSharedPointer<SurfaceMeshModel> >();
+	if( nodeMesh.isNull() ) return result;
+
+	Vector3VertexProperty origMeshPoints = nodeMesh->get_vertex_property<Vector3>(VPOINT);
+
+	Vector3 deltaMesh = n->property.value("deltaMesh").value<Vector3>();
+	Vector3 v0 = origMeshPoints[Vertex(0)];
+	Vector3 translation = c0 - (v0 - deltaMesh);
+
+	foreach(Vertex v, nodeMesh->vertices()){
+		Vector3 p = origMeshPoints[v] + translation;
+		std::vector<float> vert(3);
+		vert[0] = p[0]; vert[1] = p[1]; vert[2] = p[2];
+		result->vertices.push_back( vert );
+	}
+
+	foreach(Face f, nodeMesh->faces()){
+		std::vector<int> verts;
+		Surface_mesh::Vertex_around_face_circulator vit = nodeMesh->vertices(f),vend=vit;
+		do{ verts.push_back( Vertex(vit).idx() ); } while(++vit != vend);
+		result->faces.push_back( verts );
+	}
+
+	return result;
+}
+
+void SynthesisManager::renderFrames( QVector<int> frameIDs, QString prefix, int reconLevel, int numWorkers )
+{
+	if( !scheduler || frameIDs.isEmpty() ) return;
+	if( numWorkers < 1 ) numWorkers = QThread::idealThreadCount();
+
+	QThreadPool pool;
+	pool.setMaxThreadCount( numWorkers );
+
+	// Workers evaluate NURBS with the accuracy of the calling thread
+	NURBS::EvaluationContext context = NURBS::EvaluationContext::current();
+
+	// Cores are split between workers, for both Poisson and the OpenMP loops of synthesis
+	int workerThreads = std::max(1, QThread::idealThreadCount() / numWorkers);
+
+	auto runAll = [&]( int count, std::function<void(int)> job ){
+		QVector< QFuture<void> > futures;
+		for(int i = 0; i < count; i++) futures << QtConcurrent::run(&pool, [=]{
+			NURBS::ScopedEvaluationContext scoped( context );
+			omp_set_num_threads( workerThreads );
+			job(i);
+		});
+		for(auto & f : futures) f.waitForFinished();
+	};
+
+	struct FrameJob{
+		int id;
+		QSharedPointer<Structure::Graph> graph;
+		SynthData data;
+		QVector<Structure::Node*> nodes;
+		QVector< QSharedPointer<SimpleMesh> > meshes;
+	};
+
+	// Workers only read the shared graphs through this
+	const NodeLookup lookup = nodeLookup();
+
+	scheduler->emitProgressStarted();
+
+	// Frames are processed in batches so only a few are held in memory
+	int batchSize = numWorkers;
+	for(int batchStart = 0; batchStart < frameIDs.size(); batchStart += batchSize)
+	{
+		int count = qMin(batchSize, frameIDs.size() - batchStart);
+		QVector<FrameJob> jobs( count );
+
+		// Build frames and synthesize their point sets
+		runAll(count, [&]( int i ){
+			FrameJob & job = jobs[i];
+			job.id = frameIDs[batchStart + i];
+			job.graph = QSharedPointer<Structure::Graph>( scheduler->allGraphs.build(job.id) );
+
+			geometryMorph( job.data, job.graph.data(), false, -1, &lookup );
+
+			foreach(Structure::Node * node, job.graph->nodes){
+				// Skip inactive nodes
+				if( node->property["zeroGeometry"].toBool() || node->property["shrunk"].toBool()) continue;
+				job.nodes.push_back(node);
+			}
+			job.meshes.resize( job.nodes.size() );
+		});
+
+		// Reconstruct all parts of all frames in the batch
+		QVector< QPair<int,int> > parts;
+		for(int i = 0; i < count; i++)
+			for(int ni = 0; ni < jobs[i].nodes.size(); ni++)
+				parts << qMakePair(i, ni);
+
+		runAll(parts.size(), [&]( int pi ){
+			FrameJob & job = jobs[parts[pi].first];
+			int ni = parts[pi].second;
+			Structure::Node * node = job.nodes[ni];
+
+			QMap<QString, QVariant> nodeData = job.data.value(node->id);
+			QVector<Eigen::Vector3f> points = nodeData.value("points").value< QVector<Eigen::Vector3f> >();
+			QVector<Eigen::Vector3f> normals = nodeData.value("normals").value< QVector<Eigen::Vector3f> >();
+
+			if( points.size() )
+				job.meshes[ni] = reconstructNode( points, normals, reconLevel, workerThreads );
+			else
+				job.meshes[ni] = placedNodeMesh( node, lookup );
+		});
+
+		// Write entire reconstructed meshes
+		runAll(count, [&]( int i ){
+			FrameJob & job = jobs[i];
+
+			QMap< QString, QSharedPointer<SimpleMesh> > meshes;
+			for(int ni = 0; ni < job.nodes.size(); ni++) meshes[job.nodes[ni]->id] = job.meshes[ni];
+
+			QString numString = QString("%1").arg(job.id, 3, 10, QChar('0'));
+			QFile file( QString("%1_%2.obj").arg(prefix).arg(numString) );
+
+			// Create folder
+			QFileInfo fileInfo(file.fileName());
+			QDir d(""); d.mkpath(fileInfo.absolutePath());
+
+			// Open for writing
+			if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return;
+
+			QTextStream out(&file);
+			int voffset = 0;
+
+			foreach(QString nid, meshes.keys()){
+				const SimpleMesh & mesh = *meshes[nid];
+				out << "# NV = " << mesh.vertices.size() << " NF = " << mesh.faces.size() << "\n";
+				for(auto & v : mesh.vertices) out << "v " << v[0] << " " << v[1] << " " << v[2] << "\n";
+				out << "g " << nid << "\n";
+				for(auto & f : mesh.faces){
+					out << "f ";
+					for(auto vi : f) out << (vi + 1 + voffset) << " ";
+					out << "\n";
+				}
+				voffset += (int)mesh.vertices.size();
+			}
+
+			file.close();
+		});
+
+		int progress = (double(batchStart + count) / frameIDs.size()) * 100;
+		scheduler->emitProgressChanged( progress );
+		qDebug() << QString("Rendering sequence [%1 %]").arg(progress);
+	}
+
+	scheduler->emitProgressedDone();
+}
+
 void SynthesisManager::reconstructXYZ()
 {
     QStringList fileNames = QFileDialog::getOpenFileNames(0, "Open XYZ File","", "XYZ Files (*.xyz)");
@@ -691,12 +871,37 @@ void SynthesisManager::drawSampled()
 	glFuncs->glBindBuffer(GL_ARRAY_BUFFER, 0); // avoid interference with other drawing
 }
 
-void SynthesisManager::geometryMorph( SynthData & data, Structure::Graph * graph, bool isApprox, int limit )
+SynthesisManager::NodeLookup SynthesisManager::nodeLookup()
+{
+	NodeLookup lookup;
+
+	// First match wins, as with 'getNode'
+	auto fill = [&]( QHash<QString, Structure::Node*> & table, Structure::Graph * g ){
+		if( !g ) return;
+		foreach(Node * n, g->nodes) if( !table.contains(n->id) ) table.insert(n->id, n);
+	};
+	fill( lookup.originalActive, scheduler->originalActiveGraph );
+	fill( lookup.originalTarget, scheduler->originalTargetGraph );
+	fill( lookup.target, scheduler->targetGraph );
+
+	return lookup;
+}
+
+void SynthesisManager::geometryMorph( SynthData & data, Structure::Graph * graph, bool isApprox, int limit, const NodeLookup * lookup )
 {
 	Structure::Graph * activeGraph = scheduler->activeGraph;
 	Structure::Graph * targetGraph = scheduler->targetGraph;
 	QVector<Node*> usedNodes;
 
+	NodeLookup ownLookup;
+	if( !lookup ){
+		ownLookup = nodeLookup();
+		lookup = &ownLookup;
+	}
+
+	// Read-only view, frames may be morphed concurrently
+	const QMap<QString, QMap<QString, QMap<QString,QVariant> > > & synthInput = synthData;
+
 	QString ag = activeGraph->name();
 	QString tg = targetGraph->name();
 
@@ -710,10 +915,10 @@ void SynthesisManager::geometryMorph( SynthData & data, Structure::Graph * graph
 
 		// Check against expected skeleton geometry
 		{
-			Node * origN = scheduler->originalActiveGraph->getNode(n->id);
+			Node * origN = lookup->originalActive.value(n->id);
 			QString tid = n->property["corresponded"].toString();
 
-			if( !tid.isEmpty() && n->property["taskIsDone"].toBool() ) origN = scheduler->originalTargetGraph->getNode( tid );
+			if( !tid.isEmpty() && n->property["taskIsDone"].toBool() ) origN = lookup->originalTarget.value( tid );
 
 			Array1D_Vector3 cp0 = origN->controlPoints();
 			Array1D_Vector3 cp1 = n->controlPoints();
@@ -732,7 +937,7 @@ void SynthesisManager::geometryMorph( SynthData & data, Structure::Graph * graph
 
 		if(isDeformed || isNotDone)
 		{
-			const QVector<float> & offsets = synthData[ag][n->id]["offsets"].value< QVector<float> >();
+			const QVector<float> & offsets = synthInput[ag][n->id]["offsets"].value< QVector<float> >();
 			if(offsets.isEmpty()) continue;
 
 			usedNodes.push_back(n);
@@ -741,11 +946,11 @@ void SynthesisManager::geometryMorph( SynthData & data, Structure::Graph * graph
 
 	// Count num samples per node and total
 	int numTotalSamples = 0;
+	QMap<QString, int> numSamples;
 	foreach(Node * n, usedNodes){
-		const QVector<float> & offsets = synthData[ag][n->id]["offsets"].value< QVector<float> >();
-		int numSamples = offsets.size();
-		synthData[ag][n->id]["numSamples"] = numSamples;
-		numTotalSamples += numSamples;
+		const QVector<float> & offsets = synthInput[ag][n->id]["offsets"].value< QVector<float> >();
+		numSamples[n->id] = offsets.size();
+		numTotalSamples += offsets.size();
 	}
 
 	foreach(Node * n, usedNodes)
@@ -760,7 +965,7 @@ void SynthesisManager::geometryMorph( SynthData & data, Structure::Graph * graph
 
 		if(limit > 0)
 		{
-			int numSamplesNode = synthData[ag][n->id]["numSamples"].toInt();
+			int numSamplesNode = numSamples[n->id];
 			double relative = double(numSamplesNode) / numTotalSamples;
 
 			// Subsample once
@@ -815,8 +1020,8 @@ void SynthesisManager::geometryMorph( SynthData & data, Structure::Graph * graph
 		}
 		else
 		{
-			ndata["node1"] = synthData[ag][n->id];
-			ndata["node2"] = synthData[tg][tgnid];
+			ndata["node1"] = synthInput[ag][n->id];
+			ndata["node2"] = synthInput[tg][tgnid];
 		}
 
 		if(n->type() == Structure::CURVE) Synthesizer::blendGeometryCurves((Structure::Curve *)n, t, ndata, points, normals, isApprox);
@@ -855,9 +1060,10 @@ void SynthesisManager::drawSynthesis( Structure::Graph * activeGraph )
 			glFuncs->glDeleteBuffers(1, &VertexVBOID);
 		}
 
-		beginFastNURBS();
-		geometryMorph( currentData, activeGraph, true, POINTS_LIMIT );
-		endFastNURBS();
+		{
+			NURBS::ScopedEvaluationContext fastNURBS( NURBS::EvaluationContext::fast() );
+			geometryMorph( currentData, activeGraph, true, POINTS_LIMIT );
+		}
 
 		vertices.clear();
 
@@ -2,7 +2,10 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QMutex>
 #include <QStack>
+#include <QSharedPointer>
 #include <vector>
 
 #include "StructureGraph.h"
@@ -13,6 +16,7 @@
 class GraphCorresponder;
 class Scheduler;
 class TopoBlender;
+struct SimpleMesh;
 typedef QMap<QString, QMap<QString, QVariant> > SynthData;
 
 // Proxies
@@ -23,26 +27,6 @@ struct SimplePolygon{
 	std::vector<Vector3> vertices; QColor c; bool isWireframe;
 };
 
-extern QStack<double> nurbsQuality;
-
-static void inline beginFastNURBS(){
-	nurbsQuality.clear();
-	nurbsQuality.push(TIME_ITERATIONS);
-	nurbsQuality.push(CURVE_TOLERANCE);
-	nurbsQuality.push(RombergIntegralOrder);
-
-	TIME_ITERATIONS			= 6;
-	CURVE_TOLERANCE			= 1e-05;
-	RombergIntegralOrder	= 5;
-}
-
-static void inline endFastNURBS(){
-	if(nurbsQuality.size() < 3) return;
-	RombergIntegralOrder = nurbsQuality.pop();
-	CURVE_TOLERANCE = nurbsQuality.pop();
-	TIME_ITERATIONS = nurbsQuality.pop();
-}
-
 class SynthesisManager : public QObject
 {
 	Q_OBJECT
@@ -84,6 +68,18 @@ public:
 
 	bool samplesAvailable(QString graph, QString nodeID);
 
+	// Reconstructed meshes keyed by a hash of the synthesized points, the full input is kept to tell collisions apart
+	QSharedPointer<SimpleMesh> reconstructNode( const QVector<Eigen::Vector3f> & points, const QVector<Eigen::Vector3f> & normals, int reconLevel, int threads = 0 );
+	struct ReconEntry{
+		int reconLevel;
+		QVector<Eigen::Vector3f> points, normals;
+		QSharedPointer<SimpleMesh> mesh;
+	};
+	QHash< quint64, ReconEntry > reconCache;
+	QList<quint64> reconCacheOrder;
+	QMutex reconCacheMutex;
+	int reconCacheSize;
+
 public slots:
     void generateSynthesisData();
 	void setSampleCount(int numSamples);
@@ -99,9 +95,14 @@ public slots:
 	void renderCurrent();
 	void renderCurrent( Structure::Graph * currentGraph, QString path = "" );
 	void renderGraph( Structure::Graph graph, QString filename, bool isOutPointCloud, int reconLevel, bool isOutGraph = false, bool isOutParts = true );
+	void renderFrames( QVector<int> frameIDs, QString prefix, int reconLevel, int numWorkers = -1 );
 
 	void drawSampled();
-	void geometryMorph( SynthData & data, Structure::Graph * graph, bool isApprox, int limit = -1 );
+	// Nodes of the scheduler's original and target graphs by id, resolved on the calling thread
+	// so frames can be morphed concurrently without looking up the shared graphs
+	struct NodeLookup{ QHash<QString, Structure::Node*> originalActive, originalTarget, target; };
+	NodeLookup nodeLookup();
+	void geometryMorph( SynthData & data, Structure::Graph * graph, bool isApprox, int limit = -1, const NodeLookup * lookup = NULL );
 	void drawSynthesis( Structure::Graph * activeGraph );
 
 	void bufferCleanup();
@@ -50,8 +50,7 @@ RMF Synthesizer::consistentFrame( Structure::Curve * curve, Array1D_Vector4d & c
 	std::vector<Scalar> times;
 	curve->curve.SubdivideByLengthTime(CURVE_FRAME_COUNT, times);
 	foreach(Scalar t, times) coords.push_back(Vector4d(t,0,0,0));
-	std::vector<Vector3d> samplePoints;
-	foreach(Vector4d c, coords) samplePoints.push_back( curve->position(c) );
+	std::vector<Vector3d> samplePoints = curve->positions( coords );
 
     RMF rmf = RMF( samplePoints );
 	rmf.compute();
@@ -90,9 +89,14 @@ QVector<ParameterCoord> Synthesizer::genPointCoordsCurve( Structure::Curve * cur
 	// Project
 	int N = points.size();
 
+	// OpenMP threads do not inherit the caller's NURBS accuracy
+	NURBS::EvaluationContext context = NURBS::EvaluationContext::current();
+
 	#pragma omp parallel for
 	for(int i = 0; i < N; i++)
 	{
+		NURBS::ScopedEvaluationContext scoped( context );
+
 		NURBS::NURBSCurved mycurve = curve->curve;
 
 		float theta, psi;
@@ -135,20 +139,22 @@ QVector<ParameterCoord> Synthesizer::genPointCoordsSheet( Structure::Sheet * she
 
 	qDebug() << "Sheet resolution count = " << sheetCoords.size();
 
+	foreach(Array1D_Vector4d row, sheetCoords)
+		foreach(Vector4d c, row) allCoords.push_back(c);
+
 	NanoKdTree kdtree;
-	foreach(Array1D_Vector4d row, sheetCoords){
-		foreach(Vector4d c, row) {
-			kdtree.addPoint( sheet->position(c) );
-			allCoords.push_back(c);
-		}
-	}
+	foreach(Vector3d p, sheet->positions( allCoords )) kdtree.addPoint( p );
 	kdtree.build();
 
 	int N = points.size();
 
+	NURBS::EvaluationContext context = NURBS::EvaluationContext::current();
+
 	#pragma omp parallel for
 	for(int i = 0; i < N; i++)
 	{
+		NURBS::ScopedEvaluationContext scoped( context );
+
 		NURBS::NURBSRectangled r = sheet->surface;
 
 		Vector3f point = points[i];
@@ -434,9 +440,13 @@ void Synthesizer::sampleGeometryCurve( QVector<ParameterCoord> samples, Structur
 	const std::vector<Vector3d> curvePnts = curve->curve.mCtrlPoint;
 	int N = samples.size();
 
+	NURBS::EvaluationContext context = NURBS::EvaluationContext::current();
+
 	#pragma omp parallel for
 	for(int i = 0; i < N; i++)
 	{
+		NURBS::ScopedEvaluationContext scoped( context );
+
 		NURBS::NURBSCurved mycurve = NURBS::NURBSCurved::createCurveFromPoints(curvePnts);
 
 		ParameterCoord sample = samplesArray[i];
@@ -504,9 +514,13 @@ void Synthesizer::sampleGeometrySheet( QVector<ParameterCoord> samples, Structur
 	const Array2D_Vector3 sheetPnts = sheet->surface.mCtrlPoint;
 	int N = samples.size();
 
+	NURBS::EvaluationContext context = NURBS::EvaluationContext::current();
+
 	#pragma omp parallel for
 	for(int i = 0; i < N; i++)
 	{
+		NURBS::ScopedEvaluationContext scoped( context );
+
 		NURBS::NURBSRectangled r = NURBS::NURBSRectangled::createSheetFromPoints(sheetPnts);
 
 		ParameterCoord sample = samplesArray[i];
@@ -681,8 +695,8 @@ void Synthesizer::reconstructGeometryCurve( Structure::Curve * base_curve, const
 		double curveLength = base_curve->curve.GetTotalLength();
 		curveLength = qMax(curveLength, 1e-4);
 
-		foreach(Vector4d p, base_curve->discretizedPoints( curveLength / steps).front())
-			proxy.push_back( base_curve->position(p).cast<float>() );
+		foreach(Vector3d p, base_curve->positions( base_curve->discretizedPoints( curveLength / steps).front() ))
+			proxy.push_back( p.cast<float>() );
 
 		if(!proxy.size()) isApprox = false;
 	}
@@ -691,9 +705,13 @@ void Synthesizer::reconstructGeometryCurve( Structure::Curve * base_curve, const
 
 	int N = in_samples.size();
 
+	NURBS::EvaluationContext context = NURBS::EvaluationContext::current();
+
 	#pragma omp parallel for
 	for(int i = 0; i < N; i++)
 	{
+		NURBS::ScopedEvaluationContext scoped( context );
+
 		ParameterCoord sample = in_samples[i];
 
 		Vector3f rayPos, rayDir;
@@ -768,9 +786,13 @@ void Synthesizer::reconstructGeometrySheet( Structure::Sheet * base_sheet, const
 
 	int N = in_samples.size();
 
+	NURBS::EvaluationContext context = NURBS::EvaluationContext::current();
+
 	#pragma omp parallel for
 	for(int i = 0; i < N; i++)
 	{
+		NURBS::ScopedEvaluationContext scoped( context );
+
 		Vector3d _X, _Y, _Z;
 		Vector3d vDirection, sheetPoint;
 		Vector3f rayPos, rayDir;
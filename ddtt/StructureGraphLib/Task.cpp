@@ -330,6 +330,9 @@ void Task::prepare()
 			{
 				l->popState();
 			}
+
+			// Restored end points were relinked by the scheduler
+			active->rebuildIndex();
 		}
 	}
 
@@ -638,7 +641,7 @@ void Task::postDone()
 					else
 					{
 						// Replace to node of this task
-						link->replace(siblingID, n, link->getCoord(siblingID));
+						active->relinkEdge(link, siblingID, n, link->getCoord(siblingID));
 
 						// Avoid modifying this link in the future
 						link->clearState();
@@ -829,7 +832,7 @@ void Task::executeMorphEdges( double t )
 		Array1D_Vector4d newCoords = Array1D_Vector4d(1, cur.a.second);
 
 		if(otherOld->id != otherNew->id)
-			link->replace( otherOld->id, otherNew, newCoords );
+			active->relinkEdge( link, otherOld->id, otherNew, newCoords );
 		else
 			link->setCoord( otherOld->id, newCoords );
 	}
@@ -946,9 +946,7 @@ bool TopoBlender::convertSheetToCurve( QString nodeID1, QString nodeID2, Structu
 	superG1->removeNode( oldSheet->id );
 
 	// Replace ID for new node
-	QString tempID = newCurve->id;
-	foreach(Structure::Link* l, superG1->getEdges(tempID)) l->id.replace(tempID, nodeID1);
-	newCurve->id = nodeID1;
+	superG1->renameNode( newCurve->id, nodeID1 );
 
 	return converted;
 }
@@ -16,6 +16,7 @@ BofSearchManager::BofSearchManager(QString folderPath, bool isCacheImages) : fol
     // Read vocabulary from desk
     imdb::vocabulary voc(folderPath, 3000);
 	vocab = voc.centers;
+	vocabIndex.build(vocab);
 
     std::cout << "Building / loading index..\n";
 
@@ -33,7 +34,7 @@ BofSearchManager::BofSearchManager(QString folderPath, bool isCacheImages) : fol
 	}
 }
 
-std::vector<dist_idx_t> BofSearchManager::search(const cv::Mat &image, bool isNormalizeSimiliarity)
+std::vector<dist_idx_t> BofSearchManager::search(const cv::Mat &image, bool isNormalizeSimiliarity, size_t numResults)
 {
     MapType data;
 
@@ -42,22 +43,17 @@ std::vector<dist_idx_t> BofSearchManager::search(const cv::Mat &image, bool isNo
     // Compute descriptor
     gen.compute( data );
 
-    // quantize
-    imdb::quantize_fn quantizer = imdb::quantize_hard<Array1Df, clustering::l2norm_squared<Array1Df> >();
-    Array2Df quantized_samples;
-
+    // quantize against the vocabulary index
     const Array2Df& samples = data["features"].value<Array2Df>();
-    imdb::quantize_samples_parallel(samples, vocab, quantized_samples, quantizer);
 
     Array1Df histvw;
-    imdb::build_histvw(quantized_samples, vocab.size(), histvw, false);
+    vocabIndex.build_histvw(samples, histvw);
 
     // Search
-    size_t in_numresults = std::numeric_limits<size_t>::max();
     std::vector<dist_idx_t> results;
-    this->query( histvw, in_numresults, results );
+    this->query( histvw, numResults, results );
 
-    if( isNormalizeSimiliarity )
+    if( isNormalizeSimiliarity && !results.empty() )
     {
         double minVal = results.back().first;
         double maxVal = results.front().first;
@@ -88,49 +84,48 @@ void BofSearchManager::buildSimiliartyMatrix()
     std::cout << "Now we will build similiarty matrix..\n";
 
     QDir d(folderPath);
-    QString absPath = d.absolutePath() + "/";
-    QStringList files = d.entryList( QStringList() << "*.png" );
 
-    size_t N = files.size();
+    // One row per indexed image, in the order of the image files
+    size_t N = index.num_documents();
+
+    std::ofstream out;
+    out.open( qPrintable( d.absolutePath() + "/" + QString("%1_affinity.csv").arg( "affinity" ) ) );
+
+    qDebug() << "Building matrix..";
+    QElapsedTimer timer; timer.start();
 
-    std::vector< std::vector<double> > M(N, std::vector<double>(N, 0));
+    // Rows are dot products of the stored tf-idf weights, computed in parallel blocks and written in order
+    const size_t blockSize = 16, blocksPerPass = 64;
 
-    // Build matrix
+    for(size_t pass = 0; pass < N; pass += blockSize * blocksPerPass)
     {
-        qDebug() << "Building matrix..";
-        QElapsedTimer timer; timer.start();
+        int numBlocks = (int)std::min(blocksPerPass, (N - pass + blockSize - 1) / blockSize);
+        std::vector<Array2Df> blocks(numBlocks);
 
-        // Fill up matrix
         #pragma omp parallel for
-        for(int i = 0; i < N; i++)
+        for(int b = 0; b < numBlocks; b++)
         {
-            cv::Mat curImg = cv::imread((absPath + files.at(i)).toStdString(), CV_LOAD_IMAGE_GRAYSCALE);
-
-            std::vector<dist_idx_t> row = search(curImg);
+            size_t first = pass + b * blockSize;
+            blocks[b].resize( std::min(blockSize, N - first) );
+            index.document_similarities( (uint32_t)first, blocks[b] );
+        }
 
-            for(int j = 0; j < (int)row.size(); j++)
+        for(int b = 0; b < numBlocks; b++)
+        {
+            for(size_t r = 0; r < blocks[b].size(); r++)
             {
-                double similiarty = row[j].first;
-                if(i == j) similiarty = 1;
+                size_t i = pass + b * blockSize + r;
+                blocks[b][r][i] = 1;
 
-                M[i][j] = M[j][i] = similiarty;
+                QStringList vector;
+                for(size_t j = 0; j < N; j++)
+                    vector << QString::number( blocks[b][r][j] );
+                out << vector.join(",").toStdString() << "\n";
             }
         }
-
-        qDebug() << "Matrix took " << timer.elapsed() << " ms\n";
     }
 
-    // Save to file
-    {
-        std::ofstream out;
-        out.open( qPrintable( d.absolutePath() + "/" + QString("%1_affinity.csv").arg( "affinity" ) ) );
-
-        for(int i = 0; i < N; i++){
-            QStringList vector;
-            for(int j = 0; j < N; j++)
-                vector << QString::number( M[i][j] );
-            out << vector.join(",").toStdString() << "\n";
-        }
-        out.close();
-    }
+    out.close();
+
+    qDebug() << "Matrix took " << timer.elapsed() << " ms\n";
 }
@@ -1,6 +1,9 @@
 #pragma once
 #include "galif.h"
 #include "inverted_index.h"
+#include "quantizer.h"
+
+#include <limits>
 
 class BofSearchManager
 {
@@ -8,7 +11,7 @@ public:
 	BofSearchManager(QString folderPath, bool isCacheImages = false);
 
 	std::vector<dist_idx_t> search( QString imageFilename );
-    std::vector<dist_idx_t> search(const cv::Mat& image , bool isNormalizeSimiliarity = false);
+    std::vector<dist_idx_t> search(const cv::Mat& image , bool isNormalizeSimiliarity = false, size_t numResults = std::numeric_limits<size_t>::max());
 
     /**
      * @brief Perform a query for the most similar 'documents' on the inverted index.
@@ -30,6 +33,7 @@ private:
 	std::shared_ptr<imdb::idf_function> _idf;
 
 	Array2Df vocab;
+	imdb::vocabulary_index vocabIndex;
 	imdb::InvertedIndex index;
 
     QString folderPath;
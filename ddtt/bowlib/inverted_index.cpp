@@ -24,6 +24,124 @@ the terms of the BSD license (see the LICENSE file).
 namespace imdb {
 
 
+// 'POST' in little endian, bumped version whenever the layout changes
+static const uint32_t postings_magic = 0x54534f50;
+static const uint32_t postings_version = 1;
+static const size_t postings_header_size = 6 * sizeof(uint32_t);
+
+Postings::Postings() : num_terms(0), num_documents(0), is_nonnegative(true)
+{
+    setPointers();
+}
+
+Postings::Postings(const InvertedIndex& index)
+{
+    num_terms = index.num_terms();
+    num_documents = index.num_documents();
+    is_nonnegative = true;
+
+    _offsets.resize(num_terms + 1, 0);
+    _maxWeights.resize(num_terms, 0);
+    _Ft = index.Ft();
+    _Ft.resize(num_terms, 0);
+    _ft.assign(index.ft().begin(), index.ft().end());
+    _ft.resize(num_terms, 0);
+
+    for (uint32_t term_id = 0; term_id < num_terms; term_id++)
+        _offsets[term_id + 1] = _offsets[term_id] + index.doc_frequency_list()[term_id].size();
+
+    _docs.reserve(_offsets.back());
+    _weights.reserve(_offsets.back());
+
+    for (uint32_t term_id = 0; term_id < num_terms; term_id++)
+    {
+        const std::vector<InvertedIndex::doc_freq_pair>& df_list = index.doc_frequency_list()[term_id];
+        const std::vector<float>& weight_list = index.doc_weight_list()[term_id];
+
+        for (size_t list_id = 0; list_id < df_list.size(); list_id++)
+        {
+            float weight = weight_list[list_id];
+
+            _docs.push_back(df_list[list_id].first);
+            _weights.push_back(weight);
+
+            if (list_id == 0 || weight > _maxWeights[term_id]) _maxWeights[term_id] = weight;
+            if (weight < 0) is_nonnegative = false;
+        }
+    }
+
+    setPointers();
+}
+
+void Postings::setPointers()
+{
+    offsets = _offsets.data();
+    max_weights = _maxWeights.data();
+    Ft = _Ft.data();
+    ft = _ft.data();
+    docs = _docs.data();
+    weights = _weights.data();
+}
+
+std::shared_ptr<const Postings> Postings::map(const std::string& filename)
+{
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(QString::fromStdString(filename));
+    if (!file->open(QIODevice::ReadOnly)) return std::shared_ptr<const Postings>();
+
+    qint64 size = file->size();
+    if (size < qint64(postings_header_size + sizeof(uint64_t))) return std::shared_ptr<const Postings>();
+
+    const uchar* data = file->map(0, size);
+    if (!data) return std::shared_ptr<const Postings>();
+
+    const uint32_t* header = reinterpret_cast<const uint32_t*>(data);
+    if (header[0] != postings_magic || header[1] != postings_version) return std::shared_ptr<const Postings>();
+
+    uint64_t T = header[2];
+    if (size < qint64(postings_header_size + (T + 1) * sizeof(uint64_t))) return std::shared_ptr<const Postings>();
+
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(data + postings_header_size);
+    uint64_t C = offsets[T];
+    if (uint64_t(size) != postings_header_size + (T + 1) * sizeof(uint64_t) + 3 * T * 4 + 2 * C * 4) return std::shared_ptr<const Postings>();
+
+    Postings* postings = new Postings;
+    postings->num_terms = header[2];
+    postings->num_documents = header[3];
+    postings->is_nonnegative = header[4] != 0;
+
+    const uchar* p = data + postings_header_size;
+    postings->offsets     = reinterpret_cast<const uint64_t*>(p); p += (T + 1) * sizeof(uint64_t);
+    postings->max_weights = reinterpret_cast<const float*>(p);    p += T * sizeof(float);
+    postings->Ft          = reinterpret_cast<const float*>(p);    p += T * sizeof(float);
+    postings->ft          = reinterpret_cast<const uint32_t*>(p); p += T * sizeof(uint32_t);
+    postings->docs        = reinterpret_cast<const uint32_t*>(p); p += C * sizeof(uint32_t);
+    postings->weights     = reinterpret_cast<const float*>(p);
+    postings->_file = file;
+
+    return std::shared_ptr<const Postings>(postings);
+}
+
+void Postings::save(const std::string& filename) const
+{
+    QFile file( QString::fromStdString(filename) );
+    if (!file.open(QIODevice::WriteOnly)) throw std::ios_base::failure("Cannot write postings to " + filename);
+
+    uint32_t header[6] = { postings_magic, postings_version, num_terms, num_documents, is_nonnegative ? 1u : 0u, 0 };
+    uint64_t C = offsets[num_terms];
+
+    bool isWritten =
+        file.write(reinterpret_cast<const char*>(header), postings_header_size) == qint64(postings_header_size) &&
+        file.write(reinterpret_cast<const char*>(offsets), (num_terms + 1) * sizeof(uint64_t)) == qint64((num_terms + 1) * sizeof(uint64_t)) &&
+        file.write(reinterpret_cast<const char*>(max_weights), num_terms * sizeof(float)) == qint64(num_terms * sizeof(float)) &&
+        file.write(reinterpret_cast<const char*>(Ft), num_terms * sizeof(float)) == qint64(num_terms * sizeof(float)) &&
+        file.write(reinterpret_cast<const char*>(ft), num_terms * sizeof(uint32_t)) == qint64(num_terms * sizeof(uint32_t)) &&
+        file.write(reinterpret_cast<const char*>(docs), C * sizeof(uint32_t)) == qint64(C * sizeof(uint32_t)) &&
+        file.write(reinterpret_cast<const char*>(weights), C * sizeof(float)) == qint64(C * sizeof(float));
+
+    if (!isWritten) throw std::ios_base::failure("Cannot write postings to " + filename);
+}
+
+
 InvertedIndex::InvertedIndex()
 {
     init();
@@ -38,22 +156,57 @@ void InvertedIndex::prepare(QString folderPath, const vocabulary & voc)
 {
 	QDir d(folderPath);
 	QString index_file = QString("%1/index.bin").arg(d.absolutePath());
+	QString postings_file = QString("%1/postings.bin").arg(d.absolutePath());
+
+	// Postings written after the index hold everything a query needs
+	if( QFileInfo(index_file).exists() && QFileInfo(postings_file).exists() 
+		&& QFileInfo(postings_file).lastModified() >= QFileInfo(index_file).lastModified() ){
+		std::shared_ptr<const Postings> postings = Postings::map( postings_file.toStdString() );
+		if( postings && postings->num_terms == voc.centers.size() ){
+			use_postings( postings );
+			qDebug() << "Mapped postings :" << postings_file;
+			return;
+		}
+	}
 
 	if( QFileInfo(index_file).exists() ){
 		load( index_file.toStdString() );
-		return;
 	}
+	else{
+		init( voc.centers.size() );
 
-	init( voc.centers.size() );
+		std::string tf = "video_google", idf = "video_google";
 
-	std::string tf = "video_google", idf = "video_google";
+		for( auto h : imdb::compute_histvw(voc) ) 
+			addHistogram( h );
+
+		finalize(*this, *imdb::make_tf(tf), *imdb::make_idf(idf));
+
+		save( index_file.toStdString() );
+	}
+
+	// Only a cache, queries work from the index if it cannot be written
+	try{
+		_postings->save( postings_file.toStdString() );
+	}
+	catch( const std::ios_base::failure & e ){
+		qDebug() << "Postings not saved :" << e.what();
+	}
+}
+
+void InvertedIndex::use_postings(const std::shared_ptr<const Postings>& postings)
+{
+    init(postings->num_terms);
 
-	for( auto h : imdb::compute_histvw(voc) ) 
-		addHistogram( h );
+    _numDocuments = postings->num_documents;
+    _ft.assign(postings->ft, postings->ft + _numWords);
+    _Ft.assign(postings->Ft, postings->Ft + _numWords);
 
-	finalize(*this, *imdb::make_tf(tf), *imdb::make_idf(idf));
+    for (uint32_t t = 0; t < _numWords; t++)
+        if (_ft[t]) _uniqueWords.insert(t);
 
-	save( index_file.toStdString() );
+    _postings = postings;
+    _finalized = true;
 }
 
 void InvertedIndex::addHistogram(const Array1Df &histogram) {
@@ -100,6 +253,15 @@ void InvertedIndex::addHistogram(const Array1Df &histogram) {
 
 void InvertedIndex::finalize(const InvertedIndex& collection_index, const tf_function& tf, const idf_function& idf) {
 
+    finalize_weights(collection_index, tf, idf);
+
+    _postings = std::make_shared<Postings>(*this);
+
+    _finalized = true;
+}
+
+void InvertedIndex::finalize_weights(const InvertedIndex& collection_index, const tf_function& tf, const idf_function& idf) {
+
     // compute average document length
     _avgDocLen = 0.0f;
     for (size_t i = 0; i < _documentSizes.size(); i++) _avgDocLen += _documentSizes[i];
@@ -112,8 +274,6 @@ void InvertedIndex::finalize(const InvertedIndex& collection_index, const tf_fun
 
     // apply weighting
     apply_tfidf(collection_index, tf, idf);
-
-    _finalized = true;
 }
 
 
@@ -177,6 +337,16 @@ void InvertedIndex::apply_tfidf(const InvertedIndex& collection_index, const tf_
 
 
 
+// k-th largest accumulator among the candidates, k > 0 and at most the number of candidates
+static float kth_score(const std::vector<float>& accumulators, const std::vector<uint32_t>& candidates, size_t k)
+{
+    std::vector<float> scores(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) scores[i] = accumulators[candidates[i]];
+
+    std::nth_element(scores.begin(), scores.begin() + (k - 1), scores.end(), std::greater<float>());
+    return scores[k - 1];
+}
+
 void InvertedIndex::query(const Array1Df& histogram, const tf_function &tf, const idf_function &idf, uint numResults, std::vector<dist_idx_t>& result) const
 {
     using namespace std;
@@ -199,38 +369,85 @@ void InvertedIndex::query(const Array1Df& histogram, const tf_function &tf, cons
     // tf-idf weighting function (note that we need to use the collection
     // statistic from this index as only it contains the required term
     // frequency stats over all documents).
+    // Only its weights are read, no postings are built for it
     InvertedIndex indexQuery(_numWords);
     indexQuery.addHistogram(histogram);
-    indexQuery.finalize(*this, tf, idf);
+    indexQuery.finalize_weights(*this, tf, idf);
 
-    // TODO: maybe make this a member so we do not have frequent re-allocations for each query
-    // TODO: test making this a map
-    vector<float> accumulators(_numDocuments, 0);
+    const Postings& postings = *_postings;
+
+    // Query terms in decreasing order of the most they can add to the score of a document
+    struct query_term { uint32_t term_id; float weight, bound; };
+    vector<query_term> terms;
+    bool isBounded = postings.is_nonnegative;
 
     const set<uint32_t>& uniqueTerms = indexQuery.unique_terms();
     set<uint32_t>::const_iterator cit;
     for (cit = uniqueTerms.begin(); cit != uniqueTerms.end(); ++cit)
     {
-        uint32_t term_id = *cit;
+        query_term qt;
+        qt.term_id = *cit;
 
         // tf-idf weight of the current term in the query
-        float wqt = indexQuery.doc_weight_list()[term_id][0];
+        qt.weight = indexQuery.doc_weight_list()[qt.term_id][0];
+        qt.bound = qt.weight * postings.max_weights[qt.term_id];
+
+        if (qt.weight < 0) isBounded = false;
+        terms.push_back(qt);
+    }
+
+    sort(terms.begin(), terms.end(), [](const query_term& a, const query_term& b){ return a.bound > b.bound; });
+
+    // remaining[i] is the most terms i and later can add
+    vector<double> remaining(terms.size() + 1, 0);
+    for (int i = (int)terms.size() - 1; i >= 0; i--) remaining[i] = remaining[i + 1] + terms[i].bound;
+
+    // TODO: maybe make this a member so we do not have frequent re-allocations for each query
+    vector<float> accumulators(_numDocuments, 0);
+
+    // only documents sharing a term with the query get scored
+    vector<uint32_t> candidates;
+    vector<char> isCandidate(_numDocuments, 0);
+
+    bool isAdmitting = true;
+    float maxScore = 0, kth = 0;
+    size_t nextCheck = 0;
+
+    for (size_t i = 0; i < terms.size(); i++)
+    {
+        // Documents not met so far score at most remaining[i]. Once that cannot beat the k-th best
+        // candidate they are left out, and only the scores of the candidates are completed. The
+        // k-th best only grows, so it is recomputed every few terms.
+        if (isAdmitting && isBounded && numResults > 0 && candidates.size() >= numResults && remaining[i] < maxScore)
+        {
+            if (i >= nextCheck) { kth = kth_score(accumulators, candidates, numResults); nextCheck = i + 8; }
+            if (kth > remaining[i] * (1 + 1e-5)) isAdmitting = false;
+        }
+
+        const query_term& qt = terms[i];
+        float wqt = qt.weight;
 
-        // iterate over the list of document/frequency pairs for
+        // iterate over the list of document/weight pairs for
         // the current term term_id
-        const vector<doc_freq_pair>& df_list = _docFrequencyList[term_id];
-        const vector<float>& weight_list = _docWeightList[term_id];
+        uint64_t begin = postings.offsets[qt.term_id], end = postings.offsets[qt.term_id + 1];
 
-        for (size_t list_id = 0; list_id < df_list.size(); list_id++)
+        for (uint64_t list_id = begin; list_id < end; list_id++)
         {
-            uint32_t doc_id = df_list[list_id].first;
+            uint32_t doc_id = postings.docs[list_id];
+
+            if (!isCandidate[doc_id])
+            {
+                if (!isAdmitting) continue;
+                isCandidate[doc_id] = 1;
+                candidates.push_back(doc_id);
+            }
 
             // tf-idf weight of the current term and the document
-            // in this index at list_id
-            float wdt = weight_list[list_id];
+            float wdt = postings.weights[list_id];
 
             // compute dot product
-            accumulators[doc_id] +=  wdt*wqt;
+            accumulators[doc_id] += wdt*wqt;
+            maxScore = std::max(maxScore, accumulators[doc_id]);
         }
     }
 
@@ -240,13 +457,26 @@ void InvertedIndex::query(const Array1Df& histogram, const tf_function &tf, cons
     // that are greater than the currently smallest element in the queue,
     // i.e. the queue retains the largest entries from the accumulator with
     // the smallest element in the queue sorted on top of the queue
-    std::priority_queue<dist_idx_t, std::vector<dist_idx_t>, std::greater<dist_idx_t> > queue;
+    typedef std::priority_queue<dist_idx_t, std::vector<dist_idx_t>, std::greater<dist_idx_t> > result_queue;
+    result_queue queue;
 
-    for (uint i = 0; i < _numDocuments; i++)
+    for (size_t i = 0; i < candidates.size(); i++)
     {
-        queue.push(dist_idx_t(accumulators[i], i));
+        queue.push(dist_idx_t(accumulators[candidates[i]], candidates[i]));
         if (queue.size() > numResults) queue.pop();
     }
+
+    // The ranking reaches documents of score zero, which are ordered among all documents
+    if (queue.size() < numResults || (!queue.empty() && queue.top().first <= 0))
+    {
+        queue = result_queue();
+
+        for (uint i = 0; i < _numDocuments; i++)
+        {
+            queue.push(dist_idx_t(accumulators[i], i));
+            if (queue.size() > numResults) queue.pop();
+        }
+    }
     assert(queue.size() <= numResults);
 
     // DO NOT CHANGE the limit to queue.size() in the loop,
@@ -262,6 +492,36 @@ void InvertedIndex::query(const Array1Df& histogram, const tf_function &tf, cons
 }
 
 
+void InvertedIndex::document_similarities(uint32_t first, Array2Df& rows) const
+{
+    const Postings& postings = *_postings;
+    uint32_t last = std::min(first + (uint32_t)rows.size(), _numDocuments);
+
+    for (size_t r = 0; r < rows.size(); r++) rows[r].assign(_numDocuments, 0);
+    if (first >= last) return;
+
+    for (uint32_t term_id = 0; term_id < postings.num_terms; term_id++)
+    {
+        const uint32_t* begin = postings.docs + postings.offsets[term_id];
+        const uint32_t* end = postings.docs + postings.offsets[term_id + 1];
+        const float* weights = postings.weights + postings.offsets[term_id];
+
+        // documents of the rows containing the term, lists are sorted by document
+        const uint32_t* from = std::lower_bound(begin, end, first);
+        const uint32_t* to = std::lower_bound(from, end, last);
+
+        for (const uint32_t* a = from; a != to; ++a)
+        {
+            Array1Df& row = rows[*a - first];
+            float wa = weights[a - begin];
+
+            for (const uint32_t* b = begin; b != end; ++b)
+                row[*b] += wa * weights[b - begin];
+        }
+    }
+}
+
+
 void InvertedIndex::init(unsigned int num_words)
 {
     _finalized = false;
@@ -273,6 +533,7 @@ void InvertedIndex::init(unsigned int num_words)
     _documentUniqueSizes.clear();
     _Ft.clear();
     _uniqueWords.clear();
+    _postings.reset();
 
     _numWords = num_words;
     _numDocuments = 0;
@@ -304,6 +565,8 @@ void InvertedIndex::load(const std::string& filename)
     _documentSizes = readArray1Df(in);
     _documentUniqueSizes = readArray1Duint(in);
 
+    _postings = std::make_shared<Postings>(*this);
+
 	qDebug() << "Loaded index :" << QString::fromStdString(filename);
 }
 
@@ -13,8 +13,67 @@ the terms of the BSD license (see the LICENSE file).
 #include "tf_idf.h"
 #include "vocabulary.h"
 
+#include <memory>
+
+class QFile;
+
 namespace imdb {
 
+class InvertedIndex;
+
+/**
+ * @ingroup search
+ * @brief Flat posting lists of a finalized InvertedIndex, holding everything a query() reads.
+ *
+ * The documents containing term t are docs[offsets[t]] to docs[offsets[t+1]-1] in increasing order,
+ * their tf-idf weights are at the same positions in weights. Files written by save() have exactly this
+ * layout in native byte order, so map() uses them in place instead of reading them:
+ *  - uint32 magic, version, num_terms, num_documents, is_nonnegative, reserved
+ *  - uint64 offsets[num_terms + 1]
+ *  - float max_weights[num_terms], Ft[num_terms]
+ *  - uint32 ft[num_terms], docs[offsets[num_terms]]
+ *  - float weights[offsets[num_terms]]
+ */
+class Postings
+{
+public:
+
+    explicit Postings(const InvertedIndex& index);
+
+    /// Maps a file written by save(), returns an empty pointer if it is missing or malformed
+    static std::shared_ptr<const Postings> map(const std::string& filename);
+
+    /// @throw std::ios_base::failure in case writing fails
+    void save(const std::string& filename) const;
+
+    uint32_t num_terms, num_documents;
+
+    /// All weights are >= 0, required for the early termination in query()
+    bool is_nonnegative;
+
+    const uint64_t* offsets;
+    const float*    max_weights;
+    const float*    Ft;
+    const uint32_t* ft;
+    const uint32_t* docs;
+    const float*    weights;
+
+private:
+
+    Postings();
+    Postings(const Postings&);
+    Postings& operator=(const Postings&);
+
+    void setPointers();
+
+    std::vector<uint64_t> _offsets;
+    std::vector<float>    _maxWeights, _Ft, _weights;
+    std::vector<uint32_t> _ft, _docs;
+
+    // keeps the mapping alive
+    std::shared_ptr<QFile> _file;
+};
+
 
 /**
  * @ingroup search
@@ -67,7 +126,7 @@ public:
      */
     InvertedIndex(unsigned int num_words);
 
-	// Custom loader
+	// Custom loader, queries from the mapped postings file when it is up to date
 	void prepare(QString folderPath, const vocabulary & voc);
 
     /**
@@ -115,6 +174,17 @@ public:
      */
     void query(const Array1Df& histogram, const tf_function &tf, const idf_function &idf, uint numResults, std::vector<dist_idx_t>& result) const;
 
+    /**
+     * @brief Dot products between the tf-idf weights of consecutive documents and all documents
+     *
+     * Only the posting lists of terms shared with the documents are visited, so the cost of all rows is
+     * the sum of the squared posting list lengths rather than the square of the number of documents.
+     *
+     * @param first Id of the document of rows[0]
+     * @param rows Each row is resized to num_documents() and filled, rows.size() documents are computed
+     */
+    void document_similarities(uint32_t first, Array2Df& rows) const;
+
 
     inline const std::vector<std::vector<doc_freq_pair> >&    doc_frequency_list() const {return _docFrequencyList;}
     inline const std::vector<std::vector<float> >&            doc_weight_list()    const {return _docWeightList;}
@@ -125,6 +195,7 @@ public:
     inline const std::set<uint32_t>&                unique_terms()          const {return _uniqueWords;}
     inline uint32_t                                 num_terms()             const {return _numWords;}
     inline uint32_t                                 num_documents()         const {return _numDocuments;}
+    inline const std::shared_ptr<const Postings>&   postings()              const {return _postings;}
 
 
     /// Convenience function to load a serialized InvertedIndex
@@ -143,6 +214,12 @@ private:
 
     void apply_tfidf(const InvertedIndex& collection_index, const tf_function& tf, const idf_function& idf);
 
+    // finalize() without building the postings, enough for a throwaway query index
+    void finalize_weights(const InvertedIndex& collection_index, const tf_function& tf, const idf_function& idf);
+
+    // takes the collection statistics from mapped postings, the per document lists stay empty
+    void use_postings(const std::shared_ptr<const Postings>& postings);
+
     // completely "clears" the index, we provide the default parameter
     // num_words = 0 for those cases where the number of words is not
     // known beforehand (e.g. in the default constructor, required when
@@ -201,6 +278,9 @@ private:
 
     // helps us to check that the index has been finalized before it gets saved
     bool _finalized;
+
+    // flat copy of the weighted lists used by query(), shared between copies of the index
+    std::shared_ptr<const Postings> _postings;
 };
 
 
@@ -2,6 +2,9 @@
 #include "types.h"
 
 #include <functional>
+#include <memory>
+#include <cmath>
+#include <opencv2/flann/flann.hpp>
 
 namespace imdb {
 
@@ -231,6 +234,105 @@ inline void build_histvw(const Array2Df& quantized_features, size_t vocabularySi
 }
 
 
+/**
+ * @brief Randomized kd-forest over the vocabulary, quantizes without comparing a sample against every word
+ *
+ * Closest words are approximate, \p checks bounds the number of leaves visited per sample. Samples are
+ * queried in blocks spread over the available threads.
+ */
+class vocabulary_index
+{
+public:
+
+    vocabulary_index() : _size(0), _checks(64) {}
+
+    vocabulary_index(const Array2Df& vocabulary, int trees = 4, int checks = 64) { build(vocabulary, trees, checks); }
+
+    void build(const Array2Df& vocabulary, int trees = 4, int checks = 64)
+    {
+        _size = vocabulary.size();
+        _checks = checks;
+        _index.reset();
+        if (vocabulary.empty()) return;
+
+        _centers = to_mat(vocabulary);
+        _index = std::make_shared<cv::flann::Index>(_centers, cv::flann::KDTreeIndexParams(trees));
+    }
+
+    size_t size() const { return _size; }
+
+    /**
+     * @brief Closest words of each sample
+     * @param samples Samples to be quantized
+     * @param k Number of words per sample
+     * @param words words[i*k + n] is the n-th closest word of sample i
+     * @param distances Squared l2 distances to the words, same layout as \p words
+     */
+    void quantize(const Array2Df& samples, int k, std::vector<index_t>& words, Array1Df& distances) const
+    {
+        k = std::min(k, (int)_size);
+        words.assign(samples.size() * k, 0);
+        distances.assign(samples.size() * k, 0);
+        if (samples.empty() || !_index || k < 1) return;
+
+        cv::Mat queries = to_mat(samples);
+
+        const int block = 256;
+        int numBlocks = (queries.rows + block - 1) / block;
+
+        #pragma omp parallel for
+        for (int b = 0; b < numBlocks; b++)
+        {
+            int begin = b * block, end = std::min(queries.rows, begin + block);
+
+            cv::Mat indices(end - begin, k, CV_32S, cv::Scalar(0)), dists(end - begin, k, CV_32F, cv::Scalar(0));
+            _index->knnSearch(queries.rowRange(begin, end), indices, dists, k, cv::flann::SearchParams(_checks));
+
+            for (int i = begin; i < end; i++)
+            {
+                for (int n = 0; n < k; n++)
+                {
+                    words[i * k + n] = std::max(0, indices.at<int>(i - begin, n));
+                    distances[i * k + n] = dists.at<float>(i - begin, n);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Histogram of visual words of hard quantized samples
+     *
+     * Same as build_histvw() without spatial bins on the output of quantize_hard.
+     */
+    void build_histvw(const Array2Df& samples, Array1Df& histvw) const
+    {
+        std::vector<index_t> words;
+        Array1Df distances;
+        quantize(samples, 1, words, distances);
+
+        histvw.assign(_size, 0);
+        for (size_t i = 0; i < words.size(); i++) histvw[words[i]] += 1;
+    }
+
+private:
+
+    static cv::Mat to_mat(const Array2Df& rows)
+    {
+        cv::Mat m((int)rows.size(), (int)rows.front().size(), CV_32F);
+        for (int i = 0; i < m.rows; i++)
+            std::copy(rows[i].begin(), rows[i].end(), m.ptr<float>(i));
+        return m;
+    }
+
+    // FLANN keeps a pointer to the centers, they live as long as the index
+    cv::Mat _centers;
+    std::shared_ptr<cv::flann::Index> _index;
+    size_t _size;
+    int _checks;
+};
+
+
 /** @} */
 
+
 } // end namespace
@@ -261,7 +261,7 @@ void DeformPathItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *,
 	// Draw in between
 	if( !path->scheduler.isNull() && path->scheduler->allGraphs.size() && path->property["isReady"].toBool() )
 	{
-		Structure::Graph * g = path->scheduler->allGraphs[path->si];
+		QSharedPointer<Structure::Graph> g = path->scheduler->allGraphs[path->si];
 
 		glViewport(dx + inbetween.x(), dy + viewport[3] - inbetween.height() - inbetween.top(), inbetween.width(), inbetween.height());
 
@@ -294,7 +294,7 @@ void DeformPathItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *,
 
 				if(sm->proxies.size())
 				{
-					for(auto poly : sm->drawWithProxies( g ))
+					for(auto poly : sm->drawWithProxies( g.data() ))
 					{
 						glColorQt( sm->color );
 						glBegin(GL_POLYGON);
@@ -18,7 +18,7 @@ void DeformationPath::execute()
 	blender = QSharedPointer<TopoBlender>( new TopoBlender( gcorr, scheduler.data() ) );
 	
 	scheduler->executeAll();
-	for(auto & g : scheduler->allGraphs) g->moveBottomCenterToOrigin( true );
+	scheduler->allGraphs.apply([](Structure::Graph * g){ g->moveBottomCenterToOrigin( true ); });
 	property["isReady"].setValue( true );
 }
 
@@ -37,7 +37,7 @@ void DeformationPath::renderSamples()
 
 	// Execute path
 	scheduler->executeAll();
-	for(auto & g : scheduler->allGraphs) g->moveBottomCenterToOrigin( true );
+	scheduler->allGraphs.apply([](Structure::Graph * g){ g->moveBottomCenterToOrigin( true ); });
 
 	if( scheduler->allGraphs.size() )
 	{
@@ -81,7 +81,7 @@ void DeformationPath::renderProxies()
 
 	//this->badMorphing();
 
-	for(auto & g : scheduler->allGraphs) g->moveBottomCenterToOrigin( true );
+	scheduler->allGraphs.apply([](Structure::Graph * g){ g->moveBottomCenterToOrigin( true ); });
 
 	property["synthManager"].setValue( smanager );
 
@@ -154,7 +154,7 @@ void DeformationPath::badMorphing()
 				n->property["shrunk"].setValue( true );
 		}
 
-		scheduler->allGraphs.push_back(  new Structure::Graph( *scheduler->activeGraph )  );
+		scheduler->allGraphs.append( scheduler->activeGraph );
 	}
 
 	property["progressDone"] = true;
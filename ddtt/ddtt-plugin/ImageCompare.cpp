@@ -4,10 +4,148 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QDebug>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QSet>
+#include <functional>
+
+#include <opencv2/flann/flann.hpp>
 
 #include "fft.h"
 #include "QC.h"
 
+// Rows of 'features' are the signatures of data[positions[row]], all of length 'dim'. Instances
+// added after the first 'count' are not in the forest.
+struct ImageCompare::DescriptorIndex
+{
+	int dim, count;
+	quint64 stamp;
+	std::vector<int> positions;
+	cv::Mat features;
+	cv::flann::Index flann;
+};
+
+typedef QPair<double, int> ScoreInstance;
+
+static bool byScore( const ScoreInstance& a, const ScoreInstance& b ){ return a.first < b.first; }
+
+// FNV-1a over the ids and signatures, changes whenever the data files do
+static quint64 signatureStamp( const ImageCompare::DataSet & dataset )
+{
+	quint64 h = 14695981039346656037ULL;
+	auto mix = [&]( const void * bytes, size_t n ){
+		const unsigned char * b = (const unsigned char *) bytes;
+		for(size_t i = 0; i < n; i++){ h ^= b[i]; h *= 1099511628211ULL; }
+	};
+
+	for(auto & inst : dataset.data){
+		mix( inst.id.constData(), inst.id.size() * sizeof(QChar) );
+		mix( inst.signature.data(), inst.signature.size() * sizeof(double) );
+	}
+
+	return h;
+}
+
+static bool isIndexed( const ImageCompare::DataSet & dataset, const ImageCompare::Instance & instance )
+{
+	return !dataset.index.isNull() && (int)instance.signature.size() == dataset.index->dim;
+}
+
+// Approximate 'k' nearest by the forest and the instances added since, ranked by exact distance.
+// Instances left out for mismatched signatures are only used to fill up to 'k'.
+static QVector<ScoreInstance> indexNearest( const ImageCompare::DataSet & dataset, const ImageCompare::Instance & instance, int k, int checks )
+{
+	ImageCompare::DescriptorIndex & index = *dataset.index;
+	QVector<ScoreInstance> candidates;
+
+	for(int j = index.count; j < dataset.data.size(); j++)
+		candidates << ScoreInstance( ImageCompare::distance(dataset.data.at(j), instance), j );
+
+	int knn = std::min( k, (int)index.positions.size() );
+	if( knn > 0 )
+	{
+		cv::Mat query( 1, index.dim, CV_32F );
+		for(int d = 0; d < index.dim; d++) query.at<float>(d) = (float)instance.signature[d];
+
+		cv::Mat indices( 1, knn, CV_32S, cv::Scalar(-1) ), dists( 1, knn, CV_32F );
+		index.flann.knnSearch( query, indices, dists, knn, cv::flann::SearchParams(checks) );
+
+		for(int i = 0; i < knn; i++){
+			int r = indices.at<int>(i);
+			if( r < 0 ) continue;
+			int j = index.positions[r];
+			candidates << ScoreInstance( ImageCompare::distance(dataset.data.at(j), instance), j );
+		}
+	}
+
+	if( candidates.size() < k && (int)index.positions.size() < index.count )
+	{
+		QVector<ScoreInstance> rest;
+		for(int j = 0; j < index.count; j++)
+			if( (int)dataset.data.at(j).signature.size() != index.dim )
+				rest << ScoreInstance( ImageCompare::distance(dataset.data.at(j), instance), j );
+		std::sort( rest.begin(), rest.end(), byScore );
+		candidates += rest.mid( 0, k - candidates.size() );
+	}
+
+	std::sort( candidates.begin(), candidates.end(), byScore );
+	return candidates.mid( 0, k );
+}
+
+// Positions within 'threshold' of each instance, closest first and excluding itself
+static QVector< QVector<ScoreInstance> > nearDuplicates( const ImageCompare::DataSet & dataset, double threshold, int checks )
+{
+	int N = dataset.data.size();
+	QVector< QVector<ScoreInstance> > result( N );
+
+	auto compare = [&]( int i, int j ){
+		double dist = ImageCompare::distance(dataset.data.at(i), dataset.data.at(j));
+		if( dist < threshold ) result[i] << ScoreInstance( dist, j );
+	};
+
+	// Instances outside the forest against all others
+	int count = dataset.index.isNull() ? 0 : dataset.index->count;
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(int i = count; i < N; i++){
+		for(int j = 0; j < N; j++) if(i != j) compare( i, j );
+		std::sort( result[i].begin(), result[i].end(), byScore );
+	}
+
+	if( dataset.index.isNull() ) return result;
+
+	// Forest distances are squared, slightly widened for the float rounding
+	ImageCompare::DescriptorIndex & index = *dataset.index;
+	double radius = threshold * threshold * 1.001;
+	int rows = (int)index.positions.size();
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(int r = 0; r < rows; r++)
+	{
+		int i = index.positions[r];
+
+		for(int maxResults = std::min(64, rows); ; maxResults = std::min(maxResults * 4, rows))
+		{
+			cv::Mat indices( 1, maxResults, CV_32S, cv::Scalar(-1) ), dists( 1, maxResults, CV_32F, cv::Scalar(0) );
+			int found = index.flann.radiusSearch( index.features.row(r), indices, dists, radius, maxResults, cv::flann::SearchParams(checks) );
+
+			if( found >= maxResults && maxResults < rows ) continue;
+
+			for(int n = 0; n < std::min(found, maxResults); n++){
+				int c = indices.at<int>(n);
+				if( c >= 0 && c != r ) compare( i, index.positions[c] );
+			}
+			break;
+		}
+
+		for(int j = count; j < N; j++) compare( i, j );
+
+		std::sort( result[i].begin(), result[i].end(), byScore );
+	}
+
+	return result;
+}
+
 ImageCompare::ImageCompare()
 {
 }
@@ -33,6 +171,8 @@ void ImageCompare::loadKnowledge(QString folderPath, QString datasetName)
 	dataset.data = data;
 
 	datasets[datasetName] = dataset;
+
+	buildIndex( datasetName );
 }
 
 void ImageCompare::addMoreKnowledge(QString datasetName, QString folderPath)
@@ -44,6 +184,9 @@ void ImageCompare::addMoreKnowledge(QString datasetName, QString folderPath)
 
 	QDir d(folderPath);
 	datasets[datasetName].data << loadDatafiles( d, d.entryList( QStringList() << "*.png" ) );
+
+	// Merged data sets are not saved under the first folder
+	buildIndex( datasetName, false );
 }
 
 void ImageCompare::addInstance(QString datasetName, Instance instance)
@@ -55,6 +198,74 @@ void ImageCompare::addInstance(QString datasetName, Instance instance)
 	datasets[datasetName].data.push_back( instance );
 }
 
+void ImageCompare::buildIndex( QString datasetName, bool isPersistent )
+{
+	if( !datasets.contains(datasetName) ) return;
+	DataSet & dataset = datasets[datasetName];
+	dataset.index.clear();
+
+	// Signatures of another length never match (see QC::L2distance) and are left out
+	int dim = 0;
+	for(auto & inst : dataset.data) if( inst.signature.size() ){ dim = (int)inst.signature.size(); break; }
+	if( !dim ) return;
+
+	QSharedPointer<DescriptorIndex> index( new DescriptorIndex );
+	index->dim = dim;
+	index->count = dataset.data.size();
+	index->stamp = signatureStamp( dataset );
+	for(int i = 0; i < dataset.data.size(); i++)
+		if( (int)dataset.data[i].signature.size() == dim ) index->positions.push_back( i );
+
+	int rows = (int)index->positions.size();
+	index->features.create( rows, dim, CV_32F );
+
+	#pragma omp parallel for
+	for(int r = 0; r < rows; r++){
+		const std::vector<double> & sig = dataset.data[index->positions[r]].signature;
+		float * row = index->features.ptr<float>(r);
+		for(int d = 0; d < dim; d++) row[d] = (float)sig[d];
+	}
+
+	QDir d( dataset.path );
+	QString headerFilename = d.absoluteFilePath("descriptors.index");
+	QString flannFilename = d.absoluteFilePath("descriptors.flann");
+
+	bool isLoaded = false;
+
+	if( isPersistent && QFile::exists(headerFilename) && QFile::exists(flannFilename) )
+	{
+		QFile file( headerFilename );
+		if( file.open(QIODevice::ReadOnly) )
+		{
+			QDataStream in( &file );
+			quint64 stamp; qint32 fileDim, fileRows;
+			in >> stamp >> fileDim >> fileRows;
+
+			if( stamp == index->stamp && fileDim == dim && fileRows == rows )
+				isLoaded = index->flann.load( index->features, flannFilename.toStdString() );
+		}
+	}
+
+	if( !isLoaded )
+	{
+		index->flann.build( index->features, cv::flann::KDTreeIndexParams( property.value("indexTrees", 4).toInt() ) );
+
+		if( isPersistent )
+		{
+			QFile file( headerFilename );
+			if( file.open(QIODevice::WriteOnly) )
+			{
+				index->flann.save( flannFilename.toStdString() );
+
+				QDataStream out( &file );
+				out << index->stamp << qint32(dim) << qint32(rows);
+			}
+		}
+	}
+
+	dataset.index = index;
+}
+
 QVector<ImageCompare::Instance> ImageCompare::loadDatafiles(QDir d, QStringList imageFiles)
 {
 	QVector<ImageCompare::Instance> data( imageFiles.size() );
@@ -261,34 +472,51 @@ ImageCompare::InstanceMatches ImageCompare::kNearest(const Instance &instance, i
 {
 	ImageCompare::InstanceMatches result;
 
-	typedef QPair<double, int> ScoreInstance;
-	QVector< ScoreInstance > candidates;
+	int checks = property.value("indexChecks", 256).toInt();
 
-	for(auto key : datasets.keys())
+	for(auto it = datasets.constBegin(); it != datasets.constEnd(); ++it)
 	{
-		const DataSet & dataset = datasets[key];
+		const DataSet & dataset = it.value();
+		QVector< ScoreInstance > candidates;
+
+		// bound check
+		int K = std::min(k, dataset.data.size());
 
-		for(auto & j : dataset.data)
+		if( !isReversed && isIndexed(dataset, instance) )
 		{
-			candidates << ScoreInstance( ImageCompare::distance(j, instance), j.index );
+			candidates = indexNearest( dataset, instance, K, checks );
 		}
+		else
+		{
+			for(int j = 0; j < dataset.data.size(); j++)
+				candidates << ScoreInstance( ImageCompare::distance(dataset.data.at(j), instance), j );
 
-		// Sort...
-		std::sort( candidates.begin(), candidates.end(), [](const ScoreInstance& a, const ScoreInstance& b){ return a.first < b.first; } );
-
-		// To get 'k' furthest, useful for debugging
-		if(isReversed) std::reverse(candidates.begin(), candidates.end());
+			// Sort...
+			std::sort( candidates.begin(), candidates.end(), byScore );
 
-		// bound check
-		int K = std::min(k, datasets[key].data.size());
+			// To get 'k' furthest, useful for debugging
+			if(isReversed) std::reverse(candidates.begin(), candidates.end());
+		}
 
 		// Return first 'k'
-		for(int i = 0; i < K; i++) result.push_back( qMakePair(candidates[i].first, datasets[key].data.at( candidates[i].second )) );
+		for(int i = 0; i < std::min(K, candidates.size()); i++)
+			result.push_back( qMakePair(candidates[i].first, dataset.data.at( candidates[i].second )) );
 	}
 
 	return result;
 }
 
+QVector<ImageCompare::InstanceMatches> ImageCompare::kNearest(const QVector<Instance> &instances, int k) const
+{
+	QVector<InstanceMatches> result( instances.size() );
+
+	#pragma omp parallel for schedule(dynamic)
+	for(int i = 0; i < instances.size(); i++)
+		result[i] = kNearest( instances[i], k );
+
+	return result;
+}
+
 ImageCompare::Instance ImageCompare::getInstance( QString datasetName, int idx )
 {
 	return datasets[datasetName].data.at(idx);
@@ -304,42 +532,61 @@ QVector< QVector<ImageCompare::Instance> > ImageCompare::duplicateSets( double t
 	if(!datasetName.length() || !datasets.keys().contains(datasetName))	datasetName = datasets.keys().front();
 	DataSet & dataset = datasets[datasetName];
 
-	int N = dataset.data.size();
+	QVector< QVector< ScoreInstance > > candidates = nearDuplicates( dataset, threshold, property.value("indexChecks", 256).toInt() );
 
-	typedef QPair<double, int> ScoreInstance;
-	QVector< QVector< ScoreInstance > > candidates(N);
+	QVector< QVector<ImageCompare::Instance> > result;
 
-	for(int i = 0; i < N; i++)
+	for(int i = 0; i < candidates.size(); i++)
 	{
-		Instance & instance = dataset.data[i];
+		QVector<ImageCompare::Instance> mysimilar;
+		for(auto p : candidates[i]) mysimilar.push_back(dataset.data.at(p.second));
 
-		for(int j = 0; j < N; j++)
+		if( !mysimilar.empty() ) 
 		{
-			if(i==j) continue;
-
-			candidates[i].push_back( qMakePair(distance(instance, dataset.data.at(j)), j) );
+			mysimilar.push_front( dataset.data.at(i) );
+			result.push_back( mysimilar );
 		}
+	}
+
+	return result;
+}
+
+QVector< QVector<ImageCompare::Instance> > ImageCompare::duplicateClusters( double threshold, QString datasetName )
+{
+	if(!datasetName.length() || !datasets.keys().contains(datasetName))	datasetName = datasets.keys().front();
+	DataSet & dataset = datasets[datasetName];
+
+	QVector< QVector< ScoreInstance > > candidates = nearDuplicates( dataset, threshold, property.value("indexChecks", 256).toInt() );
+
+	// Union-find over pairs closer than 'threshold'
+	std::vector<int> parent( candidates.size() );
+	for(int i = 0; i < (int)parent.size(); i++) parent[i] = i;
+
+	std::function<int(int)> root = [&](int i){ return parent[i] == i ? i : (parent[i] = root(parent[i])); };
 
-		// Sort
-		std::sort( candidates[i].begin(), candidates[i].end(), 
-			[](const ScoreInstance& a, const ScoreInstance& b){ return a.first < b.first; } );
+	for(int i = 0; i < candidates.size(); i++)
+		for(auto p : candidates[i]) parent[ root(p.second) ] = root(i);
+
+	// Clusters ordered by their first member
+	QVector< QVector<int> > clusters;
+	QMap<int,int> clusterOf;
+
+	for(int i = 0; i < candidates.size(); i++)
+	{
+		int r = root(i);
+		if( !clusterOf.contains(r) ){ clusterOf[r] = clusters.size(); clusters.push_back( QVector<int>() ); }
+		clusters[ clusterOf[r] ].push_back( i );
 	}
 
 	QVector< QVector<ImageCompare::Instance> > result;
 
-	for(int i = 0; i < N; i++)
+	for(auto & cluster : clusters)
 	{
-		std::vector<int> similar;
-		for(auto p : candidates[i]) if(p.first < threshold) similar.push_back( p.second );
-
-		QVector<ImageCompare::Instance> mysimilar;
-		for(auto s : similar) mysimilar.push_back(dataset.data.at(s));
+		if( cluster.size() < 2 ) continue;
 
-		if( !mysimilar.empty() ) 
-		{
-			mysimilar.push_front( dataset.data.at(i) );
-			result.push_back( mysimilar );
-		}
+		QVector<ImageCompare::Instance> members;
+		for(auto i : cluster) members.push_back( dataset.data.at(i) );
+		result.push_back( members );
 	}
 
 	return result;
@@ -352,7 +599,8 @@ void ImageCompare::removeDuplicateSets( double threshold, QString datasetName )
 
 	QStringList filenamesToRemove;
 
-	for(auto set : duplicateSets(threshold, datasetName)){
+	// Keep the first of each cluster
+	for(auto set : duplicateClusters(threshold, datasetName)){
 		set.removeFirst();
 		for(auto instance : set) filenamesToRemove << instance.filename;	
 	}
@@ -368,6 +616,42 @@ void ImageCompare::removeDuplicateSets( double threshold, QString datasetName )
 	loadKnowledge(datasetPath, datasetName);
 }
 
+ImageCompare::IndexCheck ImageCompare::checkIndex( QString datasetName, int queries, int k )
+{
+	IndexCheck check = { 0, 0, 0, 0 };
+	if( !datasets.contains(datasetName) || datasets[datasetName].data.empty() ) return check;
+
+	// Query with instances spread over the data set, against that data set alone
+	ImageCompare indexed, linear;
+	indexed.property = linear.property = property;
+	indexed.datasets[datasetName] = linear.datasets[datasetName] = datasets[datasetName];
+	linear.datasets[datasetName].index.clear();
+	if( indexed.datasets[datasetName].index.isNull() ) indexed.buildIndex( datasetName, false );
+
+	const QVector<Instance> & data = datasets[datasetName].data;
+	QVector<Instance> instances;
+	for(int i = 0; i < queries; i++) instances << data.at( (qint64(i) * data.size()) / queries );
+	check.queries = instances.size();
+
+	QElapsedTimer timer; timer.start();
+	QVector<InstanceMatches> exact = linear.kNearest( instances, k );
+	check.linearTime = timer.elapsed();
+
+	timer.restart();
+	QVector<InstanceMatches> approximate = indexed.kNearest( instances, k );
+	check.indexTime = timer.elapsed();
+
+	int total = 0, found = 0;
+	for(int q = 0; q < check.queries; q++){
+		QSet<QString> filenames;
+		for(auto & match : approximate[q]) filenames << match.second.filename;
+		for(auto & match : exact[q]){ total++; if( filenames.contains(match.second.filename) ) found++; }
+	}
+	check.recall = total ? double(found) / total : 1.0;
+
+	return check;
+}
+
 void ImageCompare::showInstances(InstanceMatches instances)
 {
 	QVector<QImage> imgs;
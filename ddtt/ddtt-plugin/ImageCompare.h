@@ -8,6 +8,7 @@
 #include <QPainter>
 #include <QDir>
 #include <QMessageBox>
+#include <QSharedPointer>
 
 inline void showImages(QVector<QImage> imgs, QStringList labels = QStringList()){ 
 	QMessageBox msg;
@@ -41,10 +42,14 @@ public:
 		Instance(std::vector< std::pair<double,double> > contour);
 	};
 
+	/// Randomized kd-forest over the signatures of a data set, see 'buildIndex'
+	struct DescriptorIndex;
+
 	struct DataSet{
 		QString name, path;
 		QVector<Instance> data;
 		QMap<QString,QVariant> property;
+		QSharedPointer<DescriptorIndex> index;
 	};
 
     QMap<QString,DataSet> datasets;
@@ -54,6 +59,9 @@ public:
 	void addMoreKnowledge(QString datasetName, QString folderPath);
 	void addInstance( QString datasetName, ImageCompare::Instance instance );
 	static QVector<ImageCompare::Instance> loadDatafiles(QDir d, QStringList imageFiles);
+
+	/// Search index, saved next to the data files when 'isPersistent' and reused while the signatures are unchanged
+	void buildIndex( QString datasetName, bool isPersistent = true );
 	
 	/// Signatures for fast look up
 	static bool isClockwise( const std::vector< std::pair<double,double> > & contour );
@@ -68,11 +76,17 @@ public:
 	/// k-nearest neighbors
 	typedef QVector< QPair<double, Instance > > InstanceMatches;
 	InstanceMatches kNearest(const ImageCompare::Instance &instance, int k = 1, bool isReversed = false) const;
+	QVector<InstanceMatches> kNearest(const QVector<ImageCompare::Instance> &instances, int k = 1) const;
 
 	/// Duplicated items
 	QVector< QVector<Instance> > duplicateSets( double threshold, QString datasetName = QString() );
+	QVector< QVector<Instance> > duplicateClusters( double threshold, QString datasetName = QString() );
 	void removeDuplicateSets( double threshold, QString datasetName = QString() );
 
+	/// Index against linear search on instances of the data set
+	struct IndexCheck{ int queries; double recall; double linearTime, indexTime; };
+	IndexCheck checkIndex( QString datasetName, int queries = 100, int k = 7 );
+
 	/// Utility
 	Instance getInstance(QString datasetName, int idx = 0);
 	size_t datasetSize(QString datasetName);
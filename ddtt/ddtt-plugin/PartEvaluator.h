@@ -61,8 +61,8 @@ struct PartEvaluator{
 			path.synthman->makeProxies(60, 20);
 			path.scheduler->executeAll();
 			QVector<Eigen::MatrixXd> buffers;
-			buffers << renderGraphBinary( path.scheduler->allGraphs.front(), path.synthman.data() );
-			buffers << renderGraphBinary( path.scheduler->allGraphs.back(), path.synthman.data() );
+			buffers << renderGraphBinary( path.scheduler->allGraphs.front().data(), path.synthman.data() );
+			buffers << renderGraphBinary( path.scheduler->allGraphs.back().data(), path.synthman.data() );
 			for(auto buffer : buffers){
 				std::vector< std::pair<double,double> > contour;
 				for(auto p : MarchingSquares::march(buffer, 1.0)) contour.push_back( std::make_pair(p.x(), p.y()) );
@@ -111,9 +111,9 @@ struct PartEvaluator{
 
 			// Compare graph after node removed
 			int midx = (double(endTime) / scheduler->totalExecutionTime()) * (scheduler->allGraphs.size()-1);
-			Structure::Graph * modified = scheduler->allGraphs[midx];
+			QSharedPointer<Structure::Graph> modified = scheduler->allGraphs[midx];
 
-			Eigen::MatrixXd buffer = renderGraphBinary( modified, synthman );
+			Eigen::MatrixXd buffer = renderGraphBinary( modified.data(), synthman );
 
 			// Find outer most contour using marching squares
 			std::vector< std::pair<double,double> > contour;
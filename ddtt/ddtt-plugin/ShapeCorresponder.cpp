@@ -103,8 +103,8 @@ ShapeCorresponder::ShapeCorresponder(Structure::Graph * g1, Structure::Graph * g
 		path.scheduler->executeAll();
 
 		QVector<Eigen::MatrixXd> buffers;
-		buffers << renderGraphBinary( path.scheduler->allGraphs.front(), path.synthman.data() );
-		buffers << renderGraphBinary( path.scheduler->allGraphs.back(), path.synthman.data() );
+		buffers << renderGraphBinary( path.scheduler->allGraphs.front().data(), path.synthman.data() );
+		buffers << renderGraphBinary( path.scheduler->allGraphs.back().data(), path.synthman.data() );
 
 		for(auto buffer : buffers)
 		{
@@ -149,8 +149,6 @@ void ShapeCorresponder::run()
 
 	DeformationPath bestPath;
 	{
-		beginFastNURBS();
-
 		// Evaluate deformations
 		#pragma omp parallel for
 		for(int pi = 0; pi < (int)paths.size(); pi++)
@@ -158,6 +156,9 @@ void ShapeCorresponder::run()
 			#pragma omp flush (abort)
 			if(!abort)
 			{
+				// NURBS quality is per thread
+				NURBS::ScopedEvaluationContext fastNURBS( NURBS::EvaluationContext::fast() );
+
 				if(pd->wasCanceled()){
 					abort = true;
 					#pragma omp flush (abort)
@@ -196,9 +197,9 @@ void ShapeCorresponder::run()
 						t = ((1.0 - 0.6) / 2.0) + (t * 0.6); // middle 60%
 
 						int idx = t * (path.scheduler->allGraphs.size()-1);
-						Structure::Graph * g = path.scheduler->allGraphs[idx];
+						QSharedPointer<Structure::Graph> g = path.scheduler->allGraphs[idx];
 
-						Eigen::MatrixXd buffer = renderGraphBinary( g, path.synthman.data() );
+						Eigen::MatrixXd buffer = renderGraphBinary( g.data(), path.synthman.data() );
 
 						if( buffer.size() )
 						{
@@ -296,8 +297,6 @@ void ShapeCorresponder::run()
 				}
 			}
 		}
-
-		endFastNURBS();
 	}
 
 	// Timing
@@ -90,7 +90,7 @@ void ShapeCorresponder2::run()
 
 				// Compare with knowledge
 				cv::Mat cvinbetween = QImageToCvMat(inbetween);
-				std::vector<dist_idx_t> neighbours = bmanager->search( cvinbetween );
+				std::vector<dist_idx_t> neighbours = bmanager->search( cvinbetween, false, k_neighbours );
 				neighbours.resize( k_neighbours );
 
 				double error = 0.0;
@@ -84,9 +84,9 @@ void ddtt::loadKnowledge()
 		ImageCompare::Instance inst = im.getInstance("chairs");
 
 		// Timing:
-		QElapsedTimer queryTimer; queryTimer.start();
-		ImageCompare::InstanceMatches results = im.kNearest( inst, 7 );
-		mainWindow()->setStatusBarMessage( QString("Query time (%1 ms)").arg(queryTimer.elapsed()) );
+		ImageCompare::IndexCheck check = im.checkIndex( "chairs", 100, 7 );
+		mainWindow()->setStatusBarMessage( QString("Query time for %1 queries: linear (%2 ms) index (%3 ms) recall %4").arg(
+			check.queries).arg(check.linearTime).arg(check.indexTime).arg(check.recall) );
 
 		// Debug:
 		ImageCompare::showInstances( ImageCompare::InstanceMatches() << qMakePair(0,inst) );
@@ -95,7 +95,7 @@ void ddtt::loadKnowledge()
 		// Clean up:
 		//im.removeDuplicateSets(0.2, "chairs");
 
-		for(auto dupset : im.duplicateSets( 0.3 ))
+		for(auto dupset : im.duplicateClusters( 0.3 ))
 		{
 			QVector<QImage> setimgs;
 			for(auto instance : dupset)	setimgs << instance.image();
@@ -9,9 +9,10 @@ namespace AStar
 {
 	class PathSearchNode : public Energy::SearchNode{
 	public:
-		PathSearchNode(const Energy::SearchNode & n = Energy::SearchNode()) : Energy::SearchNode(n){}
+		PathSearchNode(const Energy::SearchNode & n = Energy::SearchNode(), int k_top = 4) : Energy::SearchNode(n), k_top(k_top){}
 
-		static int k_top;
+		// Children suggested per expansion, carried by each node so searches can run concurrently
+		int k_top;
 
 		/* Heuristic */
 		double GoalDistanceEstimate( PathSearchNode & )
@@ -56,7 +57,7 @@ namespace AStar
 			auto suggestions = Energy::GuidedDeformation::suggestChildren(*this, k_top);
 
 			for (auto suggestion : suggestions)
-				astarsearch->AddSuccessor(PathSearchNode(suggestion));
+				astarsearch->AddSuccessor(PathSearchNode(suggestion, k_top));
 
 			return suggestions.size();
 		}
@@ -97,9 +98,7 @@ namespace AStar
 
 		auto startCopy = QSharedPointer<Energy::SearchNode>(new Energy::SearchNode(start));
 
-		PathSearchNode::k_top = k_top;
-
-		PathSearchNode startNode(*startCopy);
+		PathSearchNode startNode(*startCopy, k_top);
 
 		std::vector< std::vector<Energy::SearchNode> > result;
 
@@ -7,10 +7,11 @@
 #include <QDialogButtonBox>
 #include <QListWidget>
 #include <QMatrix4x4>
+#include <QtConcurrent/QtConcurrentRun>
 #include "EncodeDecodeGeometry.h"
 
 #include "AStarSearch.h"
-int AStar::PathSearchNode::k_top = 5;
+#include <omp.h>
 
 Structure::ShapeGraph *shapeA, *shapeB;
 static QVector<QColor> myrndcolors = rndColors2(100);
@@ -35,6 +36,7 @@ void BatchProcess::init()
 	isManyTypesJobs = false;
 	isKeepThread = false;
 	thumbWidth = 256;
+	numWorkers = 1;
     dpTopK = 20;
     dpTopK_2 = 2;
 
@@ -67,8 +69,10 @@ void BatchProcess::init()
 	}
 }
 
-BatchProcess::BatchProcess(QString filename) : jobfilename(filename), isVisualize(true)
+BatchProcess::BatchProcess(QString filename, QVariantMap options) : jobfilename(filename), isVisualize(true)
 {
+	isVisualize = !options["isQuietMode"].toBool();
+
 	init();
 
 	// Load job's data
@@ -89,6 +93,9 @@ BatchProcess::BatchProcess(QString filename) : jobfilename(filename), isVisualiz
 		thumbWidth = std::max(256, json["thumbWidth"].toInt());
 		jobsArray = json["jobs"].toArray();
 
+		if (json.contains("numWorkers")) numWorkers = json["numWorkers"].toInt();
+		checkpointFilename = json["checkpointFile"].toString();
+
 		if (isDPsearch)
 		{
 			dpTopK = json.contains("dpTopK") ? json["dpTopK"].toInt() : 20;
@@ -107,6 +114,10 @@ BatchProcess::BatchProcess(QString filename) : jobfilename(filename), isVisualiz
         }
 	}
 
+	// Command line overrides the job file
+	if (options.contains("numWorkers")) numWorkers = options["numWorkers"].toInt();
+	if (options.contains("checkpointFile")) checkpointFilename = options["checkpointFile"].toString();
+
 	// Selective jobs dialog
 	if (QGuiApplication::queryKeyboardModifiers().testFlag(Qt::ShiftModifier))
 	{
@@ -170,74 +181,119 @@ void BatchProcess::run()
 	// Progress
 	pd->setMaximum(jobsArray.size());
 
-	for (int idx = 0; idx < jobsArray.size(); idx++ )
+	// Jobs finished by an earlier run of this batch
+	QMap<QString, QVariantMap> finishedReports = readCheckpoint();
+
+	struct PendingJob{ int idx, uid; QString key; };
+	QVector<PendingJob> pending;
+	std::vector<QVariantMap> reports(jobsArray.size());
+	std::vector<bool> isReported(jobsArray.size(), false);
+	QSet<QString> inputs;
+
+	for (int idx = 0; idx < jobsArray.size(); idx++)
 	{
-		auto & j = jobsArray[idx];
+		auto job = jobsArray.at(idx).toObject(); if (job.isEmpty()) continue;
 
-		/// Input Shapes:
-		auto job = j.toObject(); if (job.isEmpty()) continue;
-		auto source = job["source"].toString();
-		auto target = job["target"].toString();
-		auto title = job["title"].toString();
+		PendingJob j;
+		j.idx = idx;
+		j.uid = ++jobUID;
+		j.key = jobKey(job, idx);
 
-		if (isSwapped)
+		isReported[idx] = true;
+
+		if (finishedReports.contains(j.key))
 		{
-			std::swap(source, target);
-			auto splitTitle = title.split("-");
-			title = splitTitle.size() > 1 ? splitTitle.back() + "-" + splitTitle.front() : title;
+			reports[idx] = finishedReports[j.key];
+			continue;
 		}
 
-		emit(setLabelText(QString("Corresponding: %1...").arg(title)));
+		inputs << job["source"].toString() << job["target"].toString();
+		pending << j;
+	}
 
-		/// Initial Assignments:
-		Energy::Assignments assignments;
-		for (auto a : job["assignments"].toArray())
-		{
-			QStringList la, lb;
-			for (auto part : a.toObject()["source"].toArray().toVariantList()) la << part.toString();
-			for (auto part : a.toObject()["target"].toArray().toVariantList()) lb << part.toString();
-			if (isSwapped) std::swap(la, lb);
-			assignments.push_back(qMakePair(la, lb));
-		}
+	QThreadPool pool;
+	pool.setMaxThreadCount(numWorkers > 0 ? numWorkers : QThread::idealThreadCount());
 
-		// Job report
-		QVariantMap jobReport;
+	// OpenMP loops inside a job share the cores with the other workers
+	int ompThreads = std::max(1, omp_get_num_procs() / pool.maxThreadCount());
 
-		// Execute job:
-        double execute_cost = executeJob(source, target, job, assignments, jobReport, idx);
+	loadShapes(inputs.toList(), &pool);
 
-        jobReport["execute_cost"].setValue(execute_cost);
+	QAtomicInt finishedCount(jobsArray.size() - pending.size());
 
-		if (isSaveReport)
+	QVector< QFuture<void> > futures;
+	for (auto j : pending)
+	{
+		futures << QtConcurrent::run(&pool, [=, &reports, &finishedCount]
 		{
-			auto report_file = QString("%1/%2.job%3.txt").arg(outputPath).arg(title).arg(jobUID);
-			QFile file(report_file);
-			file.open(QFile::WriteOnly | QFile::Text);
-			QTextStream out(&file);
-			for (auto key : jobReport.keys())
+			omp_set_num_threads(ompThreads);
+
+			/// Input Shapes:
+			auto job = jobsArray.at(j.idx).toObject();
+			auto source = job["source"].toString();
+			auto target = job["target"].toString();
+			auto title = job["title"].toString();
+
+			if (isSwapped)
 			{
-				out << key << ":" << "\n";
-				for (auto item : jobReport[key].toStringList())
-				{
-					out << item << "\n";
-				}
-				out << "\n======================\n";
+				std::swap(source, target);
+				auto splitTitle = title.split("-");
+				title = splitTitle.size() > 1 ? splitTitle.back() + "-" + splitTitle.front() : title;
 			}
-		}
 
-        jobReports.push_back(jobReport);
+			emit(setLabelText(QString("Corresponding: %1...").arg(title)));
 
-		// Log this result
-		if (false)
-		{
-			QFile file("log.txt");
-			if (file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Append)){
+			/// Initial Assignments:
+			Energy::Assignments assignments;
+			for (auto a : job["assignments"].toArray())
+			{
+				QStringList la, lb;
+				for (auto part : a.toObject()["source"].toArray().toVariantList()) la << part.toString();
+				for (auto part : a.toObject()["target"].toArray().toVariantList()) lb << part.toString();
+				if (isSwapped) std::swap(la, lb);
+				assignments.push_back(qMakePair(la, lb));
+			}
+
+			// Job report
+			QVariantMap jobReport;
+
+			// Execute job:
+			double execute_cost = executeJob(source, target, job, assignments, jobReport, j.idx, j.uid);
+
+			jobReport["execute_cost"].setValue(execute_cost);
+
+			if (isSaveReport)
+			{
+				auto report_file = QString("%1/%2.job%3.txt").arg(outputPath).arg(title).arg(j.uid);
+				QFile file(report_file);
+				file.open(QFile::WriteOnly | QFile::Text);
 				QTextStream out(&file);
-				out << source << "," << target << "," << jobReport["min_cost"].toDouble() << "\n";
+				for (auto key : jobReport.keys())
+				{
+					out << key << ":" << "\n";
+					for (auto item : jobReport[key].toStringList())
+					{
+						out << item << "\n";
+					}
+					out << "\n======================\n";
+				}
 			}
-		}
+
+			reports[j.idx] = jobReport;
+			writeCheckpoint(j.key, jobReport);
+
+			emit(jobFinished(std::min(int(++finishedCount), jobsArray.size() - 1)));
+		});
 	}
 
+	for (auto & f : futures) f.waitForFinished();
+
+	// Reports in job order
+	for (int idx = 0; idx < jobsArray.size(); idx++)
+		if (isReported[idx]) jobReports.push_back(reports[idx]);
+
+	loadedShapes.clear();
+
 	allTime = allTimer.elapsed();
 
 	emit(jobFinished(jobsArray.size()));
@@ -245,11 +301,90 @@ void BatchProcess::run()
 	emit(reportMessage(QString("Batch process time (%1 s)").arg(double(allTimer.elapsed()) / 1000), 0));
 }
 
-double BatchProcess::executeJob(QString sourceFile, QString targetFile, QJsonObject & job, 
-	Energy::Assignments & assignments, QVariantMap & jobReport, int jobIdx)
+void BatchProcess::loadShapes(QStringList filenames, QThreadPool * pool)
 {
-	jobUID++;
+	QMap< QString, QFuture< QSharedPointer<const Structure::ShapeGraph> > > futures;
+	for (auto filename : filenames)
+	{
+		if (loadedShapes.contains(filename)) continue;
+		futures[filename] = QtConcurrent::run(pool, [=]{
+			return QSharedPointer<const Structure::ShapeGraph>(new Structure::ShapeGraph(filename));
+		});
+	}
 
+	for (auto filename : futures.keys())
+		loadedShapes[filename] = futures[filename].result();
+}
+
+QSharedPointer<Structure::ShapeGraph> BatchProcess::copyShape(QString filename, bool isDetachMeshes)
+{
+	// Called from the workers, the loaded shapes are only read
+	auto loaded = loadedShapes.value(filename);
+	if (loaded.isNull())
+		return QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(filename));
+
+	auto shape = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*loaded));
+
+	if (isDetachMeshes)
+	{
+		for (auto n : shape->nodes)
+		{
+			if (!n->property.contains("mesh")) continue;
+
+			auto orig_mesh = n->property["mesh"].value< QSharedPointer<SurfaceMeshModel> >().data();
+			if (!orig_mesh) continue;
+
+			QSharedPointer<SurfaceMeshModel> new_mesh_ptr(orig_mesh->clone());
+			new_mesh_ptr->updateBoundingBox();
+			n->property["mesh"].setValue(new_mesh_ptr);
+		}
+	}
+
+	return shape;
+}
+
+QString BatchProcess::jobKey(const QJsonObject & job, int jobIdx)
+{
+	return QString("%1|%2|%3|%4").arg(jobIdx).arg(job["title"].toString()).arg(job["source"].toString()).arg(job["target"].toString());
+}
+
+QMap<QString, QVariantMap> BatchProcess::readCheckpoint()
+{
+	QMap<QString, QVariantMap> finished;
+	if (checkpointFilename.isEmpty()) return finished;
+
+	QFile file(checkpointFilename);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return finished;
+
+	// One job per line, a line cut short by an interruption does not parse and is redone
+	while (!file.atEnd())
+	{
+		auto entry = QJsonDocument::fromJson(file.readLine()).object();
+		if (entry.isEmpty()) continue;
+		finished[entry["key"].toString()] = entry["report"].toObject().toVariantMap();
+	}
+
+	return finished;
+}
+
+void BatchProcess::writeCheckpoint(QString key, const QVariantMap & jobReport)
+{
+	if (checkpointFilename.isEmpty()) return;
+
+	QJsonObject entry;
+	entry["key"] = key;
+	entry["report"] = QJsonObject::fromVariantMap(jobReport);
+
+	QMutexLocker locker(&checkpointMutex);
+
+	QFile file(checkpointFilename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Append)) return;
+	file.write(QJsonDocument(entry).toJson(QJsonDocument::Compact) + "\n");
+}
+
+double BatchProcess::executeJob(QString sourceFile, QString targetFile, QJsonObject & job, 
+	Energy::Assignments & assignments, QVariantMap & jobReport, int jobIdx, int uid)
+{
 	// Results:
 	QMap <double, Energy::SearchNode> sorted_solutions;
 	QVector < QVector <Energy::SearchNode> > solution_vec;
@@ -257,9 +392,10 @@ double BatchProcess::executeJob(QString sourceFile, QString targetFile, QJsonObj
 	/// Search solutions:
 	Energy::GuidedDeformation egd;
 
-	// Load shapes
-    auto shapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(sourceFile));
-    auto shapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(targetFile));
+	// Copy shapes, meshes are shared unless this job moves them
+	bool isMovingMeshes = job["isAllowCutsJoins"].toBool() || job["isFlip"].toBool();
+	auto shapeA = copyShape(sourceFile, isMovingMeshes);
+	auto shapeB = copyShape(targetFile, isMovingMeshes);
 
 	if (shapeA->nodes.isEmpty() || shapeB->nodes.isEmpty()) return 1.0;
 
@@ -371,15 +507,13 @@ double BatchProcess::executeJob(QString sourceFile, QString targetFile, QJsonObj
 		}
 	}
 
-	emit(jobFinished(std::min(jobIdx + 1, jobsArray.size() - 1)));
-	QCoreApplication::processEvents();
 	searchTime = searchTimer.elapsed();
 
 	double minCostResult = 1.0;
 
 	// Prepare for matching file
 	QString match_file;
-	if (isManyTypesJobs) match_file = QString("%1/%2.job%3.match").arg(outputPath).arg(title).arg(jobUID);
+	if (isManyTypesJobs) match_file = QString("%1/%2.job%3.match").arg(outputPath).arg(title).arg(uid);
 	else match_file = QString("%1/%2.match").arg(outputPath).arg(title);
 	jobReport["match_file"].setValue(match_file);
 
@@ -469,7 +603,6 @@ double BatchProcess::executeJob(QString sourceFile, QString targetFile, QJsonObj
 				renderer->render(shapeA.data()).scaledToWidth(thumbWidth, Qt::TransformationMode::SmoothTransformation),
 				renderer->render(shapeB.data()).scaledToWidth(thumbWidth, Qt::TransformationMode::SmoothTransformation));
 
-			renderer->cur_shape = NULL;
 		}
 
 		// Show deformed
@@ -513,7 +646,6 @@ double BatchProcess::executeJob(QString sourceFile, QString targetFile, QJsonObj
 			if (isVisualize)
 			{
 				auto deformedImg = renderer->render(shapeAcopy.data()).scaledToWidth(thumbWidth, Qt::TransformationMode::SmoothTransformation);
-				renderer->cur_shape = NULL;
 				deformedImg = drawText("[Deformed source]", deformedImg, 14, deformedImg.height() - 20);
 
 				cur_solution_img = stitchImages(cur_solution_img, deformedImg);
@@ -611,14 +743,14 @@ double BatchProcess::executeJob(QString sourceFile, QString targetFile, QJsonObj
 		img = drawText(msg, img, img.width() - msgWidth, 14);
 		img = drawText(QString("steps %1").arg(numNodesSearched), img, img.width() - msgWidth, 30);
 
-		auto output_file = QString("%1/%2.job%3.png").arg(outputPath).arg(title).arg(jobUID);
+		auto output_file = QString("%1/%2.job%3.png").arg(outputPath).arg(title).arg(uid);
 		img.save(output_file);
 		std::cout << " Saving image: " << qPrintable(output_file) << "\n";
 
 		jobReport["img_file"].setValue(output_file);
 	}
 
-	jobReport["is_swapped"].setValue(jobUID);
+	jobReport["is_swapped"].setValue(uid);
 	jobReport["min_cost"].setValue(minCostResult);
 	jobReport["search_time"].setValue(searchTime);
 
@@ -681,8 +813,25 @@ void BatchProcess::setJobsArray(QJsonArray fromJobsArray)
 
 QImage RenderingWidget::render(Structure::ShapeGraph * shape)
 {
-	QElapsedTimer timer;
+	// One shape at a time, jobs may render from several workers
+	QMutexLocker locker(&renderMutex);
+
 	this->cur_shape = shape;
+
+	// Drawing happens on the GUI thread that owns the widget, workers wait for it
+	QImage img;
+	if (QThread::currentThread() == thread())
+		img = renderCurrent();
+	else
+		QMetaObject::invokeMethod(this, "renderCurrent", Qt::BlockingQueuedConnection, Q_RETURN_ARG(QImage, img));
+
+	cur_shape = NULL;
+	return img;
+}
+
+QImage RenderingWidget::renderCurrent()
+{
+	QElapsedTimer timer;
 	buffer = QImage();
 	this->update();
 
@@ -693,8 +842,7 @@ QImage RenderingWidget::render(Structure::ShapeGraph * shape)
         if (timer.elapsed() > 10000)
 			break;
 	}
-	
-	cur_shape = NULL;
+
 	return buffer;
 }
 
@@ -3,11 +3,13 @@
 #include "EnergyGuidedDeformation.h"
 
 #include <QThread>
+#include <QThreadPool>
 #include <QProgressDialog>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QVariantMap>
+#include <QMutex>
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
@@ -17,7 +19,9 @@ public:
 	RenderingWidget(int width, QWidget * parent);
 	Structure::ShapeGraph * cur_shape;
 	QImage render(Structure::ShapeGraph * shape);
+	Q_INVOKABLE QImage renderCurrent();
 	QImage buffer;
+	QMutex renderMutex;
 protected:
 	void initializeGL();
 	void paintGL();
@@ -28,7 +32,7 @@ class BatchProcess : public QThread
 {
 	Q_OBJECT
 public:
-    BatchProcess(QString filename);
+    BatchProcess(QString filename, QVariantMap options = QVariantMap());
 	BatchProcess(QString sourceFilename, QString targetFilename, QVariantMap options = QVariantMap());
 
 	QProgressDialog * pd;
@@ -42,7 +46,19 @@ public:
 	void exportJobFile(QString filename);
 
 	double executeJob(QString sourceFile, QString targetFile, QJsonObject & job, 
-		Energy::Assignments & assignments, QVariantMap & jobReport, int jobIdx);
+		Energy::Assignments & assignments, QVariantMap & jobReport, int jobIdx, int uid);
+
+	// Inputs are loaded once per file and shared read-only, jobs get their own copy.
+	// Meshes stay shared unless the job moves them (flip, cuts)
+	QMap< QString, QSharedPointer<const Structure::ShapeGraph> > loadedShapes;
+	void loadShapes(QStringList filenames, QThreadPool * pool);
+	QSharedPointer<Structure::ShapeGraph> copyShape(QString filename, bool isDetachMeshes);
+
+	// Finished jobs are appended to the checkpoint as they complete, a rerun skips them
+	static QString jobKey(const QJsonObject & job, int jobIdx);
+	QMap<QString, QVariantMap> readCheckpoint();
+	void writeCheckpoint(QString key, const QVariantMap & jobReport);
+	QMutex checkpointMutex;
 
 	// Job properties:
 	QString jobfilename;
@@ -57,6 +73,8 @@ public:
 	bool isManyTypesJobs;
 	bool isVisualize;
 	int thumbWidth;
+	int numWorkers;				// jobs run at once, <= 0 uses all cores
+	QString checkpointFilename;	// empty for no checkpoint
 	QJsonArray jobsArray;
 
 	int dpTopK, dpTopK_2;
@@ -91,6 +91,8 @@ void Energy::GuidedDeformation::applyAssignment(Energy::SearchNode * path, bool
 {
 	double prevEnergy = path->energy;
 
+	path->detachShapes();
+
 	QSet<QString> mappedParts;
 
 	// Go over and apply the suggested assignments:
@@ -176,12 +178,8 @@ QVector<Energy::SearchNode> Energy::GuidedDeformation::suggestChildren(Energy::S
 	// Current shapes bounding boxes
 	auto boxA = path.shapeA->bbox(), boxB = path.shapeB->bbox();
 
-	// Output:
-	QList< QPair<double, Energy::SearchNode> > evaluated_children;
-
-	//#ifndef QT_DEBUG
-	//#pragma omp parallel for
-	//#endif
+	/// Thresholding [1]: Skip assignment if spatially too far, and pick part matching for the rest
+	QVector< QPair<QStringList, QStringList> > candidates(pairings.size());
 	for (int r = 0; r < pairings.size(); r++)
 	{
 		auto & pairing = pairings[r];
@@ -196,112 +194,116 @@ QVector<Energy::SearchNode> Energy::GuidedDeformation::suggestChildren(Energy::S
 		auto rboxB = path.shapeB->relationBBox(relationB);
 		Vector3 rboxCenterB = (rboxB.center() - boxB.min()).array() / boxB.sizes().array();
 
-		/// Thresholding [1]: Skip assignment if spatially too far
 		auto dist = (rboxCenterA - rboxCenterB).norm();
-		if (dist < candidate_threshold)
-		{
-			double curEnergy = 0;
-			QStringList la = relationA.parts, lb = relationB.parts;
+		if (dist >= candidate_threshold) continue;
 
-			// Case: many-to-many, find best matching between two sets
-			if (la.size() != 1 && lb.size() != 1)
-			{
-				//Eigen::Vector4d centroid_coordinate(0.5, 0.5, 0, 0);
-				auto intrestingCentroid = [&](Structure::ShapeGraph * shape, QString nodeID){
-					Eigen::Vector4d c(0, 0, 0, 0);
-					auto edges = shape->getEdges(nodeID);
-					if (edges.empty()) return Eigen::Vector4d(0.5,0.5,0,0);
-					for (auto e : edges) c += e->getCoord(nodeID).front();
-					return Eigen::Vector4d(c / edges.size());
-				};
+		QStringList la = relationA.parts, lb = relationB.parts;
 
-				lb.clear();
+		// Case: many-to-many, find best matching between two sets
+		if (la.size() != 1 && lb.size() != 1)
+		{
+			//Eigen::Vector4d centroid_coordinate(0.5, 0.5, 0, 0);
+			auto intrestingCentroid = [&](Structure::ShapeGraph * shape, QString nodeID){
+				Eigen::Vector4d c(0, 0, 0, 0);
+				auto edges = shape->getEdges(nodeID);
+				if (edges.empty()) return Eigen::Vector4d(0.5,0.5,0,0);
+				for (auto e : edges) c += e->getCoord(nodeID).front();
+				return Eigen::Vector4d(c / edges.size());
+			};
 
-				for (size_t i = 0; i < relationA.parts.size(); i++)
-				{
-					auto partID = relationA.parts[i];
-					auto partA = path.shapeA->getNode(partID);
+			lb.clear();
 
-					auto centroid_coordinateA = intrestingCentroid(path.shapeA.data(), partID);
-					Vector3 partCenterA = (partA->position(centroid_coordinateA) - rboxA.min()).array() / rboxA.sizes().array();
+			for (size_t i = 0; i < relationA.parts.size(); i++)
+			{
+				auto partID = relationA.parts[i];
+				auto partA = path.shapeA->getNode(partID);
 
-					partCenterA.array() *= rboxA.diagonal().normalized().array();
+				auto centroid_coordinateA = intrestingCentroid(path.shapeA.data(), partID);
+				Vector3 partCenterA = (partA->position(centroid_coordinateA) - rboxA.min()).array() / rboxA.sizes().array();
 
-					QMap<double, QString> dists;
-					for (auto tpartID : relationB.parts)
-					{
-						auto centroid_coordinateB = intrestingCentroid(path.shapeB.data(), tpartID);
-						Vector3 partCenterB = (path.shapeB->getNode(tpartID)->position(centroid_coordinateB) - rboxB.min()).array() / rboxB.sizes().array();
+				partCenterA.array() *= rboxA.diagonal().normalized().array();
 
-						partCenterB.array() *= rboxA.diagonal().normalized().array();
+				QMap<double, QString> dists;
+				for (auto tpartID : relationB.parts)
+				{
+					auto centroid_coordinateB = intrestingCentroid(path.shapeB.data(), tpartID);
+					Vector3 partCenterB = (path.shapeB->getNode(tpartID)->position(centroid_coordinateB) - rboxB.min()).array() / rboxB.sizes().array();
 
-						dists[(partCenterA - partCenterB).norm()] = tpartID;
-					}
+					partCenterB.array() *= rboxA.diagonal().normalized().array();
 
-					lb << dists.values().front();
+					dists[(partCenterA - partCenterB).norm()] = tpartID;
 				}
-			}
-			else
-			{
-				la = relationA.parts;
-				lb = relationB.parts;
-			}
 
-			// Make copies
-			auto shapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeA));
-			auto shapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeB));
-
-			// Apply then evaluate cost of current suggestion
-			auto copy_la = la, copy_lb = lb;
-			topologicalOpeartions(shapeA.data(), shapeB.data(), copy_la, copy_lb);
-			applyDeformation(shapeA.data(), shapeB.data(), copy_la, copy_lb, path.fixed + path.current + copy_la.toSet());
-
-			// Evaluate:
-			{
-				SearchNode tempNode;
-				tempNode.shapeA = shapeA;
-				tempNode.shapeB = shapeB;
-				tempNode.fixed = path.fixed + path.current + copy_la.toSet();
-				tempNode.mapping = path.mapping;
-				for (size_t i = 0; i < la.size(); i++) tempNode.mapping[copy_la[i]] = copy_lb[i].split(",").front();
-				tempNode.unassigned = path.unassigned;
-				for (auto p : la) tempNode.unassigned.remove(p);
-				curEnergy = EvaluateCorrespondence::evaluate(&tempNode);
+				lb << dists.values().front();
 			}
+		}
 
-			/// Thresholding [2]: Skip really bad assignments
-			double cost = curEnergy - path.energy;
-			if (cost < cost_threshold)
-			{
-				auto modifiedShapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeA));
-				auto modifiedShapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeB));
+		candidates[r] = qMakePair(la, lb);
+	}
 
-				auto unassigned = path.unassigned;
-				for (auto p : la) unassigned.remove(p);
+	// Output, one slot per pairing so the merge below does not depend on thread timing
+	QVector<double> costs(pairings.size(), std::numeric_limits<double>::max());
 
-				Assignments assignment;
-				assignment << qMakePair(la, lb);
-				assert(la.size() && lb.size());
+	// Candidates only read the parent's shapes, each deforms its own private copies
+	#ifndef QT_DEBUG
+	#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (int r = 0; r < pairings.size(); r++)
+	{
+		auto la = candidates[r].first, lb = candidates[r].second;
+		if (la.empty()) continue;
 
-				//#pragma omp critical
-				evaluated_children.push_back(qMakePair(cost, SearchNode(modifiedShapeA, modifiedShapeB, 
-					path.fixed + path.current, assignment, unassigned, path.mapping, cost, path.energy)));
-			}
-		}
+		// Make copies
+		auto shapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeA));
+		auto shapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeB));
+
+		// Apply then evaluate cost of current suggestion
+		auto copy_la = la, copy_lb = lb;
+		topologicalOpeartions(shapeA.data(), shapeB.data(), copy_la, copy_lb);
+		applyDeformation(shapeA.data(), shapeB.data(), copy_la, copy_lb, path.fixed + path.current + copy_la.toSet());
+
+		// Evaluate:
+		SearchNode tempNode;
+		tempNode.shapeA = shapeA;
+		tempNode.shapeB = shapeB;
+		tempNode.fixed = path.fixed + path.current + copy_la.toSet();
+		tempNode.mapping = path.mapping;
+		for (size_t i = 0; i < la.size(); i++) tempNode.mapping[copy_la[i]] = copy_lb[i].split(",").front();
+		tempNode.unassigned = path.unassigned;
+		for (auto p : la) tempNode.unassigned.remove(p);
+
+		costs[r] = EvaluateCorrespondence::evaluate(&tempNode) - path.energy;
 	}
 
-	/// Thresholding [3] : only accept the 'k' top suggestions
-	qSort(evaluated_children);
-	auto sorted_children = evaluated_children.toVector();
-	sorted_children.resize(std::min(sorted_children.size(), k_top_candidates));
+	/// Thresholding [2]: Skip really bad assignments
+	QVector<int> evaluated_children;
+	for (int r = 0; r < pairings.size(); r++)
+		if (costs[r] < cost_threshold) evaluated_children << r;
+
+	/// Thresholding [3] : only accept the 'k' top suggestions, ties keep pairing order
+	std::stable_sort(evaluated_children.begin(), evaluated_children.end(), [&](int a, int b){ return costs[a] < costs[b]; });
+	evaluated_children.resize(std::min(evaluated_children.size(), k_top_candidates));
 
 	QVector < Energy::SearchNode > accepted_children;
-	for (auto & child : sorted_children)
+	for (auto r : evaluated_children)
 	{
+		auto la = candidates[r].first, lb = candidates[r].second;
+		assert(la.size() && lb.size());
+
+		auto unassigned = path.unassigned;
+		for (auto p : la) unassigned.remove(p);
+
+		Assignments assignment;
+		assignment << qMakePair(la, lb);
+
+		// Children share the parent's shapes until they are applied
+		SearchNode child(path.shapeA, path.shapeB, path.fixed + path.current, assignment, unassigned, path.mapping, costs[r], path.energy);
+		child.isSharedShapes = true;
+
 		// Copy parent's mapping cost
-		child.second.mappingCost = path.mappingCost;
+		child.mappingCost = path.mappingCost;
 
-		accepted_children.push_back(child.second);
+		accepted_children.push_back(child);
 	}
 
 	// Clean up of no longer needed data:
@@ -379,6 +381,7 @@ void Energy::GuidedDeformation::topologicalOpeartions(Structure::ShapeGraph *sha
 
 		// Replace curve with a squashed sheet
 		shapeA->nodes.replace(shapeA->nodes.indexOf(snode), snode_sheet);
+		shapeA->rebuildIndex();
 
 		// Prepare for evaluation
 		EvaluateCorrespondence::sampleNode(shapeA, snode_sheet, shapeA->property["sampling_resolution"].toDouble());
@@ -734,16 +737,18 @@ void Energy::GuidedDeformation::applySearchPath(QVector<Energy::SearchNode*> pat
 {
 	path.front()->shapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*origShapeA));
 	path.front()->shapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*origShapeB));
+	path.front()->isSharedShapes = false;
 
 	for (size_t i = 0; i < path.size(); i++)
 	{
 		auto p = path[i];
 
-		// Prepare using previous step
+		// Prepare using previous step, applyAssignment makes the one copy
 		if (i > 0)
 		{
-			p->shapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path[i - 1]->shapeA.data()));
-			p->shapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path[i - 1]->shapeB.data()));
+			p->shapeA = path[i - 1]->shapeA;
+			p->shapeB = path[i - 1]->shapeB;
+			p->isSharedShapes = true;
 			p->energy = path[i - 1]->energy;
 		}
 
@@ -972,9 +977,6 @@ void Energy::GuidedDeformation::propagateDP(Energy::SearchNode & path, Structure
 			double cost = curEnergy - path.energy;
 			if (cost < cost_threshold)
 			{
-				auto modifiedShapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeA));
-				auto modifiedShapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*path.shapeB));
-
 				auto unassigned = path.unassigned;
 				for (auto p : la) unassigned.remove(p);
 
@@ -983,7 +985,8 @@ void Energy::GuidedDeformation::propagateDP(Energy::SearchNode & path, Structure
 				assert(la.size() && lb.size());
 
 				costs[r] = curEnergy;
-				res[r] = SearchNode(modifiedShapeA, modifiedShapeB, path.fixed + path.current, assignment, unassigned, path.mapping, cost, path.energy);
+				res[r] = SearchNode(path.shapeA, path.shapeB, path.fixed + path.current, assignment, unassigned, path.mapping, cost, path.energy);
+				res[r].isSharedShapes = true;
 
 				res[r].mappingCost = path.mappingCost;
 			}
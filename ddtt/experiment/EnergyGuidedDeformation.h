@@ -24,13 +24,22 @@ namespace Energy
 		QMap<QString, QVariant> property;
 		int num_children;
 
+		// Children start out sharing their parent's shapes, a private copy is made before the first change
+		bool isSharedShapes;
+		void detachShapes(){
+			if (!isSharedShapes) return;
+			shapeA = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*shapeA));
+			shapeB = QSharedPointer<Structure::ShapeGraph>(new Structure::ShapeGraph(*shapeB));
+			isSharedShapes = false;
+		}
+
 		SearchNode(QSharedPointer<Structure::ShapeGraph> shapeA = QSharedPointer<Structure::ShapeGraph>(), 
 			QSharedPointer<Structure::ShapeGraph> shapeB = QSharedPointer<Structure::ShapeGraph>(),
 			const QSetString & fixed = QSetString(), const Assignments & assignments = Assignments(),
 			const QSetString & unassigned = QSetString(), const QMap<QString, QString> & mapping = QMap<QString, QString>(),
 			double cost = std::numeric_limits<double>::max(), double energy = 0.0)
 			: shapeA(shapeA), shapeB(shapeB), fixed(fixed), assignments(assignments), unassigned(unassigned), mapping(mapping), 
-			cost(cost), energy(energy), num_children(0){}
+			cost(cost), energy(energy), num_children(0), isSharedShapes(false){}
 
 		QSetString fixedOnTarget(){ QSetString result; for (auto a : assignments) for (auto p : a.second) result << p; return result; }
 		QSetString unassignedList(){
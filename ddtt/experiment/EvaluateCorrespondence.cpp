@@ -157,6 +157,9 @@ void EvaluateCorrespondence::prepare(Structure::ShapeGraph * shape)
 
 			Eigen::AlignedBox3d groupBox;
 
+			// Box of the first part, taken from its vertices since meshes may be shared across threads
+			Eigen::AlignedBox3d frontBox;
+
 			QVector <double> all_projections;
 			double min_part_range = DBL_MAX;
 			for (auto partID : r.parts)
@@ -165,14 +168,14 @@ void EvaluateCorrespondence::prepare(Structure::ShapeGraph * shape)
 				auto mesh = n->property["mesh"].value< QSharedPointer<SurfaceMeshModel> >();
 				if (mesh.isNull()) continue;
 
-				mesh->updateBoundingBox();
-
 				QVector <double> part_projections;
 				for (auto v : mesh->vertices())
 				{
 					double t = (mesh->vertex_coordinates()[v] - line_start).dot(line_direction);
 					part_projections << t;
 					all_projections << t;
+
+					if (partID == r.parts.front()) frontBox.extend(mesh->vertex_coordinates()[v]);
 				}
 				qSort(part_projections);
 
@@ -199,9 +202,8 @@ void EvaluateCorrespondence::prepare(Structure::ShapeGraph * shape)
 			if (r.parts.size() == 2){
 				double dot_val = shape->getNode(r.parts.front())->diagonal().normalized()
 					.dot(shape->getNode(r.parts.back())->diagonal().normalized());
-				if (abs(dot_val) < 0.2){
-					auto mesh = shape->getNode(r.parts.front())->property["mesh"].value< QSharedPointer<SurfaceMeshModel> >();
-					filled = mesh->bbox().sizes().minCoeff();
+				if (abs(dot_val) < 0.2 && !frontBox.isEmpty()){
+					filled = frontBox.sizes().minCoeff();
 				}
 			}
 
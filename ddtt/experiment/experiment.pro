@@ -11,7 +11,7 @@ CONFIG(debug, debug|release) {
     CFG = release
 }
 
-QT += gui opengl xml svg
+QT += gui opengl xml svg concurrent
 
 HEADERS +=  experiment.h \
             experiment-widget.h \
@@ -43,6 +43,10 @@ DatasetMap shapesInDataset(QString datasetPath)
 
 int main(int argc, char *argv[])
 {
+	// Headless machines: no display is needed, implies quiet mode
+	for (int i = 1; i < argc; i++)
+		if (QString(argv[i]) == "--offscreen") qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication a(argc, argv);
     MainWindow w;
     //w.show();
@@ -66,6 +70,11 @@ int main(int argc, char *argv[])
             { { "k", "k" }, QString("(k) parameter for DP search."), QString("k") },
             { { "o", "roundtrip" }, QString("Compute least cost from source to target, and target to source.") },
             { { "c", "cut" }, QString("Allow part cuts/joins.") },
+
+			/* Batch of jobs */
+			{ { "w", "workers" }, QString("Number of jobs run at once, 0 for all cores."), QString("workers") },
+			{ "checkpoint", QString("File recording finished jobs, an interrupted batch resumes from it."), QString("checkpoint") },
+			{ "offscreen", QString("No display needed, skips rendering of thumbnails.") },
 	});
 
     if (!parser.parse(QCoreApplication::arguments())) {
@@ -129,6 +138,7 @@ int main(int argc, char *argv[])
                 if (parser.isSet("o")) pargs << "-o";
                 if (parser.isSet("k")) pargs << "-k" << parser.value("k");
 				if (parser.isSet("q")) pargs << "-q";
+				if (parser.isSet("offscreen")) pargs << "--offscreen";
                 if (parser.isSet("c")) pargs << "-c";
                 if (parser.isSet("m")) pargs << "-m";
 
@@ -261,7 +271,7 @@ int main(int argc, char *argv[])
             if(parser.isSet("g")) options["align"].setValue(true);
             if(parser.isSet("o")) options["roundtrip"].setValue(true);
             if(parser.isSet("k")) options["k"].setValue(parser.value("k").toInt());
-			if(parser.isSet("q")) options["isQuietMode"].setValue(true);
+			if(parser.isSet("q") || parser.isSet("offscreen")) options["isQuietMode"].setValue(true);
             if(parser.isSet("c")) options["isAllowCutsJoins"].setValue(true);
             if(parser.isSet("m")) options["isIgnoreSymmetryGroups"].setValue(true);
 
@@ -368,8 +378,13 @@ int main(int argc, char *argv[])
 		jobs_filename = QFileDialog::getOpenFileName(&w, "Load Jobs", "", "Jobs File (*.json)");
     }
 
+	QVariantMap batchOptions;
+	if (parser.isSet("q") || parser.isSet("offscreen")) batchOptions["isQuietMode"].setValue(true);
+	if (parser.isSet("workers")) batchOptions["numWorkers"].setValue(parser.value("workers").toInt());
+	if (parser.isSet("checkpoint")) batchOptions["checkpointFile"].setValue(parser.value("checkpoint"));
+
     QTimer::singleShot(0, [&] {
-        BatchProcess * bp = new BatchProcess(jobs_filename);
+        BatchProcess * bp = new BatchProcess(jobs_filename, batchOptions);
         QObject::connect(bp, SIGNAL(allJobsFinished()), &w, SLOT(close()));
 		QObject::connect(bp, SIGNAL(finished()), bp, SLOT(deleteLater()));
         bp->start();
@@ -5,7 +5,7 @@ StarlabTemplate(none)
 
 QMAKE_CXXFLAGS -= /MP
 
-QT     += core gui
+QT     += core gui concurrent
 CONFIG += console
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
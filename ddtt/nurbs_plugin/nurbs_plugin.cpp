@@ -211,6 +211,37 @@ bool nurbs_plugin::keyPressEvent( QKeyEvent* event )
 		used = true;
 	}
 
+	if(event->key() == Qt::Key_B)
+	{
+		QStringList report;
+
+		if(rects.size()){
+			NURBS::NURBSRectangled::BatchBenchmark b = NURBS::NURBSRectangled::benchmarkBatch( rects.back() );
+			report << QString("sheet %1 pts: per-point %2 ms, batch %3 ms, cached %4 ms (diff %5)").arg(b.points)
+				.arg(b.perPoint * 1e3).arg(b.batch * 1e3).arg(b.cached * 1e3).arg(b.maxDifference);
+		}
+
+		if(curves.size()){
+			NURBS::NURBSCurved::BatchBenchmark b = NURBS::NURBSCurved::benchmarkBatch( curves.back() );
+			report << QString("curve %1 pts: per-point %2 ms, batch %3 ms, cached %4 ms (diff %5)").arg(b.points)
+				.arg(b.perPoint * 1e3).arg(b.batch * 1e3).arg(b.cached * 1e3).arg(b.maxDifference);
+		}
+
+		mainWindow()->setStatusBarMessage( report.join(" | ") );
+
+		used = true;
+	}
+
+	if(event->key() == Qt::Key_T && curves.size())
+	{
+		NURBS::NURBSCurved::ContextCheck c = NURBS::NURBSCurved::checkContexts( curves.back() );
+
+		mainWindow()->setStatusBarMessage( QString("Fast and precise projections in parallel: %1 projections, %2 mismatches, mode gap %3, %4")
+			.arg(c.projections).arg(c.mismatches).arg(c.gap).arg(c.isRestored ? "context restored" : "context NOT restored") );
+
+		used = true;
+	}
+
 	if(event->key() == Qt::Key_Space)
 	{
 		buildSamples();
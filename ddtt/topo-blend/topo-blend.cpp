@@ -519,7 +519,7 @@ bool topoblend::keyPressEvent( QKeyEvent* event )
 
 			for(int i = 0; i < scheduler->allGraphs.size(); i++)
 			{
-				Structure::Graph * g = Structure::Graph::actualGraph( scheduler->allGraphs[i] );
+				Structure::Graph * g = Structure::Graph::actualGraph( scheduler->allGraphs[i].data() );
 				QMap<QString, int> info;
 
 				info["id"] = i;
@@ -614,6 +614,21 @@ bool topoblend::keyPressEvent( QKeyEvent* event )
 		used = true;
 	}
 
+	if(event->key() == Qt::Key_B)
+	{
+		if(graphs.size() < 1) return true;
+
+		// Super-graphs are the large case
+		Structure::Graph * g = (scheduler && scheduler->activeGraph) ? scheduler->activeGraph : graphs.back();
+
+		auto b = Structure::Graph::benchmarkLookups( g );
+
+		mainWindow()->setStatusBarMessage( QString("Graph lookups (V = %1, E = %2): indexed (%3 ms) / linear (%4 ms) / mismatches (%5)")
+			.arg( g->nodes.size() ).arg( g->edges.size() ).arg( b.indexed, 0, 'f', 1 ).arg( b.linear, 0, 'f', 1 ).arg( b.mismatches ) );
+
+		used = true;
+	}
+
 	if(event->key() == Qt::Key_N)
 	{
 		viz_params["showNames"] = !viz_params["showNames"].toBool();
@@ -0,0 +1,205 @@
+#include "GeodesicService.h"
+#include <omp.h>
+#include <algorithm>
+
+using namespace SurfaceMesh;
+
+GeodesicService::GeodesicService( SurfaceMeshModel * mesh, double t_factor ) : n( mesh->n_vertices() ), ready(false)
+{
+	Vector3VertexProperty vpoints = mesh->vertex_coordinates();
+	for(Vertex v : mesh->vertices()) points.push_back( vpoints[v] );
+
+	for(Face f : mesh->faces())
+	{
+		std::vector<int> tri;
+		for(Vertex v : mesh->vertices(f)) tri.push_back( v.idx() );
+		if( tri.size() != 3 ) continue;
+		faces.push_back( Eigen::Vector3i(tri[0], tri[1], tri[2]) );
+	}
+
+	typedef Eigen::Triplet<double> T;
+	std::vector<T> L_c;
+	Eigen::VectorXd mass = Eigen::VectorXd::Zero(n);
+	double sumEdgeLength = 0;
+
+	// Component labels, to pin the Poisson system once per component
+	std::vector<int> parent(n);
+	for(int i = 0; i < n; i++) parent[i] = i;
+	auto findRoot = [&](int i){ while(parent[i] != i) i = parent[i] = parent[parent[i]]; return i; };
+
+	for(auto & f : faces)
+	{
+		Eigen::Vector3d p[3] = { points[f[0]], points[f[1]], points[f[2]] };
+		Eigen::Vector3d N = (p[1] - p[0]).cross(p[2] - p[0]);
+		double area = 0.5 * N.norm();
+
+		Eigen::Vector3d cot;
+		for(int k = 0; k < 3; k++)
+		{
+			Eigen::Vector3d a = p[(k+1)%3] - p[k], b = p[(k+2)%3] - p[k];
+			cot[k] = a.dot(b) / std::max(a.cross(b).norm(), 1e-20);
+			sumEdgeLength += a.norm();
+		}
+
+		faceNormal.push_back( N.normalized() );
+		faceCot.push_back( cot );
+
+		for(int k = 0; k < 3; k++)
+		{
+			int i = f[(k+1)%3], j = f[(k+2)%3];
+			double w = 0.5 * cot[k];
+			L_c.push_back(T(i, j, -w));
+			L_c.push_back(T(j, i, -w));
+			L_c.push_back(T(i, i, w));
+			L_c.push_back(T(j, j, w));
+
+			mass[f[k]] += area / 3.0;
+			parent[findRoot(i)] = findRoot(j);
+		}
+	}
+
+	if( faces.empty() ) return;
+
+	// Isolated vertices get a unit mass so both systems stay definite
+	for(int i = 0; i < n; i++) if( mass[i] <= 0 ) mass[i] = 1.0;
+
+	Eigen::SparseMatrix<double> L(n, n);
+	L.setFromTriplets(L_c.begin(), L_c.end());
+
+	// Time step from the mean edge length
+	double h = sumEdgeLength / (3.0 * faces.size());
+	double t = t_factor * h * h;
+
+	Eigen::SparseMatrix<double> heat = t * L;
+	for(int i = 0; i < n; i++) heat.coeffRef(i, i) += mass[i];
+	heatSolver.compute( heat );
+
+	Eigen::SparseMatrix<double> poisson = L;
+	for(int i = 0; i < n; i++) if( findRoot(i) == i ) poisson.coeffRef(i, i) += 1.0;
+	poissonSolver.compute( poisson );
+
+	ready = (heatSolver.info() == Eigen::Success && poissonSolver.info() == Eigen::Success);
+}
+
+Eigen::MatrixXd GeodesicService::solve( const Eigen::MatrixXd & delta ) const
+{
+	int cols = int(delta.cols());
+
+	// Heat flow
+	Eigen::MatrixXd u = heatSolver.solve( delta );
+
+	// Normalized gradient, integrated divergence at vertices
+	Eigen::MatrixXd div = Eigen::MatrixXd::Zero(n, cols);
+
+	for(size_t fi = 0; fi < faces.size(); fi++)
+	{
+		const Eigen::Vector3i & f = faces[fi];
+		Eigen::Vector3d p[3] = { points[f[0]], points[f[1]], points[f[2]] };
+		const Eigen::Vector3d & N = faceNormal[fi];
+		const Eigen::Vector3d & cot = faceCot[fi];
+
+		Eigen::Vector3d edge[3];	// opposite each corner
+		for(int k = 0; k < 3; k++) edge[k] = N.cross( p[(k+2)%3] - p[(k+1)%3] );
+
+		for(int c = 0; c < cols; c++)
+		{
+			Eigen::Vector3d grad = u(f[0],c) * edge[0] + u(f[1],c) * edge[1] + u(f[2],c) * edge[2];
+			double len = grad.norm();
+			if( len <= 0 ) continue;
+			Eigen::Vector3d X = -grad / len;
+
+			for(int k = 0; k < 3; k++)
+			{
+				Eigen::Vector3d e1 = p[(k+1)%3] - p[k], e2 = p[(k+2)%3] - p[k];
+				div(f[k], c) += 0.5 * (cot[(k+2)%3] * e1.dot(X) + cot[(k+1)%3] * e2.dot(X));
+			}
+		}
+	}
+
+	// Recover the distance, shifted to be zero at the sources
+	Eigen::MatrixXd phi = poissonSolver.solve( -div );
+	for(int c = 0; c < cols; c++) phi.col(c).array() -= phi.col(c).minCoeff();
+
+	return phi;
+}
+
+Eigen::VectorXd GeodesicService::distance( const std::vector<int> & sources ) const
+{
+	if( !ready ) return Eigen::VectorXd::Zero(n);
+
+	Eigen::MatrixXd delta = Eigen::MatrixXd::Zero(n, 1);
+	for(int s : sources) delta(s, 0) = 1.0;
+
+	return solve( delta ).col(0);
+}
+
+Eigen::MatrixXd GeodesicService::distances( const std::vector<int> & sources, int blockSize ) const
+{
+	int count = int(sources.size());
+	Eigen::MatrixXd result = Eigen::MatrixXd::Zero(n, count);
+	if( !ready ) return result;
+
+	int numBlocks = (count + blockSize - 1) / blockSize;
+
+	#pragma omp parallel for schedule(dynamic)
+	for(int b = 0; b < numBlocks; b++)
+	{
+		int start = b * blockSize, cols = std::min(blockSize, count - start);
+
+		Eigen::MatrixXd delta = Eigen::MatrixXd::Zero(n, cols);
+		for(int c = 0; c < cols; c++) delta(sources[start + c], c) = 1.0;
+
+		result.middleCols(start, cols) = solve( delta );
+	}
+
+	return result;
+}
+
+Eigen::VectorXd GeodesicService::sumDistances( const std::vector<int> & sources, int blockSize ) const
+{
+	int count = int(sources.size());
+	Eigen::VectorXd sum = Eigen::VectorXd::Zero(n);
+	if( !ready ) return sum;
+
+	int numBlocks = (count + blockSize - 1) / blockSize;
+
+	#pragma omp parallel
+	{
+		Eigen::VectorXd partial = Eigen::VectorXd::Zero(n);
+
+		#pragma omp for schedule(dynamic)
+		for(int b = 0; b < numBlocks; b++)
+		{
+			int start = b * blockSize, cols = std::min(blockSize, count - start);
+
+			Eigen::MatrixXd delta = Eigen::MatrixXd::Zero(n, cols);
+			for(int c = 0; c < cols; c++) delta(sources[start + c], c) = 1.0;
+
+			partial += solve( delta ).rowwise().sum();
+		}
+
+		#pragma omp critical
+		sum += partial;
+	}
+
+	return sum;
+}
+
+std::vector<int> GeodesicService::farthestPoints( int startVertex, int count ) const
+{
+	std::vector<int> selected( 1, startVertex );
+	if( !ready ) return selected;
+
+	while( (int)selected.size() < count )
+	{
+		Eigen::VectorXd d = distance( selected );
+
+		int maxIDX = 0;
+		d.maxCoeff( &maxIDX );
+		if( std::find(selected.begin(), selected.end(), maxIDX) != selected.end() ) break;
+
+		selected.push_back( maxIDX );
+	}
+
+	return selected;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include "SurfaceMeshModel.h"
+#include <Eigen/Sparse>
+
+// Geodesic distances with the heat method (Crane et al. 2013). The heat flow and
+// Poisson systems only depend on the mesh, so both are factorized once and then
+// reused for any number of sources, solved in parallel blocks.
+class GeodesicService
+{
+public:
+	GeodesicService( SurfaceMesh::SurfaceMeshModel * mesh, double t_factor = 1.0 );
+
+	// Distance to the closest of the given sources
+	Eigen::VectorXd distance( const std::vector<int> & sources ) const;
+
+	// One distance array (column) per source
+	Eigen::MatrixXd distances( const std::vector<int> & sources, int blockSize = 16 ) const;
+
+	// Sum of the per-source distances, without keeping them all in memory
+	Eigen::VectorXd sumDistances( const std::vector<int> & sources, int blockSize = 16 ) const;
+
+	// Sources picked one at a time as the furthest vertex from those already picked
+	std::vector<int> farthestPoints( int startVertex, int count ) const;
+
+	bool isReady() const { return ready; }
+
+protected:
+	int n;
+	bool ready;
+
+	std::vector<Eigen::Vector3i> faces;
+	std::vector<Eigen::Vector3d> points;
+	std::vector<Eigen::Vector3d> faceNormal;
+	std::vector<Eigen::Vector3d> faceCot;	// cotangent of the angle at each corner
+
+	typedef Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > Solver;
+	Solver heatSolver;		// (A + t L) u = delta
+	Solver poissonSolver;	// L phi = -div X, pinned at one vertex
+
+	// Distances for each column of one-hot (or multi-hot) heat sources
+	Eigen::MatrixXd solve( const Eigen::MatrixXd & delta ) const;
+};
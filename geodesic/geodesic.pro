@@ -0,0 +1,15 @@
+include($$[STARLAB])
+include($$[SURFACEMESH])
+StarlabTemplate(none)
+
+TARGET = geodesic
+TEMPLATE = lib
+CONFIG += staticlib
+
+SOURCES += GeodesicService.cpp
+HEADERS += GeodesicService.h
+
+# Build options
+CONFIG(debug, debug|release) {CFG = debug} else {CFG = release}
+DESTDIR = $$PWD/$$CFG/lib
+
@@ -0,0 +1,161 @@
+#pragma once
+
+// Lazily lists the assignments of groups to candidates in which no candidate, other than
+// 'nothing', is taken more than 'maxUses' times. Nothing is built up front: the default order
+// is that of filtering the Cartesian product of the candidate lists (group 0 varying fastest),
+// done by backtracking. The best-first order lists them by increasing summed cost instead.
+
+#include <QVector>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <Eigen/Core>
+
+class AssignmentEnumerator
+{
+public:
+	typedef QVector<size_t> Assignment;
+
+	// 'costs(i, j)' is the cost of giving candidate j to group i, only used in best-first order
+	AssignmentEnumerator( const QVector<Assignment> & candidates, const Eigen::MatrixXd & costs, size_t nothing,
+		int maxUses, bool isBestFirst = false, int maxCount = -1 )
+		: candidates(candidates), costs(costs), nothing(nothing), maxUses(maxUses),
+		  isBestFirst(isBestFirst), maxCount(maxCount), yielded(0), depth(0)
+	{
+		size_t numChoices = nothing + 1;
+		for(auto & c : candidates) for(auto j : c) numChoices = std::max(numChoices, j + 1);
+		uses.resize( numChoices, 0 );
+
+		if( candidates.isEmpty() ) depth = -1;
+		position.resize( candidates.size(), -1 );
+
+		if( isBestFirst && depth == 0 ) startBestFirst();
+	}
+
+	// False once every assignment, or 'maxCount' of them, has been listed
+	bool next( Assignment & assignment )
+	{
+		if( maxCount >= 0 && yielded >= maxCount ) return false;
+
+		bool isFound = isBestFirst ? nextBestFirst( assignment ) : nextInOrder( assignment );
+		if( isFound ) yielded++;
+		return isFound;
+	}
+
+	int count() const { return yielded; }
+
+private:
+	QVector<Assignment> candidates;
+	Eigen::MatrixXd costs;
+	size_t nothing;
+	int maxUses;
+	bool isBestFirst;
+	int maxCount, yielded;
+
+	std::vector<int> uses;
+
+	bool isAllowed( size_t j ) const { return j == nothing || uses[j] < maxUses; }
+
+	// Backtracking, depth d assigns group n - 1 - d
+	int depth;
+	std::vector<int> position;
+
+	bool nextInOrder( Assignment & assignment )
+	{
+		int n = candidates.size();
+
+		while( depth >= 0 )
+		{
+			int g = n - 1 - depth;
+			auto & choices = candidates[g];
+
+			if( position[depth] >= 0 ) uses[ choices[position[depth]] ]--;
+
+			int p = position[depth] + 1;
+			while( p < choices.size() && !isAllowed(choices[p]) ) p++;
+
+			if( p == choices.size() ){
+				position[depth] = -1;
+				depth--;
+				continue;
+			}
+
+			position[depth] = p;
+			uses[ choices[p] ]++;
+
+			if( depth == n - 1 ){
+				assignment.resize( n );
+				for(int d = 0; d < n; d++) assignment[n - 1 - d] = candidates[n - 1 - d][position[d]];
+				return true;
+			}
+
+			depth++;
+		}
+
+		return false;
+	}
+
+	// A* over partial assignments of groups 0..depth-1, the bound adds the cheapest candidate
+	// of each remaining group so complete assignments come out in order of cost
+	struct Node{ int parent, depth; size_t choice; double cost; };
+	std::vector<Node> nodes;
+	std::vector<double> remaining;	// [d] lowest possible cost of groups d..n-1
+	typedef std::pair<double,int> Entry;
+	std::priority_queue< Entry, std::vector<Entry>, std::greater<Entry> > frontier;
+
+	void startBestFirst()
+	{
+		int n = candidates.size();
+		remaining.resize( n + 1, 0.0 );
+
+		for(int g = n - 1; g >= 0; g--){
+			double best = 0.0;
+			for(int p = 0; p < candidates[g].size(); p++){
+				double c = costs(g, candidates[g][p]);
+				if( p == 0 || c < best ) best = c;
+			}
+			remaining[g] = remaining[g + 1] + best;
+		}
+
+		Node root = { -1, 0, 0, 0.0 };
+		nodes.push_back( root );
+		frontier.push( Entry(remaining[0], 0) );
+	}
+
+	bool nextBestFirst( Assignment & assignment )
+	{
+		int n = candidates.size();
+
+		while( !frontier.empty() )
+		{
+			int id = frontier.top().second;
+			frontier.pop();
+
+			Node node = nodes[id];
+
+			// Choices along the path to this node
+			Assignment chosen( node.depth );
+			for(int i = id; nodes[i].parent >= 0; i = nodes[i].parent) chosen[nodes[i].depth - 1] = nodes[i].choice;
+
+			if( node.depth == n ){
+				assignment = chosen;
+				return true;
+			}
+
+			for(auto j : chosen) uses[j]++;
+
+			for(auto j : candidates[node.depth])
+			{
+				if( !isAllowed(j) ) continue;
+
+				Node child = { id, node.depth + 1, j, node.cost + costs(node.depth, j) };
+				nodes.push_back( child );
+				frontier.push( Entry(child.cost + remaining[child.depth], (int)nodes.size() - 1) );
+			}
+
+			for(auto j : chosen) uses[j]--;
+		}
+
+		return false;
+	}
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+// Compact undirected graph in compressed sparse row form, with a Dijkstra that keeps
+// its state in a separate scratch object so one immutable graph can be shared by threads.
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+namespace GenericGraphs{
+
+template <typename WeightType = double>
+class CSRGraph
+{
+public:
+	typedef uint32_t vertex_t;
+	typedef WeightType weight_t;
+
+	std::vector<vertex_t> offsets;	// size n + 1
+	std::vector<vertex_t> targets;
+	std::vector<weight_t> weights;
+
+	size_t numVertices() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+	size_t numEdges() const { return targets.size() / 2; }
+
+	vertex_t degree( vertex_t v ) const { return offsets[v+1] - offsets[v]; }
+	const vertex_t * neighboursBegin( vertex_t v ) const { return targets.data() + offsets[v]; }
+	const vertex_t * neighboursEnd( vertex_t v ) const { return targets.data() + offsets[v+1]; }
+
+	struct EdgeRecord{ vertex_t a, b; weight_t w; };
+
+	// Builds from undirected edges, duplicates (in either direction) are kept once
+	static CSRGraph fromEdges( size_t n, std::vector<EdgeRecord> & edges )
+	{
+		for(auto & e : edges) if( e.a > e.b ) std::swap(e.a, e.b);
+		std::sort(edges.begin(), edges.end(), [](const EdgeRecord & x, const EdgeRecord & y){
+			return x.a < y.a || (x.a == y.a && x.b < y.b);
+		});
+		edges.erase(std::unique(edges.begin(), edges.end(), [](const EdgeRecord & x, const EdgeRecord & y){
+			return x.a == y.a && x.b == y.b;
+		}), edges.end());
+
+		CSRGraph g;
+		g.offsets.assign(n + 1, 0);
+		for(auto & e : edges){ g.offsets[e.a + 1]++; g.offsets[e.b + 1]++; }
+		for(size_t i = 0; i < n; i++) g.offsets[i+1] += g.offsets[i];
+
+		g.targets.resize( edges.size() * 2 );
+		g.weights.resize( edges.size() * 2 );
+
+		std::vector<vertex_t> cursor(g.offsets.begin(), g.offsets.end() - 1);
+		for(auto & e : edges){
+			g.targets[cursor[e.a]] = e.b; g.weights[cursor[e.a]++] = e.w;
+			g.targets[cursor[e.b]] = e.a; g.weights[cursor[e.b]++] = e.w;
+		}
+
+		return g;
+	}
+
+	size_t memoryBytes() const
+	{
+		return offsets.capacity() * sizeof(vertex_t) + targets.capacity() * sizeof(vertex_t) + weights.capacity() * sizeof(weight_t);
+	}
+};
+
+// Per-thread Dijkstra state over a CSRGraph, using an indexed 4-ary heap.
+// Only touched vertices are reset between runs, so radius-limited queries stay local.
+template <typename WeightType = double>
+class ShortestPaths
+{
+public:
+	typedef CSRGraph<WeightType> Graph;
+	typedef typename Graph::vertex_t vertex_t;
+	typedef WeightType weight_t;
+
+	static vertex_t invalid() { return std::numeric_limits<vertex_t>::max(); }
+	static weight_t infinity() { return std::numeric_limits<weight_t>::infinity(); }
+
+	std::vector<weight_t> distance;
+	std::vector<vertex_t> previous;
+
+	// Distances from the closest of the sources, stopping beyond 'radius'
+	void compute( const Graph & g, const std::vector<vertex_t> & sources, weight_t radius = infinity() )
+	{
+		reset( g.numVertices() );
+
+		for(auto s : sources){
+			if( distance[s] == 0 ) continue;
+			touch( s );
+			distance[s] = 0;
+			push( s );
+		}
+
+		while( !heap.empty() )
+		{
+			vertex_t u = pop();
+			weight_t du = distance[u];
+			if( du > radius ) break;
+
+			for(vertex_t e = g.offsets[u]; e < g.offsets[u+1]; e++)
+			{
+				vertex_t v = g.targets[e];
+				weight_t dv = du + g.weights[e];
+				if( dv >= distance[v] ) continue;
+
+				if( distance[v] == infinity() ) touch( v );
+				distance[v] = dv;
+				previous[v] = u;
+
+				if( position[v] == invalid() ) push( v ); else siftUp( position[v] );
+			}
+		}
+
+		// Vertices left in the heap lie beyond the radius
+		for(auto v : heap) position[v] = invalid();
+		heap.clear();
+	}
+
+	void compute( const Graph & g, vertex_t source, weight_t radius = infinity() )
+	{
+		compute( g, std::vector<vertex_t>(1, source), radius );
+	}
+
+	// Path from the closest source to 'target', source first
+	std::vector<vertex_t> pathTo( vertex_t target ) const
+	{
+		std::vector<vertex_t> path;
+		if( target >= distance.size() || distance[target] == infinity() ) return path;
+		for(vertex_t v = target; v != invalid(); v = previous[v]) path.push_back(v);
+		std::reverse(path.begin(), path.end());
+		return path;
+	}
+
+private:
+	std::vector<vertex_t> heap, position, touched;
+
+	void reset( size_t n )
+	{
+		if( distance.size() != n )
+		{
+			distance.assign(n, infinity());
+			previous.assign(n, invalid());
+			position.assign(n, invalid());
+			touched.clear();
+			return;
+		}
+
+		for(auto v : touched){
+			distance[v] = infinity();
+			previous[v] = invalid();
+		}
+		touched.clear();
+	}
+
+	void touch( vertex_t v ) { touched.push_back(v); }
+
+	void push( vertex_t v )
+	{
+		heap.push_back(v);
+		position[v] = vertex_t(heap.size() - 1);
+		siftUp( heap.size() - 1 );
+	}
+
+	vertex_t pop()
+	{
+		vertex_t top = heap.front();
+		position[top] = invalid();
+
+		vertex_t last = heap.back();
+		heap.pop_back();
+
+		if( !heap.empty() ){
+			heap[0] = last;
+			position[last] = 0;
+			siftDown( 0 );
+		}
+
+		return top;
+	}
+
+	void siftUp( size_t i )
+	{
+		vertex_t v = heap[i];
+		weight_t d = distance[v];
+		while( i > 0 )
+		{
+			size_t parent = (i - 1) / 4;
+			if( distance[heap[parent]] <= d ) break;
+			heap[i] = heap[parent];
+			position[heap[i]] = vertex_t(i);
+			i = parent;
+		}
+		heap[i] = v;
+		position[v] = vertex_t(i);
+	}
+
+	void siftDown( size_t i )
+	{
+		vertex_t v = heap[i];
+		weight_t d = distance[v];
+		size_t n = heap.size();
+		while( true )
+		{
+			size_t first = 4 * i + 1;
+			if( first >= n ) break;
+
+			size_t best = first;
+			size_t last = std::min(first + 4, n);
+			for(size_t c = first + 1; c < last; c++)
+				if( distance[heap[c]] < distance[heap[best]] ) best = c;
+
+			if( distance[heap[best]] >= d ) break;
+			heap[i] = heap[best];
+			position[heap[i]] = vertex_t(i);
+			i = best;
+		}
+		heap[i] = v;
+		position[v] = vertex_t(i);
+	}
+};
+
+}
@@ -6,14 +6,18 @@
 
 CorrespondenceGenerator::CorrespondenceGenerator(ParticleMesh * pmeshA, ParticleMesh * pmeshB, bool isNoCompute) : sA(pmeshA), sB(pmeshB)
 {
+	// Parameters:
+	similarityThreshold = 0.25;
+	countThreshold = 1;
+	isBestFirst = false;
+	maxAssignments = -1;
+
 	if (isNoCompute) return;
-	computedAssignments = segmentAssignFromGroupAssign( generateGroupAssignments() );
+	computeCandidates();
 }
 
-Assignments CorrespondenceGenerator::generateGroupAssignments()
-{		
-	Assignments generatedAssignments;
-
+void CorrespondenceGenerator::computeCandidates()
+{
 	auto & segsA = sA->property["segments"].value<Segments>();
 	auto & segsB = sB->property["segments"].value<Segments>();
 
@@ -23,7 +27,7 @@ Assignments CorrespondenceGenerator::generateGroupAssignments()
 	auto & groupsB = sB->property["groups"].value< std::vector< std::vector<size_t> > >();
 
 	/// Build similarity matrix of groups:
-	Eigen::MatrixXd similiarity = Eigen::MatrixXd::Ones( groupsA.size(), groupsB.size() + 1 );
+	similiarity = Eigen::MatrixXd::Ones( groupsA.size(), groupsB.size() + 1 );
 
 	for(size_t i = 0; i < similiarity.rows(); i++){
 		double minVal = DBL_MAX;
@@ -63,49 +67,27 @@ Assignments CorrespondenceGenerator::generateGroupAssignments()
 	}
 	if(false) showTableColorMap(data, true); // DEBUG
 
-	// Parameters:
-	double similarity_threshold = 0.25;
-	int count_threshold = 1;
-
 	// Collect good candidates
-	Assignments candidates;
+	candidates.clear();
 	for(size_t i = 0; i < similiarity.rows(); i++){
 		QVector<size_t> candidate;
 		for(size_t j = 0; j < similiarity.cols(); j++){
-			if(similiarity(i,j) < similarity_threshold)
+			if(similiarity(i,j) < similarityThreshold)
 				candidate << j;
 		}
 		candidates << candidate;
 	}
+}
 
-	Assignments assignments;
-	cart_product(assignments, candidates);
-
-	// Filter assignments
-	Assignments filtered;
-	for(auto & a : assignments)
-	{
-		QMap<size_t,size_t> counts;
-		bool accept = true;
-		auto NOTHING_SEGMENT = similiarity.cols()-1;
-
-		for(auto i : a) counts[i]++;
-		for(auto k : counts.keys()){
-			if(k != NOTHING_SEGMENT && counts[k] > count_threshold){
-				accept = false;
-				break;
-			}
-		}
-
-		if( accept ) filtered << a;
-	}
+AssignmentEnumerator CorrespondenceGenerator::enumerateGroupAssignments() const
+{
+	auto NOTHING_SEGMENT = similiarity.cols()-1;
 
-	// DEBUG:
-	if(true) saveToTextFile("assignments.txt", vecToString2(filtered));
+	// Leaving a group unmatched costs as much as the worst accepted match
+	Eigen::MatrixXd costs = similiarity;
+	costs.col(NOTHING_SEGMENT).setConstant(similarityThreshold);
 
-	generatedAssignments = filtered;
-	
-	return generatedAssignments;
+	return AssignmentEnumerator(candidates, costs, NOTHING_SEGMENT, countThreshold, isBestFirst, maxAssignments);
 }
 
 QVector<Pairings> CorrespondenceGenerator::segmentAssignFromGroupAssign( Assignments groupAssignments )
@@ -1,5 +1,6 @@
 #pragma once
 #include "ParticleMesh.h"
+#include "AssignmentEnumerator.h"
 
 typedef QVector< QPair<size_t, size_t> >  Pairings;
 typedef QVector< QVector<size_t> > Assignments;
@@ -9,10 +10,18 @@ class CorrespondenceGenerator
 public:
 	CorrespondenceGenerator(ParticleMesh * pmeshA, ParticleMesh * pmeshB, bool isNoCompute = false);
     ParticleMesh *sA, *sB;
-	QVector<Pairings> computedAssignments;
+
+	Eigen::MatrixXd similiarity;	// groups of A x (groups of B + nothing), lower is more similar
+	Assignments candidates;			// per group of A, the groups of B under 'similarityThreshold'
+
+	double similarityThreshold;
+	int countThreshold;				// times a group of B can be assigned
+	bool isBestFirst;				// by summed similarity instead of candidate order
+	int maxAssignments;				// -1 for all
 
     QVector<RenderObject::Base*> debug;
 
-	Assignments generateGroupAssignments();
+	void computeCandidates();
+	AssignmentEnumerator enumerateGroupAssignments() const;
 	QVector<Pairings> segmentAssignFromGroupAssign( Assignments groupAssignments );
 };
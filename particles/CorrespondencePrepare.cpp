@@ -34,8 +34,7 @@ CorrespondencePrepare::CorrespondencePrepare( std::vector<ParticleMesh*> meshes
 			SegmentGraph neiGraph;
 			auto & segments = input[i]->segmentToComponents( input[i]->toGraph(), neiGraph, true );
 
-			for(auto & seg : segments)
-				seg.property["slices"].setValue( PartCorresponder::computeSlices( input[i], seg ) );
+			PartCorresponder::indexSlices( input[i], segments );
 
 			for(auto & seg : segments)
 				seg.property["bbox"].setValue( input[i]->segmentBoundingBox(seg) );
@@ -5,14 +5,114 @@
 #include <QProgressDialog>
 QProgressDialog * pd = NULL;
 
+// Scores a path by replaying its segment matches over the input particles, which are only read.
+// Per path it keeps the correspondences of shape A and the duplicates 'applyMatches' would append
+// to either shape, and gives the score of applying the path to copies of both particle sets.
+struct PathScorer
+{
+	const Particles & A, & B;
+
+	std::vector<size_t> correspondence;		// of A's particles, then of A's duplicates
+	std::vector<size_t> originA, originB;	// particle each duplicate copies
+	std::vector<char> isMatchedA, isMatchedB;
+
+	PathScorer( const Particles & A, const Particles & B ) : A(A), B(B) {}
+
+	void reset()
+	{
+		correspondence.resize( A.size() );
+		isMatchedA.resize( A.size() );
+		isMatchedB.resize( B.size() );
+
+		for(size_t i = 0; i < A.size(); i++){
+			correspondence[i] = A[i].correspondence;
+			isMatchedA[i] = A[i].isMatched;
+		}
+		for(size_t j = 0; j < B.size(); j++) isMatchedB[j] = B[j].isMatched;
+
+		originA.clear();
+		originB.clear();
+	}
+
+	void apply( const ParticleMatches & matches )
+	{
+		for(auto & m : matches)
+		{
+			size_t a = (m.side == 0) ? m.i : m.j;
+			size_t b = (m.side == 0) ? m.j : m.i;
+
+			// Entry of A taking the match, a duplicate when the particle is already matched
+			size_t entry = a;
+			if( isMatchedA[a] ){
+				originA.push_back( a );
+				correspondence.push_back( correspondence[a] );
+				entry = correspondence.size() - 1;
+			}
+			isMatchedA[a] = true;
+
+			// Id of the particle of B, likewise
+			size_t id = B[b].id;
+			if( isMatchedB[b] ){
+				originB.push_back( b );
+				id = B.size() + originB.size() - 1;
+			}
+			isMatchedB[b] = true;
+
+			correspondence[entry] = id;
+		}
+	}
+
+	// DBL_MAX as soon as the partial sum goes above 'bound'
+	double score( double bound ) const
+	{
+		size_t countB = B.size() + originB.size();
+
+		double score = 0;
+
+		int numSamples = 4;
+		int start = 1; // Skipping initial configuration
+
+		for(int sample = start; sample < numSamples; sample++) 
+		{
+			double t = double(sample) / (numSamples-1);
+
+			for(size_t e = 0; e < correspondence.size(); e++)
+			{
+				auto & pos = A[ (e < A.size()) ? e : originA[e - A.size()] ].pos;
+				size_t c = correspondence[e];
+
+				// one-to-none
+				if( c >= countB ) 
+				{
+					score += (pos /*- boxA.center()*/).norm() * 100;
+					continue;
+				}
+
+				auto & target = B[ (c < B.size()) ? c : originB[c - B.size()] ].pos;
+				auto blended = AlphaBlend(t, pos, target);
+
+				score += (blended - pos).norm();
+
+				if( (e & 1023) == 0 && score > bound ) return DBL_MAX;
+			}
+
+			if( score > bound ) return DBL_MAX;
+		}
+
+		return score;
+	}
+};
+
 CorrespondenceSearch::CorrespondenceSearch(CorrespondenceGenerator *generator) :
 	generator( generator ), sA( generator->sA ), sB( generator->sB )
 {
-	int pathsCount = (int)generator->computedAssignments.size();
-	property["pathsCount"].setValue( pathsCount );
-	if (pathsCount == 0) return;
+	property["pathsCount"].setValue( 0 );
+	if (generator->candidates.isEmpty()) return;
+
+	// Paths are listed as they are evaluated, their number is only known when capped
+	int maxPaths = std::max(0, generator->maxAssignments);
 
-    pd = new QProgressDialog( "Searching..", "Cancel", 0, pathsCount );
+    pd = new QProgressDialog( "Searching..", "Cancel", 0, maxPaths );
 	pd->show();
 	pd->setValue(0);
 
@@ -23,72 +123,101 @@ void CorrespondenceSearch::run()
 {
 	QElapsedTimer allTimer; allTimer.start();
 
-    auto & paths = generator->computedAssignments;
-
 	QVector<ParticleMesh*> input; input << sA << sB;
-	QVector<Particles> inputParticles; inputParticles << sA->particles << sB->particles;
-	auto boxA = sA->bbox();
 
-	std::vector<double> pathScores( paths.size(), DBL_MAX );
-  
+	auto assignments = generator->enumerateGroupAssignments();
+	const int batchSize = 256;
+
+	// Matches of each segment pair, shared by all paths that use it
+	QMap< QPair<size_t,size_t>, ParticleMatches > matchCache;
+
+	double bestScore = DBL_MAX;
+	double cutScore = DBL_MAX;	// lowest score so far, paths above it can not be the best
+	int pathsCount = 0;
+
 	bool abort = false;
 
-    // Evaluate correspondences
-    #pragma omp parallel for
-    for(int pi = 0; pi < (int)paths.size(); pi++)
-    {
-        #pragma omp flush (abort)
-        if(!abort)
-        {
-            if(pd->wasCanceled()){
-                abort = true;
-                #pragma omp flush (abort)
-            }
-
-			double score = 0;
-			auto & path = paths[pi];
-
-			// Compute dense correspondence
-			QVector<Particles> particles = inputParticles;
-			for(auto & pairing : path) PartCorresponder::correspondSegments( pairing, input, particles );
-
-			// Evaluate correspondence:
-			{
-				int numSamples = 4;
-				int start = 1; // Skipping initial configuration
+	while( !abort )
+	{
+		// Next batch of group assignments, as segment pairings
+		Assignments batch;
+		QVector<size_t> assignment;
+		while( batch.size() < batchSize && assignments.next(assignment) ) batch << assignment;
+		if( batch.isEmpty() ) break;
+
+		auto paths = generator->segmentAssignFromGroupAssign( batch );
+
+		// Match segment pairs not seen yet
+		{
+			QVector< QPair<size_t,size_t> > missing;
+			for(auto & path : paths)
+				for(auto & pairing : path)
+					if( !matchCache.contains(pairing) && !missing.contains(pairing) ) missing << pairing;
+
+			std::vector<ParticleMatches> computed( missing.size() );
+
+			#pragma omp parallel for schedule(dynamic)
+			for(int mi = 0; mi < (int)missing.size(); mi++)
+				computed[mi] = PartCorresponder::matchSegments( missing[mi], input );
+
+			for(int mi = 0; mi < (int)missing.size(); mi++)
+				matchCache[missing[mi]].swap( computed[mi] );
+		}
 
-				for(int sample = start; sample < numSamples; sample++) 
+		const auto & cache = matchCache;
+
+		std::vector<double> pathScores( paths.size(), DBL_MAX );
+
+		// Evaluate correspondences
+		#pragma omp parallel
+		{
+			PathScorer scorer( sA->particles, sB->particles );
+
+			#pragma omp for
+			for(int pi = 0; pi < (int)paths.size(); pi++)
+			{
+				#pragma omp flush (abort)
+				if(!abort)
 				{
-					double t = double(sample) / (numSamples-1);
+					if(pd->wasCanceled()){
+						abort = true;
+						#pragma omp flush (abort)
+					}
 
-					for(auto & p : particles[0])
-					{
-						// one-to-none
-						if( p.correspondence > particles[1].size() ) 
-						{
-							score += (p.pos /*- boxA.center()*/).norm() * 100;
-							continue;
-						}
+					// Compute dense correspondence
+					scorer.reset();
+					for(auto & pairing : paths[pi]) scorer.apply( *cache.find(pairing) );
 
-						auto blended = AlphaBlend(t, p.pos, particles[1][p.correspondence].pos);
+					// Evaluate correspondence:
+					#pragma omp flush (cutScore)
+					double score = scorer.score( cutScore );
 
-						score += (blended - p.pos).norm();
+					#pragma omp critical
+					{
+						if( score < cutScore ) cutScore = score;
 					}
+
+					pathScores[pi] = score;
+
+					emit( pathComputed() );
 				}
 			}
+		}
 
-			pathScores[pi] = score;
-
-			emit( pathComputed() );
-        }
-    }
+		/// Keep best correspondence, the first one on ties:
+		{
+			auto bestPath = std::min_element(pathScores.begin(), pathScores.end()) - pathScores.begin();
+			if( pathsCount == 0 || pathScores[bestPath] < bestScore ){
+				bestScore = pathScores[bestPath];
+				bestCorrespondence = paths[bestPath];
+			}
+		}
 
-	/// Assign best correspondence:
-	{
-		auto bestPath = std::min_element(pathScores.begin(), pathScores.end()) - pathScores.begin();
-		bestCorrespondence = paths[bestPath];
+		pathsCount += paths.size();
 	}
 
+	property["pathsCount"].setValue( pathsCount );
+
 	// Timing
 	property["allSearchTime"].setValue( (int)allTimer.elapsed() );
 
@@ -124,4 +253,6 @@ void CorrespondenceSearch::applyCorrespondence(const PartsCorrespondence & corre
 	// Assign back
 	sA->particles = particles.front();
 	sB->particles = particles.back();
+	sA->updateColumns();
+	sB->updateColumns();
 }
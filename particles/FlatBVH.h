@@ -0,0 +1,323 @@
+#pragma once
+
+// Flattened bounding volume hierarchy for batched ray queries.
+// Nodes are laid out depth-first (left child follows its parent) and rays are
+// traced in packets that share a single traversal, four at a time under SSE.
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLATBVH_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace raytracing{
+
+class FlatBVH
+{
+public:
+	enum { PacketSize = 4, MaxLeafSize = 4, NumBins = 16, MaxSAHDepth = 48, StackSize = 128 };
+
+	struct Node{
+		float bmin[3]; int start;	// first triangle (leaf) or right child (inner)
+		float bmax[3]; int count;	// triangle count (leaf) or -(split axis + 1) (inner)
+		bool isLeaf() const { return count > 0; }
+	};
+
+	struct Triangle{
+		float v0[3], e1[3], e2[3];
+		int faceid;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+
+	bool empty() const { return nodes.empty(); }
+
+	void build( const std::vector<Eigen::Vector3f> & vertices, const std::vector<Eigen::Vector3i> & faces )
+	{
+		nodes.clear();
+		triangles.clear();
+		if( faces.empty() ) return;
+
+		// Per face bounds and centroids
+		size_t n = faces.size();
+		std::vector<Eigen::AlignedBox3f> boxes( n );
+		std::vector<Eigen::Vector3f> centers( n );
+		std::vector<int> order( n );
+		for(size_t i = 0; i < n; i++)
+		{
+			for(int j = 0; j < 3; j++) boxes[i].extend( vertices[ faces[i][j] ] );
+			centers[i] = boxes[i].center();
+			order[i] = int(i);
+		}
+
+		nodes.reserve( 2 * n / MaxLeafSize + 1 );
+		buildRecursive( boxes, centers, order, 0, int(n), 0 );
+
+		// Store triangles in leaf order for coherent access
+		triangles.resize( n );
+		for(size_t i = 0; i < n; i++)
+		{
+			const Eigen::Vector3i & f = faces[ order[i] ];
+			Eigen::Vector3f v0 = vertices[f[0]], e1 = vertices[f[1]] - v0, e2 = vertices[f[2]] - v0;
+
+			Triangle & tri = triangles[i];
+			for(int k = 0; k < 3; k++){ tri.v0[k] = v0[k]; tri.e1[k] = e1[k]; tri.e2[k] = e2[k]; }
+			tri.faceid = order[i];
+		}
+	}
+
+	// Closest hits for 'count' (at most PacketSize) rays traced together.
+	// Misses leave 'tfar' untouched and set 'faceid' to -1.
+	void intersectPacket( const Eigen::Vector3f * origins, const Eigen::Vector3f * directions, int count, float * tfar, int * faceid ) const
+	{
+		Packet p;
+		for(int i = 0; i < PacketSize; i++)
+		{
+			bool isUsed = i < count;
+			for(int k = 0; k < 3; k++)
+			{
+				p.org[k][i] = isUsed ? origins[i][k] : 0.0f;
+				p.dir[k][i] = isUsed ? directions[i][k] : 1.0f;
+
+				// Avoid NaN slabs for axis aligned rays
+				float d = p.dir[k][i];
+				if( std::abs(d) < 1e-20f ) d = (d < 0) ? -1e-20f : 1e-20f;
+				p.inv[k][i] = 1.0f / d;
+			}
+			p.tfar[i] = isUsed ? tfar[i] : -1.0f;
+			p.faceid[i] = -1;
+		}
+
+		if( !nodes.empty() ) traverse( p, (1 << count) - 1 );
+
+		for(int i = 0; i < count; i++)
+		{
+			faceid[i] = p.faceid[i];
+			if( p.faceid[i] >= 0 ) tfar[i] = p.tfar[i];
+		}
+	}
+
+	// Closest hit for a single ray, returns false on miss
+	bool intersect( const Eigen::Vector3f & origin, const Eigen::Vector3f & direction, float & t, int & faceid ) const
+	{
+		t = std::numeric_limits<float>::infinity();
+		intersectPacket( &origin, &direction, 1, &t, &faceid );
+		return faceid >= 0;
+	}
+
+private:
+	struct Packet{
+		float org[3][PacketSize], dir[3][PacketSize], inv[3][PacketSize];
+		float tfar[PacketSize];
+		int faceid[PacketSize];
+	};
+
+	int buildRecursive( const std::vector<Eigen::AlignedBox3f> & boxes, const std::vector<Eigen::Vector3f> & centers,
+		std::vector<int> & order, int begin, int end, int depth )
+	{
+		int nodeIndex = int(nodes.size());
+		nodes.push_back( Node() );
+
+		Eigen::AlignedBox3f bounds, centerBounds;
+		for(int i = begin; i < end; i++){
+			bounds.extend( boxes[order[i]] );
+			centerBounds.extend( centers[order[i]] );
+		}
+
+		for(int k = 0; k < 3; k++){
+			nodes[nodeIndex].bmin[k] = bounds.min()[k];
+			nodes[nodeIndex].bmax[k] = bounds.max()[k];
+		}
+
+		int count = end - begin;
+		if( count <= MaxLeafSize )
+		{
+			nodes[nodeIndex].start = begin;
+			nodes[nodeIndex].count = count;
+			return nodeIndex;
+		}
+
+		int axis = 0;
+		Eigen::Vector3f extent = centerBounds.sizes();
+		if( extent[1] > extent[axis] ) axis = 1;
+		if( extent[2] > extent[axis] ) axis = 2;
+
+		int mid = -1;
+
+		// Binned surface area heuristic along the widest centroid axis
+		if( depth < MaxSAHDepth && extent[axis] > 0 )
+		{
+			Eigen::AlignedBox3f binBox[NumBins];
+			int binCount[NumBins] = {0};
+
+			float scale = NumBins / extent[axis];
+			auto binOf = [&]( int i ){
+				return std::min( int((centers[i][axis] - centerBounds.min()[axis]) * scale), int(NumBins) - 1 );
+			};
+
+			for(int i = begin; i < end; i++){
+				int b = binOf( order[i] );
+				binBox[b].extend( boxes[order[i]] );
+				binCount[b]++;
+			}
+
+			// Sweep from the right to accumulate suffix areas
+			float rightArea[NumBins];
+			int rightCount[NumBins];
+			Eigen::AlignedBox3f acc;
+			int accCount = 0;
+			for(int b = NumBins - 1; b > 0; b--){
+				acc.extend( binBox[b] );
+				accCount += binCount[b];
+				rightArea[b] = area( acc );
+				rightCount[b] = accCount;
+			}
+
+			float bestCost = std::numeric_limits<float>::max();
+			int bestSplit = -1;
+			acc.setEmpty();
+			accCount = 0;
+			for(int b = 1; b < NumBins; b++){
+				acc.extend( binBox[b-1] );
+				accCount += binCount[b-1];
+				if( accCount == 0 || rightCount[b] == 0 ) continue;
+
+				float cost = area( acc ) * accCount + rightArea[b] * rightCount[b];
+				if( cost < bestCost ){ bestCost = cost; bestSplit = b; }
+			}
+
+			if( bestSplit > 0 )
+			{
+				int * split = std::partition( &order[0] + begin, &order[0] + end, [&]( int i ){ return binOf(i) < bestSplit; } );
+				mid = int(split - &order[0]);
+			}
+		}
+
+		// Fallback to an object median split
+		if( mid <= begin || mid >= end )
+		{
+			mid = (begin + end) / 2;
+			std::nth_element( &order[0] + begin, &order[0] + mid, &order[0] + end, [&]( int a, int b ){
+				return centers[a][axis] < centers[b][axis];
+			});
+		}
+
+		buildRecursive( boxes, centers, order, begin, mid, depth + 1 );
+		int right = buildRecursive( boxes, centers, order, mid, end, depth + 1 );
+
+		nodes[nodeIndex].start = right;
+		nodes[nodeIndex].count = -(axis + 1);
+		return nodeIndex;
+	}
+
+	static float area( const Eigen::AlignedBox3f & box )
+	{
+		if( box.isEmpty() ) return 0;
+		Eigen::Vector3f d = box.sizes();
+		return 2.0f * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+	}
+
+	// Bit mask of active rays whose segment [0,tfar] overlaps the node box
+	int hitMask( const Node & node, const Packet & p, int active ) const
+	{
+#ifdef FLATBVH_USE_SSE
+		__m128 tmin = _mm_setzero_ps();
+		__m128 tmax = _mm_loadu_ps( p.tfar );
+		for(int k = 0; k < 3; k++)
+		{
+			__m128 o = _mm_loadu_ps( p.org[k] ), inv = _mm_loadu_ps( p.inv[k] );
+			__m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps(node.bmin[k]), o ), inv );
+			__m128 t2 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps(node.bmax[k]), o ), inv );
+			tmin = _mm_max_ps( tmin, _mm_min_ps( t1, t2 ) );
+			tmax = _mm_min_ps( tmax, _mm_max_ps( t1, t2 ) );
+		}
+		return _mm_movemask_ps( _mm_cmple_ps( tmin, tmax ) ) & active;
+#else
+		int mask = 0;
+		for(int i = 0; i < PacketSize; i++)
+		{
+			if( !(active & (1 << i)) ) continue;
+			float tmin = 0, tmax = p.tfar[i];
+			for(int k = 0; k < 3; k++)
+			{
+				float t1 = (node.bmin[k] - p.org[k][i]) * p.inv[k][i];
+				float t2 = (node.bmax[k] - p.org[k][i]) * p.inv[k][i];
+				tmin = std::max( tmin, std::min(t1, t2) );
+				tmax = std::min( tmax, std::max(t1, t2) );
+			}
+			if( tmin <= tmax ) mask |= (1 << i);
+		}
+		return mask;
+#endif
+	}
+
+	// Moller-Trumbore, two sided, hits in (0, tfar)
+	static void intersectTriangle( const Triangle & tri, Packet & p, int i )
+	{
+		float dir[3] = { p.dir[0][i], p.dir[1][i], p.dir[2][i] };
+		float org[3] = { p.org[0][i], p.org[1][i], p.org[2][i] };
+
+		float pv[3] = { dir[1]*tri.e2[2] - dir[2]*tri.e2[1], dir[2]*tri.e2[0] - dir[0]*tri.e2[2], dir[0]*tri.e2[1] - dir[1]*tri.e2[0] };
+		float det = tri.e1[0]*pv[0] + tri.e1[1]*pv[1] + tri.e1[2]*pv[2];
+		if( std::abs(det) < 1e-12f ) return;
+		float invDet = 1.0f / det;
+
+		float tv[3] = { org[0] - tri.v0[0], org[1] - tri.v0[1], org[2] - tri.v0[2] };
+		float u = (tv[0]*pv[0] + tv[1]*pv[1] + tv[2]*pv[2]) * invDet;
+		if( u < 0.0f || u > 1.0f ) return;
+
+		float qv[3] = { tv[1]*tri.e1[2] - tv[2]*tri.e1[1], tv[2]*tri.e1[0] - tv[0]*tri.e1[2], tv[0]*tri.e1[1] - tv[1]*tri.e1[0] };
+		float v = (dir[0]*qv[0] + dir[1]*qv[1] + dir[2]*qv[2]) * invDet;
+		if( v < 0.0f || u + v > 1.0f ) return;
+
+		float t = (tri.e2[0]*qv[0] + tri.e2[1]*qv[1] + tri.e2[2]*qv[2]) * invDet;
+		if( t > 0.0f && t < p.tfar[i] ){
+			p.tfar[i] = t;
+			p.faceid[i] = tri.faceid;
+		}
+	}
+
+	void traverse( Packet & p, int active ) const
+	{
+		struct Entry{ int node, mask; };
+		Entry stack[StackSize];
+		int top = 0;
+		stack[top++] = Entry{ 0, active };
+
+		while( top > 0 )
+		{
+			Entry e = stack[--top];
+			const Node & node = nodes[e.node];
+
+			// Re-test since closer hits may have been found after this entry was pushed
+			int mask = hitMask( node, p, e.mask );
+			if( !mask ) continue;
+
+			if( node.isLeaf() )
+			{
+				for(int t = node.start; t < node.start + node.count; t++)
+					for(int i = 0; i < PacketSize; i++)
+						if( mask & (1 << i) ) intersectTriangle( triangles[t], p, i );
+				continue;
+			}
+
+			// Visit the near child first, judged by the first active ray
+			int axis = -node.count - 1, first = 0;
+			while( !(mask & (1 << first)) ) first++;
+			int nearChild = e.node + 1, farChild = node.start;
+			if( p.dir[axis][first] < 0 ) std::swap( nearChild, farChild );
+
+			stack[top++] = Entry{ farChild, mask };
+			stack[top++] = Entry{ nearChild, mask };
+		}
+	}
+};
+
+}
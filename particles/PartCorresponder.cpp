@@ -34,32 +34,34 @@ Slices PartCorresponder::computeSlices( ParticleMesh * input, const SegmentGraph
 
 	curSlices.resize( numLayers );
 
-	// Divide segment into layers
-	for(int i = 0; i < numLayers; i++)
-	{
-		int bottom = zcoords.minimum + (i * perLayer);
-		int top = bottom + perLayer;
+	// Divide segment into layers, in one pass over the edges. An edge belongs to a layer when both its ends do
+	std::vector<SegmentGraph> layerGraphs( numLayers );
 
-		SegmentGraph layerGraph;
-
-		for(auto & edge : seg.GetEdgesSet())
-		{
-			Vector3 pgi = (input->particles[edge.index].pos - input->grid.translation.cast<double>()) / input->grid.unitlength;
-			Vector3 pgj = (input->particles[edge.target].pos - input->grid.translation.cast<double>()) / input->grid.unitlength;
+	for(auto & edge : seg.GetEdgesSet())
+	{
+		Vector3 pgi = (input->particles[edge.index].pos - input->grid.translation.cast<double>()) / input->grid.unitlength;
+		Vector3 pgj = (input->particles[edge.target].pos - input->grid.translation.cast<double>()) / input->grid.unitlength;
 
-			int zi = (int)pgi.z(), zj = (int)pgj.z();
+		int zi = (int)pgi.z(), zj = (int)pgj.z();
 
-			if((zi < bottom || zj < bottom) || (zi >= top || zj >= top)) continue;
+		int layer = (zi - zcoords.minimum) / perLayer;
+		if( layer != (zj - zcoords.minimum) / perLayer ) continue;
 
-			if(zi >= bottom && zi < top) layerGraph.AddVertex(edge.index);
-			if(zj >= bottom && zj < top) layerGraph.AddVertex(edge.target);
+		auto & layerGraph = layerGraphs[layer];
+		layerGraph.AddVertex(edge.index);
+		layerGraph.AddVertex(edge.target);
+		layerGraph.AddEdge( edge.index, edge.target, 1 );
+	}
 
-			layerGraph.AddEdge( edge.index, edge.target, 1 );
-		}
+	for(int i = 0; i < numLayers; i++)
+	{
+		auto & layerGraph = layerGraphs[i];
 
 		if( layerGraph.vertices.empty() ) continue;
 
 		auto & slice = curSlices[i];
+		slice.bottom = zcoords.minimum + (i * perLayer);
+		slice.top = slice.bottom + perLayer;
 		slice.chunksFromGraphs( layerGraph.toConnectedParts() );
 
 		// Compute chunks parameters
@@ -90,47 +92,94 @@ Slices PartCorresponder::computeSlices( ParticleMesh * input, const SegmentGraph
 	return goodSlices;
 }
 
+// Identifies the particles (and grid) a segment's slices are made from
+static quint64 sliceStamp( ParticleMesh * input, const SegmentGraph & seg )
+{
+	quint64 h = 14695981039346656037ULL;
+	auto mix = [&]( const void * data, size_t size ){
+		auto bytes = (const unsigned char *)data;
+		for(size_t i = 0; i < size; i++){ h ^= bytes[i]; h *= 1099511628211ULL; }
+	};
+
+	mix( &input->grid.unitlength, sizeof(input->grid.unitlength) );
+	mix( input->grid.translation.data(), sizeof(input->grid.translation[0]) * 3 );
+
+	for(auto v : seg.vertices){
+		mix( &v, sizeof(v) );
+		mix( input->particles[v].pos.data(), sizeof(double) * 3 );
+	}
+
+	return h;
+}
+
+void PartCorresponder::indexSlices( ParticleMesh * input, const Segments & segments )
+{
+	auto & index = input->sliceIndex;
+
+	for(auto sid : index.segments.keys())
+		if( !segments.contains(sid) ) index.segments.remove(sid);
+
+	for(auto it = segments.constBegin(); it != segments.constEnd(); ++it)
+	{
+		quint64 stamp = sliceStamp( input, it.value() );
+		if( index.contains(it.key(), stamp) ) continue;
+
+		index.insert( it.key(), stamp, computeSlices(input, it.value()) );
+	}
+}
+
 void PartCorresponder::correspondSegments(const QPair<size_t,size_t> & segmentsPair, 
 										  const QVector<ParticleMesh *> & input, 
 										  QVector<Particles> & particles)
 {
-	QVector<Slices> slices;
+	applyMatches( matchSegments(segmentsPair, input), particles );
+}
+
+ParticleMatches PartCorresponder::matchSegments(const QPair<size_t,size_t> & segmentsPair, const QVector<ParticleMesh *> & input)
+{
+	ParticleMatches matches;
 
-	auto segs1 = input[0]->property["segments"].value<Segments>();
-	auto segs2 = input[1]->property["segments"].value<Segments>();
+	// Slices are read from the index in place, the few that get marked or split are copied first
+	const Slices * slices[] = { &input[0]->sliceIndex.slices( segmentsPair.first ), &input[1]->sliceIndex.slices( segmentsPair.second ) };
+	QMap<int, Slice> edited[2];
 
-	slices << segs1[segmentsPair.first].property["slices"].value<Slices>();
-	slices << segs2[segmentsPair.second].property["slices"].value<Slices>();
+	auto sliceAt = [&]( int side, int id ) -> const Slice & {
+		auto it = edited[side].constFind( id );
+		return it != edited[side].constEnd() ? *it : slices[side]->at( id );
+	};
+	auto editSlice = [&]( int side, int id ) -> Slice & {
+		if( !edited[side].contains( id ) ) edited[side].insert( id, slices[side]->at( id ) );
+		return edited[side][id];
+	};
 
 	auto ii = 0, ij = 1;
 
 	// i has more slices than j
-	bool isSwap = slices[ii].size() < slices[ij].size();
+	bool isSwap = slices[ii]->size() < slices[ij]->size();
 
 	/// Correspond chunks:
 	{
 		if( isSwap ) std::swap(ii, ij);
 
-		for(size_t sliceID = 0; sliceID < slices[ii].size(); sliceID++)
+		for(size_t sliceID = 0; sliceID < slices[ii]->size(); sliceID++)
 		{
-			auto & slice_i = slices[ii][sliceID];
-			double a = double(sliceID) / std::max(1, (slices[ii].size()-1));
-			int j_idx =  std::ceil(a * (slices[ij].size()-1));
-			auto & slice_j = slices[ij][j_idx];
+			double a = double(sliceID) / std::max(1, (slices[ii]->size()-1));
+			int j_idx =  std::ceil(a * (slices[ij]->size()-1));
 
-			/// First project chunks onto diagonal of their slice
-			QVector< QVector< size_t > > sortedChunks;
+			// Slice of each shape
+			int ids[2];
+			ids[ii] = sliceID;
+			ids[ij] = j_idx;
 
-			QVector<Slice*> bothSlices;
-			bothSlices << &slice_i << &slice_j;
-			if( isSwap ) std::reverse(bothSlices.begin(), bothSlices.end());
+			const Slice & slice_i = sliceAt(ii, ids[ii]);
+			const Slice & slice_j = sliceAt(ij, ids[ij]);
 
 			// Most basic case, a single chunk matches with another
 			if( slice_i.chunks.size() == 1 && slice_j.chunks.size() == 1 )
 			{
 				QVector<SliceChunk> chunks;
 				chunks << slice_i.chunks.front() << slice_j.chunks.front();
-				matchChunk( chunks, input, particles );
+				matchChunk( chunks, input, matches );
 				continue;
 			}
 
@@ -140,11 +189,11 @@ void PartCorresponder::correspondSegments(const QPair<size_t,size_t> & segmentsP
 
 			for(size_t shapei = 0; shapei < input.size(); shapei++)
 			{
-				auto & slice = bothSlices[shapei];
-				if(slice->chunks.size() < 3) continue;
+				const Slice & slice = sliceAt(shapei, ids[shapei]);
+				if(slice.chunks.size() < 3) continue;
 
-				Eigen::MatrixXd points( slice->chunks.size(), 3 ); size_t r = 0;
-				for(auto & chunk : slice->chunks) points.row(r++) = chunk.box.center();
+				Eigen::MatrixXd points( slice.chunks.size(), 3 ); size_t r = 0;
+				for(auto & chunk : slice.chunks) points.row(r++) = chunk.box.center();
 				Vector3 b_center (points.colwise().mean());
 				points = points.rowwise() - b_center.transpose();
 				Eigen::JacobiSVD<Eigen::MatrixXd> svd(points, Eigen::ComputeThinU | Eigen::ComputeThinV);
@@ -154,21 +203,21 @@ void PartCorresponder::correspondSegments(const QPair<size_t,size_t> & segmentsP
 				if(ratio > grid_spread_threshold)
 				{
 					isGrid2D = true;
-					slice->isGrid2D = true;
+					if( !slice.isGrid2D ) editSlice(shapei, ids[shapei]).isGrid2D = true;
 				}
 			}
 
 			// Split 1D grids along the 'y' axis when matching against 2D grids
 			if( isGrid2D )
 			{
-				for(size_t i = 0; i < bothSlices.size(); i++)
+				for(size_t i = 0; i < input.size(); i++)
 				{
-					auto & slice = bothSlices[i];
-					if(slice->isGrid2D) continue; // no splits needed
+					const Slice & slice = sliceAt(i, ids[i]);
+					if(slice.isGrid2D) continue; // no splits needed
 
 					QVector<SliceChunk> splitChunks;
 					
-					for(auto & oldChunk : slice->chunks)
+					for(auto & oldChunk : slice.chunks)
 					{
 						auto halves = splitBox( oldChunk.box, Vector3::UnitY() );
 
@@ -189,8 +238,8 @@ void PartCorresponder::correspondSegments(const QPair<size_t,size_t> & segmentsP
 							chunk.tree = QSharedPointer<NanoKdTree>(new NanoKdTree);
 							for(auto v : chunk.g.vertices)
 							{
-								particles[i][v].relativePos = (particles[i][v].pos - chunk.box.min()).array() / chunk.box.sizes().array();
-								chunk.tree->addPoint( particles[i][v].relativePos );
+								Vector3 relativePos = (input[i]->particles[v].pos - chunk.box.min()).array() / chunk.box.sizes().array();
+								chunk.tree->addPoint( relativePos );
 								chunk.vmap.push_back( v );
 							}
 							chunk.tree->build();
@@ -200,20 +249,56 @@ void PartCorresponder::correspondSegments(const QPair<size_t,size_t> & segmentsP
 					}
 
 					// Replace slice's chunks with newly split ones
-					slice->chunks = splitChunks;
+					editSlice(i, ids[i]).chunks = splitChunks;
 				}
 			}
 
 			QVector< QVector<SliceChunk> > gridChunks;
-			gridChunks << bothSlices.front()->chunks << bothSlices.back()->chunks;
+			gridChunks << sliceAt(0, ids[0]).chunks << sliceAt(1, ids[1]).chunks;
 
-			matchGridChunk(gridChunks, isGrid2D, input, particles);
+			matchGridChunk(gridChunks, isGrid2D, input, matches);
 		}
 	}
+
+	return matches;
+}
+
+void PartCorresponder::applyMatches(const ParticleMatches & matches, QVector<Particles> & particles)
+{
+	for(auto & m : matches)
+	{
+		auto si = m.side, sj = (si+1) % 2;
+
+		auto vi = std::min(m.i, particles[si].size() - 1);
+		auto vj = std::min(m.j, particles[sj].size() - 1);
+
+		auto pi = &particles[si][vi];
+		auto pj = &particles[sj][vj];
+
+		if( pi->isMatched )
+		{
+			particles[si].push_back( *pi );
+			pi = &particles[si].back();
+			pi->id = particles[si].size()-1;
+		}
+
+		if( pj->isMatched )
+		{
+			particles[sj].push_back( *pj );
+			pj = &particles[sj].back();
+			pj->id = particles[sj].size()-1;
+		}
+
+		pi->correspondence = pj->id;
+		pj->correspondence = pi->id;
+
+		pj->isMatched = true;
+		pi->isMatched = true;
+	}
 }
 
 void PartCorresponder::matchGridChunk(const QVector< QVector<SliceChunk> > & chunk, bool isGrid2D,
-									  const QVector<ParticleMesh *> & input, QVector<Particles> & particles)
+									  const QVector<ParticleMesh *> & input, ParticleMatches & matches)
 {
 	if( !isGrid2D )
 	{
@@ -232,7 +317,7 @@ void PartCorresponder::matchGridChunk(const QVector< QVector<SliceChunk> > & chu
 		}
 
 		// match 1D grid chunks
-		match1DGridChunk( sorted, input, particles );
+		match1DGridChunk( sorted, input, matches );
 	}
 	else
 	{		
@@ -269,12 +354,12 @@ void PartCorresponder::matchGridChunk(const QVector< QVector<SliceChunk> > & chu
 			for(int i = 0; i < input.size(); i++)
 				row.push_back( splitRows[i][r] );
 
-			matchGridChunk(row, false, input, particles);
+			matchGridChunk(row, false, input, matches);
 		}
 	}
 }
 
-void PartCorresponder::match1DGridChunk( QVector< QVector<SliceChunk> > sortedChunk, const QVector<ParticleMesh *> & input, QVector<Particles> & particles )
+void PartCorresponder::match1DGridChunk( QVector< QVector<SliceChunk> > sortedChunk, const QVector<ParticleMesh *> & input, ParticleMatches & matches )
 {
 	QVector< QVector<SliceChunk> > readyChunkPairs;
 
@@ -290,10 +375,10 @@ void PartCorresponder::match1DGridChunk( QVector< QVector<SliceChunk> > sortedCh
 		{
 			QVector<SliceChunk> chunkPairs;
 			if( sortedChunkFront.size() == 1 ) chunkPairs.push_back( sortedChunkFront.front() );
-			else chunkPairs.push_back( mergeChunks( sortedChunkFront, input.front(), particles.front() ) );
+			else chunkPairs.push_back( mergeChunks( sortedChunkFront, input.front() ) );
 
 			if( sortedChunkBack.size() == 1) chunkPairs.push_back( sortedChunkBack.front() );
-			else chunkPairs.push_back( mergeChunks( sortedChunkBack, input.back(), particles.back() ) );
+			else chunkPairs.push_back( mergeChunks( sortedChunkBack, input.back() ) );
 
 			readyChunkPairs.push_back( chunkPairs );
 		}
@@ -319,10 +404,10 @@ void PartCorresponder::match1DGridChunk( QVector< QVector<SliceChunk> > sortedCh
 
 	// Match each pair of chunks
 	for(auto & pairChunk : readyChunkPairs)
-		matchChunk(pairChunk, input, particles);
+		matchChunk(pairChunk, input, matches);
 }
 
-void PartCorresponder::matchChunk( QVector<SliceChunk> chunk, const QVector<ParticleMesh *> & input, QVector<Particles> & particles )
+void PartCorresponder::matchChunk( QVector<SliceChunk> chunk, const QVector<ParticleMesh *> & input, ParticleMatches & matches )
 {
 	for(size_t si = 0; si < input.size(); si++)
 	{
@@ -330,55 +415,22 @@ void PartCorresponder::matchChunk( QVector<SliceChunk> chunk, const QVector<Part
 
 		if(chunk[si].vmap.empty() || chunk[sj].vmap.empty()) continue;
 
-		std::vector<size_t> closestMap( chunk[si].vmap.size(), -1 );
-
-		// Find closest particle
-		for(int i = 0; i < (int)chunk[si].vmap.size(); i++)
-		{
-			auto vi = chunk[si].vmap[i];
-			vi = std::min(vi, particles[si].size() - 1);
-
-			auto vj = chunk[sj].vmap[chunk[sj].tree->closest(particles[si][vi].relativePos)];
-
-			closestMap[i] = vj;
-		}
-
-		// Match particles one-to-one
+		// Find closest particle, by position relative to each chunk's box as stored in its tree
 		for(int i = 0; i < (int)chunk[si].vmap.size(); i++)
 		{
 			auto vi = chunk[si].vmap[i];
-			vi = std::min(vi, particles[si].size() - 1);
-
-			auto vj = closestMap[i];
-			vj = std::min(vj, particles[sj].size() - 1);
-
-			auto pi = &particles[si][vi];
-			auto pj = &particles[sj][vj];
-
-			if( pi->isMatched )
-			{
-				particles[si].push_back( *pi );
-				pi = &particles[si].back();
-				pi->id = particles[si].size()-1;
-			}
-
-			if( pj->isMatched )
-			{
-				particles[sj].push_back( *pj );
-				pj = &particles[sj].back();
-				pj->id = particles[sj].size()-1;
-			}
+			vi = std::min(vi, input[si]->particles.size() - 1);
 
-			pi->correspondence = pj->id;
-			pj->correspondence = pi->id;
+			auto vj = chunk[sj].vmap[chunk[sj].tree->closest(chunk[si].tree->cloud.pts[i])];
+			vj = std::min(vj, input[sj]->particles.size() - 1);
 
-			pj->isMatched = true;
-			pi->isMatched = true;
+			ParticleMatch m = { (int)si, vi, vj };
+			matches.push_back( m );
 		}
 	}
 }
 
-SliceChunk PartCorresponder::mergeChunks(const QVector<SliceChunk> & chunks, ParticleMesh * input, Particles & particles)
+SliceChunk PartCorresponder::mergeChunks(const QVector<SliceChunk> & chunks, ParticleMesh * input)
 {
 	SliceChunk chunk;
 	if(chunks.empty()) return chunk;
@@ -412,7 +464,7 @@ SliceChunk PartCorresponder::mergeChunks(const QVector<SliceChunk> & chunks, Par
 	{
 		for(auto v : chunks[ci].g.vertices)
 		{
-			auto p = particles[v].pos - delta;
+			auto p = input->particles[v].pos - delta;
 			packedPoints.push_back( p );
 
 			chunk.box.extend( p + halfVoxel );
@@ -434,7 +486,6 @@ SliceChunk PartCorresponder::mergeChunks(const QVector<SliceChunk> & chunks, Par
 	{
 		Vector3 relativePos = (packedPoints[i] - chunk.box.min()).array() / chunk.box.sizes().array();
 		chunk.tree->addPoint( relativePos );
-		particles[chunk.vmap[i]].relativePos = relativePos;
 	}
 	chunk.tree->build();
 
@@ -4,51 +4,39 @@
 
 #include <NanoKdTree.h>
 
-extern int slice_uid;
-struct SliceChunk{
-	Eigen::AlignedBox3d box;
-	SegmentGraph g;
-	QSharedPointer<NanoKdTree> tree;
-	std::vector<size_t> vmap;
-	SliceChunk(const SegmentGraph & graph = SegmentGraph()) : g(graph), uid(slice_uid++) {}
-	int uid;
-	QMap<QString,QVariant> property;
-};
-
-struct Slice{
-	QVector<SliceChunk> chunks;
-	void chunksFromGraphs(const std::vector<SegmentGraph> & graphs){
-		for(auto & graph : graphs)
-			chunks.push_back( SliceChunk(graph) );
-	}
-	Slice() : isGrid2D(false){}
-	bool isGrid2D;
-	Eigen::AlignedBox3d box(){ Eigen::AlignedBox3d b; for(auto & c : chunks) b.extend(c.box); return b; }
-};
-typedef QVector<Slice> Slices;
-
 Q_DECLARE_METATYPE( Segments );
 Q_DECLARE_METATYPE( Slices );
 Q_DECLARE_METATYPE( Eigen::AlignedBox3d );
 
+// Particle 'i' of shape 'side' matched to particle 'j' of the other shape, see 'applyMatches'
+struct ParticleMatch{ int side; size_t i, j; };
+typedef std::vector<ParticleMatch> ParticleMatches;
+
 class PartCorresponder
 {
 public:
 	static Slices computeSlices( ParticleMesh * input, const SegmentGraph & seg );
 
+	// Slices the segments of 'input' that its slice index misses or holds for other particles
+	static void indexSlices( ParticleMesh * input, const Segments & segments );
+
 	static void correspondSegments( const QPair<size_t,size_t> & segmentsPair, 
 		const QVector<ParticleMesh *> & input, QVector<Particles> & particles );
 
+	// Matches of a segment pair in the order they are applied, only reads the input
+	static ParticleMatches matchSegments( const QPair<size_t,size_t> & segmentsPair, const QVector<ParticleMesh *> & input );
+	static void applyMatches( const ParticleMatches & matches, QVector<Particles> & particles );
+
 	static void matchChunk( QVector<SliceChunk> chunk, const QVector<ParticleMesh *> & input, 
-		QVector<Particles> & particles );
+		ParticleMatches & matches );
 
 	static void matchGridChunk(const QVector< QVector<SliceChunk> > & chunk, 
-		bool isGrid2D, const QVector<ParticleMesh *> & input, QVector<Particles> & particles);
+		bool isGrid2D, const QVector<ParticleMesh *> & input, ParticleMatches & matches);
 
 	static void match1DGridChunk( QVector< QVector<SliceChunk> > chunk, const QVector<ParticleMesh *> & input, 
-		QVector<Particles> & particles );
+		ParticleMatches & matches );
 
 	// helpers:
-	static SliceChunk mergeChunks( const QVector<SliceChunk> & chunks, ParticleMesh * input, Particles & particles );
+	static SliceChunk mergeChunks( const QVector<SliceChunk> & chunks, ParticleMesh * input );
 	static QVector< QPair<int,int> > distributeVectors(int x, int y);
 };
@@ -9,6 +9,12 @@
 #include "spherelib.h"
 #include "disjointset.h"
 
+#include <QElapsedTimer>
+#include <map>
+#include <iterator>
+
+#include "mc.h"
+
 Q_DECLARE_METATYPE(Eigen::Vector3d)
 
 QVector<QColor> ParticleMesh::rndcolors = rndColors2(10000);
@@ -88,7 +94,6 @@ ParticleMesh::ParticleMesh(QString mesh_filename, int gridsize) : surface_mesh(N
 	grid.unitlength = 1.0 / grid.gridsize;
 	grid.translation = Eigen::Vector3f(0,0,0);
 	grid.occupied.clear();
-	grid.occupied.resize( pow(gridsize,3), EMPTY_VOXEL );
 
 	/// Go over voxelization of all parts
 	for(size_t i = 0; i < parts.size(); i++)
@@ -117,7 +122,7 @@ ParticleMesh::ParticleMesh(QString mesh_filename, int gridsize) : surface_mesh(N
 			grid.data.push_back(voxel);
 			grid.data.back().color[0] = i; // hijacking color to record segment ID
 
-			grid.occupied[voxel.morton] = FULL_VOXEL;
+			grid.occupied.set(voxel.morton);
 		}
 	}
 
@@ -135,6 +140,7 @@ ParticleMesh::ParticleMesh(QString mesh_filename, int gridsize) : surface_mesh(N
 void ParticleMesh::init( bool isAssignedSegment )
 {
 	// Insert particles
+	mortonToParticleID.reserve( grid.data.size() );
 	for( auto & voxel : grid.data )
 	{
 		Eigen::Vector3f point = grid.voxelPos(voxel.morton);
@@ -143,13 +149,15 @@ void ParticleMesh::init( bool isAssignedSegment )
 
 		particle.id = particles.size();
 		particle.morton = voxel.morton;
-		mortonToParticleID[voxel.morton] = particle.id;
+		mortonToParticleID.insert( voxel.morton, particle.id );
 
 		if( isAssignedSegment ) particle.segment = voxel.color[0];
 
 		particles.push_back( particle );
 	}
 
+	updateColumns();
+
 	grid.findOccupied();
 
 	// Cache adjacency
@@ -171,7 +179,7 @@ void ParticleMesh::init( bool isAssignedSegment )
 Eigen::AlignedBox3d ParticleMesh::bbox()
 {
 	Eigen::AlignedBox3d box;
-	for(auto & p : particles) box.extend(p.pos);
+	for(auto & pos : columns.position) box.extend(pos);
 	return box;
 }
 
@@ -376,6 +384,8 @@ void ParticleMesh::distort()
 		for(auto & v : seg.vertices)
 			particles[v].pos += delta;
 	}
+
+	updateColumns();
 }
 
 ParticleMesh::~ParticleMesh()
@@ -390,27 +400,27 @@ SegmentGraph ParticleMesh::toGraph( SegmentGraph::vertices_set selected ) const
 	int eidx = 0;
 	std::vector<size_t> pindices;
 
+	const auto & position = columns.position;
+
 	NanoKdTree tree;
-	for(auto & p : particles) 
+	for(size_t pid = 0; pid < position.size(); pid++) 
 	{
 		bool isInclude = true;
 
-		if(!selected.empty() && selected.find(p.id) == selected.end()) 
+		if(!selected.empty() && selected.find(pid) == selected.end()) 
 			isInclude = false;
 
 		if( isInclude ){
-			tree.addPoint(p.pos);
-			pindices.push_back(p.id);
+			tree.addPoint(position[pid]);
+			pindices.push_back(pid);
 		}
 	}
 	tree.build();
 
 	for(auto & pid : pindices)
 	{
-		auto & p = particles[pid];
-
 		KDResults matches;
-		tree.ball_search(p.pos, grid.unitlength*1.01, matches);
+		tree.ball_search(position[pid], grid.unitlength*1.01, matches);
 		matches.erase(matches.begin()); // remove self
 
 		for(auto match : matches)
@@ -418,13 +428,46 @@ SegmentGraph ParticleMesh::toGraph( SegmentGraph::vertices_set selected ) const
 			double edge_weight = 1.0;
 			double d2 = match.second;
 			edge_weight = d2 /*std::sqrt(d2)*/;
-			graph.AddEdge( uint(p.id), uint(match.first), edge_weight, eidx++ );
+			graph.AddEdge( uint(pid), uint(match.first), edge_weight, eidx++ );
 		}
 	}
 
 	return graph;
 }
 
+ParticleGraph ParticleMesh::toCSRGraph( SegmentGraph::vertices_set selected ) const
+{
+	std::vector<ParticleGraph::EdgeRecord> edges;
+	std::vector<size_t> pindices;
+
+	const auto & position = columns.position;
+
+	NanoKdTree tree;
+	for(size_t pid = 0; pid < position.size(); pid++) 
+	{
+		if(!selected.empty() && selected.find(pid) == selected.end()) continue;
+
+		tree.addPoint(position[pid]);
+		pindices.push_back(pid);
+	}
+	tree.build();
+
+	for(auto & pid : pindices)
+	{
+		KDResults matches;
+		tree.ball_search(position[pid], grid.unitlength*1.01, matches);
+		matches.erase(matches.begin()); // remove self
+
+		for(auto match : matches)
+		{
+			ParticleGraph::EdgeRecord e = { ParticleGraph::vertex_t(pid), ParticleGraph::vertex_t(pindices[match.first]), match.second };
+			edges.push_back(e);
+		}
+	}
+
+	return ParticleGraph::fromEdges( particles.size(), edges );
+}
+
 std::vector< double > ParticleMesh::agd( int numStartPoints, SegmentGraph graph ) const
 {
 	if( graph.vertices.empty() ) graph = toGraph();
@@ -432,6 +475,24 @@ std::vector< double > ParticleMesh::agd( int numStartPoints, SegmentGraph graph
 	std::vector<size_t> vertex_pool;
 	for(auto v : graph.vertices) vertex_pool.push_back(v);
 
+	// Compact copy with unit weights, shared by all threads
+	std::map<size_t,size_t> vmap;
+	for(size_t i = 0; i < vertex_pool.size(); i++) vmap[vertex_pool[i]] = i;
+
+	std::vector<ParticleGraph::EdgeRecord> edges;
+	for(auto e : graph.GetEdgesSet()){
+		ParticleGraph::EdgeRecord r = { ParticleGraph::vertex_t(vmap[e.index]), ParticleGraph::vertex_t(vmap[e.target]), 1.0 };
+		edges.push_back(r);
+	}
+
+	std::vector<size_t> local_pool( vertex_pool.size() );
+	for(size_t i = 0; i < vertex_pool.size(); i++) local_pool[i] = i;
+
+	return agd( numStartPoints, ParticleGraph::fromEdges(vertex_pool.size(), edges), local_pool );
+}
+
+std::vector< double > ParticleMesh::agd( int numStartPoints, const ParticleGraph & graph, const std::vector<size_t> & vertex_pool ) const
+{
 	std::vector<double> sum_distances( vertex_pool.size(), 0.0 );
 
 	// Random staring points
@@ -453,19 +514,24 @@ std::vector< double > ParticleMesh::agd( int numStartPoints, SegmentGraph graph
 	else
 		for(size_t i = 0; i < vertex_pool.size(); i++) v.push_back( vertex_pool[i] );
 
-	// Sum distances to other
-	#pragma omp parallel for
-	for(int pi = 0; pi < (int)v.size(); pi++)
+	// Sum distances to other, graph is shared and each thread keeps its own scratch
+	#pragma omp parallel
 	{
-		SegmentGraph curGraph;
-		std::map<size_t,size_t> vmap;
-		for(auto v : graph.vertices) vmap[v] = vmap.size();
-		for(auto e : graph.GetEdgesSet()) curGraph.AddEdge( vmap[e.index], vmap[e.target], 1 );
+		ParticlePaths paths;
+		std::vector<double> partial_sum( vertex_pool.size(), 0.0 );
 
-		curGraph.DijkstraComputePaths( vmap[v[pi]] );
+		#pragma omp for
+		for(int pi = 0; pi < (int)v.size(); pi++)
+		{
+			paths.compute( graph, ParticleGraph::vertex_t(v[pi]) );
 
+			for(size_t pj = 0; pj < vertex_pool.size(); pj++)
+				partial_sum[pj] += paths.distance[ vertex_pool[pj] ];
+		}
+
+		#pragma omp critical
 		for(size_t pj = 0; pj < vertex_pool.size(); pj++)
-			sum_distances[pj] += curGraph.min_distance[ pj ];
+			sum_distances[pj] += partial_sum[pj];
 	}
 
 	// Average
@@ -549,20 +615,24 @@ void ParticleMesh::computeDistanceToFloor()
 		p.flag = ParticleFlags::FLOOR;
 	}
 
-	auto g = toGraph();
-	g.DijkstraComputePathsMany( sources );
+	updateColumns();
+
+	auto g = toCSRGraph();
+	ParticlePaths paths;
+	paths.compute( g, std::vector<ParticleGraph::vertex_t>(sources.begin(), sources.end()) );
+	auto & min_distance = paths.distance;
 
-	double minVal = *std::min_element(g.min_distance.begin(),g.min_distance.end());
-	auto tipPoint = std::max_element(g.min_distance.begin(),g.min_distance.end());
+	double minVal = *std::min_element(min_distance.begin(),min_distance.end());
+	auto tipPoint = std::max_element(min_distance.begin(),min_distance.end());
 	double maxVal = *tipPoint;
 	double range = maxVal - minVal;
 
 	// Normalize
 	for(auto & p : particles)
-		p.measure = (g.min_distance[p.id] - minVal) / range;
+		p.measure = (min_distance[p.id] - minVal) / range;
 
 	// Keep a path from ground to furthest tip point
-	auto path = g.DijkstraGetShortestPathsTo( tipPoint - g.min_distance.begin() );
+	auto path = paths.pathTo( ParticleGraph::vertex_t(tipPoint - min_distance.begin()) );
 
 	for(auto p : path) if(p < particles.size()) pathFromFloor.push_back(p);
 
@@ -769,7 +839,7 @@ std::vector<size_t> ParticleMesh::neighbourhood( Particle<Vector3> & p, int step
 		toSee.pop();
 		visisted.insert(current);
 
-		mortonDecode(particles[current].morton, x, y, z);
+		mortonDecode(columns.morton[current], x, y, z);
 
 		for(int u = -1; u <= 1; u++){
 			for(int v = -1; v <= 1; v++){
@@ -808,9 +878,10 @@ std::vector< std::pair< double, size_t > > ParticleMesh::closestParticles(const
 
 	std::vector< DistParticleID > result;
 
-	for(auto & p : particles){
-		double dist = (p.pos-point).norm();
-		if(dist <= threshold) result.push_back( std::make_pair(dist, p.id) );
+	const auto & position = columns.position;
+	for(size_t pid = 0; pid < position.size(); pid++){
+		double dist = (position[pid]-point).norm();
+		if(dist <= threshold) result.push_back( std::make_pair(dist, pid) );
 	}
 
 	std::sort( result.begin(), result.end(), [](const DistParticleID& a, const DistParticleID & b){ return a.first < b.first; } );
@@ -822,8 +893,9 @@ void ParticleMesh::cluster( int K, const std::vector<size_t> & seeds, bool use_l
 {
 	if(!particles.size()) return;
 
-	// Clustering engine:
-	clustering::kmeans< std::vector< VectorFloat >, clustering::lpnorm< VectorFloat > > km(desc, K, clustering::KmeansInitPlusPlus);
+	// Clustering engine, works on its own copy of the rows:
+	std::vector< VectorFloat > rows = desc.toRows();
+	clustering::kmeans< std::vector< VectorFloat >, clustering::lpnorm< VectorFloat > > km(rows, K, clustering::KmeansInitPlusPlus);
 
 	// Distance measure:
 	if(use_l1_norm) clustering::lpnorm_p = 1;
@@ -833,7 +905,7 @@ void ParticleMesh::cluster( int K, const std::vector<size_t> & seeds, bool use_l
 	if( seeds.size() )
 	{
 		km._centers.clear();
-		for(auto pid : seeds) km._centers.push_back( desc[pid] );
+		for(auto pid : seeds) km._centers.push_back( rows[pid] );
 	}
 
 	// [DEBUG] seed points
@@ -994,7 +1066,7 @@ std::vector<size_t> ParticleMesh::specialSeeding( SeedType seedType, int K, Segm
 		QMap<double,size_t> descParticle;
 		for(auto particleID : selected)
 		{
-			auto d = Eigen::Map<Eigen::VectorXf>(&desc[particleID][0], desc[particleID].size());
+			auto d = desc.rowMap(particleID);
 			descParticle[ d.norm() * this->particles[particleID].flat ] = particleID;
 		}
 		QVector<size_t> sorted = descParticle.values().toVector();
@@ -1026,7 +1098,7 @@ SurfaceMeshModel * ParticleMesh::meshPoints( std::vector<Vector3> points, Eigen:
 	auto unitlength = grid.unitlength;
 	size_t gridsize = grid.gridsize;
 
-	std::vector<char> occupied(pow(gridsize,3), EMPTY_VOXEL);
+	SparseOccupancy occupied;
 	std::set<uint64_t> voxels;
 
 	for(const auto & point : points)
@@ -1037,7 +1109,7 @@ SurfaceMeshModel * ParticleMesh::meshPoints( std::vector<Vector3> points, Eigen:
 		if(!grid.isValidGridPoint(gridpnt)) continue;
 		uint64_t m = mortonEncode_LUT(gridpnt.z(),gridpnt.y(),gridpnt.x());
 
-		occupied[m] = FULL_VOXEL;
+		occupied.set(m);
 		voxels.insert(m);
 
 		// Anisotropic voxels  
@@ -1049,7 +1121,7 @@ SurfaceMeshModel * ParticleMesh::meshPoints( std::vector<Vector3> points, Eigen:
 				if(!grid.isValidGridPoint(gp)) continue;
 
 				uint64_t mi = mortonEncode_LUT(gp.z(),gp.y(),gp.x());
-				occupied[mi] = FULL_VOXEL;
+				occupied.set(mi);
 				voxels.insert(mi);
 			}
 		}
@@ -1136,7 +1208,7 @@ Vector3 ParticleMesh::mainDirection( size_t particleID )
 	{
 		if(isVisisted[antiRays[idx]]) continue;
 		isVisisted[antiRays[idx]] = true;
-		auto & pdesc = desc[particleID];
+		const float * pdesc = desc.row(particleID);
 
 		auto diam = pdesc[idx] + pdesc[antiRays[idx]];
 		if(diam > maxDiam)
@@ -1163,7 +1235,7 @@ void ParticleMesh::serialize(QDataStream& os) const
 	for(auto & p : particles) os << p;
 
 	// Descriptors
-	for(auto & p : particles) os << desc[p.id]; 
+	for(auto & p : particles) os << desc.rowVector(p.id); 
 
 	// Grid
 	os << grid.gridsize << grid.unitlength << grid.translation;
@@ -1174,6 +1246,9 @@ void ParticleMesh::serialize(QDataStream& os) const
 	// Reflectional symmetry
 	os << reflectionPlanes.size();
 	for(auto p : reflectionPlanes) os << p.pos << p.n;
+
+	// Slices of segments
+	os << sliceIndex;
 }
 
 void ParticleMesh::deserialize(QDataStream& is)
@@ -1181,9 +1256,21 @@ void ParticleMesh::deserialize(QDataStream& is)
 	size_t particleCount;
 	is >> particleCount;
 	particles.resize(particleCount);
-	desc.resize(particleCount);
 	for(size_t i = 0; i < particleCount; i++) is >> particles[i];
-	for(size_t i = 0; i < particleCount; i++) is >> desc[i];
+
+	std::vector< std::vector<float> > rows(particleCount);
+	for(size_t i = 0; i < particleCount; i++) is >> rows[i];
+	desc = DescriptorMatrix::fromRows(rows);
+
+	mortonToParticleID.clear();
+	mortonToParticleID.reserve(particleCount);
+	grid.occupied.clear();
+	for(auto & p : particles){
+		mortonToParticleID.insert( p.morton, p.id );
+		grid.occupied.set( p.morton );
+	}
+	updateColumns();
+
 	is >> grid.gridsize >> grid.unitlength >> grid.translation;
 
 	is >> sphereResolutionUsed;
@@ -1199,6 +1286,10 @@ void ParticleMesh::deserialize(QDataStream& is)
 		reflectionPlanes.push_back( Plane(pos, n, 1) );
 	}
 
+	// Slices of segments, missing from older files
+	sliceIndex.clear();
+	if( !is.atEnd() ) is >> sliceIndex;
+
 	// Bounds
 	auto box = bbox();
 	bbox_min = box.min();
@@ -1268,12 +1359,191 @@ void ParticleMesh::centerInsideGrid( bool isNormalizeAndCenter )
 
 		grid.data.push_back( VoxelData<Eigen::Vector3f>(p.morton,false) );
 
-		mortonToParticleID[p.morton] = p.id;
+		mortonToParticleID.insert( p.morton, p.id );
 	}
 
+	updateColumns();
+
 	grid.findOccupied();
 }
 
+void ParticleMesh::averageNeighbourDescriptors( int iterations )
+{
+	int n = (int)particles.size(), gridsize = grid.gridsize;
+	if( !n || iterations < 1 || desc.rows() != particles.size() ) return;
+	if( columns.size() != particles.size() ) updateColumns();
+
+	// Occupied voxels among the 26 around each particle, gathered once for all iterations
+	std::vector<size_t> offsets( n + 1, 0 ), neighbours;
+	neighbours.reserve( n * 26 );
+
+	for(int pi = 0; pi < n; pi++)
+	{
+		grid.occupied.forEachNeighbour(columns.morton[pi], gridsize, [&](uint64_t mcode){
+			size_t nj = mortonToParticleID.find( mcode );
+			if(nj != MortonHash::npos()) neighbours.push_back( nj );
+		});
+
+		offsets[pi + 1] = neighbours.size();
+	}
+
+	size_t cols = desc.cols();
+	DescriptorMatrix smoothDesc = desc;
+
+	for(int it = 0; it < iterations; it++)
+	{
+		#pragma omp parallel for
+		for(int pi = 0; pi < n; pi++)
+		{
+			float * sum = smoothDesc.row(pi);
+			size_t begin = offsets[pi], end = offsets[pi + 1];
+
+			// Isolated particles keep their descriptor
+			if(begin == end){
+				std::copy(desc.row(pi), desc.row(pi) + cols, sum);
+				continue;
+			}
+
+			std::fill(sum, sum + cols, 0.0f);
+
+			for(size_t k = begin; k < end; k++)
+			{
+				const float * nei = desc.row( neighbours[k] );
+				for(size_t j = 0; j < cols; j++) sum[j] += nei[j];
+			}
+
+			int count = int(end - begin);
+			for(size_t j = 0; j < cols; j++) sum[j] /= count;
+		}
+
+		std::swap( desc, smoothDesc );
+	}
+}
+
+ParticleMesh::StorageBenchmark ParticleMesh::storageBenchmark( SurfaceMeshModel * mesh, int gridsize, int descriptorSize, int iterations )
+{
+	StorageBenchmark b;
+	b.gridsize = gridsize;
+
+	ParticleMesh pmesh( mesh, gridsize );
+	int n = (int)pmesh.particles.size();
+	b.particles = n;
+
+	// Same random descriptors for both layouts
+	std::mt19937 gen(0);
+	std::uniform_real_distribution<float> dis(0, 1);
+	std::vector< std::vector<float> > nested( n, std::vector<float>(descriptorSize) );
+	for(auto & d : nested) for(auto & v : d) v = dis(gen);
+	pmesh.desc = DescriptorMatrix::fromRows( nested );
+
+	std::map<uint64_t,size_t> mortonMap;
+	for(auto & p : pmesh.particles) mortonMap[p.morton] = p.id;
+
+	// Red-black tree node: three pointers and a color next to the key and value
+	b.mapBytes = mortonMap.size() * (sizeof(std::pair<const uint64_t,size_t>) + 4 * sizeof(void*));
+	b.hashBytes = pmesh.mortonToParticleID.memoryBytes();
+	b.nestedBytes = n * (sizeof(std::vector<float>) + descriptorSize * sizeof(float));
+	b.flatBytes = pmesh.desc.memoryBytes();
+	b.denseOccupiedBytes = SparseOccupancy::denseBytes( gridsize );
+	b.sparseOccupiedBytes = pmesh.grid.occupied.memoryBytes();
+
+	// Old layout: a dense occupancy array over the whole grid
+	std::vector<bool> denseOccupied( size_t(gridsize) * gridsize * gridsize, false );
+	for(auto m : pmesh.grid.occupied.occupiedVoxels()) denseOccupied[m] = true;
+
+	QElapsedTimer timer; timer.start();
+	{
+		auto & descriptor = nested;
+
+		for(int it = 0; it < iterations; it++)
+		{
+			auto smoothDesc = descriptor;
+
+			#pragma omp parallel for
+			for(int pi = 0; pi < n; pi++)
+			{
+				const auto & p = pmesh.particles[pi];
+
+				std::vector<float> sum( descriptor[p.id].size(), 0 );
+				int count = 0;
+
+				unsigned int x,y,z;
+				mortonDecode(p.morton, x, y, z);
+
+				for(int u = -1; u <= 1; u++){
+					for(int v = -1; v <= 1; v++){
+						for(int w = -1; w <= 1; w++)
+						{
+							Eigen::Vector3i c(x + u, y + v, z + w);
+							if(c.x() < 0 || c.y() < 0 || c.z() < 0) continue;
+							if(c.x() > gridsize-1 || c.y() > gridsize-1 || c.z() > gridsize-1) continue;
+
+							uint64_t mcode = mortonEncode_LUT(c.x(),c.y(),c.z());
+							if(p.morton == mcode) continue;
+							if(!denseOccupied[ mcode ]) continue;
+
+							std::vector<float> nei = descriptor[ mortonMap.find(mcode)->second ];
+							for(size_t j = 0; j < sum.size(); j++) sum[j] += nei[j];
+							count++;
+						}
+					}
+				}
+
+				if(count) for(size_t j = 0; j < sum.size(); j++) sum[j] /= count;
+				else sum = descriptor[p.id];
+
+				smoothDesc[p.id] = sum;
+			}
+
+			descriptor = smoothDesc;
+		}
+	}
+	b.nestedTime = timer.elapsed() / 1000.0;
+
+	timer.restart();
+	pmesh.averageNeighbourDescriptors( iterations );
+	b.flatTime = timer.elapsed() / 1000.0;
+
+	// Marching cubes over the padded dense volume against the sparse occupancy
+	{
+		timer.restart();
+		ScalarVolume volume = initScalarVolume( gridsize, 1 );
+		for(auto m : pmesh.grid.occupied.occupiedVoxels())
+		{
+			unsigned int x,y,z;
+			mortonDecode(m, x, y, z);
+			volume[x + MC_VOLUME_PADDING][y + MC_VOLUME_PADDING][z + MC_VOLUME_PADDING] = -1;
+		}
+		auto denseTriangles = march( volume, 0.5 );
+		b.denseMarchTime = timer.elapsed() / 1000.0;
+
+		timer.restart();
+		auto sparseTriangles = march( pmesh.grid.occupied, gridsize, 0.5 );
+		b.sparseMarchTime = timer.elapsed() / 1000.0;
+
+		// Triangles are compared as sorted lists of rounded corners, output order differs between the two
+		auto keys = []( const std::vector< std::vector<Point3f> > & triangles ){
+			std::vector< std::vector<int> > result;
+			for(auto & t : triangles){
+				std::vector<int> key;
+				for(auto & p : t){ key.push_back( qRound(p.x * 1000) ); key.push_back( qRound(p.y * 1000) ); key.push_back( qRound(p.z * 1000) ); }
+				result.push_back( key );
+			}
+			std::sort( result.begin(), result.end() );
+			return result;
+		};
+		auto denseKeys = keys( denseTriangles ), sparseKeys = keys( sparseTriangles );
+
+		std::vector< std::vector<int> > difference;
+		std::set_symmetric_difference( denseKeys.begin(), denseKeys.end(), sparseKeys.begin(), sparseKeys.end(), std::back_inserter(difference) );
+
+		b.marchTriangles = denseKeys.size();
+		b.marchMismatches = difference.size();
+	}
+
+	return b;
+}
+
 void ParticleMesh::basicFindReflectiveSymmetry()
 {
 	// Find global reflection planes from a fixed set
@@ -1300,16 +1570,18 @@ void ParticleMesh::basicFindReflectiveSymmetry()
 	std::vector<Vector3> specialPoints;
 	NanoKdTree tree;
 	{
-		auto g = toGraph();
-		auto vals = agd(50, g);
+		auto g = toCSRGraph();
+		std::vector<size_t> all( particles.size() );
+		for(size_t i = 0; i < all.size(); i++) all[i] = i;
+		auto vals = agd(50, g, all);
 
 		for(auto & p : particles)
 		{
 			std::vector<size_t> neighbours;
-			for(auto & vj : g.GetNeighbours(p.id)){
-				for(auto & vk : g.GetNeighbours(vj))
-					neighbours.push_back(vk);
-				neighbours.push_back(vj);
+			for(auto vj = g.neighboursBegin(p.id); vj != g.neighboursEnd(p.id); vj++){
+				for(auto vk = g.neighboursBegin(*vj); vk != g.neighboursEnd(*vj); vk++)
+					neighbours.push_back(*vk);
+				neighbours.push_back(*vj);
 			}
 
 			bool isMaxima = true;
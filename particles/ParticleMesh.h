@@ -14,6 +14,7 @@
 #include "voxelization.h"
 
 #include "SpatialHash.h"
+#include "ParticleStore.h"
 
 #include "GenericGraph.h"
 typedef GenericGraphs::Graph<uint,double> SegmentGraph;
@@ -21,7 +22,12 @@ typedef QMap< unsigned int, SegmentGraph > Segments;
 typedef std::vector<float> VectorFloat;
 typedef std::vector< Particle<Vector3> > Particles;
 
+#include "CSRGraph.h"
+typedef GenericGraphs::CSRGraph<double> ParticleGraph;
+typedef GenericGraphs::ShortestPaths<double> ParticlePaths;
+
 #include "Planes.h"
+#include "SliceIndex.h"
 
 class ParticleMesh : public Serializable
 {
@@ -32,8 +38,9 @@ public:
 	~ParticleMesh();
 	PropertyMap property;
 
-	Particles particles;
-	std::vector< std::vector<float> > desc, sig;
+	Particles particles;		// records, array of structs
+	ParticleColumns columns;	// hot fields of the records as arrays, see 'updateColumns'
+	DescriptorMatrix desc, sig;	// flat, one row per particle
 
 	SurfaceMeshModel * surface_mesh;
 
@@ -43,12 +50,17 @@ public:
 
 	typedef Eigen::Vector3f VoxelVector;
 	VoxelContainer<VoxelVector> grid;
-	std::map<uint64_t,size_t> mortonToParticleID;
+	MortonHash mortonToParticleID;
 
 	QMap<QString,size_t> partNames;
 
+	SliceIndex sliceIndex;
+
 public:
 	void init( bool isAssignedSegment = false );
+
+	// Copy positions, directions, flags and Morton codes of the records into 'columns', after editing them
+	void updateColumns() { columns.gather( particles ); }
 	void process();
 	void computeDistanceToFloor();
 	std::vector<size_t> pathFromFloor;
@@ -61,6 +73,7 @@ public:
 	std::vector<size_t> specialSeeding( SeedType seedType, int K, SegmentGraph::vertices_set selected = SegmentGraph::vertices_set() );
 
 	SegmentGraph toGraph( SegmentGraph::vertices_set selected = SegmentGraph::vertices_set() ) const;
+	ParticleGraph toCSRGraph( SegmentGraph::vertices_set selected = SegmentGraph::vertices_set() ) const;
 
 	Segments segmentToComponents( SegmentGraph fromGraph, SegmentGraph & neiGraph, bool isCombineSameSegmentID = false );
 
@@ -70,6 +83,7 @@ public:
 	SpatialHash< Vector3, Vector3::Scalar > spatialHash();
 	std::vector<size_t> randomSamples( int numSamples, bool isSpread );
 	std::vector< double > agd( int numStartPoints, SegmentGraph graph = SegmentGraph() ) const;
+	std::vector< double > agd( int numStartPoints, const ParticleGraph & graph, const std::vector<size_t> & vertex_pool ) const;
 	std::vector<size_t> neighbourhood( Particle<Vector3> & p, int step = 2);
 	Particle<Vector3> pointToParticle( const Vector3 & point );
 	std::vector< Vector3 > particlesCorners( SegmentGraph::vertices_set selected = SegmentGraph::vertices_set() ) const;
@@ -89,6 +103,9 @@ public:
 
 	void distort();
 
+	// Replace each descriptor by the mean of its occupied neighbouring voxels
+	void averageNeighbourDescriptors( int iterations );
+
 	void basicFindReflectiveSymmetry();
 	std::vector<Plane> reflectionPlanes;
 
@@ -100,6 +117,10 @@ public:
 	void drawParticles( qglviewer::Camera * camera );
 	void drawDebug(QGLWidget & widget);
 
+	// Memory and neighbour averaging time of the flat stores against the nested containers they replaced
+	struct StorageBenchmark{ int gridsize; size_t particles, mapBytes, hashBytes, nestedBytes, flatBytes, denseOccupiedBytes, sparseOccupiedBytes, marchTriangles, marchMismatches; double nestedTime, flatTime, denseMarchTime, sparseMarchTime; };
+	static StorageBenchmark storageBenchmark( SurfaceMeshModel * mesh, int gridsize, int descriptorSize = 64, int iterations = 3 );
+
 	// Serialization:
 	void serialize(QDataStream& os) const;	
 	void deserialize(QDataStream&);
@@ -0,0 +1,179 @@
+#pragma once
+
+// Flat containers for per-particle data: a Morton code to particle id hash, a
+// contiguous descriptor matrix with one row per particle and separate arrays for
+// the particle fields that neighbour loops read.
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <Eigen/Core>
+
+// Open addressing with linear probing over a power of two table, kept at most half full
+class MortonHash
+{
+public:
+	typedef uint64_t key_t;
+	typedef size_t value_t;
+
+	static value_t npos() { return std::numeric_limits<value_t>::max(); }
+
+	MortonHash() : count(0) {}
+
+	void clear() { keys.clear(); values.clear(); count = 0; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	void reserve( size_t n )
+	{
+		size_t capacity = 16;
+		while( capacity < 2 * n ) capacity <<= 1;
+		if( capacity > keys.size() ) rehash( capacity );
+	}
+
+	void insert( key_t key, value_t value )
+	{
+		if( 2 * (count + 1) > keys.size() ) rehash( std::max(size_t(16), keys.size() * 2) );
+
+		size_t i = slot( key );
+		if( values[i] == npos() ){ keys[i] = key; count++; }
+		values[i] = value;
+	}
+
+	value_t find( key_t key ) const
+	{
+		if( keys.empty() ) return npos();
+		return values[ slot(key) ];
+	}
+
+	bool contains( key_t key ) const { return find(key) != npos(); }
+
+	// Missing codes map to particle 0, as std::map::operator[] did
+	value_t operator[]( key_t key ) const { value_t v = find(key); return v == npos() ? 0 : v; }
+
+	size_t memoryBytes() const { return keys.capacity() * sizeof(key_t) + values.capacity() * sizeof(value_t); }
+
+private:
+	std::vector<key_t> keys;
+	std::vector<value_t> values;	// npos marks an empty slot
+	size_t count;
+
+	static size_t mix( key_t key )
+	{
+		key ^= key >> 33; key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33; key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return size_t(key);
+	}
+
+	size_t slot( key_t key ) const
+	{
+		size_t mask = keys.size() - 1;
+		size_t i = mix(key) & mask;
+		while( values[i] != npos() && keys[i] != key ) i = (i + 1) & mask;
+		return i;
+	}
+
+	void rehash( size_t capacity )
+	{
+		std::vector<key_t> oldKeys( capacity, 0 );
+		std::vector<value_t> oldValues( capacity, npos() );
+		oldKeys.swap( keys );
+		oldValues.swap( values );
+		count = 0;
+
+		for(size_t i = 0; i < oldKeys.size(); i++)
+			if( oldValues[i] != npos() ) insert( oldKeys[i], oldValues[i] );
+	}
+};
+
+// Row-major float matrix, one row per particle
+class DescriptorMatrix
+{
+public:
+	DescriptorMatrix() : numRows(0), numCols(0) {}
+	DescriptorMatrix( size_t rows, size_t cols, float value = 0 ) { resize(rows, cols, value); }
+
+	void resize( size_t rows, size_t cols, float value = 0 )
+	{
+		numRows = rows; numCols = cols;
+		data.assign( rows * cols, value );
+	}
+
+	void clear() { resize(0, 0); }
+
+	size_t rows() const { return numRows; }
+	size_t cols() const { return numCols; }
+	size_t size() const { return numRows; }
+	bool empty() const { return numRows == 0; }
+
+	float * row( size_t i ) { return data.data() + i * numCols; }
+	const float * row( size_t i ) const { return data.data() + i * numCols; }
+
+	Eigen::Map<Eigen::VectorXf> rowMap( size_t i ) { return Eigen::Map<Eigen::VectorXf>( row(i), numCols ); }
+	Eigen::Map<const Eigen::VectorXf> rowMap( size_t i ) const { return Eigen::Map<const Eigen::VectorXf>( row(i), numCols ); }
+
+	std::vector<float> rowVector( size_t i ) const { return std::vector<float>( row(i), row(i) + numCols ); }
+	void setRow( size_t i, const std::vector<float> & values ) { std::memcpy( row(i), values.data(), numCols * sizeof(float) ); }
+
+	std::vector< std::vector<float> > toRows() const
+	{
+		std::vector< std::vector<float> > result( numRows );
+		for(size_t i = 0; i < numRows; i++) result[i] = rowVector(i);
+		return result;
+	}
+
+	// Rows shorter than the widest one are padded with zeros
+	static DescriptorMatrix fromRows( const std::vector< std::vector<float> > & rows )
+	{
+		size_t cols = 0;
+		for(auto & r : rows) cols = std::max(cols, r.size());
+
+		DescriptorMatrix m( rows.size(), cols );
+		for(size_t i = 0; i < rows.size(); i++) std::copy( rows[i].begin(), rows[i].end(), m.row(i) );
+		return m;
+	}
+
+	size_t memoryBytes() const { return data.capacity() * sizeof(float); }
+
+	std::vector<float> data;
+
+private:
+	size_t numRows, numCols;
+};
+
+// Morton code, position, direction and flag of each particle as separate arrays, indexed by particle id.
+// The Particle records stay the ones that get edited, 'gather' copies them here after they change.
+class ParticleColumns
+{
+public:
+	std::vector<uint64_t> morton;
+	std::vector<Eigen::Vector3d> position, direction;
+	std::vector<int> flag;
+
+	size_t size() const { return morton.size(); }
+	void clear() { morton.clear(); position.clear(); direction.clear(); flag.clear(); }
+
+	template<typename Records>
+	void gather( const Records & particles )
+	{
+		size_t n = particles.size();
+		morton.resize(n); position.resize(n); direction.resize(n); flag.resize(n);
+
+		for(size_t i = 0; i < n; i++)
+		{
+			const auto & p = particles[i];
+			morton[i] = p.morton;
+			position[i] = p.pos;
+			direction[i] = p.direction;
+			flag[i] = int(p.flag);
+		}
+	}
+
+	size_t memoryBytes() const
+	{
+		return morton.capacity() * sizeof(uint64_t) + (position.capacity() + direction.capacity()) * sizeof(Eigen::Vector3d) + flag.capacity() * sizeof(int);
+	}
+};
@@ -1,6 +1,10 @@
 #include "Raytracing.h"
+#include <chrono>
 
+// Embree binaries are only shipped for Windows
+#ifdef _WIN32
 #define USE_EMBREE
+#endif
 
 #ifdef USE_EMBREE
 #include "embree2/rtcore.h"
@@ -67,6 +71,18 @@ raytracing::Raytracing<Vector3>::Raytracing( SurfaceMesh::SurfaceMeshModel * mes
         // Build octree
         Octree * octree = new Octree( mesh );
 		accelerator = octree;
+
+		// Flattened BVH for batched queries
+		std::vector<Eigen::Vector3f> vertices;
+		std::vector<Eigen::Vector3i> faces;
+		for(auto v : mesh->vertices()) vertices.push_back( mesh->vertex_coordinates()[v].cast<float>() );
+		for(auto f : mesh->faces())
+		{
+			std::vector<int> mesh_triangle;
+			for(auto v : mesh->vertices(f)) mesh_triangle.push_back(v.idx());
+			faces.push_back( Eigen::Vector3i(mesh_triangle[0], mesh_triangle[1], mesh_triangle[2]) );
+		}
+		bvh.build( vertices, faces );
     }
     #endif
 }
@@ -102,6 +118,80 @@ raytracing::RayHit raytracing::Raytracing<Vector3>::hit( const Vector3& rayOrigi
 #endif
 }
 
+template<typename Vector3>
+std::vector<raytracing::RayHit> raytracing::Raytracing<Vector3>::hit( const std::vector<Vector3>& rayOrigins, const std::vector<Vector3>& rayDirections )
+{
+	std::vector<RayHit> hits( rayOrigins.size() );
+
+#ifdef USE_EMBREE
+	// Embree already traverses its own BVH with SIMD per ray
+	#pragma omp parallel for
+	for(int i = 0; i < (int)rayOrigins.size(); i++)
+		hits[i] = hit( rayOrigins[i], rayDirections[i] );
+#else
+	int numPackets = int((rayOrigins.size() + FlatBVH::PacketSize - 1) / FlatBVH::PacketSize);
+
+	#pragma omp parallel for
+	for(int pi = 0; pi < numPackets; pi++)
+	{
+		size_t start = size_t(pi) * FlatBVH::PacketSize;
+		int count = int(std::min(rayOrigins.size() - start, size_t(FlatBVH::PacketSize)));
+
+		Eigen::Vector3f org[FlatBVH::PacketSize], dir[FlatBVH::PacketSize];
+		float tfar[FlatBVH::PacketSize];
+		int faceid[FlatBVH::PacketSize];
+
+		for(int i = 0; i < count; i++)
+		{
+			org[i] = rayOrigins[start + i].template cast<float>();
+			dir[i] = rayDirections[start + i].template cast<float>();
+			tfar[i] = std::numeric_limits<float>::infinity();
+		}
+
+		bvh.intersectPacket( org, dir, count, tfar, faceid );
+
+		// Report distances along the ray like the per-ray path does
+		for(int i = 0; i < count; i++)
+			if( faceid[i] >= 0 ) hits[start + i] = RayHit( tfar[i] * dir[i].norm(), faceid[i] );
+	}
+#endif
+
+	return hits;
+}
+
+template<typename Vector3>
+typename raytracing::Raytracing<Vector3>::Benchmark raytracing::Raytracing<Vector3>::benchmark( SurfaceMesh::SurfaceMeshModel * mesh, 
+	const std::vector<Vector3>& rayOrigins, const std::vector<Vector3>& rayDirections )
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Benchmark b = { 0, 0, 0, 0 };
+
+	Raytracing<Vector3> rt( mesh );
+
+	std::vector<RayHit> single( rayOrigins.size() );
+	auto start = Clock::now();
+	#pragma omp parallel for
+	for(int i = 0; i < (int)rayOrigins.size(); i++)
+		single[i] = rt.hit( rayOrigins[i], rayDirections[i] );
+	double singleTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+	start = Clock::now();
+	std::vector<RayHit> batched = rt.hit( rayOrigins, rayDirections );
+	double batchedTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+	b.perRay = rayOrigins.size() / std::max(singleTime, 1e-9);
+	b.batched = rayOrigins.size() / std::max(batchedTime, 1e-9);
+
+	for(size_t i = 0; i < rayOrigins.size(); i++)
+	{
+		if( single[i].faceid != batched[i].faceid ) b.mismatchedFaces++;
+		if( single[i].isHit && batched[i].isHit )
+			b.maxDifference = std::max( b.maxDifference, std::abs(single[i].distance - batched[i].distance) );
+	}
+
+	return b;
+}
+
 template<typename Vector3>
 raytracing::Raytracing<Vector3>::~Raytracing()
 {
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <vector>
 #include "SurfaceMeshModel.h"
+#include "FlatBVH.h"
 
 namespace raytracing{
 
@@ -22,6 +24,15 @@ public:
 	~Raytracing();
 	inline RayHit hit( const Vector3& rayOrigin, const Vector3& rayDirection );
 	void * accelerator;
+
+	// Batched queries, ray i goes from rayOrigins[i] along rayDirections[i].
+	// Consecutive rays are traced together, so callers should order them coherently.
+	std::vector<RayHit> hit( const std::vector<Vector3>& rayOrigins, const std::vector<Vector3>& rayDirections );
+	FlatBVH bvh;
+
+	// Rays per second of the per-ray and batched paths, and their largest disagreement
+	struct Benchmark{ double perRay, batched, maxDifference; size_t mismatchedFaces; };
+	static Benchmark benchmark( SurfaceMesh::SurfaceMeshModel * mesh, const std::vector<Vector3>& rayOrigins, const std::vector<Vector3>& rayDirections );
 };
 
 }
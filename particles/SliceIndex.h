@@ -0,0 +1,152 @@
+#pragma once
+
+// Slices of the segments of a shape. Each segment is cut into layers of grid 'z' coordinates, each
+// layer into connected chunks with a box and a kd-tree of their particles relative to that box.
+// Built once per shape by 'PartCorresponder::indexSlices' and saved with the particles, so
+// corresponding two segments only looks their slices up.
+
+#include <QSharedPointer>
+#include <QVector>
+#include <QMap>
+#include <QVariant>
+#include <Eigen/Geometry>
+
+#include "NanoKdTree.h"
+#include "Serializable.h"
+
+#include "GenericGraph.h"
+typedef GenericGraphs::Graph<uint,double> SegmentGraph;
+
+extern int slice_uid;
+struct SliceChunk{
+	Eigen::AlignedBox3d box;
+	SegmentGraph g;
+	QSharedPointer<NanoKdTree> tree;
+	std::vector<size_t> vmap;
+	SliceChunk(const SegmentGraph & graph = SegmentGraph()) : g(graph), uid(slice_uid++) {}
+	int uid;
+	QMap<QString,QVariant> property;
+};
+
+struct Slice{
+	QVector<SliceChunk> chunks;
+	void chunksFromGraphs(const std::vector<SegmentGraph> & graphs){
+		for(auto & graph : graphs)
+			chunks.push_back( SliceChunk(graph) );
+	}
+	Slice() : isGrid2D(false), bottom(0), top(0){}
+	bool isGrid2D;
+	int bottom, top;	// grid 'z' coordinates of the layer, [bottom, top)
+	Eigen::AlignedBox3d box(){ Eigen::AlignedBox3d b; for(auto & c : chunks) b.extend(c.box); return b; }
+};
+typedef QVector<Slice> Slices;
+
+class SliceIndex : public Serializable
+{
+public:
+	struct Entry{
+		quint64 stamp;	// of the particles the slices were made from
+		Slices slices;	// in increasing layers
+		Entry() : stamp(0) {}
+	};
+	QMap<unsigned int, Entry> segments;
+
+	void clear() { segments.clear(); }
+
+	bool contains( unsigned int sid, quint64 stamp ) const
+	{
+		auto it = segments.constFind( sid );
+		return it != segments.constEnd() && it->stamp == stamp;
+	}
+
+	// Empty for segments not in the index
+	const Slices & slices( unsigned int sid ) const
+	{
+		static const Slices none;
+		auto it = segments.constFind( sid );
+		return it != segments.constEnd() ? it->slices : none;
+	}
+
+	void insert( unsigned int sid, quint64 stamp, const Slices & slices )
+	{
+		Entry & entry = segments[sid];
+		entry.stamp = stamp;
+		entry.slices = slices;
+	}
+
+	// Chunk graphs keep their vertices only, trees are rebuilt from the stored relative positions
+	void serialize( QDataStream& os ) const
+	{
+		os << quint32( segments.size() );
+		for(auto it = segments.constBegin(); it != segments.constEnd(); ++it)
+		{
+			os << quint32( it.key() ) << it->stamp << quint32( it->slices.size() );
+
+			for(auto & slice : it->slices)
+			{
+				os << qint32( slice.bottom ) << qint32( slice.top ) << quint32( slice.chunks.size() );
+
+				for(auto & chunk : slice.chunks)
+				{
+					Eigen::Vector3d bmin = chunk.box.min(), bmax = chunk.box.max();
+					os << bmin << bmax << quint32( chunk.vmap.size() );
+
+					for(size_t i = 0; i < chunk.vmap.size(); i++)
+						os << quint64( chunk.vmap[i] ) << Eigen::Vector3d( chunk.tree->cloud.pts[i] );
+				}
+			}
+		}
+	}
+
+	void deserialize( QDataStream& is )
+	{
+		segments.clear();
+
+		quint32 segmentCount;
+		is >> segmentCount;
+
+		for(quint32 s = 0; s < segmentCount; s++)
+		{
+			quint32 sid, sliceCount;
+			Entry entry;
+			is >> sid >> entry.stamp >> sliceCount;
+
+			entry.slices.resize( sliceCount );
+			for(auto & slice : entry.slices)
+			{
+				qint32 bottom, top;
+				quint32 chunkCount;
+				is >> bottom >> top >> chunkCount;
+				slice.bottom = bottom;
+				slice.top = top;
+
+				for(quint32 c = 0; c < chunkCount; c++)
+				{
+					SliceChunk chunk;
+
+					Eigen::Vector3d bmin, bmax;
+					quint32 count;
+					is >> bmin >> bmax >> count;
+					chunk.box = Eigen::AlignedBox3d( bmin, bmax );
+
+					chunk.tree = QSharedPointer<NanoKdTree>(new NanoKdTree);
+					for(quint32 i = 0; i < count; i++)
+					{
+						quint64 v;
+						Eigen::Vector3d relativePos;
+						is >> v >> relativePos;
+
+						chunk.g.AddVertex( v );
+						chunk.vmap.push_back( v );
+						chunk.tree->addPoint( relativePos );
+					}
+					chunk.tree->build();
+
+					slice.chunks.push_back( chunk );
+				}
+			}
+
+			segments[sid] = entry;
+		}
+	}
+};
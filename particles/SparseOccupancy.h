@@ -0,0 +1,192 @@
+#pragma once
+
+// Voxel occupancy stored as 8x8x8 bricks of bits, only bricks holding a voxel are allocated.
+// The lower nine bits of a Morton code address the voxel inside its brick, the rest is the
+// Morton code of the brick itself, so a lookup is one hash probe and a bit test.
+
+#include <vector>
+#include <bitset>
+#include <algorithm>
+#include <cstdint>
+
+#include "morton.h"
+#include "ParticleStore.h"
+
+class SparseOccupancy
+{
+public:
+	enum{ BRICK_BITS = 9, BRICK_SIZE = 8, BRICK_WORDS = 8 };
+
+	void clear() { index.clear(); keys.clear(); words.clear(); }
+
+	inline bool test( uint64_t m ) const
+	{
+		size_t b = index.find( m >> BRICK_BITS );
+		if( b == MortonHash::npos() ) return false;
+		return testInBrick( b, m );
+	}
+
+	// Same values as the dense array it replaces: FULL_VOXEL or EMPTY_VOXEL
+	inline char operator[]( uint64_t m ) const { return test(m) ? 1 : 0; }
+
+	inline void set( uint64_t m )
+	{
+		size_t b = brick( m >> BRICK_BITS );
+		uint64_t i = m & 511;
+		words[b * BRICK_WORDS + (i >> 6)] |= (uint64_t(1) << (i & 63));
+	}
+
+	inline void reset( uint64_t m )
+	{
+		size_t b = index.find( m >> BRICK_BITS );
+		if( b == MortonHash::npos() ) return;
+		uint64_t i = m & 511;
+		words[b * BRICK_WORDS + (i >> 6)] &= ~(uint64_t(1) << (i & 63));
+	}
+
+	// Safe to call from several threads once the brick exists, see 'allocate'
+	inline void setAtomic( uint64_t m )
+	{
+		size_t b = index.find( m >> BRICK_BITS );
+		uint64_t i = m & 511;
+		uint64_t & word = words[b * BRICK_WORDS + (i >> 6)];
+		uint64_t bit = uint64_t(1) << (i & 63);
+		#pragma omp atomic
+		word |= bit;
+	}
+
+	// Bricks covering the whole grid, for passes that touch most of it (flood fill)
+	void allocate( size_t gridsize )
+	{
+		unsigned int n = (unsigned int)((gridsize + BRICK_SIZE - 1) / BRICK_SIZE);
+		index.reserve( size_t(n) * n * n );
+		for(unsigned int x = 0; x < n; x++)
+			for(unsigned int y = 0; y < n; y++)
+				for(unsigned int z = 0; z < n; z++)
+					brick( mortonEncode_LUT(x, y, z) );
+	}
+
+	size_t size() const
+	{
+		size_t count = 0;
+		for(auto w : words) count += std::bitset<64>(w).count();
+		return count;
+	}
+
+	bool empty() const
+	{
+		for(auto w : words) if( w ) return false;
+		return true;
+	}
+
+	// Occupied voxels in increasing Morton order
+	std::vector<uint64_t> occupiedVoxels() const { return collect( false, 0 ); }
+
+	// Unoccupied voxels of the grid in increasing Morton order, missing bricks count as empty
+	std::vector<uint64_t> emptyVoxels( size_t gridsize ) const { return collect( true, gridsize ); }
+
+	// Calls f(m) for each occupied voxel among the 26 around 'm', in x, y, z loop order
+	template<typename Function>
+	void forEachNeighbour( uint64_t m, size_t gridsize, Function f ) const
+	{
+		unsigned int x,y,z;
+		mortonDecode(m, x, y, z);
+
+		uint64_t lastKey = m >> BRICK_BITS;
+		size_t lastBrick = index.find( lastKey );
+
+		for(int u = -1; u <= 1; u++){
+			for(int v = -1; v <= 1; v++){
+				for(int w = -1; w <= 1; w++)
+				{
+					if(u == 0 && v == 0 && w == 0) continue;
+
+					int cx = int(x) + u, cy = int(y) + v, cz = int(z) + w;
+					if(cx < 0 || cy < 0 || cz < 0) continue;
+					if(cx > int(gridsize)-1 || cy > int(gridsize)-1 || cz > int(gridsize)-1) continue;
+
+					uint64_t n = mortonEncode_LUT(cx, cy, cz);
+
+					// Most neighbours share the brick of the previous one
+					uint64_t key = n >> BRICK_BITS;
+					if( key != lastKey ){ lastKey = key; lastBrick = index.find( key ); }
+
+					if( lastBrick != MortonHash::npos() && testInBrick( lastBrick, n ) ) f( n );
+				}
+			}
+		}
+	}
+
+	size_t brickCount() const { return keys.size(); }
+	const std::vector<uint64_t> & brickCodes() const { return keys; }
+	size_t memoryBytes() const { return index.memoryBytes() + (keys.capacity() + words.capacity()) * sizeof(uint64_t); }
+	static size_t denseBytes( size_t gridsize ) { return gridsize * gridsize * gridsize * sizeof(char); }
+
+private:
+	MortonHash index;				// brick code to brick number
+	std::vector<uint64_t> keys;		// brick number to brick code
+	std::vector<uint64_t> words;	// BRICK_WORDS per brick
+
+	inline bool testInBrick( size_t b, uint64_t m ) const
+	{
+		uint64_t i = m & 511;
+		return (words[b * BRICK_WORDS + (i >> 6)] >> (i & 63)) & 1;
+	}
+
+	size_t brick( uint64_t key )
+	{
+		size_t b = index.find( key );
+		if( b != MortonHash::npos() ) return b;
+
+		b = brickCount();
+		index.insert( key, b );
+		keys.push_back( key );
+		words.resize( words.size() + BRICK_WORDS, 0 );
+		return b;
+	}
+
+	std::vector<uint64_t> collect( bool isEmpty, size_t gridsize ) const
+	{
+		std::vector<uint64_t> bricks;
+
+		if( isEmpty )
+		{
+			// Every brick of the grid, allocated or not
+			unsigned int n = (unsigned int)((gridsize + BRICK_SIZE - 1) / BRICK_SIZE);
+			for(unsigned int x = 0; x < n; x++)
+				for(unsigned int y = 0; y < n; y++)
+					for(unsigned int z = 0; z < n; z++)
+						bricks.push_back( mortonEncode_LUT(x, y, z) );
+		}
+		else
+		{
+			bricks = keys;
+		}
+
+		std::sort( bricks.begin(), bricks.end() );
+
+		std::vector<uint64_t> result;
+		for(auto key : bricks)
+		{
+			size_t b = index.find( key );
+			if( !isEmpty && b == MortonHash::npos() ) continue;
+
+			for(uint64_t i = 0; i < 512; i++)
+			{
+				uint64_t m = (key << BRICK_BITS) | i;
+				bool isSet = (b != MortonHash::npos()) && testInBrick( b, m );
+				if( isSet == isEmpty ) continue;
+
+				if( isEmpty ){
+					unsigned int x,y,z;
+					mortonDecode(m, x, y, z);
+					if( x > gridsize-1 || y > gridsize-1 || z > gridsize-1 ) continue;
+				}
+
+				result.push_back( m );
+			}
+		}
+
+		return result;
+	}
+};
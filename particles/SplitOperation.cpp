@@ -40,7 +40,7 @@ void SplitOperation::split()
 
     for(auto v : seg.vertices){
         pmap[v] = pmap.size();
-        descs.push_back( s->desc[v] );
+        descs.push_back( s->desc.rowVector(v) );
     }
 
     // Perform binary split
@@ -49,7 +49,7 @@ void SplitOperation::split()
     km._centers.clear();
 	auto seeds = s->specialSeeding(ParticleMesh::DESCRIPTOR, K, seg.vertices);
 
-    for(auto pid : seeds) km._centers.push_back( s->desc[pid] );
+    for(auto pid : seeds) km._centers.push_back( s->desc.rowVector(pid) );
     km.run();
 
     // Assign found clusters
@@ -6,6 +6,9 @@
 #include <utility>
 #include <cmath>
 #include <omp.h>
+#include <set>
+
+#include "SparseOccupancy.h"
 
 #define MC_VOLUME_PADDING 10
 
@@ -416,3 +419,92 @@ inline std::vector< std::vector<Point3f> > march( const ScalarVolume & volume, d
 
 	return allTriangles;
 }
+
+// Same surface as 'march' over a padded volume holding -1 inside and 1 outside at isovalue 0.5,
+// taken directly from the occupancy: only cells in bricks next to occupied ones are visited.
+// Points come out unpadded, as the dense path returns them after removing MC_VOLUME_PADDING.
+inline std::vector< std::vector<Point3f> > march( const SparseOccupancy & occupied, size_t gridsize, double isovalue = 0.5 )
+{
+	const int B = SparseOccupancy::BRICK_SIZE, n = (int)gridsize;
+
+	// Cells are grouped by the brick of their far corner, a brick of voxels is
+	// reached by cells of its own group and of the next one on each axis
+	std::set<uint64_t> bricks;
+	for(auto key : occupied.brickCodes())
+	{
+		unsigned int x,y,z;
+		mortonDecode(key, x, y, z);
+		for(unsigned int u = 0; u <= 1; u++)
+			for(unsigned int v = 0; v <= 1; v++)
+				for(unsigned int w = 0; w <= 1; w++)
+					bricks.insert( mortonEncode_LUT(x + u, y + v, z + w) );
+	}
+
+	// Cell origins run from -1, which stands in for the padding: cells further out have no inside corner
+	std::vector<Eigen::Vector3i> active;
+	for(auto key : bricks)
+	{
+		unsigned int x,y,z;
+		mortonDecode(key, x, y, z);
+		if( int(x * B) > n || int(y * B) > n || int(z * B) > n ) continue;
+		active.push_back( Eigen::Vector3i(x, y, z) );
+	}
+
+	auto value = [&]( int x, int y, int z ) -> double {
+		if(x < 0 || y < 0 || z < 0 || x > n-1 || y > n-1 || z > n-1) return 1;
+		return occupied.test( mortonEncode_LUT(x, y, z) ) ? -1 : 1;
+	};
+
+	std::vector< std::vector< std::vector<Point3f> > > trianglesThread( omp_get_max_threads() );
+
+	#pragma omp parallel for
+	for(int i = 0; i < (int)active.size(); i++)
+	{
+		Eigen::Vector3i b = active[i];
+
+		for( int cz = b[0] * B - 1; cz < (b[0] + 1) * B - 1; ++cz ) {
+			for( int cy = b[1] * B - 1; cy < (b[1] + 1) * B - 1; ++cy ) {
+				for( int cx = b[2] * B - 1; cx < (b[2] + 1) * B - 1; ++cx ) {
+					if( cz > n-1 || cy > n-1 || cx > n-1 ) continue;
+
+					std::vector<std::pair<Point3f, double> > cell;
+					bool isInside = false, isOutside = false;
+					for( int dz = 0 ; dz < 2; ++dz ) {
+						for( int dy = 0 ; dy < 2 ; ++dy ) {
+							for( int dx = 0 ; dx < 2 ; ++dx ) {
+								Point3f p;
+								p.x  = cx + dx;
+								p.y  = cy + dy;
+								p.z  = cz + dz;
+								double v = value(cz + dz, cy + dy, cx + dx);
+								if(v < 0) isInside = true; else isOutside = true;
+								cell.push_back ( std::make_pair( p, v) );
+							}
+						}
+					}
+					if( !isInside || !isOutside ) continue;
+
+					std::vector<Point3f> pnts;
+					polygonize(cell, isovalue, pnts ) ;
+
+					for(size_t t = 0; t < pnts.size() / 3; t++)
+					{
+						std::vector<Point3f> triangle;
+						triangle.push_back( pnts[t * 3 + 2] );
+						triangle.push_back( pnts[t * 3 + 1] );
+						triangle.push_back( pnts[t * 3 + 0] );
+
+						trianglesThread[ omp_get_thread_num() ].push_back( triangle );
+					}
+				}
+			}
+		}
+	}
+
+	std::vector< std::vector<Point3f> > allTriangles;
+	for(auto & tris : trianglesThread)
+		for(auto & t : tris)
+			allTriangles.push_back(t);
+
+	return allTriangles;
+}
@@ -86,8 +86,8 @@ void particles::processShapes()
 			s->sphereResolutionUsed = pw->ui->sphereResolution->value();
 
 			// Hit results are saved as vector of distances
-			std::vector< std::vector<float> > & descriptor = (s->desc = std::vector< std::vector<float> >( 
-				s->particles.size(), std::vector<float>( perSampleRaysCount ) ));
+			DescriptorMatrix & descriptor = s->desc;
+			descriptor.resize( s->particles.size(), perSampleRaysCount );
 
 			int rayCount = 0;
 
@@ -105,23 +105,37 @@ void particles::processShapes()
 				//raytracing::Raytracing<Eigen::Vector3d> rt( s->surface_mesh );
 				// ^^^ Moved up ^^
 
-				// Shoot rays around all particles
+				// Shoot rays around all particles, in blocks of neighboring particles so that
+				// rays sharing a direction are traced together as coherent packets
+				int blockSize = 64;
+				int numBlocks = int((s->particles.size() + blockSize - 1) / blockSize);
+
 				#pragma omp parallel for
-				for(int pi = 0; pi < (int)s->particles.size(); pi++)
+				for(int bi = 0; bi < numBlocks; bi++)
 				{
-					auto & p = s->particles[pi];
+					size_t start = size_t(bi) * blockSize, end = std::min(start + blockSize, s->particles.size());
 
-					int r = 0;
-					for(auto d : sampledRayDirections)
-					{
-						raytracing::RayHit hit = rt.hit( p.pos, d );
-						descriptor[pi][r++] = hit.distance;
-						rayCount++;
+					std::vector<Vector3> origins, directions;
+					for(auto d : sampledRayDirections){
+						for(size_t pi = start; pi < end; pi++){
+							origins.push_back( s->particles[pi].pos );
+							directions.push_back( d );
+						}
 					}
 
-					p.avgDiameter = 0;
+					std::vector<raytracing::RayHit> hits = rt.hit( origins, directions );
+
+					size_t h = 0;
+					for(size_t r = 0; r < perSampleRaysCount; r++)
+						for(size_t pi = start; pi < end; pi++)
+							descriptor.row(pi)[r] = hits[h++].distance;
+
+					for(size_t pi = start; pi < end; pi++)
+						s->particles[pi].avgDiameter = 0;
 				}
 
+				rayCount = int(s->particles.size() * perSampleRaysCount);
+
 				// Smooth ray response
 				int smoothRaysIter = pw->ui->fnSmoothIters->value();
 				if(smoothRaysIter > 0)
@@ -130,9 +144,9 @@ void particles::processShapes()
 					{
 						auto & p = s->particles[pi];
 
-						sphere.setValues( descriptor[pi] );
+						sphere.setValues( descriptor.rowVector(pi) );
 						sphere.smoothValues( smoothRaysIter );
-						descriptor[pi] = sphere.values();
+						descriptor.setRow( pi, sphere.values() );
 					}
 				}
 
@@ -142,59 +156,7 @@ void particles::processShapes()
 
 				// Average of neighbors
 				int avgNeighIters = pw->ui->avgNeighIters->value();
-				if( avgNeighIters )
-				{
-					size_t gridsize = s->grid.gridsize;
-
-					for(int it = 0; it < avgNeighIters; it++)
-					{
-						auto smoothDesc = descriptor;
-						{
-							#pragma omp parallel for
-							for(int pi = 0; pi < (int)s->particles.size(); pi++)
-							{
-								const auto & p = s->particles[pi];
-
-								std::vector<float> sum( descriptor[p.id].size(), 0 );
-								int count = 0;
-
-								unsigned int x,y,z;
-								mortonDecode(p.morton, x, y, z);
-
-								for(int u = -1; u <= 1; u++){
-									for(int v = -1; v <= 1; v++){
-										for(int w = -1; w <= 1; w++)
-										{
-											Eigen::Vector3i c(x + u, y + v, z + w);
-
-											// Skip outside grid
-											if(c.x() < 0 || c.y() < 0 || c.z() < 0) continue;
-											if(c.x() > gridsize-1 || c.y() > gridsize-1 || c.z() > gridsize-1) continue;
-
-											uint64_t mcode = mortonEncode_LUT(c.x(),c.y(),c.z());
-											if(p.morton == mcode) continue;
-											if(!s->grid.occupied[ mcode ]) continue;
-
-											size_t nj = s->mortonToParticleID[ mcode ];
-
-											std::vector<float> nei = descriptor[nj];
-
-											// Add this neighbor to sum
-											for(size_t j = 0; j < sum.size(); j++) sum[j] += nei[j];
-											count++;
-										}
-									}
-								}
-
-								// divide over count
-								for(size_t j = 0; j < sum.size(); j++) sum[j] /= count;
-
-								smoothDesc[p.id] = sum;
-							}
-						}
-						descriptor = smoothDesc;
-					}
-				}
+				if( avgNeighIters ) s->averageNeighbourDescriptors( avgNeighIters );
 
 				// Use medial points
 				if( pw->ui->useMedialPoints->isChecked() )
@@ -211,7 +173,7 @@ void particles::processShapes()
 						for(int pi = 0; pi < (int)s->particles.size(); pi++)
 						{
 							auto & p = s->particles[pi];
-							std::vector<float> & desc = descriptor[pi];
+							const float * desc = descriptor.row(pi);
 
 							Vector3 maPoint = p.pos;
 							
@@ -325,11 +287,10 @@ void particles::processShapes()
 						{
 							if( ma_point_active[pi] ){
 								Vector3 maPoint = ma_point[pi].cast<double>();
-								int r = 0;
-								for(auto d : sampledRayDirections){
-									raytracing::RayHit hit = rt.hit( maPoint, d );
-									descriptor[pi][r++] = hit.distance;
-								}
+								std::vector<Vector3> origins( sampledRayDirections.size(), maPoint );
+								std::vector<raytracing::RayHit> hits = rt.hit( origins, sampledRayDirections );
+								for(size_t r = 0; r < hits.size(); r++)
+									descriptor[pi][r] = hits[r].distance;
 
 								// Compute flatness of my neighbourhood
 								double search_rad = s->grid.unitlength * 4;
@@ -385,6 +346,8 @@ void particles::processShapes()
 							auto maxelement = std::max_element(descriptor[pi].begin(),descriptor[pi].end());
 							s->particles[pi].direction = sampledRayDirections[ maxelement - descriptor[pi].begin() ];
 						}
+
+						s->updateColumns();
 					}
 
 					// Normalize diameters
@@ -452,17 +415,19 @@ void particles::processShapes()
 			// Rotation invariant descriptor
 			if( pw->ui->useRotationInv->isChecked() && pw->ui->bands->value() > 0 )
 			{
-				s->sig = std::vector< std::vector<float> >(s->particles.size(), std::vector<float>( pw->ui->bands->value() ));
+				std::vector< std::vector<float> > sig( s->particles.size() );
 
 				#pragma omp parallel for
 				for(int pi = 0; pi < (int)s->particles.size(); pi++){
 					auto & p = s->particles[pi];
-					auto desc = s->desc[pi];
+					auto desc = s->desc.rowVector(pi);
 					//desc = Bounds<float>::from( desc ).normalize( desc ); // Normalize descriptor
 					std::vector<float> coeff;
 					sh.SH_project_function(desc, sh_samples, coeff);
-					s->sig[p.id] = sh.SH_signature(coeff);
+					sig[p.id] = sh.SH_signature(coeff);
 				}
+
+				s->sig = DescriptorMatrix::fromRows( sig );
 			}
 
 			// [DEBUG] visualize distance to ground
@@ -499,6 +464,8 @@ void particles::processShapes()
 	// Descriptor options
 	for(auto & s : pw->pmeshes)
 	{
+		std::vector< std::vector<float> > descs( s->particles.size() );
+
 		#pragma omp parallel for
 		for(int i = 0; i < (int)s->particles.size(); i++)
 		{
@@ -506,8 +473,8 @@ void particles::processShapes()
 
 			std::vector<float> new_desc;
 
-			if(pw->ui->useDescriptor->isChecked() ) 	new_desc = s->desc[p.id];
-			if(pw->ui->useRotationInv->isChecked())		new_desc = s->sig[p.id];
+			if(pw->ui->useDescriptor->isChecked() ) 	new_desc = s->desc.rowVector(p.id);
+			if(pw->ui->useRotationInv->isChecked())		new_desc = s->sig.rowVector(p.id);
 			if(pw->ui->useGroundDist->isChecked() )		new_desc.push_back(p.measure);
 			if(pw->ui->useDiameter->isChecked()   ) 	new_desc.push_back(p.avgDiameter);
 			if(pw->ui->useFlat->isChecked()		  )		new_desc.push_back(p.flat);
@@ -518,9 +485,11 @@ void particles::processShapes()
 			// Numerical check
 			for(auto & d : new_desc) if(isnan(d) || !isfinite(d)) d = 0;
 
-			s->desc[p.id] = new_desc;
+			descs[p.id] = new_desc;
 		}
 
+		s->desc = DescriptorMatrix::fromRows( descs );
+
 		//showTable(s->desc, std::min(size_t(100),s->particles.size()));
 	}
 	
@@ -717,7 +686,7 @@ void particles::create()
 
 			for(auto v : seg.vertices){
 				pmap[v] = pmap.size();
-				descs.push_back( s->desc[v] );
+				descs.push_back( s->desc.rowVector(v) );
 			}
 
 			// Perform binary split
@@ -726,7 +695,7 @@ void particles::create()
 			km._centers.clear();
 			auto seeds = s->specialSeeding(ParticleMesh::DESCRIPTOR, K, seg.vertices);
 
-			for(auto pid : seeds) km._centers.push_back( s->desc[pid] );
+			for(auto pid : seeds) km._centers.push_back( s->desc.rowVector(pid) );
 			km.run();
 
 			// Assign found clusters
@@ -884,8 +853,7 @@ void particles::create()
 						segments[p1.segment].AddEdge(p1.id, p2.id, 1);
 				}
 
-				for (auto & seg : segments)
-					seg.property["slices"].setValue(PartCorresponder::computeSlices(pw->pmeshes[i], seg));
+				PartCorresponder::indexSlices(pw->pmeshes[i], segments);
 
 				for (auto & seg : segments)
 					seg.property["bbox"].setValue(pw->pmeshes[i]->segmentBoundingBox(seg));
@@ -1147,13 +1115,13 @@ bool particles::keyPressEvent(QKeyEvent*e)
 		{
 			size_t pj = p.id;
 
-			auto di = Eigen::Map<Eigen::VectorXf>(&pmesh->desc[pi][0], pmesh->desc[pi].size());
+			auto di = pmesh->desc.rowMap(pi);
 			double d = DBL_MAX;
 
 			for( auto indices : rotatedIndices )
 			{
 				std::vector<float> rotated_desc;
-				for(auto idx : indices) rotated_desc.push_back(pmesh->desc[pj][idx]);
+				for(auto idx : indices) rotated_desc.push_back(pmesh->desc.row(pj)[idx]);
 
 				auto dj = Eigen::Map<Eigen::VectorXf>(&rotated_desc[0], rotated_desc.size());
 				auto dist = (di-dj).lpNorm<1>();
@@ -1180,6 +1148,56 @@ bool particles::keyPressEvent(QKeyEvent*e)
 		return true;
 	}
 
+	// Compare per-ray and batched ray tracing
+	if(e->key() == Qt::Key_B)
+	{
+		ParticlesWidget * pwidget = (ParticlesWidget*) widget;
+		if(!pwidget || !pwidget->isReady || pwidget->pmeshes.size() < 1) return false;
+
+		auto & pmesh = pwidget->pmeshes.front();
+
+		Spherelib::Sphere sphere( pwidget->ui->sphereResolution->value() );
+		std::vector< Eigen::Vector3d > sampledRayDirections = sphere.rays();
+
+		std::vector<Vector3> origins, directions;
+		for(auto d : sampledRayDirections){
+			for(auto & p : pmesh->particles){
+				origins.push_back( p.pos );
+				directions.push_back( d );
+			}
+		}
+
+		auto b = raytracing::Raytracing<Eigen::Vector3d>::benchmark( pmesh->surface_mesh, origins, directions );
+
+		mainWindow()->setStatusBarMessage( QString("Rays (%1): per-ray (%2 rays/sec) / batched (%3 rays/sec) / max difference (%4) / face mismatches (%5)")
+			.arg( origins.size() ).arg( b.perRay, 0, 'f', 0 ).arg( b.batched, 0, 'f', 0 ).arg( b.maxDifference ).arg( b.mismatchedFaces ) );
+
+		return true;
+	}
+
+	// Compare nested and flat particle storage at increasing resolutions
+	if(e->key() == Qt::Key_M)
+	{
+		ParticlesWidget * pwidget = (ParticlesWidget*) widget;
+		if(!pwidget || !pwidget->isReady || pwidget->pmeshes.size() < 1) return false;
+
+		QStringList report;
+		for(int gridsize : QVector<int>() << 64 << 128 << 256)
+		{
+			auto b = ParticleMesh::storageBenchmark( pwidget->pmeshes.front()->surface_mesh, gridsize );
+			report << QString("[%1] particles (%2) lookup (%3 KB / %4 KB) desc (%5 KB / %6 KB) occupied (%7 KB / %8 KB) averaging (%9 s / %10 s)")
+				.arg( b.gridsize ).arg( b.particles ).arg( b.mapBytes / 1024 ).arg( b.hashBytes / 1024 )
+				.arg( b.nestedBytes / 1024 ).arg( b.flatBytes / 1024 ).arg( b.denseOccupiedBytes / 1024 ).arg( b.sparseOccupiedBytes / 1024 )
+				.arg( b.nestedTime ).arg( b.flatTime )
+				+ QString(" marching (%1 s / %2 s, %3 triangles, %4 mismatched)")
+				.arg( b.denseMarchTime ).arg( b.sparseMarchTime ).arg( b.marchTriangles ).arg( b.marchMismatches );
+		}
+
+		mainWindow()->setStatusBarMessage( report.join(" ") );
+
+		return true;
+	}
+
 	if(e->key() == Qt::Key_R)
 	{
 		ParticlesWidget * pw = (ParticlesWidget *) widget;
@@ -1236,18 +1254,19 @@ bool particles::keyPressEvent(QKeyEvent*e)
 			SphericalHarmonic<Vector3,float> sh( std::max(1,pwidget->ui->bands->value()) );
 			std::vector< SHSample<Vector3,float> > sh_samples;
 			sh.SH_setup_spherical( sampledRayDirections, sh_samples );
-			sh.SH_project_function( pmesh->desc[ pi ], sh_samples, pmesh->desc[pi] );
+			std::vector<float> coeff;
+			sh.SH_project_function( pmesh->desc.rowVector(pi), sh_samples, coeff );
 
-			sphere->setValues( sh.SH_reconstruct(sampledRayDirections, pmesh->desc[pi]) );
+			sphere->setValues( sh.SH_reconstruct(sampledRayDirections, coeff) );
 		}
 		else
-			sphere->setValues( pmesh->desc[ pi ] );
+			sphere->setValues( pmesh->desc.rowVector(pi) );
 
 		sphere->normalizeValues();
 
 		mainWindow()->setStatusBarMessage( QString("Particle [%1] with maximum [%2] and minimum [%3] measure [%4] flat [%5]").arg(pi).arg(*std::max_element(
-			pmesh->desc[ pi ].begin(),pmesh->desc[ pi ].end())).arg(*std::min_element(pmesh->desc[ pi ].begin(),
-			pmesh->desc[ pi ].end())).arg(pmesh->particles[pi].measure).arg(pmesh->particles[pi].flat) );
+			pmesh->desc.row(pi),pmesh->desc.row(pi) + pmesh->desc.cols())).arg(*std::min_element(pmesh->desc.row(pi),
+			pmesh->desc.row(pi) + pmesh->desc.cols())).arg(pmesh->particles[pi].measure).arg(pmesh->particles[pi].flat) );
 
 		spheres.clear();
 		spheres.push_back( sphere );
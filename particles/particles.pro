@@ -12,15 +12,21 @@ HEADERS += \
     particles.h \
     particles-widget.h \
     ParticleMesh.h \
+    ParticleStore.h \
+    SparseOccupancy.h \
     Particle.h \
     Raytracing.h \
+    FlatBVH.h \
+    CSRGraph.h \
     BasicTable.h \
     StructureAnalysis.h \
     convexhull.h \
     SplitOperation.h \
     Segmentation.h \
     PartCorresponder.h \
+    SliceIndex.h \
     CorrespondencePrepare.h \
+    AssignmentEnumerator.h \
     CorrespondenceGenerator.h \
     CorrespondenceSearch.h
 
@@ -8,6 +8,7 @@
 #include "SurfaceMeshModel.h"
 
 #include "morton.h"
+#include "SparseOccupancy.h"
 
 template <typename T>
 struct AABox {
@@ -94,7 +95,7 @@ struct VoxelContainer{
 	double unitlength;
 	size_t gridsize;
 	bool isSolid;
-	std::vector<char> occupied;
+	SparseOccupancy occupied;
 	std::vector< std::vector<Vector3> > quads;
 	VoxelContainer() : translation(Vector3(0,0,0)), unitlength(-1), gridsize(-1){}
 	std::vector< Vector3 > voxelCenters(){
@@ -108,7 +109,7 @@ struct VoxelContainer{
 		mortonDecode(m, v[0], v[1], v[2]);
 		return Vector3(v[2] * unitlength, v[1] * unitlength, v[0] * unitlength) + delta;
 	}
-	void findOccupied(){ occupied.resize(gridsize*gridsize*gridsize, EMPTY_VOXEL); for(auto & v : data) occupied[v.morton] = FULL_VOXEL; }
+	void findOccupied(){ for(auto & v : data) occupied.set(v.morton); }
 	std::vector< Vector3 > pointsOutside( double alpha = 0.0 )
 	{
 		std::vector< Vector3 > result;
@@ -243,10 +244,9 @@ inline std::vector< std::vector<uint64_t> > voxelPath(Eigen::Vector3i center, Ei
 
 template<typename Vector3>
 inline void voxelize_schwarz_method(SurfaceMeshModel * mesh, const uint64_t morton_start, const uint64_t morton_end, 
-		const double unitlength, std::vector<char> & voxels, vector< VoxelData<Vector3> > &data, size_t &nfilled) 
+		const double unitlength, SparseOccupancy & voxels, vector< VoxelData<Vector3> > &data, size_t &nfilled) 
 {
 	voxels.clear();
-	voxels.resize(morton_end - morton_start, EMPTY_VOXEL);
 
 	data.clear();
 	data.reserve(50000);
@@ -346,7 +346,7 @@ inline void voxelize_schwarz_method(SurfaceMeshModel * mesh, const uint64_t mort
 
 					uint64_t index = mortonEncode_LUT(z, y, x);
 
-					if (voxels[index - morton_start] == FULL_VOXEL){ continue; } // already marked, continue
+					if (voxels[index] == FULL_VOXEL){ continue; } // already marked, continue
 
 					// TRIANGLE PLANE THROUGH BOX TEST
 					Vector3 p = Vector3(x*unitlength, y*unitlength, z*unitlength);
@@ -372,7 +372,7 @@ inline void voxelize_schwarz_method(SurfaceMeshModel * mesh, const uint64_t mort
 					if ((n_zx_e1.dot(p_zx) + d_xz_e1) < 0.0){ continue; }
 					if ((n_zx_e2.dot(p_zx) + d_xz_e2) < 0.0){ continue; }
 
-					voxels[index - morton_start] = FULL_VOXEL;
+					voxels.set(index);
 					data.push_back(VoxelData<Vector3>(index, true, n));
 
 					nfilled++;
@@ -434,8 +434,8 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 	container.gridsize = gridsize;
 	uint64_t morton_part = (gridsize * gridsize * gridsize);
 
-	// Storage for voxel on/off
-	std::vector<char> voxels; 
+	// Storage for voxel on/off, only bricks touched by the surface until filled
+	SparseOccupancy voxels;
 
 	// morton codes for this partition
 	uint64_t start = 0;
@@ -459,7 +459,10 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 	{	
 		// Original set of surface voxels (sparse representation)
 		std::set<uint64_t> surface_voxels;
-		for(uint64_t m = 0; m < morton_part; m++) if(voxels.at(m) == FULL_VOXEL) surface_voxels.insert(m);
+		for(auto m : voxels.occupiedVoxels()) surface_voxels.insert(m);
+
+		// Flood fill reaches most of the grid, one bit per voxel from here on
+		voxels.allocate( gridsize );
 
 		// Flood fill from the outside walls
 		std::vector<uint64_t> outer;
@@ -512,11 +515,9 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 				uint64_t curVox = queue.front();
 				queue.pop_front();
 
-				const uint64_t vox = voxels.at(curVox);
-
-				if( vox == EMPTY_VOXEL )
+				if( voxels[curVox] == EMPTY_VOXEL )
 				{
-					voxels.at(curVox) = FULL_VOXEL;
+					voxels.setAtomic(curVox);
 
 					unsigned int x,y,z;
 					mortonDecode(curVox, x, y, z);
@@ -533,7 +534,7 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 		}
 
 		// Now carve out surface
-		for(auto s : surface_voxels) voxels[s] = EMPTY_VOXEL;
+		for(auto s : surface_voxels) voxels.reset(s);
 
 		// Solid voxels to surface
 		if( isManifoldReady )
@@ -578,7 +579,7 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 									for(auto path : paths){
 										for(auto step : path){
 											isFixing = true;
-											voxels[step] = EMPTY_VOXEL;
+											voxels.reset(step);
 											surface_voxels.insert( step );
 											//if(false) container.aux.push_back( VoxelData<Vector3>(step, true) ); // DEBUG
 										}
@@ -595,7 +596,7 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 										(voxels[d[2]] != EMPTY_VOXEL && voxels[d[3]] != EMPTY_VOXEL) ){
 										for(int i = 0; i < 2; i++){
 											isFixing = true;
-											voxels[d[i]] = EMPTY_VOXEL;
+											voxels.reset(d[i]);
 											surface_voxels.insert( d[i] );
 											//if(false) container.aux.push_back( VoxelData<Vector3>(d[i], true) ); // DEBUG
 										}
@@ -609,10 +610,8 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 
 			// Collect inner voxels
 			container.data.clear(); // remove surface voxels
-			for(uint64_t m = 0; m < morton_part; m++){
-				if(voxels[m] == EMPTY_VOXEL){
-					container.data.push_back( VoxelData<Vector3>(m, (surface_voxels.find(m) != surface_voxels.end())) );
-				}
+			for(auto m : voxels.emptyVoxels(gridsize)){
+				container.data.push_back( VoxelData<Vector3>(m, (surface_voxels.find(m) != surface_voxels.end())) );
 			}
 
 			// Collect set of pair voxels (inside / outside)
@@ -683,10 +682,8 @@ inline VoxelContainer<Vector3> ComputeVoxelization( SurfaceMeshModel * mesh, siz
 		{
 			// Just collect voxels
 			container.data.clear();
-			for(uint64_t m = 0; m < morton_part; m++){
-				if(voxels[m] == EMPTY_VOXEL)
-					container.data.push_back( VoxelData<Vector3>(m, (surface_voxels.find(m) != surface_voxels.end())) );
-			}
+			for(auto m : voxels.emptyVoxels(gridsize))
+				container.data.push_back( VoxelData<Vector3>(m, (surface_voxels.find(m) != surface_voxels.end())) );
 		}
 	}
 
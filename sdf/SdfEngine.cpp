@@ -0,0 +1,155 @@
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+
+#include "SdfEngine.h"
+
+SdfEngine::SdfEngine( SurfaceMesh::SurfaceMeshModel * mesh, const Options & options ) : options(options)
+{
+	// Acceleration structure
+	std::vector<Eigen::Vector3f> vertices;
+	std::vector<Eigen::Vector3i> faces;
+	for(auto v : mesh->vertices()) vertices.push_back( mesh->vertex_coordinates()[v].cast<float>() );
+	for(auto f : mesh->faces())
+	{
+		std::vector<int> tri;
+		for(auto v : mesh->vertices(f)) tri.push_back(v.idx());
+		faces.push_back( Eigen::Vector3i(tri[0], tri[1], tri[2]) );
+	}
+	bvh.build( vertices, faces );
+
+	// Cone template
+	const double gaussianVar = 120.0 * DEG2RAD;
+	double gaussianDiv2 = 1.0 / (2.0 * pow(gaussianVar,2));
+
+	for(int i = 0; i < options.numCones; i++)
+	{
+		double degree = options.coneSeparation * DEG2RAD * (i+1);
+		coneHalfCos.push_back( cos(degree * 0.5) );
+		coneHalfSin.push_back( sin(degree * 0.5) );
+		coneWeight.push_back( options.gaussianWeights ? expf(-pow(degree, 2) * gaussianDiv2) : 1.0 );
+	}
+
+	double theta = 2.0 * M_PI / options.raysInCone;
+	for(int j = 0; j < options.raysInCone; j++)
+	{
+		spinCos.push_back( cos(theta * j) );
+		spinSin.push_back( sin(theta * j) );
+	}
+}
+
+void SdfEngine::fanDirections( const Vector3 & n, Eigen::Vector3f * directions ) const
+{
+	// First ray goes straight opposite to the normal
+	Vector3 v = -n.normalized();
+	directions[0] = v.cast<float>();
+
+	// Cones tilt about an axis orthogonal to the normal. That axis is not unit length,
+	// so the tilt is reproduced exactly as the quaternion it used to build applies it.
+	Vector3 a = orthogonalVector(n);
+	double s2 = a.squaredNorm();
+	Vector3 u = a.cross(v);
+	Vector3 w = n.normalized().cross(u);
+
+	int r = 1;
+	for(int i = 0; i < options.numCones; i++)
+	{
+		double alpha = 1.0 - 2.0 * coneHalfSin[i] * coneHalfSin[i] * s2;
+		double beta = 2.0 * coneHalfCos[i] * coneHalfSin[i];
+
+		for(int j = 0; j < options.raysInCone; j++)
+			directions[r++] = (alpha * v + beta * (spinCos[j] * u + spinSin[j] * w)).normalized().cast<float>();
+	}
+}
+
+double SdfEngine::aggregate( Sample * samples, int count ) const
+{
+	if( !options.robust )
+	{
+		double distanceCounter = 0.0, intersectionCounter = 0.0;
+		for(int i = 0; i < count; i++){
+			distanceCounter += samples[i].first * samples[i].second;
+			intersectionCounter += samples[i].second;
+		}
+		return distanceCounter / intersectionCounter;
+	}
+
+	auto weightedMedian = [&]( int n ){
+		std::sort(samples, samples + n, [](const Sample & x, const Sample & y){ return x.first < y.first; });
+		double total = 0, acc = 0;
+		for(int i = 0; i < n; i++) total += samples[i].second;
+		for(int i = 0; i < n; i++){
+			acc += samples[i].second;
+			if( acc >= total * 0.5 ) return double(samples[i].first);
+		}
+		return n ? double(samples[n-1].first) : 0.0;
+	};
+
+	if( count == 0 ) return 0;
+
+	// Discard samples further than one standard deviation from the median
+	double median = weightedMedian( count );
+	double mean = 0, var = 0;
+	for(int i = 0; i < count; i++) mean += samples[i].first;
+	mean /= count;
+	for(int i = 0; i < count; i++) var += pow(samples[i].first - mean, 2);
+	double stddev = sqrt(var / count);
+
+	int kept = 0;
+	for(int i = 0; i < count; i++)
+		if( std::abs(samples[i].first - median) <= stddev )
+			samples[kept++] = samples[i];
+
+	return kept ? weightedMedian( kept ) : median;
+}
+
+double SdfEngine::compute( const Vector3 & p, const Vector3 & n ) const
+{
+	typedef raytracing::FlatBVH BVH;
+	int numRays = raysPerVertex();
+
+	std::vector<Eigen::Vector3f> dirs( numRays ), origins( numRays );
+	std::vector<float> tfar( numRays );
+	std::vector<int> faceid( numRays );
+	std::vector<Sample> samples;
+	samples.reserve( numRays );
+
+	fanDirections( n, &dirs[0] );
+	for(int r = 0; r < numRays; r++){
+		origins[r] = (p + dirs[r].cast<double>() * 1e-6).cast<float>();
+		tfar[r] = std::numeric_limits<float>::infinity();
+	}
+
+	for(int r = 0; r < numRays; r += BVH::PacketSize)
+		bvh.intersectPacket( &origins[r], &dirs[r], std::min(int(BVH::PacketSize), numRays - r), &tfar[r], &faceid[r] );
+
+	for(int r = 0; r < numRays; r++)
+	{
+		if( faceid[r] < 0 ) continue;
+		double weight = (r == 0) ? 1.0 : coneWeight[ (r - 1) / options.raysInCone ];
+		samples.push_back( Sample(tfar[r], weight) );
+	}
+
+	return aggregate( samples.data(), int(samples.size()) );
+}
+
+bool SdfEngine::compute( const std::vector<Vector3> & points, const std::vector<Vector3> & normals,
+	std::vector<double> & result, ProgressCallback progress ) const
+{
+	int N = int(points.size());
+	result.resize( N );
+
+	const int chunkSize = 4096;
+	for(int start = 0; start < N; start += chunkSize)
+	{
+		int end = std::min(start + chunkSize, N);
+
+		#pragma omp parallel for
+		for(int i = start; i < end; i++)
+			result[i] = compute( points[i], normals[i] );
+
+		if( progress && !progress(end, N) ) return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include "SurfaceMeshModel.h"
+#include "FlatBVH.h"
+
+#define DEG2RAD 0.01745329
+
+static inline Vector3 orthogonalVector(const Vector3& n) {
+	if ((abs(n.y()) >= 0.9 * abs(n.x())) &&
+		abs(n.z()) >= 0.9 * abs(n.x())) return Vector3(0.0, -n.z(), n.y());
+	else if ( abs(n.x()) >= 0.9 * abs(n.y()) &&
+		abs(n.z()) >= 0.9 * abs(n.y()) ) return Vector3(-n.z(), 0.0, n.x());
+	else return Vector3(-n.y(), n.x(), 0.0);
+}
+
+// Shape diameter function over a flattened BVH. The cone of rays is laid out
+// once as a template and each vertex traces its whole fan as ray packets.
+class SdfEngine
+{
+public:
+	struct Options{
+		int numCones, raysInCone;
+		double coneSeparation;		// degrees between consecutive cones
+		bool gaussianWeights;
+		bool robust;				// reject outliers and take the weighted median
+		Options() : numCones(4), raysInCone(8), coneSeparation(20.0), gaussianWeights(true), robust(false) {}
+	};
+
+	// Called with (done, total) between chunks of vertices, returning false cancels
+	typedef std::function<bool(int,int)> ProgressCallback;
+
+	SdfEngine( SurfaceMesh::SurfaceMeshModel * mesh, const Options & options = Options() );
+
+	// Fills one value per point, returns false when cancelled
+	bool compute( const std::vector<Vector3> & points, const std::vector<Vector3> & normals,
+		std::vector<double> & result, ProgressCallback progress = ProgressCallback() ) const;
+
+	double compute( const Vector3 & p, const Vector3 & n ) const;
+
+protected:
+	Options options;
+	raytracing::FlatBVH bvh;
+
+	// Cone template, shared by all vertices
+	std::vector<double> coneHalfCos, coneHalfSin, coneWeight;
+	std::vector<double> spinCos, spinSin;
+
+	int raysPerVertex() const { return 1 + options.numCones * options.raysInCone; }
+	void fanDirections( const Vector3 & n, Eigen::Vector3f * directions ) const;
+	typedef std::pair<float,float> Sample;	// (distance, weight)
+	double aggregate( Sample * samples, int count ) const;
+};
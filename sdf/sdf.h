@@ -5,8 +5,6 @@
 
 #include <Eigen/Sparse>
 
-#include "Octree.h"
-
 class sdf: public SurfaceMeshFilterPlugin{
     Q_OBJECT
     Q_PLUGIN_METADATA(IID "sdf.plugin.starlab")
@@ -18,8 +16,4 @@ public:
 
     void initParameters(RichParameterSet* pars);
     void applyFilter(RichParameterSet* pars);
-
-	static double compute_volume(const Vector3 & p, const Vector3 & n, 
-		int numCones, double coneSeparation, int raysInCone, bool gaussianWeights, 
-		Octree * octree, QList<Ray> * allRays = 0);
 };
@@ -1,7 +1,9 @@
 include($$[STARLAB])
 include($$[SURFACEMESH])
-include($$[OCTREE])
 StarlabTemplate(plugin)
 
-HEADERS += sdf.h
-SOURCES += sdf.cpp
+HEADERS += sdf.h SdfEngine.h
+SOURCES += sdf.cpp SdfEngine.cpp
+
+# Shared flattened BVH
+INCLUDEPATH += ../particles